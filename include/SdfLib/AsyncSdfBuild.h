@@ -0,0 +1,61 @@
+#ifndef ASYNC_SDF_BUILD_H
+#define ASYNC_SDF_BUILD_H
+
+#include <memory>
+#include <future>
+#include <functional>
+
+#include "SdfFunction.h"
+#include "utils/BuildProgress.h"
+
+namespace sdflib
+{
+/**
+ * @brief Builds a structure in a background thread, reporting its progress and allowing its cancellation.
+ *        The build function runs with the progress of the handle as the current progress of its thread,
+ *        so any structure constructor called inside it reports to the handle.
+ **/
+class AsyncSdfBuild
+{
+public:
+    typedef std::function<std::unique_ptr<SdfFunction>()> BuildFunction;
+
+    /**
+     * @brief Starts the construction in a new thread
+     * @param buildFunction Function building the structure. The objects used by the function must
+     *                      be kept alive until the construction has finished.
+     **/
+    AsyncSdfBuild(BuildFunction buildFunction);
+
+    /**
+     * @brief Cancels the construction and waits for it to finish
+     **/
+    ~AsyncSdfBuild();
+
+    AsyncSdfBuild(const AsyncSdfBuild&) = delete;
+    AsyncSdfBuild& operator=(const AsyncSdfBuild&) = delete;
+
+    bool isFinished() const;
+    void wait() const;
+
+    /**
+     * @brief Requests the construction to stop. It does not wait for the construction to finish.
+     **/
+    void cancel() { mProgress.cancel(); }
+    bool isCancelled() const { return mProgress.isCancelled(); }
+
+    const BuildProgress& getProgress() const { return mProgress; }
+
+    /**
+     * @brief Waits for the construction and releases the structure
+     * @return The built structure or null if the construction has been cancelled,
+     *         or if the structure has already been taken
+     **/
+    std::unique_ptr<SdfFunction> getResult();
+private:
+    BuildProgress mProgress;
+    std::future<std::unique_ptr<SdfFunction>> mResult;
+};
+}
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef BUILD_CACHE_H
+#define BUILD_CACHE_H
+
+#include <string>
+#include <memory>
+
+#include "utils/Mesh.h"
+#include "SdfFunction.h"
+#include "OctreeSdf.h"
+#include "ExactOctreeSdf.h"
+#include "UniformGridSdf.h"
+
+namespace sdflib
+{
+/**
+ * @brief Stores the built structures in a directory and reuses them when the same
+ *        structure is requested again. Each structure is identified by a hash of
+ *        the mesh vertices and indices combined with all the build parameters.
+ **/
+class BuildCache
+{
+public:
+    /**
+     * @param cacheDirectory The directory where the structures are stored. It is created if it does not exist.
+     **/
+    BuildCache(const std::string& cacheDirectory);
+
+    /**
+     * @brief Returns the octree stored in the cache or builds it and stores it in the cache.
+     *        The parameters are the same as the OctreeSdf constructor.
+     *        If the construction is cancelled through its BuildProgress, the coarse result is returned but not stored.
+     **/
+    std::unique_ptr<OctreeSdf> getOctreeSdf(const Mesh& mesh, BoundingBox box, uint32_t depth, uint32_t startDepth,
+                                            float terminationThreshold = 1e-3,
+                                            OctreeSdf::InitAlgorithm initAlgorithm = OctreeSdf::InitAlgorithm::NO_CONTINUITY,
+                                            uint32_t numThreads = 1,
+                                            OctreeSdf::InterpolationType interpolationType = OctreeSdf::InterpolationType::TRICUBIC,
+                                            float narrowBand = 0.0f,
+                                            bool anisotropicStartGrid = false,
+                                            const std::vector<OctreeSdf::RefinementRegion>& refinementRegions = {});
+
+    /**
+     * @brief Returns the exact octree stored in the cache or builds it and stores it in the cache.
+     *        The parameters are the same as the ExactOctreeSdf constructor.
+     *        If the construction is cancelled through its BuildProgress, the coarse result is returned but not stored.
+     **/
+    std::unique_ptr<ExactOctreeSdf> getExactOctreeSdf(const Mesh& mesh, BoundingBox box, uint32_t maxDepth,
+                                                      uint32_t startDepth = 1, uint32_t minTrianglesPerNode = 128,
+                                                      uint32_t numThreads = 1, float narrowBand = 0.0f,
+                                                      bool anisotropicStartGrid = false,
+                                                      bool compactSerialization = false);
+
+    /**
+     * @brief Returns the uniform grid stored in the cache or builds it and stores it in the cache.
+     *        The parameters are the same as the UniformGridSdf constructor.
+     *        If the construction is cancelled through its BuildProgress, the coarse result is returned but not stored.
+     **/
+    std::unique_ptr<UniformGridSdf> getUniformGridSdf(const Mesh& mesh, BoundingBox box, uint32_t depth,
+                                                      UniformGridSdf::InitAlgorithm initAlgorithm = UniformGridSdf::InitAlgorithm::OCTREE,
+                                                      float narrowBand = 0.0f);
+
+    /**
+     * @return A 64-bit hash of the mesh vertices and indices
+     **/
+    static uint64_t hashMesh(const Mesh& mesh);
+
+    /**
+     * @return The path of the file storing the structure with the given key
+     **/
+    std::string getEntryPath(uint64_t key) const;
+
+    uint32_t getNumHits() const { return mNumHits; }
+    uint32_t getNumMisses() const { return mNumMisses; }
+
+    /**
+     * @return If the last returned structure is the coarse result of a cancelled construction.
+     *         These structures are not stored in the cache.
+     **/
+    bool isLastResultPartial() const { return mLastResultPartial; }
+private:
+    // Incremented when the stored structures or the builders change
+    static constexpr uint32_t CACHE_VERSION = 2;
+
+    std::string mCacheDirectory;
+    uint32_t mNumHits = 0;
+    uint32_t mNumMisses = 0;
+    bool mLastResultPartial = false;
+
+    std::unique_ptr<SdfFunction> loadEntry(uint64_t key, SdfFunction::SdfFormat format);
+    void storeEntry(uint64_t key, SdfFunction& sdf);
+    // Stores the built structure unless its construction has been cancelled
+    void storeBuiltEntry(uint64_t key, SdfFunction& sdf);
+};
+}
+
+#endif
@@ -2,9 +2,13 @@
 #define EXACT_OCTREE_SDF_H
 
 #include <array>
+#include <atomic>
+#include <cstring>
+#include <mutex>
 
 #include "utils/Mesh.h"
 #include "utils/TriangleUtils.h"
+#include "utils/Timer.h"
 #include "utils/UsefullSerializations.h"
 #include "SdfFunction.h"
 
@@ -31,6 +35,7 @@ public:
      * 
      *        If it is a leaf node, it only stores a index pointing 
      *          to the set of triangles influencing the node.
+     *        The leaves outside the narrow band store a lower bound of the distance instead.
      **/ 
     struct OctreeNode
     {
@@ -48,6 +53,8 @@ public:
 
         static constexpr uint32_t IS_LEAF_MASK = 1 << 31;
         static constexpr uint32_t CHILDREN_INDEX_MASK = ~IS_LEAF_MASK;
+        // Children index of the leaves outside the narrow band
+        static constexpr uint32_t FAR_LEAF_INDEX = CHILDREN_INDEX_MASK - 1;
         
         uint32_t childrenIndex;
         uint32_t trianglesArrayIndex;
@@ -57,6 +64,24 @@ public:
             return childrenIndex & IS_LEAF_MASK;
         }
 
+        inline bool isFarLeaf() const
+        {
+            return childrenIndex == (IS_LEAF_MASK | FAR_LEAF_INDEX);
+        }
+
+        inline float getFarLeafDistance() const
+        {
+            float distance;
+            std::memcpy(&distance, &trianglesArrayIndex, sizeof(float));
+            return distance;
+        }
+
+        inline void setFarLeaf(float distance)
+        {
+            setValues(true, FAR_LEAF_INDEX);
+            std::memcpy(&trianglesArrayIndex, &distance, sizeof(float));
+        }
+
         inline uint32_t getChildrenIndex() const
         {
             return childrenIndex & CHILDREN_INDEX_MASK;
@@ -87,16 +112,25 @@ public:
      *                            All the leaves before the maximum depth must have less than 
      *                            this minimum influencing them.
      * @param numThreads The maximum number of threads to use during the structure construction.
+     * @param narrowBand If it is greater than zero, the nodes farther than the band from the surface
+     *                   end as leaves returning a guaranteed lower bound of the distance, instead of the exact distance.
+     *                   Only the nodes storing their own set of triangles can end outside the band.
+     * @param anisotropicStartGrid If it is true, the start grid has as many cubic cells in each axis as needed
+     *                             to cover the box, instead of expanding the box to a cube.
+     * @param compactSerialization If it is true, the structure keeps a copy of the mesh to store it
+     *                             instead of the triangles data. See setCompactSerialization.
      **/
     ExactOctreeSdf(const Mesh& mesh, BoundingBox box, uint32_t maxDepth,
                    uint32_t startDepth=1, uint32_t minTrianglesPerNode = 128,
-                   uint32_t numThreads=1);
+                   uint32_t numThreads=1, float narrowBand = 0.0f,
+                   bool anisotropicStartGrid = false,
+                   bool compactSerialization = false);
 
     /**
      * @return The size of the start grid containing all 
      *          the nodes of the start depth stored sequentially 
      **/
-    glm::ivec3 getStartGridSize() const { return glm::ivec3(mStartGridSize); }
+    glm::ivec3 getStartGridSize() const { return mStartGridSize; }
 
     /**
      * @return The octree bounding box
@@ -129,39 +163,114 @@ public:
      **/
     const std::vector<TriangleUtils::TriangleData>& getTrianglesData() { return mTrianglesData; }
 
+    /**
+     * @return The array storing the sets of triangles influencing the nodes
+     **/
+    const std::vector<uint32_t>& getTrianglesSets() const { return mTrianglesSets; }
+
+    /**
+     * @return The array of masks selecting the triangles of the parent set influencing each node
+     **/
+    const std::vector<uint8_t>& getTrianglesMasks() const { return mTrianglesMasks; }
+
+    /**
+     * @brief Selects if the structure is stored with the mesh vertices and indices instead of the triangles data.
+     *        The compact files are much smaller, and the triangles data is rebuilt in parallel when they are loaded.
+     *        It needs the copy of the mesh kept by the structures built with compactSerialization
+     *        or loaded from compact files. Disabling it releases the mesh, so it cannot be enabled again.
+     **/
+    void setCompactSerialization(bool compact);
+    bool hasCompactSerialization() const { return mCompactSerialization && !mMeshIndices.empty(); }
+
+    /**
+     * @return The bytes used by the nodes, the triangles sets and masks and the triangles data.
+     *         The copy of the mesh for the compact serialization is counted with the triangles data.
+     **/
+    MemoryUsage memoryUsage() const override;
+
     float getDistance(glm::vec3 sample) const override;
     float getDistance(glm::vec3 sample, glm::vec3& outGradient) const override;
     SdfFormat getFormat() const override { return SdfFormat::EXACT_OCTREE; }
 
+    /**
+     * @brief Returns a guaranteed interval containing all the values of the field inside a region.
+     *        The interval of each leaf is computed from the distance at its center, 
+     *        because the field changes at most one unit per unit of length.
+     *        The intervals are computed in parallel by the first call, so the structures
+     *        not using this query do not pay their time and memory.
+     * @param box The region of the space
+     * @return The minimum value of the interval in the x component and the maximum in the y component
+     **/
+    glm::vec2 getDistanceBounds(BoundingBox box) const;
+
 
     // Load and save function for storing the structure on disk
     template<class Archive>
     void save(Archive & archive) const
     { 
-        archive(mBox, mStartGridSize, mStartDepth, mMinTrianglesInLeafs, mMaxTrianglesInLeafs, mMaxTrianglesEncodedInLeafs, mBitEncodingStartDepth, mBitsPerIndex, mMaxDepth, mOctreeData, mTrianglesSets, mTrianglesMasks, mTrianglesData);
+        archive(mBox);
+        saveStartGridSize(archive, mStartGridSize);
+        archive(mStartDepth, mMinTrianglesInLeafs, mMaxTrianglesInLeafs, mMaxTrianglesEncodedInLeafs, mBitEncodingStartDepth, mBitsPerIndex, mMaxDepth);
+        saveBulkArray(archive, mOctreeData, BlockCompression::Codec::INTEGERS);
+        saveBulkIndexSets(archive, mTrianglesSets, mBitsPerIndex);
+        saveBulkBytes(archive, mTrianglesMasks);
+        if(hasCompactSerialization() || mTrianglesData.empty())
+        {
+            // An empty triangles data array marks the compact files
+            saveBulkArray(archive, std::vector<TriangleUtils::TriangleData>(), BlockCompression::Codec::FLOATS);
+            archive(mMeshBox);
+            saveBulkArray(archive, mMeshVertices, BlockCompression::Codec::FLOATS);
+            saveBulkArray(archive, mMeshIndices, BlockCompression::Codec::INTEGERS);
+        }
+        else
+        {
+            saveBulkArray(archive, mTrianglesData, BlockCompression::Codec::FLOATS);
+        }
     }
 
     template<class Archive>
     void load(Archive & archive)
     {
-        archive(mBox, mStartGridSize, mStartDepth, mMinTrianglesInLeafs, mMaxTrianglesInLeafs, mMaxTrianglesEncodedInLeafs, mBitEncodingStartDepth, mBitsPerIndex, mMaxDepth, mOctreeData, mTrianglesSets, mTrianglesMasks, mTrianglesData);
+        loadVersion(archive, SdfFunction::FILE_VERSION);
+    }
+
+    /**
+     * @brief Loads the structure stored by the given version of the file container
+     * @param fileVersion The version in the file header, or LEGACY_FILE_VERSION for the files without header
+     **/
+    template<class Archive>
+    void loadVersion(Archive & archive, uint32_t fileVersion)
+    {
+        archive(mBox);
+        loadStartGridSize(archive, mStartGridSize);
+        archive(mStartDepth, mMinTrianglesInLeafs, mMaxTrianglesInLeafs, mMaxTrianglesEncodedInLeafs, mBitEncodingStartDepth, mBitsPerIndex, mMaxDepth);
+        loadBulkArray(archive, mOctreeData, BlockCompression::Codec::INTEGERS);
+        loadBulkIndexSets(archive, mTrianglesSets, mBitsPerIndex);
+        loadBulkBytes(archive, mTrianglesMasks);
+        loadBulkArray(archive, mTrianglesData, BlockCompression::Codec::FLOATS);
+
+        // The compact files store an empty triangles data array followed by the mesh.
+        // The legacy files always end after the triangles data
+        mMeshVertices.clear();
+        mMeshIndices.clear();
+        if(mTrianglesData.empty() && fileVersion != SdfFunction::LEGACY_FILE_VERSION)
+        {
+            archive(mMeshBox);
+            loadBulkArray(archive, mMeshVertices, BlockCompression::Codec::FLOATS);
+            loadBulkArray(archive, mMeshIndices, BlockCompression::Codec::INTEGERS);
+
+            if(!mMeshIndices.empty()) rebuildTrianglesData();
+        }
+        mCompactSerialization = !mMeshIndices.empty();
         
-        mStartGridCellSize = mBox.getSize().x / static_cast<float>(mStartGridSize);
-        mStartGridXY = mStartGridSize * mStartGridSize;
+        mStartGridCellSize = mBox.getSize().x / static_cast<float>(mStartGridSize.x);
+        mStartGridXY = mStartGridSize.x * mStartGridSize.y;
 
-        mTrianglesCache[0].resize(mMaxTrianglesEncodedInLeafs);
-        mTrianglesCache[1].resize(mMaxTrianglesEncodedInLeafs);
+        mNodesBounds = LazyNodesBounds();
+        mConstructionPeakMemory = 0;
         
         // Print structure size
-        SPDLOG_INFO("Octree Data: {}", mOctreeData.size() * sizeof(OctreeNode));
-        SPDLOG_INFO("Triangle Sets: {}", mTrianglesSets.size() * sizeof(uint32_t));
-        SPDLOG_INFO("Triangle Masks: {}", mTrianglesMasks.size());
-        SPDLOG_INFO("Triangle Data: {}", mTrianglesData.size() * sizeof(TriangleUtils::TriangleData));
-
-        float total = mOctreeData.size() * sizeof(OctreeNode) + mTrianglesSets.size() * sizeof(uint32_t) + mTrianglesMasks.size() + mTrianglesData.size() * sizeof(TriangleUtils::TriangleData);
-        SPDLOG_INFO("Total: {}MB", total/1048576.0f);
-        total = mOctreeData.size() * sizeof(OctreeNode) + mTrianglesSets.size() * sizeof(uint32_t) + mTrianglesMasks.size();
-        SPDLOG_INFO("Octree: {}MB", total/1048576.0f);
+        memoryUsage().print();
     }
 
 private:
@@ -174,9 +283,6 @@ private:
     // Octree bounding box
     BoundingBox mBox;
 
-    // Array used to decode the bit encoding during the structure queries
-    mutable std::array<std::vector<uint32_t>, 2> mTrianglesCache;
-
     // Structure properties
     uint32_t mMinTrianglesInLeafs;
     uint32_t mMaxTrianglesInLeafs;
@@ -186,9 +292,11 @@ private:
     uint32_t mBitsPerIndex;
 
     uint32_t mMaxDepth;
+    // Distance outside which the nodes are not subdivided, only used during the construction
+    float mNarrowBand = 0.0f;
 
     // Octree start grid
-    int mStartGridSize = 0;
+    glm::ivec3 mStartGridSize = glm::ivec3(0);
     int mStartGridXY = 0;
     uint32_t mStartDepth = 0;
     float mStartGridCellSize = 0.0f;
@@ -200,6 +308,30 @@ private:
                                           // Each triangle is stored using only a specific number of bits (mBitsPerIndex attribute)
     std::vector<uint8_t> mTrianglesMasks; // List storing sets of triangles bit encoded
     std::vector<TriangleUtils::TriangleData> mTrianglesData; // Triangle properties
+    // Interval of values of each node, stored in the same order than the nodes.
+    // They are computed by the first bounds query, the copies of the structure compute them again
+    struct LazyNodesBounds
+    {
+        std::vector<glm::vec2> values;
+        std::atomic<bool> computed{false};
+        std::mutex mutex;
+
+        LazyNodesBounds() {}
+        LazyNodesBounds(const LazyNodesBounds&) {}
+        LazyNodesBounds& operator=(const LazyNodesBounds&)
+        {
+            values.clear();
+            computed.store(false, std::memory_order_relaxed);
+            return *this;
+        }
+    };
+    mutable LazyNodesBounds mNodesBounds;
+
+    // Input mesh, only kept with the compact serialization to rebuild the triangles data of the compact files
+    std::vector<glm::vec3> mMeshVertices;
+    std::vector<uint32_t> mMeshIndices;
+    BoundingBox mMeshBox;
+    bool mCompactSerialization = false;
 
     template<typename TrianglesInfluenceStrategy>
     void initOctree(const Mesh& mesh, uint32_t startDepth, uint32_t maxDepth,
@@ -211,6 +343,22 @@ private:
                                     std::vector<uint32_t>& differentTriangles);
 
     void calculateStatistics();
+    void computeNodesBounds() const;
+    // Distance query, the internal queries of the structure are not counted in the query statistics
+    template<bool COUNT_QUERY> float getDistanceKernel(glm::vec3 sample) const;
+    void rebuildTrianglesData();
+
+    // Cube subdivided by the octree, which only differs from the box with an anisotropic start grid
+    BoundingBox getStartGridCube() const
+    {
+        if(mStartGridSize.x == mStartGridSize.y && mStartGridSize.x == mStartGridSize.z) return mBox;
+        return BoundingBox(mBox.min, mBox.min + mStartGridCellSize * static_cast<float>(1 << mStartDepth));
+    }
+    // If the node is beyond the start grid cells, which only happens with an anisotropic start grid
+    bool isOutsideStartGrid(glm::vec3 nodeCenter, float nodeHalfSize) const
+    {
+        return glm::any(glm::greaterThan(nodeCenter - nodeHalfSize, mBox.max - 0.5f * mStartGridCellSize));
+    }
 };
 }
 
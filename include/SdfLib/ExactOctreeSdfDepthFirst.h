@@ -3,6 +3,7 @@
 
 #include <string>
 #include <stack>
+#include "SdfLib/utils/BuildProgress.h"
 #ifdef OPENMP_AVAILABLE
 #include <omp.h>
 #endif
@@ -45,8 +46,10 @@ void ExactOctreeSdf::initOctree(const Mesh& mesh, uint32_t startDepth, uint32_t
         uint32_t bitEncodingStartDepth;
         uint32_t bitsPerIndex;
         uint32_t minTrianglesPerNode;
+        float narrowBand;
         uint32_t maxTrianglesInLeafs;
         uint32_t maxTrianglesEncodedInLeafs;
+        size_t peakMemory; // High-water mark of the thread buffers
         uint32_t padding[16];
 
 #ifdef SDFLIB_PRINT_STATISTICS
@@ -64,6 +67,7 @@ void ExactOctreeSdf::initOctree(const Mesh& mesh, uint32_t startDepth, uint32_t
 
     std::vector<TriangleUtils::TriangleData>& trianglesData = mTrianglesData;
     const uint32_t startOctreeDepth = glm::min(startDepth, START_OCTREE_DEPTH);
+    BuildProgress* progress = BuildProgress::getCurrent();
 
     uint32_t bitEncodingStartDepth = maxDepth - BIT_ENCODING_DEPTH;
     mBitEncodingStartDepth = bitEncodingStartDepth;
@@ -76,15 +80,17 @@ void ExactOctreeSdf::initOctree(const Mesh& mesh, uint32_t startDepth, uint32_t
     mainThread.trianglesCache.resize(maxDepth - startOctreeDepth + 2);
     mainThread.outputTrianglesCache.fill(std::vector<uint32_t>());
     mainThread.outputTrianglesMaskCache.fill(std::vector<uint8_t>());
-    mainThread.trianglesInfluence.initCaches(mBox, maxDepth);
+    mainThread.trianglesInfluence.initCaches(getStartGridCube(), maxDepth);
     mainThread.startDepth = startDepth;
     mainThread.startOctreeDepth = startOctreeDepth;
     mainThread.maxDepth = maxDepth;
     mainThread.bitEncodingStartDepth = bitEncodingStartDepth;
     mainThread.bitsPerIndex = bitsPerIndex;
     mainThread.minTrianglesPerNode = minTrianglesPerNode;
+    mainThread.narrowBand = mNarrowBand;
     mainThread.maxTrianglesInLeafs = 0;
     mainThread.maxTrianglesEncodedInLeafs = 0;
+    mainThread.peakMemory = 0;
 
 #ifdef SDFLIB_PRINT_STATISTICS
     mainThread.verticesStatistics.resize(maxDepth + 1, std::make_pair(0, 0));
@@ -127,7 +133,7 @@ void ExactOctreeSdf::initOctree(const Mesh& mesh, uint32_t startDepth, uint32_t
     
     {
         std::stack<NodeInfo>& nodes = mainThread.nodesStack;
-        float newSize = 0.5f * mBox.getSize().x * glm::pow(0.5f, startOctreeDepth);
+        float newSize = 0.5f * getStartGridCube().getSize().x * glm::pow(0.5f, startOctreeDepth);
         const glm::vec3 startCenter = mBox.min + newSize;
         const uint32_t voxlesPerAxis = 1 << startOctreeDepth;
 
@@ -137,6 +143,7 @@ void ExactOctreeSdf::initOctree(const Mesh& mesh, uint32_t startDepth, uint32_t
             {
                 for(uint32_t i=0; i < voxlesPerAxis; i++)
                 {
+                    if(isOutsideStartGrid(startCenter + glm::vec3(i, j, k) * 2.0f * newSize, newSize)) continue;
                     nodes.push(NodeInfo(0, std::numeric_limits<uint32_t>::max(), startOctreeDepth, startCenter + glm::vec3(i, j, k) * 2.0f * newSize, newSize));
                     NodeInfo& n = nodes.top();
                     std::array<float, InterpolationMethod::NUM_COEFFICIENTS> nullArray;
@@ -147,12 +154,28 @@ void ExactOctreeSdf::initOctree(const Mesh& mesh, uint32_t startDepth, uint32_t
                 }
             }
         }
+
+        if(progress != nullptr) progress->addEstimatedNodes(startOctreeDepth, nodes.size());
     }
 
     mMaxTrianglesInLeafs = 0;
     mMaxTrianglesEncodedInLeafs = 0;
 
-    auto processNode = [&mesh, &trianglesData] (const NodeInfo& node, ThreadContext& tContext, 
+    // Current size of the thread buffers. The stack shrinks and the triangles arrays are replaced
+    // during the construction, so each thread samples it after growing them to keep its high-water mark
+    auto getContextMemory = [](const ThreadContext& tContext) -> size_t
+    {
+        size_t bytes = tContext.nodesStack.size() * sizeof(NodeInfo);
+        for(const std::array<std::vector<uint32_t>, 8>& depthTriangles : tContext.triangles)
+        {
+            for(const std::vector<uint32_t>& triangles : depthTriangles) bytes += MemoryUsage::getBytes(triangles);
+        }
+        for(const std::vector<uint32_t>& triangles : tContext.outputTrianglesCache) bytes += MemoryUsage::getBytes(triangles);
+        for(const std::vector<uint8_t>& masks : tContext.outputTrianglesMaskCache) bytes += MemoryUsage::getBytes(masks);
+        return bytes;
+    };
+
+    auto processNode = [&mesh, &trianglesData, progress, &getContextMemory] (const NodeInfo& node, ThreadContext& tContext, 
                                                 std::vector<OctreeNode>& outputOctree,
                                                 std::vector<uint32_t>& outputTrianglesSets,
                                                 std::vector<uint8_t>& outputTrianglesMasks)
@@ -282,10 +305,12 @@ void ExactOctreeSdf::initOctree(const Mesh& mesh, uint32_t startDepth, uint32_t
                 tContext.maxTrianglesEncodedInLeafs = glm::max(tContext.maxTrianglesEncodedInLeafs, numTriangles);
             }
 
+            tContext.peakMemory = glm::max(tContext.peakMemory, getContextMemory(tContext));
             return;
         }
 
         std::array<float, InterpolationMethod::NUM_COEFFICIENTS> interpolationCoeff;
+        if(progress != nullptr) progress->addProcessedNodes(node.depth);
 
         const std::vector<uint32_t>& parentTriangles = *tContext.trianglesCache[rDepth - 1];
         std::vector<uint32_t>& nodeTriangles = tContext.triangles[rDepth][node.childIndex];
@@ -296,9 +321,35 @@ void ExactOctreeSdf::initOctree(const Mesh& mesh, uint32_t startDepth, uint32_t
         tContext.nodesStack.top().trianglesProcessed = true;
 
         bool isTerminalNode = false;
+        bool isFarNode = false;
+        float farNodeDistance = 0.0f;
         if(node.depth >= tContext.startDepth)
         {
-            isTerminalNode = nodeTriangles.size() <= tContext.minTrianglesPerNode;
+            // The nodes storing their own set of triangles end outside the narrow band.
+            // The filtered triangles contain the nearest triangle of any point of the node
+            if(tContext.narrowBand > 0.0f && node.depth <= tContext.bitEncodingStartDepth && !nodeTriangles.empty())
+            {
+                float minDist = INFINITY;
+                uint32_t minIndex = 0;
+                for(uint32_t t : nodeTriangles)
+                {
+                    const float dist = TriangleUtils::getSqDistPointAndTriangle(node.center, trianglesData[t]);
+                    if(dist < minDist)
+                    {
+                        minIndex = t;
+                        minDist = dist;
+                    }
+                }
+
+                const float centerDist = TriangleUtils::getSignedDistPointAndTriangle(node.center, trianglesData[minIndex]);
+                const float lowerBound = glm::abs(centerDist) - glm::sqrt(3.0f) * node.size;
+                isFarNode = lowerBound >= tContext.narrowBand;
+                farNodeDistance = (centerDist < 0.0f) ? -lowerBound : lowerBound;
+            }
+
+            // A cancelled construction ends the branches at the current depth
+            isTerminalNode = isFarNode || nodeTriangles.size() <= tContext.minTrianglesPerNode ||
+                             (progress != nullptr && progress->isCancelled());
         }
     
 
@@ -324,6 +375,7 @@ void ExactOctreeSdf::initOctree(const Mesh& mesh, uint32_t startDepth, uint32_t
             if(octreeNode != nullptr) octreeNode->setValues(false, childIndex);
 
             if(node.depth >= tContext.startDepth) outputOctree.resize(outputOctree.size() + 8);
+            if(progress != nullptr) progress->addEstimatedNodes(node.depth + 1, 8);
 
             // Low Z children
             tContext.nodesStack.push(NodeInfo(0, childIndex, node.depth + 1, node.center + glm::vec3(-newSize, -newSize, -newSize), newSize));
@@ -438,6 +490,8 @@ void ExactOctreeSdf::initOctree(const Mesh& mesh, uint32_t startDepth, uint32_t
                 child.verticesInfo[4] = pointsInfo[16]; child.verticesInfo[5] = pointsInfo[17];
                 child.verticesInfo[6] = pointsInfo[18]; child.verticesInfo[7] = node.verticesInfo[7];
             }
+
+            tContext.peakMemory = glm::max(tContext.peakMemory, getContextMemory(tContext));
         }
         else
         {
@@ -445,7 +499,11 @@ void ExactOctreeSdf::initOctree(const Mesh& mesh, uint32_t startDepth, uint32_t
             octreeNode->setValues(true, std::numeric_limits<uint32_t>::max());
             tContext.nodesStack.pop();
 
-            if(node.depth <= tContext.bitEncodingStartDepth)
+            if(isFarNode)
+            {
+                octreeNode->setFarLeaf(farNodeDistance);
+            }
+            else if(node.depth <= tContext.bitEncodingStartDepth)
             {
                 uint32_t arrayStartIndex = outputTrianglesSets.size();
                 const uint32_t numTriangles = nodeTriangles.size();
@@ -489,22 +547,29 @@ void ExactOctreeSdf::initOctree(const Mesh& mesh, uint32_t startDepth, uint32_t
 
     };
 
-    const uint32_t voxlesPerAxis = 1 << startDepth;
+    const uint32_t numStartNodes = mStartGridXY * mStartGridSize.z;
     #ifdef OPENMP_AVAILABLE
     if(numThreads < 2)
     #endif
     {
+        ScopedTimer subdivisionScope("Subdivision");
+
         // Create the grid
-        mOctreeData.resize(voxlesPerAxis * voxlesPerAxis * voxlesPerAxis);
+        mOctreeData.resize(numStartNodes);
 
         while(!mainThread.nodesStack.empty())
         {
             NodeInfo node = mainThread.nodesStack.top();
+            if(node.depth <= startDepth && isOutsideStartGrid(node.center, node.size))
+            {
+                mainThread.nodesStack.pop();
+                continue;
+            }
             
             if(node.depth == startDepth)
             {
                 glm::ivec3 startArrayPos = glm::floor((node.center - mBox.min) / mStartGridCellSize);
-                node.nodeIndex = startArrayPos.z * mStartGridXY + startArrayPos.y * mStartGridSize + startArrayPos.x;
+                node.nodeIndex = startArrayPos.z * mStartGridXY + startArrayPos.y * mStartGridSize.x + startArrayPos.x;
             }
 
             processNode(node, mainThread, mOctreeData, mTrianglesSets, mTrianglesMasks);
@@ -512,6 +577,10 @@ void ExactOctreeSdf::initOctree(const Mesh& mesh, uint32_t startDepth, uint32_t
 
         mMaxTrianglesInLeafs = mainThread.maxTrianglesInLeafs;
         mMaxTrianglesEncodedInLeafs = mainThread.maxTrianglesEncodedInLeafs;
+        // The output arrays only grow, so the peak is reached with their final size
+        mConstructionPeakMemory = MemoryUsage::getBytes(trianglesData) + MemoryUsage::getBytes(mOctreeData) +
+                                  MemoryUsage::getBytes(mTrianglesSets) + MemoryUsage::getBytes(mTrianglesMasks) +
+                                  mainThread.peakMemory;
     }
     #ifdef OPENMP_AVAILABLE
     else
@@ -526,7 +595,7 @@ void ExactOctreeSdf::initOctree(const Mesh& mesh, uint32_t startDepth, uint32_t
             std::vector<uint8_t> trianglesMasks;
             uint32_t padding[16];
         };
-        std::vector<OctreeDataWithPadding> subOctrees(voxlesPerAxis * voxlesPerAxis * voxlesPerAxis);
+        std::vector<OctreeDataWithPadding> subOctrees(numStartNodes);
 
         omp_set_dynamic(0);
         omp_set_num_threads(numThreads);
@@ -536,16 +605,21 @@ void ExactOctreeSdf::initOctree(const Mesh& mesh, uint32_t startDepth, uint32_t
         while(!mainThread.nodesStack.empty())
         {
             NodeInfo node = mainThread.nodesStack.top();
+            if(node.depth <= startDepth && isOutsideStartGrid(node.center, node.size))
+            {
+                mainThread.nodesStack.pop();
+                continue;
+            }
             
             if(node.depth == startDepth)
             {
                 mainThread.nodesStack.pop();
                 glm::ivec3 startArrayPos = glm::floor((node.center - mBox.min) / mStartGridCellSize);
                 node.nodeIndex = 0;
-                std::vector<OctreeNode>* subOctreePtr = &subOctrees[startArrayPos.z * mStartGridXY + startArrayPos.y * mStartGridSize + startArrayPos.x].octreeData;
+                std::vector<OctreeNode>* subOctreePtr = &subOctrees[startArrayPos.z * mStartGridXY + startArrayPos.y * mStartGridSize.x + startArrayPos.x].octreeData;
                 subOctreePtr->resize(1);
-                std::vector<uint32_t>* subTrianglesSetsPtr = &subOctrees[startArrayPos.z * mStartGridXY + startArrayPos.y * mStartGridSize + startArrayPos.x].trianglesSets;
-                std::vector<uint8_t>* subTrianglesMasksPtr = &subOctrees[startArrayPos.z * mStartGridXY + startArrayPos.y * mStartGridSize + startArrayPos.x].trianglesMasks;
+                std::vector<uint32_t>* subTrianglesSetsPtr = &subOctrees[startArrayPos.z * mStartGridXY + startArrayPos.y * mStartGridSize.x + startArrayPos.x].trianglesSets;
+                std::vector<uint8_t>* subTrianglesMasksPtr = &subOctrees[startArrayPos.z * mStartGridXY + startArrayPos.y * mStartGridSize.x + startArrayPos.x].trianglesMasks;
                 const uint32_t rDepth = startDepth - mainThread.startOctreeDepth;
                 std::vector<uint32_t> startTriangles = *mainThread.trianglesCache[rDepth];
                 #pragma omp task shared(threadsContext) firstprivate(node, subOctreePtr, subTrianglesSetsPtr, subTrianglesMasksPtr, rDepth, startTriangles)
@@ -555,6 +629,7 @@ void ExactOctreeSdf::initOctree(const Mesh& mesh, uint32_t startDepth, uint32_t
                     std::vector<uint8_t>& subTrianglesMasks = *subTrianglesMasksPtr;
                     const uint32_t tId = omp_get_thread_num();
                     ThreadContext& threadContext = threadsContext[tId];
+                    ScopedTimer subtreeScope("Subtree");
                     threadContext.triangles[rDepth][0] = std::move(startTriangles);
                     threadContext.trianglesCache[rDepth] = &threadContext.triangles[rDepth][0];
                     threadContext.nodesStack = std::stack<NodeInfo>(); // Reset stack
@@ -565,6 +640,8 @@ void ExactOctreeSdf::initOctree(const Mesh& mesh, uint32_t startDepth, uint32_t
 
                         processNode(node1, threadContext, subOctree, subTrianglesSets, subTrianglesMasks);
                     }
+
+                    subtreeScope.addArg("nodes", static_cast<double>(subOctree.size()));
                 }
             }
             else
@@ -573,8 +650,24 @@ void ExactOctreeSdf::initOctree(const Mesh& mesh, uint32_t startDepth, uint32_t
             }
         }
 
+        // Upper bound of the memory used while the threads were subdividing
+        size_t subdivisionPeakMemory = MemoryUsage::getBytes(trianglesData) + MemoryUsage::getBytes(mOctreeData) +
+                                       MemoryUsage::getBytes(mTrianglesSets) + MemoryUsage::getBytes(mTrianglesMasks) +
+                                       mainThread.peakMemory;
+        for(const OctreeDataWithPadding& subOctree : subOctrees)
+        {
+            subdivisionPeakMemory += MemoryUsage::getBytes(subOctree.octreeData) + 
+                                     MemoryUsage::getBytes(subOctree.trianglesSets) +
+                                     MemoryUsage::getBytes(subOctree.trianglesMasks);
+        }
+        for(const ThreadContext& tCtx : threadsContext)
+        {
+            subdivisionPeakMemory += tCtx.peakMemory;
+        }
+
         // Merge all the subtrees
-        mOctreeData.resize(voxlesPerAxis * voxlesPerAxis * voxlesPerAxis);
+        ScopedTimer mergeScope("Merge subtrees");
+        mOctreeData.resize(numStartNodes);
         for(uint32_t i=0; i < subOctrees.size(); i++)
         {
             std::vector<OctreeNode>& octreeData = subOctrees[i].octreeData;
@@ -603,8 +696,8 @@ void ExactOctreeSdf::initOctree(const Mesh& mesh, uint32_t startDepth, uint32_t
                 {
                     node.trianglesArrayIndex += startTrianglesMasksIndex;
                 }
-                else if(node.isLeaf() || 
-                        depth == mainThread.bitEncodingStartDepth)
+                else if(!node.isFarLeaf() && (node.isLeaf() || 
+                        depth == mainThread.bitEncodingStartDepth))
                 {
                     node.trianglesArrayIndex += startTrianglesSetsIndex;
                 }                
@@ -620,6 +713,23 @@ void ExactOctreeSdf::initOctree(const Mesh& mesh, uint32_t startDepth, uint32_t
             mTrianglesSets.insert(mTrianglesSets.end(), subOctrees[i].trianglesSets.begin(), subOctrees[i].trianglesSets.end());
             mTrianglesMasks.insert(mTrianglesMasks.end(), subOctrees[i].trianglesMasks.begin(), subOctrees[i].trianglesMasks.end());
         }
+        mergeScope.stop();
+
+        // The subtrees and the final arrays coexist at the end of the merge
+        size_t mergePeakMemory = MemoryUsage::getBytes(trianglesData) + MemoryUsage::getBytes(mOctreeData) +
+                                 MemoryUsage::getBytes(mTrianglesSets) + MemoryUsage::getBytes(mTrianglesMasks) +
+                                 getContextMemory(mainThread);
+        for(const OctreeDataWithPadding& subOctree : subOctrees)
+        {
+            mergePeakMemory += MemoryUsage::getBytes(subOctree.octreeData) + 
+                               MemoryUsage::getBytes(subOctree.trianglesSets) +
+                               MemoryUsage::getBytes(subOctree.trianglesMasks);
+        }
+        for(const ThreadContext& tCtx : threadsContext)
+        {
+            mergePeakMemory += getContextMemory(tCtx);
+        }
+        mConstructionPeakMemory = glm::max(subdivisionPeakMemory, mergePeakMemory);
 
         mMaxTrianglesEncodedInLeafs = 0.0f;
         mMaxTrianglesInLeafs = 0.0f;
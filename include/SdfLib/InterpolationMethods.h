@@ -24,6 +24,9 @@ struct NoneInterpolation
                                       const std::vector<TriangleUtils::TriangleData>& trianglesData,
                                       std::array<float, NUM_COEFFICIENTS>& outCoefficients) {}
 
+    inline static void calculatePointValues(float distance, glm::vec3 gradient, std::array<float, VALUES_PER_VERTEX>& outValues)
+    { }
+
     inline static void calculatePointValues(glm::vec3 point,
                                       uint32_t nearestTriangleIndex,
                                       const Mesh& mesh,
@@ -43,6 +46,12 @@ struct NoneInterpolation
 
     inline static void interpolateVertexValues(const std::array<float, NUM_COEFFICIENTS>& values, glm::vec3 fracPart, float nodeSize, std::array<float, VALUES_PER_VERTEX>& outValues)
     {}
+
+    inline static void calculateBounds(const std::array<float, NUM_COEFFICIENTS>& values, float& outMin, float& outMax)
+    {
+        outMin = 0.0f;
+        outMax = 0.0f;
+    }
 };
 
 struct TriLinearInterpolation
@@ -61,6 +70,11 @@ struct TriLinearInterpolation
         outCoefficients = *reinterpret_cast<const std::array<float, NUM_COEFFICIENTS>*>(&valuesPerVertex);
     }
 
+    inline static void calculatePointValues(float distance, glm::vec3 gradient, std::array<float, VALUES_PER_VERTEX>& outValues)
+    {
+        outValues[0] = distance;
+    }
+
     inline static void calculatePointValues(glm::vec3 point,
                                       uint32_t nearestTriangleIndex,
                                       const Mesh& mesh,
@@ -140,6 +154,17 @@ struct TriLinearInterpolation
     {
         outValues[0] = interpolateValue(values, fracPart);
     }
+
+    inline static void calculateBounds(const std::array<float, NUM_COEFFICIENTS>& values, float& outMin, float& outMax)
+    {
+        outMin = INFINITY;
+        outMax = -INFINITY;
+        for(float v : values)
+        {
+            outMin = glm::min(outMin, v);
+            outMax = glm::max(outMax, v);
+        }
+    }
 };
 
 // struct TriCubicInterpolation
@@ -270,6 +295,13 @@ struct TriCubicInterpolation
     static constexpr uint32_t EXTRA_VALUES = 0;
     static constexpr uint32_t NUM_COEFFICIENTS = 64;
 
+    inline static void calculatePointValues(float distance, glm::vec3 gradient, std::array<float, VALUES_PER_VERTEX>& outValues)
+    {
+        outValues[0] = distance;
+        outValues[1] = gradient.x; outValues[2] = gradient.y; outValues[3] = gradient.z;
+        outValues[4] = 0.0f; outValues[5] = 0.0f; outValues[6] = 0.0f; outValues[7] = 0.0f;
+    }
+
     inline static void calculatePointValues(glm::vec3 point,
                                       uint32_t nearestTriangleIndex,
                                       const Mesh& mesh,
@@ -495,6 +527,182 @@ struct TriCubicInterpolation
          + 2 * values[37] * fracPart[2] + 4 * values[38] * fracPart[0] * fracPart[2] + 6 * values[39] * fracPart[0] * fracPart[0] * fracPart[2] + 4 * values[41] * fracPart[1] * fracPart[2] + 8 * values[42] * fracPart[0] * fracPart[1] * fracPart[2] + 12 * values[43] * fracPart[0] * fracPart[0] * fracPart[1] * fracPart[2] + 6 * values[45] * fracPart[1] * fracPart[1] * fracPart[2] + 12 * values[46] * fracPart[0] * fracPart[1] * fracPart[1] * fracPart[2] + 18 * values[47] * fracPart[0] * fracPart[0] * fracPart[1] * fracPart[1] * fracPart[2]
          + 3 * values[53] * fracPart[2] * fracPart[2] + 6 * values[54] * fracPart[0] * fracPart[2] * fracPart[2] + 9 * values[55] * fracPart[0] * fracPart[0] * fracPart[2] * fracPart[2] + 6 * values[57] * fracPart[1] * fracPart[2] * fracPart[2] + 12 * values[58] * fracPart[0] * fracPart[1] * fracPart[2] * fracPart[2] + 18 * values[59] * fracPart[0] * fracPart[0] * fracPart[1] * fracPart[2] * fracPart[2] + 9 * values[61] * fracPart[1] * fracPart[1] * fracPart[2] * fracPart[2] + 18 * values[62] * fracPart[0] * fracPart[1] * fracPart[1] * fracPart[2] * fracPart[2] + 27 * values[63] * fracPart[0] * fracPart[0] * fracPart[1] * fracPart[1] * fracPart[2] * fracPart[2]) / (sqNodeSize * nodeSize);
     }
+
+    // Bounds the polynomial inside the node converting it to the Bernstein basis,
+    // whose coefficients contain all the polynomial values
+    inline static void calculateBounds(const std::array<float, NUM_COEFFICIENTS>& values, float& outMin, float& outMax)
+    {
+        std::array<float, NUM_COEFFICIENTS> b = values;
+        // Convert the cubic of each axis: b0 = a0, b1 = a0 + a1/3, b2 = a0 + 2a1/3 + a2/3, b3 = a0 + a1 + a2 + a3
+        for(uint32_t axisStride : {1u, 4u, 16u})
+        {
+            for(uint32_t i=0; i < NUM_COEFFICIENTS; i++)
+            {
+                if((i / axisStride) % 4 != 0) continue;
+                const float a0 = b[i];
+                const float a1 = b[i + axisStride];
+                const float a2 = b[i + 2 * axisStride];
+                const float a3 = b[i + 3 * axisStride];
+                b[i + axisStride] = a0 + a1 / 3.0f;
+                b[i + 2 * axisStride] = a0 + 2.0f * a1 / 3.0f + a2 / 3.0f;
+                b[i + 3 * axisStride] = a0 + a1 + a2 + a3;
+            }
+        }
+
+        outMin = INFINITY;
+        outMax = -INFINITY;
+        for(float v : b)
+        {
+            outMin = glm::min(outMin, v);
+            outMax = glm::max(outMax, v);
+        }
+    }
+};
+
+struct TriQuadraticInterpolation
+{
+    // The vertices store the same values than the tricubic interpolation
+    static constexpr uint32_t VALUES_PER_VERTEX = TriCubicInterpolation::VALUES_PER_VERTEX;
+    static constexpr uint32_t EXTRA_VALUES = 0;
+    static constexpr uint32_t NUM_COEFFICIENTS = 27;
+
+    inline static void calculatePointValues(float distance, glm::vec3 gradient, std::array<float, VALUES_PER_VERTEX>& outValues)
+    {
+        TriCubicInterpolation::calculatePointValues(distance, gradient, outValues);
+    }
+
+    inline static void calculatePointValues(glm::vec3 point,
+                                      uint32_t nearestTriangleIndex,
+                                      const Mesh& mesh,
+                                      const std::vector<TriangleUtils::TriangleData>& trianglesData, 
+                                      std::array<float, VALUES_PER_VERTEX>& outValues)
+    {
+        TriCubicInterpolation::calculatePointValues(point, nearestTriangleIndex, mesh, trianglesData, outValues);
+    }
+
+    // Fits the tricubic polynomial and projects the cubic term of each axis to the quadratic
+    // minimizing the L2 error while keeping the values at the node limits: x^3 ~ 1.5x^2 - 0.5x.
+    // The vertices values are preserved, so the continuity between leaves is kept.
+    inline static void calculateCoefficients(const std::array<std::array<float, VALUES_PER_VERTEX>, 8>& inValues,
+                                             float nodeSize,
+                                             const std::vector<uint32_t>& triangles,
+                                             const Mesh& mesh,
+                                             const std::vector<TriangleUtils::TriangleData>& trianglesData,
+                                             std::array<float, NUM_COEFFICIENTS>& outCoeff) 
+    {
+        std::array<float, TriCubicInterpolation::NUM_COEFFICIENTS> cubic;
+        TriCubicInterpolation::calculateCoefficients(inValues, nodeSize, triangles, mesh, trianglesData, cubic);
+
+        for(uint32_t axisStride : {1u, 4u, 16u})
+        {
+            for(uint32_t i=0; i < TriCubicInterpolation::NUM_COEFFICIENTS; i++)
+            {
+                if((i / axisStride) % 4 != 0) continue;
+                const float a3 = cubic[i + 3 * axisStride];
+                cubic[i + axisStride] -= 0.5f * a3;
+                cubic[i + 2 * axisStride] += 1.5f * a3;
+                cubic[i + 3 * axisStride] = 0.0f;
+            }
+        }
+
+        for(uint32_t k=0; k < 3; k++)
+        {
+            for(uint32_t j=0; j < 3; j++)
+            {
+                for(uint32_t i=0; i < 3; i++)
+                {
+                    outCoeff[i + 3 * j + 9 * k] = cubic[i + 4 * j + 16 * k];
+                }
+            }
+        }
+    }
+
+    inline static float interpolateValue(const std::array<float, NUM_COEFFICIENTS>& values, glm::vec3 fracPart) 
+    {
+        std::array<float, 3> coeffZ;
+        for(uint32_t k=0; k < 3; k++)
+        {
+            const float* v = &values[9 * k];
+            const float r0 = v[0] + fracPart.x * (v[1] + fracPart.x * v[2]);
+            const float r1 = v[3] + fracPart.x * (v[4] + fracPart.x * v[5]);
+            const float r2 = v[6] + fracPart.x * (v[7] + fracPart.x * v[8]);
+            coeffZ[k] = r0 + fracPart.y * (r1 + fracPart.y * r2);
+        }
+
+        return coeffZ[0] + fracPart.z * (coeffZ[1] + fracPart.z * coeffZ[2]);
+    }
+
+    // Evaluates the derivative of the polynomial with the given order in each axis, zero or one
+    inline static float interpolateDerivative(const std::array<float, NUM_COEFFICIENTS>& values, glm::vec3 fracPart, glm::uvec3 order)
+    {
+        std::array<std::array<float, 3>, 3> basis;
+        for(uint32_t a=0; a < 3; a++)
+        {
+            basis[a] = (order[a] == 0) ? std::array<float, 3>{1.0f, fracPart[a], fracPart[a] * fracPart[a]}
+                                       : std::array<float, 3>{0.0f, 1.0f, 2.0f * fracPart[a]};
+        }
+
+        float sum = 0.0f;
+        for(uint32_t k=0; k < 3; k++)
+        {
+            for(uint32_t j=0; j < 3; j++)
+            {
+                const float yz = basis[1][j] * basis[2][k];
+                for(uint32_t i=0; i < 3; i++)
+                {
+                    sum += values[i + 3 * j + 9 * k] * basis[0][i] * yz;
+                }
+            }
+        }
+        return sum;
+    }
+
+    inline static glm::vec3 interpolateGradient(const std::array<float, NUM_COEFFICIENTS>& values, glm::vec3 fracPart) 
+    {
+        return glm::vec3(interpolateDerivative(values, fracPart, glm::uvec3(1, 0, 0)),
+                         interpolateDerivative(values, fracPart, glm::uvec3(0, 1, 0)),
+                         interpolateDerivative(values, fracPart, glm::uvec3(0, 0, 1)));
+    }
+
+    inline static void interpolateVertexValues(const std::array<float, NUM_COEFFICIENTS>& values, glm::vec3 fracPart, float nodeSize, std::array<float, VALUES_PER_VERTEX>& outValues)
+    {
+        const float sqNodeSize = nodeSize * nodeSize;
+        outValues[0] = interpolateValue(values, fracPart);
+        outValues[1] = interpolateDerivative(values, fracPart, glm::uvec3(1, 0, 0)) / nodeSize;
+        outValues[2] = interpolateDerivative(values, fracPart, glm::uvec3(0, 1, 0)) / nodeSize;
+        outValues[3] = interpolateDerivative(values, fracPart, glm::uvec3(0, 0, 1)) / nodeSize;
+        outValues[4] = interpolateDerivative(values, fracPart, glm::uvec3(1, 1, 0)) / sqNodeSize;
+        outValues[5] = interpolateDerivative(values, fracPart, glm::uvec3(1, 0, 1)) / sqNodeSize;
+        outValues[6] = interpolateDerivative(values, fracPart, glm::uvec3(0, 1, 1)) / sqNodeSize;
+        outValues[7] = interpolateDerivative(values, fracPart, glm::uvec3(1, 1, 1)) / (sqNodeSize * nodeSize);
+    }
+
+    // Bounds the polynomial inside the node converting it to the Bernstein basis
+    inline static void calculateBounds(const std::array<float, NUM_COEFFICIENTS>& values, float& outMin, float& outMax)
+    {
+        std::array<float, NUM_COEFFICIENTS> b = values;
+        // Convert the quadratic of each axis: b0 = a0, b1 = a0 + a1/2, b2 = a0 + a1 + a2
+        for(uint32_t axisStride : {1u, 3u, 9u})
+        {
+            for(uint32_t i=0; i < NUM_COEFFICIENTS; i++)
+            {
+                if((i / axisStride) % 3 != 0) continue;
+                const float a0 = b[i];
+                const float a1 = b[i + axisStride];
+                const float a2 = b[i + 2 * axisStride];
+                b[i + axisStride] = a0 + 0.5f * a1;
+                b[i + 2 * axisStride] = a0 + a1 + a2;
+            }
+        }
+
+        outMin = INFINITY;
+        outMax = -INFINITY;
+        for(float v : b)
+        {
+            outMin = glm::min(outMin, v);
+            outMax = glm::max(outMax, v);
+        }
+    }
 };
 }
 
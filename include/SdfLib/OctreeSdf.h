@@ -3,6 +3,7 @@
 
 #include <array>
 #include <optional>
+#include <functional>
 
 #include "utils/Mesh.h"
 #include "utils/TriangleUtils.h"
@@ -22,7 +23,10 @@ class OctreeSdf : public SdfFunction
 public:
     enum InitAlgorithm
     {
-        UNIFORM, // All zones are subdivided to the maximum depth
+        // All zones are subdivided to the maximum depth.
+        // The trilinear octrees store the distances at the leaves vertices, the other types fit their
+        // polynomial in each leaf like NO_CONTINUITY, because the vertices values are not enough for them
+        UNIFORM,
         NO_CONTINUITY, // Not preserve continuity
         CONTINUITY // Preserve continuity
     };
@@ -122,6 +126,44 @@ public:
         return std::optional<TerminationRule>();
     }
 
+    enum InterpolationType
+    {
+        TRILINEAR, // 8 coefficients per leaf
+        TRIQUADRATIC, // 27 coefficients per leaf
+        TRICUBIC // 64 coefficients per leaf
+    };
+
+    static std::optional<InterpolationType> stringToInterpolationType(std::string text)
+    {
+        if(text == "trilinear" || text == "TRILINEAR")
+        {
+            return std::optional<InterpolationType>(InterpolationType::TRILINEAR);
+        }
+        else if(text == "triquadratic" || text == "TRIQUADRATIC")
+        {
+            return std::optional<InterpolationType>(InterpolationType::TRIQUADRATIC);
+        }
+        else if(text == "tricubic" || text == "TRICUBIC")
+        {
+            return std::optional<InterpolationType>(InterpolationType::TRICUBIC);
+        }
+
+        return std::optional<InterpolationType>();
+    }
+
+    /**
+     * @brief Region of the space with its own subdivision limits, to refine more the zones where
+     *        the application queries the field. The nodes overlapping several regions use the finest limits.
+     **/
+    struct RefinementRegion
+    {
+        BoundingBox box;
+        // Maximum depth of the nodes overlapping the region, it can be greater than the octree depth
+        uint32_t maxDepth;
+        // Minimum error expected in the nodes overlapping the region, relative to the box diagonal
+        float terminationThreshold;
+    };
+
     // Constructors
     OctreeSdf() {}
     /**
@@ -133,11 +175,105 @@ public:
      *                            All the leaves before the maximum depth must have an error less than 
      *                            this minimum.
      * @param initAlgorithm The building algorithm.
+     * @param interpolationType The polynomial stored in the leaves.
+     * @param narrowBand If it is greater than zero, only the nodes with distances less than the band are refined.
+     *                   The leaves outside the band store a constant guaranteed lower bound of the distance,
+     *                   instead of an accurate polynomial.
+     * @param anisotropicStartGrid If it is true, the start grid has as many cubic cells in each axis as needed
+     *                             to cover the box, instead of expanding the box to a cube.
+     *                             The cells have the size of the start depth cells of the longest axis.
+     * @param refinementRegions Regions with their own maximum depth and termination threshold.
+     *                          The depth and the threshold of the constructor only apply outside the regions.
      **/
     OctreeSdf(const Mesh& mesh, BoundingBox box, uint32_t depth, uint32_t startDepth, 
               float minimumError = 1e-3,
               InitAlgorithm initAlgorithm = InitAlgorithm::NO_CONTINUITY,
-              uint32_t numThreads = 1);
+              uint32_t numThreads = 1,
+              InterpolationType interpolationType = InterpolationType::TRICUBIC,
+              float narrowBand = 0.0f,
+              bool anisotropicStartGrid = false,
+              const std::vector<RefinementRegion>& refinementRegions = {});
+
+    /**
+     * @brief Limits of the best-first construction. The zero values mean no limit.
+     **/
+    struct BuildBudget
+    {
+        // Maximum size in bytes of the octree array, counting the nodes and the coefficients
+        size_t maxBytes = 0;
+        // Maximum number of octree nodes, counting the inner nodes and the leaves
+        size_t maxNodes = 0;
+        // Called before each subdivision, the construction stops when it returns true
+        std::function<bool()> stopRequested;
+    };
+
+    /**
+     * @brief Builds the octree subdividing first the leaves with the highest estimated error
+     *        until the budget is exhausted, the construction is interrupted or all the leaves
+     *        are below the termination threshold. The tree is valid at any moment of the construction,
+     *        so the result is always a complete octree.
+     * @param mesh The input mesh.
+     * @param box The area that the structure must cover.
+     * @param depth The maximum octree depth.
+     * @param startDepth The start depth of the octree. The start grid is always created, even if it exceeds the budget.
+     * @param budget The maximum size of the octree and the interruption callback.
+     * @param terminationThreshold The minimum error expected in a node. With zero, only the budget and the depth stop the subdivision.
+     * @param interpolationType The polynomial stored in the leaves.
+     * @param narrowBand The distance from the surface outside which the leaves are not subdivided. Zero disables it.
+     * @param anisotropicStartGrid If the start grid only covers the box instead of its enclosing cube.
+     * @param refinementRegions Regions with their own maximum depth and termination threshold.
+     **/
+    OctreeSdf(const Mesh& mesh, BoundingBox box, uint32_t depth, uint32_t startDepth,
+              const BuildBudget& budget,
+              float terminationThreshold = 0.0f,
+              InterpolationType interpolationType = InterpolationType::TRICUBIC,
+              float narrowBand = 0.0f,
+              bool anisotropicStartGrid = false,
+              const std::vector<RefinementRegion>& refinementRegions = {});
+
+    /**
+     * @brief Function returning the distance and the gradient at a point
+     **/
+    typedef std::function<float(glm::vec3 point, glm::vec3& outGradient)> DistanceFunction;
+
+    /**
+     * @brief Builds the octree approximating a generic distance function, like an analytic 
+     *        CSG tree or an imported voxel volume. The termination test is the same than the mesh construction.
+     * @param distanceFunction The function to approximate. 
+     *                         It is called from several threads when numThreads is greater than one.
+     * @param box The area that the structure must cover.
+     * @param depth The maximum octree depth.
+     * @param startDepth The start depth of the octree.
+     * @param terminationThreshold The minimum error expected in a node, relative to the box diagonal.
+     * @param initAlgorithm The building algorithm. The uniform algorithm subdivides all the nodes to the maximum depth.
+     * @param numThreads The maximum number of threads to use during the structure construction.
+     * @param interpolationType The polynomial stored in the leaves.
+     * @param narrowBand The distance from the surface outside which the leaves are not subdivided. Zero disables it.
+     *                   The lower bounds of the far leaves suppose that the function is a distance field.
+     * @param anisotropicStartGrid If the start grid only covers the box instead of its enclosing cube.
+     * @param refinementRegions Regions with their own maximum depth and termination threshold.
+     **/
+    OctreeSdf(const DistanceFunction& distanceFunction, BoundingBox box, uint32_t depth, uint32_t startDepth, 
+              float terminationThreshold = 1e-3,
+              InitAlgorithm initAlgorithm = InitAlgorithm::NO_CONTINUITY,
+              uint32_t numThreads = 1,
+              InterpolationType interpolationType = InterpolationType::TRICUBIC,
+              float narrowBand = 0.0f,
+              bool anisotropicStartGrid = false,
+              const std::vector<RefinementRegion>& refinementRegions = {});
+
+    /**
+     * @brief Builds the octree approximating another structure, like an exact octree or a uniform grid.
+     *        The rest of parameters are the same than the distance function constructor.
+     **/
+    OctreeSdf(const SdfFunction& sdfFunction, BoundingBox box, uint32_t depth, uint32_t startDepth, 
+              float terminationThreshold = 1e-3,
+              InitAlgorithm initAlgorithm = InitAlgorithm::NO_CONTINUITY,
+              uint32_t numThreads = 1,
+              InterpolationType interpolationType = InterpolationType::TRICUBIC,
+              float narrowBand = 0.0f,
+              bool anisotropicStartGrid = false,
+              const std::vector<RefinementRegion>& refinementRegions = {});
 
     /**
      * @return Returns the maximum distance in absulute value contained by the octree
@@ -150,9 +286,10 @@ public:
 
     /**
      * @return The size of the start grid containing all 
-     *          the nodes of the start depth stored sequentially 
+     *          the nodes of the start depth stored sequentially.
+     *          The axes can have a different size with an anisotropic start grid.
      **/
-    glm::ivec3 getStartGridSize() const { return glm::ivec3(mStartGridSize); }
+    glm::ivec3 getStartGridSize() const { return mStartGridSize; }
     
     /**
      * @return The octree bounding box
@@ -165,6 +302,16 @@ public:
      **/
     uint32_t getOctreeMaxDepth() const { return mMaxDepth; }
 
+    /**
+     * @return The polynomial stored in the leaves
+     **/
+    InterpolationType getInterpolationType() const { return mInterpolationType; }
+
+    /**
+     * @return The number of coefficients stored by each leaf
+     **/
+    uint32_t getLeafNumCoefficients() const;
+
     /**
      * @return The array containing all the octree structure
      **/
@@ -182,24 +329,144 @@ public:
      **/
     void getDepthDensity(std::vector<float>& depthsDensity);
 
+    /**
+     * @return The bytes used by the octree nodes and by the leaves coefficients
+     **/
+    MemoryUsage memoryUsage() const override;
+
+    /**
+     * @brief Fits a polynomial for each inner node from the values of its children,
+     *        enabling the queries with a maximum depth. The polynomial of an inner node
+     *        is stored just after its children.
+     *        The inner polynomials are stored with the structure, the files of the previous versions must compute them again.
+     *        The nodes shared by deduplicateNodes are copied again, so it should be called before the deduplication.
+     *        It is not supported after shareVertices.
+     **/
+    void computeLevelOfDetail();
+
+    /**
+     * @brief Shares the leaves with similar coefficients and then the subtrees with the same children,
+     *        so the octree becomes a directed acyclic graph over a dictionary of coefficients.
+     *        The queries and the file format do not change.
+     * @param tolerance The maximum difference of the field between two leaves sharing the coefficients. 
+     *                  With zero, only the identical leaves are shared.
+     **/
+    void deduplicateNodes(float tolerance = 0.0f);
+
+    /**
+     * @brief Replaces the coefficients of the leaves by the values at their 8 vertices, stored in a pool
+     *        shared by the leaves with the same vertex. The coefficients are fitted again from the vertices
+     *        in the queries, and the last leaves used by each thread are cached.
+     *        The octrees built with continuity share most of the vertices, the others only reduce the tricubic leaves.
+     *        It should be called after computeLevelOfDetail and deduplicateNodes, the nodes shared by deduplicateNodes are copied again.
+     * @param tolerance The maximum difference of the field, relative to the box size, between two vertices in the same position to be shared.
+     **/
+    void shareVertices(float tolerance = 1e-5f);
+
+    /**
+     * @return If the leaves reference their vertices in the shared pool instead of storing their coefficients
+     **/
+    bool hasSharedVertices() const { return !mVerticesValues.empty(); }
+
+    /**
+     * @return The values of the shared vertices, VALUES_PER_VERTEX of the interpolation method for each vertex
+     **/
+    const std::vector<float>& getVerticesValues() const { return mVerticesValues; }
+
+    /**
+     * @return If the inner nodes store their polynomial
+     **/
+    bool hasLevelOfDetail() const { return mHasLevelOfDetail; }
+
     float getDistance(glm::vec3 sample) const override;
     float getDistance(glm::vec3 sample, glm::vec3& outGradient) const override;
+
+    /**
+     * @brief Returns the distance evaluating the polynomial of the deepest node containing the sample
+     *          with a depth less or equal to maxDepth.
+     *        Without the level of detail, the query always reaches the leaves.
+     * @param sample The query point
+     * @param maxDepth The maximum depth of the node used to evaluate the distance
+     **/
+    float getDistance(glm::vec3 sample, uint32_t maxDepth) const;
+
+    /**
+     * @brief Returns a guaranteed interval containing all the values of the field inside a region.
+     *        It uses the bounds of the nodes overlapping the region, so the interval is tighter
+     *        when the region is small compared to the leaves.
+     * @param box The region of the space
+     * @return The minimum value of the interval in the x component and the maximum in the y component
+     **/
+    glm::vec2 getDistanceBounds(BoundingBox box) const;
+
+    /**
+     * @brief Samples the field in a dense grid. The leaves are processed in parallel 
+     *          and each leaf evaluates its polynomial incrementally over the grid points it covers.
+     * @param box The area covered by the grid. The first and the last points of each axis are on the box faces.
+     *            All the points of an axis without extent are on the box minimum.
+     * @param resolution The number of points in each axis
+     * @param outGrid The array where the grid values are stored in x, y, z order
+     * @param numThreads The number of threads used
+     **/
+    void sampleGrid(BoundingBox box, glm::ivec3 resolution, std::vector<float>& outGrid, uint32_t numThreads = 1) const;
 	SdfFunction::SdfFormat getFormat() const override { return SdfFunction::SdfFormat::OCTREE; }
 
     // Load and save function for storing the structure on disk
     template<class Archive>
     void save(Archive & archive) const
     { 
-        archive(mBox, mStartGridSize, mMaxDepth, mValueRange, mMinBorderValue, mOctreeData);
+        archive(mBox);
+        saveStartGridSize(archive, mStartGridSize);
+        archive(mMaxDepth, mValueRange, mMinBorderValue);
+        saveBulkArray(archive, mOctreeData, BlockCompression::Codec::FLOATS);
+        archive(mInterpolationType);
+        saveBulkArray(archive, mVerticesValues, BlockCompression::Codec::FLOATS);
+        archive(mHasLevelOfDetail);
     }
 
     template<class Archive>
     void load(Archive & archive)
     {
-        archive(mBox, mStartGridSize, mMaxDepth, mValueRange, mMinBorderValue, mOctreeData);
+        loadVersion(archive, SdfFunction::FILE_VERSION);
+    }
+
+    /**
+     * @brief Loads the structure stored by the given version of the file container
+     * @param fileVersion The version in the file header, or LEGACY_FILE_VERSION for the files without header
+     **/
+    template<class Archive>
+    void loadVersion(Archive & archive, uint32_t fileVersion)
+    {
+        archive(mBox);
+        loadStartGridSize(archive, mStartGridSize);
+        archive(mMaxDepth, mValueRange, mMinBorderValue);
+        loadBulkArray(archive, mOctreeData, BlockCompression::Codec::FLOATS);
+
+        // The legacy files end after the octree and are always tricubic
+        if(fileVersion == SdfFunction::LEGACY_FILE_VERSION)
+        {
+            mInterpolationType = InterpolationType::TRICUBIC;
+            mVerticesValues.clear();
+        }
+        else
+        {
+            archive(mInterpolationType);
+            loadBulkArray(archive, mVerticesValues, BlockCompression::Codec::FLOATS);
+        }
+
+        // The previous versions did not store the flag, so their inner polynomials are ignored
+        mHasLevelOfDetail = false;
+        if(fileVersion >= 3) archive(mHasLevelOfDetail);
+        initInterpolationKernels();
         
-        mStartGridCellSize = mBox.getSize().x / static_cast<float>(mStartGridSize);
-        mStartGridXY = mStartGridSize * mStartGridSize;
+        mStartGridCellSize = mBox.getSize().x / static_cast<float>(mStartGridSize.x);
+        mStartGridXY = mStartGridSize.x * mStartGridSize.y;
+        const int maxGridSize = glm::max(glm::max(mStartGridSize.x, mStartGridSize.y), mStartGridSize.z);
+        mStartDepth = static_cast<uint32_t>(glm::round(glm::log2(static_cast<float>(maxGridSize))));
+
+        computeNodesBounds();
+
+        mConstructionPeakMemory = 0;
 
         float total = mOctreeData.size() * sizeof(OctreeNode);
         SPDLOG_INFO("Octree Sdf Total: {}MB", total/1048576.0f);
@@ -221,19 +488,44 @@ private:
     float mMinBorderValue;
     
     // Octree start grid
-    int mStartGridSize = 0;
+    glm::ivec3 mStartGridSize = glm::ivec3(0);
     int mStartGridXY = 0;
     float mStartGridCellSize = 0.0f;
+    uint32_t mStartDepth = 0;
 
     uint32_t mMaxDepth;
+    InterpolationType mInterpolationType = InterpolationType::TRICUBIC;
+    // If the inner nodes store a polynomial after their children
+    bool mHasLevelOfDetail = false;
+    // Distance outside which the nodes are not subdivided, only used during the construction
+    float mNarrowBand = 0.0f;
+    // Regions with their own subdivision limits, only used during the construction
+    std::vector<RefinementRegion> mRefinementRegions;
+
+    // Tree with the same topology than the octree storing the interval of values of each node.
+    // The start grid nodes are stored first and the children of each node are stored together.
+    struct NodeBounds
+    {
+        float minValue;
+        float maxValue;
+        uint32_t childrenIndex; // Zero in the leaves
+    };
+    std::vector<NodeBounds> mNodesBounds;
     // Array storing the octree nodes and the arrays of coefficients
     std::vector<OctreeNode> mOctreeData;
+    // Values of the vertices referenced by the leaves after shareVertices.
+    // The leaves point to 8 indices to this pool instead of their coefficients
+    std::vector<float> mVerticesValues;
+    // Identifies the pool in the caches of the fitted leaves
+    uint64_t mVerticesPoolId = 0;
 
     // Functions to construct the structure with different strategies
+    // The strategy argument is copied to each thread, it initializes the strategies needing external data
     template<typename TrianglesInfluenceStrategy>
     void initOctree(const Mesh& mesh, uint32_t startDepth, uint32_t maxDepth,
                     float terminationThreshold, TerminationRule terminationRule,
-                    uint32_t numThreads = 1);
+                    uint32_t numThreads = 1,
+                    const TrianglesInfluenceStrategy& trianglesInfluence = TrianglesInfluenceStrategy());
 
     template<typename TrianglesInfluenceStrategy>
     void initOctreeWithContinuity(const Mesh& mesh, uint32_t startDepth, uint32_t maxDepth,
@@ -242,14 +534,103 @@ private:
     template<typename TrianglesInfluenceStrategy>
     void initOctreeWithContinuityNoDelay(const Mesh& mesh, uint32_t startDepth, uint32_t maxDepth,
                                          float terminationThreshold, OctreeSdf::TerminationRule terminationRule,
-                                         uint32_t numThreads = 1);
-    
+                                         uint32_t numThreads = 1,
+                                         const TrianglesInfluenceStrategy& trianglesInfluence = TrianglesInfluenceStrategy());
+
+    template<typename TrianglesInfluenceStrategy>
+    void initOctreeBestFirst(const Mesh& mesh, uint32_t startDepth, uint32_t maxDepth,
+                             float terminationThreshold, const BuildBudget& budget,
+                             const TrianglesInfluenceStrategy& trianglesInfluence = TrianglesInfluenceStrategy());
+
     void initUniformOctree(const Mesh& mesh, uint32_t startDepth, uint32_t maxDepth); // For testing propouses
 
     void initOctreeInGPU(const Mesh& mesh, uint32_t startDepth, uint32_t maxDepth,
                          float terminationThreshold, TerminationRule terminationRule);
 
+    void initGrid(BoundingBox box, uint32_t startDepth, bool anisotropicStartGrid);
+    // Cube subdivided by the octree, which only differs from the box with an anisotropic start grid
+    BoundingBox getStartGridCube() const
+    {
+        if(mStartGridSize.x == mStartGridSize.y && mStartGridSize.x == mStartGridSize.z) return mBox;
+        return BoundingBox(mBox.min, mBox.min + mStartGridCellSize * static_cast<float>(1 << mStartDepth));
+    }
+    // If the node is beyond the start grid cells, which only happens with an anisotropic start grid
+    bool isOutsideStartGrid(glm::vec3 nodeCenter, float nodeHalfSize) const
+    {
+        return glm::any(glm::greaterThan(nodeCenter - nodeHalfSize, mBox.max - 0.5f * mStartGridCellSize));
+    }
+    void setRefinementRegions(const std::vector<RefinementRegion>& refinementRegions, uint32_t startDepth);
+    // Deepest depth that the construction can reach, counting the refinement regions
+    uint32_t getRefinementMaxDepth(uint32_t maxDepth) const
+    {
+        for(const RefinementRegion& region : mRefinementRegions) maxDepth = glm::max(maxDepth, region.maxDepth);
+        return maxDepth;
+    }
+    // Replaces the maximum depth and the squared threshold of a node with the finest ones of the regions overlapping it.
+    // A node only partially inside the regions also keeps the given limits when they are finer,
+    // so a coarse region does not stop the subdivision of the space around it.
+    // The region thresholds are scaled like the global threshold of the builders.
+    void getNodeRefinement(glm::vec3 nodeCenter, float nodeHalfSize, float thresholdScale,
+                           uint32_t& maxDepth, float& sqTerminationThreshold) const
+    {
+        bool overlapsRegion = false;
+        bool insideRegion = false;
+        uint32_t regionsMaxDepth = 0;
+        float regionsThreshold = INFINITY;
+        const glm::vec3 nodeMin = nodeCenter - nodeHalfSize;
+        const glm::vec3 nodeMax = nodeCenter + nodeHalfSize;
+        for(const RefinementRegion& region : mRefinementRegions)
+        {
+            if(glm::any(glm::greaterThan(nodeMin, region.box.max)) ||
+               glm::any(glm::lessThan(nodeMax, region.box.min)))
+            {
+                continue;
+            }
+
+            overlapsRegion = true;
+            insideRegion = insideRegion ||
+                           (glm::all(glm::greaterThanEqual(nodeMin, region.box.min)) &&
+                            glm::all(glm::lessThanEqual(nodeMax, region.box.max)));
+            regionsMaxDepth = glm::max(regionsMaxDepth, region.maxDepth);
+            regionsThreshold = glm::min(regionsThreshold, region.terminationThreshold * thresholdScale);
+        }
+
+        if(insideRegion)
+        {
+            maxDepth = regionsMaxDepth;
+            sqTerminationThreshold = regionsThreshold * regionsThreshold;
+        }
+        else if(overlapsRegion)
+        {
+            maxDepth = glm::max(maxDepth, regionsMaxDepth);
+            sqTerminationThreshold = glm::min(sqTerminationThreshold, regionsThreshold * regionsThreshold);
+        }
+    }
     void computeMinBorderValue();
+    void computeNodesBounds();
+    // Replaces the polynomial of the leaves outside the narrow band by their distance lower bound
+    void applyNarrowBand();
+
+    // Query kernels of the interpolation type, selected once so the queries do not branch for each sample
+    float (OctreeSdf::*mDistanceKernel)(glm::vec3) const = nullptr;
+    float (OctreeSdf::*mDistanceAndGradientKernel)(glm::vec3, glm::vec3&) const = nullptr;
+    float (OctreeSdf::*mDistanceWithMaxDepthKernel)(glm::vec3, uint32_t) const = nullptr;
+    void initInterpolationKernels();
+
+    // Implementations for each interpolation method, the functions without template call the one of the octree type
+    template<typename InterpolationMethod, bool SHARED_VERTICES> float getDistanceKernel(glm::vec3 sample) const;
+    template<typename InterpolationMethod, bool SHARED_VERTICES> float getDistanceAndGradientKernel(glm::vec3 sample, glm::vec3& outGradient) const;
+    template<typename InterpolationMethod, bool SHARED_VERTICES> float getDistanceWithMaxDepthKernel(glm::vec3 sample, uint32_t maxDepth) const;
+    // Returns the coefficients of the leaf. With shared vertices, the reference is valid until the next call in the same thread
+    template<typename InterpolationMethod, bool SHARED_VERTICES>
+    const std::array<float, InterpolationMethod::NUM_COEFFICIENTS>& getLeafCoefficients(const OctreeNode& leaf, float nodeSize) const;
+    template<typename InterpolationMethod> void shareVertices(float tolerance);
+    template<typename InterpolationMethod> void computeLevelOfDetail();
+    template<typename InterpolationMethod> void computeMinBorderValue();
+    template<typename InterpolationMethod> void computeNodesBounds();
+    template<typename InterpolationMethod> void applyNarrowBand();
+    template<typename InterpolationMethod> 
+    void sampleGrid(BoundingBox box, glm::ivec3 resolution, std::vector<float>& outGrid, uint32_t numThreads) const;
 };
 }
 
@@ -183,6 +183,26 @@ inline float estimateErrorFunctionIntegralBySimpsonsRule(const std::array<float,
            4.0f / 216.0f * pow2(middlePoints[17][0] - Inter::interpolateValue(interpolationCoeff, glm::vec3(1.0f, 0.5f, 1.0f))) +
            4.0f / 216.0f * pow2(middlePoints[18][0] - Inter::interpolateValue(interpolationCoeff, glm::vec3(0.5f, 1.0f, 1.0f)));
 }
+
+// Lower bound of the absolute distance inside a node from the distances at its vertices.
+// Any point of the node is at most half the node diagonal from one of its vertices.
+template<size_t VALUES_PER_VERTEX>
+inline float getNodeMinAbsDistance(const std::array<std::array<float, VALUES_PER_VERTEX>, 8>& verticesValues, float halfSize)
+{
+    float minValue = INFINITY;
+    for(uint32_t i=0; i < 8; i++)
+    {
+        minValue = glm::min(minValue, glm::abs(verticesValues[i][0]));
+    }
+    return minValue - glm::sqrt(3.0f) * halfSize;
+}
+
+// The nodes completely outside the narrow band are not subdivided. A zero band disables the test.
+template<size_t VALUES_PER_VERTEX>
+inline bool isOutsideNarrowBand(const std::array<std::array<float, VALUES_PER_VERTEX>, 8>& verticesValues, float halfSize, float narrowBand)
+{
+    return narrowBand > 0.0f && getNodeMinAbsDistance(verticesValues, halfSize) >= narrowBand;
+}
 }
 
 #endif
\ No newline at end of file
@@ -15,6 +15,7 @@ public:
     float getDistance(glm::vec3 sample) const override;
     float getDistance(glm::vec3 sample, glm::vec3& outGradient) const override;
     BoundingBox getSampleArea() const override { return BoundingBox(glm::vec3(-INFINITY), glm::vec3(INFINITY)); }
+    MemoryUsage memoryUsage() const override;
 private:
     std::vector<TriangleUtils::TriangleData> mTriangles;
 };
@@ -4,11 +4,48 @@
 #include <glm/glm.hpp>
 #include <cereal/archives/portable_binary.hpp>
 #include <fstream>
+#include <vector>
 
 #include "utils/Mesh.h"
 
 namespace sdflib
 {
+/**
+ * @brief Bytes used by each component of a structure.
+ *        The arrays are measured by its capacity, which is the memory really allocated.
+ **/
+struct MemoryUsage
+{
+    size_t nodes = 0; // Array of octree nodes
+    size_t coefficients = 0; // Polynomial coefficients or grid values
+    size_t trianglesSets = 0; // Sets of triangles influencing the nodes
+    size_t trianglesMasks = 0; // Bit encoded sets of triangles
+    size_t trianglesData = 0; // Triangle properties used to compute distances
+    size_t caches = 0; // Auxiliary arrays used during the queries
+    size_t nodesBounds = 0; // Minimum and maximum values of each node used by the bounds queries
+
+    // Peak of memory used during the construction, including the temporal buffers and the structure arrays.
+    // Each builder keeps a high-water mark of the buffers that shrink during the construction.
+    // It is zero if the structure has been loaded from disk.
+    size_t constructionPeak = 0;
+
+    /**
+     * @return The bytes used by the structure, without counting the construction peak
+     **/
+    size_t getTotal() const 
+    { 
+        return nodes + coefficients + trianglesSets + trianglesMasks + trianglesData + caches + nodesBounds; 
+    }
+
+    /**
+     * @brief Prints the memory of each component
+     **/
+    void print() const;
+
+    template<typename T>
+    static size_t getBytes(const std::vector<T>& array) { return array.capacity() * sizeof(T); }
+};
+
 class SdfFunction
 {
 public:
@@ -21,6 +58,14 @@ public:
         NONE
     };
 
+    // Version of the file container written by saveToFile.
+    // The version 2 adds the flags and the version 3 stores the level of detail of the octrees
+    static constexpr uint32_t FILE_VERSION = 3;
+    // Version given to the files stored without header by the previous versions
+    static constexpr uint32_t LEGACY_FILE_VERSION = 0;
+    // Flags of the file container
+    static constexpr uint32_t FILE_FLAG_COMPRESSED = 1;
+
     /**
      * @return The signed distance to the mesh at the point
      **/
@@ -38,21 +83,33 @@ public:
      * @return The format of the structure
      **/
     virtual SdfFormat getFormat() const { return SdfFormat::NONE; }
+
+    /**
+     * @return The bytes used by each component of the structure
+     **/
+    virtual MemoryUsage memoryUsage() const { return MemoryUsage(); }
     
     /**
      * @brief Stores the structure to disk.
+     *        The file starts with a header with the version of the container and ends with
+     *        a checksum of the structure data, which is verified when it is loaded.
      * @param outputPath The file path where the structure should be stored
+     * @param compress If the structure arrays are compressed. The arrays are divided in blocks 
+     *                 compressed independently, which are decompressed in parallel when the file is loaded.
      * @return If the structure has been stored successfully
      **/
-    bool saveToFile(const std::string& outputPath);
+    bool saveToFile(const std::string& outputPath, bool compress = false);
 
     /**
-     * @brief Load a structure from disk
+     * @brief Load a structure from disk. The files stored without header by the previous versions are also supported.
      * @param inputPath The file path where the structure is stored
      * @return The pointer to the loaded structure. 
      *          If the file cannot be successfully loaded, it returns nullptr.
      **/
     static std::unique_ptr<SdfFunction> loadFromFile(const std::string& inputPath);
+protected:
+    // Peak of memory used during the construction
+    size_t mConstructionPeakMemory = 0;
 };
 }
 
@@ -15,6 +15,8 @@
 
 #include <vector>
 #include <array>
+#include <memory>
+#include <functional>
 #include <glm/glm.hpp>
 
 #define SDFLIB_PRINT_GJK_STATS
@@ -1011,6 +1013,57 @@ struct VHQueries
     }
 };
 
+template<typename T>
+struct DistanceFunctionQueries
+{
+    typedef T InterpolationMethod;
+
+    typedef uint32_t VertexInfo;
+    struct {} NodeInfo;
+
+    // Returns the distance and the gradient at a point, shared by the copies of each thread
+    std::shared_ptr<const std::function<float(glm::vec3, glm::vec3&)>> distanceFunction = nullptr;
+
+    void initCaches(BoundingBox box, uint32_t maxDepth) {}
+    
+    template<size_t N>
+    inline void calculateVerticesInfo(const glm::vec3 nodeCenter, const float nodeHalfSize,
+                                      const std::vector<uint32_t>& triangles,
+                                      const std::array<glm::vec3, N>& pointsRelPos,
+                                      const uint32_t pointToInterpolateMask,
+                                      const std::array<float, InterpolationMethod::NUM_COEFFICIENTS>& interpolationCoeff,
+                                      std::array<std::array<float, InterpolationMethod::VALUES_PER_VERTEX>, N>& outPointsValues,
+                                      std::array<VertexInfo, N>& outPointsInfo,
+                                      const Mesh& mesh, const std::vector<TriangleUtils::TriangleData>& trianglesData)
+    {
+        for(uint32_t i=0; i < N; i++)
+        {
+            if(pointToInterpolateMask & (1 << (N-i-1)))
+            {
+                InterpolationMethod::interpolateVertexValues(interpolationCoeff, 0.5f * pointsRelPos[i] + 0.5f, 2.0f * nodeHalfSize, outPointsValues[i]);
+            }
+            else
+            {
+                glm::vec3 gradient(0.0f);
+                const float distance = (*distanceFunction)(nodeCenter + pointsRelPos[i] * nodeHalfSize, gradient);
+                InterpolationMethod::calculatePointValues(distance, gradient, outPointsValues[i]);
+            }
+            outPointsInfo[i] = 0;
+        }
+    }
+
+    inline void filterTriangles(const glm::vec3 nodeCenter, const float nodeHalfSize,
+                                const std::vector<uint32_t>& inTriangles, std::vector<uint32_t>& outTriangles,
+                                const std::array<std::array<float, InterpolationMethod::VALUES_PER_VERTEX>, 8>& verticesValues,
+                                const std::array<VertexInfo, 8>& verticesInfo,
+                                const Mesh& mesh, const std::vector<TriangleUtils::TriangleData>& trianglesData)
+    {
+        outTriangles.clear();
+    }
+
+    void printStatistics() {}
+};
+
 #ifdef ENOKI_AVAILABLE
 template<typename T>
 struct FCPWQueries
@@ -12,6 +12,8 @@
 
 namespace sdflib
 {
+class OctreeSdf;
+
 class UniformGridSdf : public SdfFunction
 {
 public:
@@ -21,10 +23,34 @@ public:
     };
 
     UniformGridSdf() {}
+    /**
+     * @param narrowBand If it is greater than zero, the octree algorithm only computes the exact distance
+     *                   of the regions nearer than the band to the surface. The other grid points store a lower bound
+     *                   of the distance, reduced by the cell diagonal so the interpolation inside their cells never exceeds
+     *                   the real distance.
+     **/
     UniformGridSdf(const Mesh& mesh, BoundingBox box, uint32_t depth, 
-                   InitAlgorithm initAlgorithm = InitAlgorithm::OCTREE);
+                   InitAlgorithm initAlgorithm = InitAlgorithm::OCTREE,
+                   float narrowBand = 0.0f);
     UniformGridSdf(const Mesh& mesh, BoundingBox box, float cellSize, 
-                   InitAlgorithm initAlgorithm = InitAlgorithm::OCTREE);
+                   InitAlgorithm initAlgorithm = InitAlgorithm::OCTREE,
+                   float narrowBand = 0.0f);
+    /**
+     * @brief Resamples an octree in a grid using OctreeSdf::sampleGrid
+     * @param octreeSdf The octree to sample
+     * @param box The area covered by the grid
+     * @param cellSize The distance between the grid points
+     * @param numThreads The number of threads used
+     **/
+    UniformGridSdf(const OctreeSdf& octreeSdf, BoundingBox box, float cellSize, uint32_t numThreads = 1);
+    /**
+     * @brief Creates the structure from an existing grid, like an imported voxel volume
+     * @param box The area covered by the grid, the first and the last points of each axis are on the box faces
+     * @param gridSize The number of points in each axis, the cells must be cubes
+     * @param grid The grid values in x, y, z order. If it does not have the values of the grid size,
+     *             the structure is left empty and its queries return INFINITY.
+     **/
+    UniformGridSdf(BoundingBox box, glm::ivec3 gridSize, std::vector<float> grid);
     
     float getDistance(glm::vec3 sample) const override;
     float getDistance(glm::vec3 sample, glm::vec3& outGradient) const override;
@@ -36,16 +62,23 @@ public:
     glm::ivec3 getGridSize() const { return mGridSize; }
     const std::vector<float>& getGrid() const { return mGrid; }
 
+    /**
+     * @return The bytes used by the grid values
+     **/
+    MemoryUsage memoryUsage() const override;
+
     template<class Archive>
     void save(Archive & archive) const
     { 
-        archive(mBox, mGridSize, mGrid);
+        archive(mBox, mGridSize);
+        saveBulkArray(archive, mGrid, BlockCompression::Codec::FLOATS);
     }
 
     template<class Archive>
     void load(Archive & archive)
     {
-        archive(mBox, mGridSize, mGrid);
+        archive(mBox, mGridSize);
+        loadBulkArray(archive, mGrid, BlockCompression::Codec::FLOATS);
 
         glm::vec3 cellSize = mBox.getSize() / glm::vec3(mGridSize - 1);
         assert(
@@ -55,6 +88,7 @@ public:
         );
         mCellSize = (cellSize.x + cellSize.y + cellSize.z) / 3.0f;
         mGridXY = mGridSize.x * mGridSize.y;
+        mConstructionPeakMemory = 0;
     } 
 
 private:
@@ -66,7 +100,7 @@ private:
     std::vector<float> mGrid;
 
     void basicInit(const std::vector<TriangleUtils::TriangleData>& trianglesData);
-    void octreeInit(const Mesh& mesh, const std::vector<TriangleUtils::TriangleData>& trianglesData);
+    void octreeInit(const Mesh& mesh, const std::vector<TriangleUtils::TriangleData>& trianglesData, float narrowBand = 0.0f);
     void evalNode(glm::vec3 center, glm::vec3 size, 
                   std::vector<std::pair<float, uint32_t>>& parentTriangles, 
                   const std::vector<TriangleUtils::TriangleData>& trianglesData,
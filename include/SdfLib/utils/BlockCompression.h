@@ -0,0 +1,117 @@
+#ifndef BLOCK_COMPRESSION_H
+#define BLOCK_COMPRESSION_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace sdflib
+{
+/**
+ * @brief Lossless compression of the structure arrays stored on disk.
+ *        The arrays are divided in blocks compressed independently, so they are decompressed in parallel.
+ *        The structures keep all their nodes in memory, so the whole arrays are decompressed when loaded.
+ *        Inside a block of words, each group of 32 words is stored with the minimum number of bits,
+ *        after subtracting the group minimum, using the words or the differences between consecutive words.
+ **/
+namespace BlockCompression
+{
+    static constexpr uint32_t BLOCK_VALUES = 16384;
+    static constexpr uint32_t BLOCK_BYTES = 4 * BLOCK_VALUES;
+    static constexpr uint32_t GROUP_VALUES = 32;
+
+    enum Codec
+    {
+        INTEGERS, // Indices and bit sets
+        FLOATS // The float bits are transformed to a monotonic integer before the delta coding
+    };
+
+    struct CompressedArray
+    {
+        std::vector<uint32_t> blocksSize; // Bytes of each block
+        std::vector<uint8_t> data; // Compressed blocks stored sequentially
+    };
+
+    /**
+     * @brief Compresses an array of 4-byte words
+     * @param values The array words
+     * @param numValues The number of words of the array
+     * @param codec The type of data stored in the words
+     * @param numThreads The number of threads used to compress the blocks
+     **/
+    CompressedArray compress(const uint32_t* values, size_t numValues, Codec codec, uint32_t numThreads = 1);
+
+    /**
+     * @brief Decompresses all the blocks of an array in parallel
+     * @param array The compressed array
+     * @param numValues The number of words of the original array
+     * @param outValues The array where the words are stored, with space for numValues words
+     * @return If the array has been decompressed successfully
+     **/
+    bool decompress(const CompressedArray& array, size_t numValues, Codec codec, uint32_t* outValues, uint32_t numThreads = 1);
+
+    /**
+     * @brief Compresses an array of bytes, like the triangles masks, coding the runs of repeated bytes
+     * @param values The array bytes
+     * @param numValues The number of bytes of the array
+     * @param numThreads The number of threads used to compress the blocks
+     **/
+    CompressedArray compressBytes(const uint8_t* values, size_t numValues, uint32_t numThreads = 1);
+
+    /**
+     * @brief Decompresses all the blocks of an array of bytes in parallel
+     * @param array The compressed array
+     * @param numValues The number of bytes of the original array
+     * @param outValues The array where the bytes are stored, with space for numValues bytes
+     * @return If the array has been decompressed successfully
+     **/
+    bool decompressBytes(const CompressedArray& array, size_t numValues, uint8_t* outValues, uint32_t numThreads = 1);
+
+    /**
+     * @brief Compresses a sequence of triangles sets. Each set is stored as its number of indices,
+     *        followed by the indices packed with bitsPerIndex bits and an empty word.
+     *        The indices are stored as the differences between consecutive indices of the set.
+     *        The blocks not following this layout are compressed with the integers codec.
+     * @param values The array words
+     * @param numValues The number of words of the array
+     * @param bitsPerIndex The bits used by each packed index
+     * @param numThreads The number of threads used to compress the blocks
+     **/
+    CompressedArray compressIndexSets(const uint32_t* values, size_t numValues, uint32_t bitsPerIndex, uint32_t numThreads = 1);
+
+    /**
+     * @brief Decompresses all the blocks of a sequence of triangles sets in parallel
+     * @param array The compressed array
+     * @param numValues The number of words of the original array
+     * @param bitsPerIndex The bits used by each packed index
+     * @param outValues The array where the words are stored, with space for numValues words
+     * @return If the array has been decompressed successfully
+     **/
+    bool decompressIndexSets(const CompressedArray& array, size_t numValues, uint32_t bitsPerIndex, uint32_t* outValues, uint32_t numThreads = 1);
+
+    /**
+     * @return If the arrays serialized by the calling thread must be compressed
+     **/
+    bool isEnabled();
+
+    /**
+     * @return The number of threads used to compress and decompress the arrays serialized by the calling thread
+     **/
+    uint32_t getNumThreads();
+
+    /**
+     * @brief Enables or disables the compression of the arrays serialized by the calling thread during its lifetime
+     **/
+    class Scope
+    {
+    public:
+        Scope(bool enabled, uint32_t numThreads = 1);
+        ~Scope();
+    private:
+        bool mPreviousEnabled;
+        uint32_t mPreviousNumThreads;
+    };
+}
+}
+
+#endif
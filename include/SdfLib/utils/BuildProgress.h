@@ -0,0 +1,76 @@
+#ifndef BUILD_PROGRESS_H
+#define BUILD_PROGRESS_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace sdflib
+{
+/**
+ * @brief Progress and cancellation state of a structure construction.
+ *        The builders count the nodes processed at each depth and the nodes that they
+ *        expect to process, which grows when the nodes are subdivided.
+ *        When it is cancelled, the builders stop subdividing the nodes below the start grid,
+ *        so they still finish with a valid, but coarser, structure.
+ *        All the methods are thread safe.
+ **/
+class BuildProgress
+{
+public:
+    static constexpr uint32_t MAX_DEPTH = 31;
+
+    BuildProgress();
+
+    void addProcessedNodes(uint32_t depth, uint64_t numNodes = 1)
+    {
+        mProcessedNodes[clampDepth(depth)].fetch_add(numNodes, std::memory_order_relaxed);
+    }
+
+    void addEstimatedNodes(uint32_t depth, uint64_t numNodes)
+    {
+        mEstimatedNodes[clampDepth(depth)].fetch_add(numNodes, std::memory_order_relaxed);
+    }
+
+    uint64_t getProcessedNodes(uint32_t depth) const { return mProcessedNodes[clampDepth(depth)].load(std::memory_order_relaxed); }
+    uint64_t getEstimatedNodes(uint32_t depth) const { return mEstimatedNodes[clampDepth(depth)].load(std::memory_order_relaxed); }
+
+    /**
+     * @return An estimation of the completed fraction of the construction, between 0 and 1.
+     *         It can decrease when new nodes are subdivided.
+     **/
+    float getFraction() const;
+
+    void cancel() { mCancelled.store(true, std::memory_order_relaxed); }
+    bool isCancelled() const { return mCancelled.load(std::memory_order_relaxed); }
+
+    void setFinished() { mFinished.store(true, std::memory_order_release); }
+    bool isFinished() const { return mFinished.load(std::memory_order_acquire); }
+
+    /**
+     * @return The progress of the construction running in the calling thread or null
+     **/
+    static BuildProgress* getCurrent();
+
+    /**
+     * @brief Reports the constructions of the calling thread to a progress during its lifetime
+     **/
+    class Scope
+    {
+    public:
+        Scope(BuildProgress* progress);
+        ~Scope();
+    private:
+        BuildProgress* mPrevious;
+    };
+private:
+    static uint32_t clampDepth(uint32_t depth) { return (depth < MAX_DEPTH) ? depth : MAX_DEPTH; }
+
+    std::array<std::atomic<uint64_t>, MAX_DEPTH + 1> mProcessedNodes;
+    std::array<std::atomic<uint64_t>, MAX_DEPTH + 1> mEstimatedNodes;
+    std::atomic<bool> mCancelled;
+    std::atomic<bool> mFinished;
+};
+}
+
+#endif
@@ -73,8 +73,12 @@ class Mesh
 {
 public:
     Mesh() {}
-#ifdef SDFLIB_ASSIMP_AVAILABLE
+    /**
+     * @brief Loads a mesh from disk. The binary STL, binary PLY and OBJ files are loaded 
+     *        with the native loaders, the other formats are loaded with assimp if it is available.
+     **/
     Mesh(std::string filePath);
+#ifdef SDFLIB_ASSIMP_AVAILABLE
     Mesh(const aiMesh* mesh);
 #endif
     Mesh(glm::vec3* vertices, uint32_t numVertices,
@@ -0,0 +1,45 @@
+#ifndef MESH_LOADER_H
+#define MESH_LOADER_H
+
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Mesh.h"
+
+namespace sdflib
+{
+/**
+ * @brief Native loaders for the most common triangle mesh formats, which do not depend on assimp.
+ *        The files are memory mapped and parsed in parallel.
+ *        Supported formats: binary STL, binary PLY (little and big endian) and OBJ.
+ **/
+namespace MeshLoader
+{
+    /**
+     * @return If the file extension is one of the formats supported by the native loaders
+     **/
+    bool isFormatSupported(const std::string& filePath);
+
+    /**
+     * @brief Loads a mesh and welds the vertices with the same position.
+     * @param filePath The path of the mesh file
+     * @param outMesh The mesh where the vertices, indices and normals are stored
+     * @param numThreads The number of threads used during the parsing.
+     *                   Zero uses all the available threads.
+     * @return If the mesh has been loaded successfully.
+     *         It fails for the unsupported variants, like ascii STL and ascii PLY files.
+     **/
+    bool load(const std::string& filePath, Mesh& outMesh, uint32_t numThreads = 0);
+
+    /**
+     * @brief Merges the vertices with the same position and updates the indices.
+     *        The order of the first appearance of each vertex is preserved.
+     * @param vertices The vertices array, it is replaced by the unique vertices
+     * @param indices The triangles indices, they are remapped to the unique vertices
+     * @param numThreads The number of threads. Zero uses all the available threads.
+     **/
+    void weldVertices(std::vector<glm::vec3>& vertices, std::vector<uint32_t>& indices, uint32_t numThreads = 0);
+}
+}
+
+#endif
@@ -0,0 +1,176 @@
+#ifndef QUERY_STATISTICS_H
+#define QUERY_STATISTICS_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <type_traits>
+
+namespace sdflib
+{
+/**
+ * @brief Counters collected during the structures queries.
+ *        They are only collected if the library is compiled with SDFLIB_QUERY_STATISTICS,
+ *        otherwise the instrumentation compiles to nothing and the counters are always zero.
+ **/
+struct QueryStatistics
+{
+    static constexpr uint32_t MAX_DEPTH = 32;
+    // The latency histogram has LATENCY_BINS_PER_OCTAVE bins for each power of two of nanoseconds
+    static constexpr uint32_t LATENCY_BINS_PER_OCTAVE = 8;
+    static constexpr uint32_t LATENCY_BINS = 40 * LATENCY_BINS_PER_OCTAVE;
+
+    uint64_t numQueries = 0;
+    uint64_t numNodesVisited = 0;
+    uint64_t numTrianglesTested = 0;
+    uint64_t numOutOfBoxQueries = 0;
+    uint32_t maxDepthReached = 0;
+    std::array<uint64_t, MAX_DEPTH> depthHistogram{}; // Number of queries ending at each depth
+
+    uint64_t numLatencySamples = 0;
+    std::array<uint64_t, LATENCY_BINS> latencyHistogram{};
+
+    void merge(const QueryStatistics& other);
+    void reset();
+
+    float getMeanNodesVisited() const;
+    float getMeanTrianglesTested() const;
+    float getMeanDepth() const;
+    /**
+     * @return The approximated latency percentile in nanoseconds of the sampled queries
+     * @param p The percentile between 0 and 1
+     **/
+    float getLatencyPercentile(float p) const;
+};
+
+namespace QueryStats
+{
+    // Identifies the structure generating the statistics
+    enum Structure
+    {
+        GRID,
+        OCTREE,
+        EXACT_OCTREE,
+        REAL,
+        NUM_STRUCTURES
+    };
+
+    /**
+     * @return If the library has been compiled with the queries instrumentation
+     **/
+    constexpr bool isEnabled()
+    {
+    #ifdef SDFLIB_QUERY_STATISTICS
+        return true;
+    #else
+        return false;
+    #endif
+    }
+
+    /**
+     * @return The statistics of all the threads merged for one type of structure
+     * @note The counters of each thread are plain integers written without synchronization,
+     *       so it must be called once the queries have finished, never while other threads are querying
+     **/
+    QueryStatistics collect(Structure structure);
+
+    /**
+     * @brief Sets all the counters of all the threads to zero.
+     *        Like collect, it must not be called while other threads are querying
+     **/
+    void reset();
+
+    /**
+     * @brief Sets how often the query latency is measured
+     * @param oneEvery Only one of each oneEvery queries of a thread is measured.
+     *                 Zero disables the latency measurement.
+     **/
+    void setLatencySampleRate(uint32_t oneEvery);
+
+    namespace internal
+    {
+        QueryStatistics& getThreadStatistics(Structure structure);
+        bool sampleLatency();
+
+        // Accumulates the counters of one query and stores them at the end of the scope
+        struct QueryScope
+        {
+            QueryScope(Structure structure)
+                : stats(getThreadStatistics(structure)),
+                  measureLatency(sampleLatency())
+            {
+                if(measureLatency) startTime = std::chrono::steady_clock::now();
+            }
+
+            ~QueryScope()
+            {
+                stats.numQueries++;
+                stats.numNodesVisited += nodesVisited;
+                stats.numTrianglesTested += trianglesTested;
+                stats.numOutOfBoxQueries += (outOfBox) ? 1 : 0;
+                if(nodesVisited > 0)
+                {
+                    stats.depthHistogram[(depth < QueryStatistics::MAX_DEPTH) ? depth : QueryStatistics::MAX_DEPTH - 1]++;
+                    stats.maxDepthReached = (depth > stats.maxDepthReached) ? depth : stats.maxDepthReached;
+                }
+                if(measureLatency) addLatencySample();
+            }
+
+            inline void startNode(uint32_t startGridSize)
+            {
+                depth = 0;
+                while((1u << depth) < startGridSize) depth++;
+                nodesVisited = 1;
+            }
+
+            inline void descend()
+            {
+                depth++;
+                nodesVisited++;
+            }
+
+            void addLatencySample();
+
+            QueryStatistics& stats;
+            bool measureLatency;
+            bool outOfBox = false;
+            uint32_t depth = 0;
+            uint32_t nodesVisited = 0;
+            uint32_t trianglesTested = 0;
+            std::chrono::time_point<std::chrono::steady_clock> startTime;
+        };
+
+        // Scope of the queries done internally by the structures, which are not counted
+        struct NullQueryScope
+        {
+            NullQueryScope(Structure) {}
+            inline void startNode(uint32_t) {}
+            inline void descend() {}
+
+            bool outOfBox = false;
+            uint32_t trianglesTested = 0;
+        };
+    }
+}
+}
+
+// Instrumentation macros used inside the queries
+#ifdef SDFLIB_QUERY_STATISTICS
+#define SDFLIB_QUERY_STATS_SCOPE(structure) sdflib::QueryStats::internal::QueryScope sdflibQueryScope(structure)
+// Only counts the query if the constant expression countQuery is true
+#define SDFLIB_QUERY_STATS_OPTIONAL_SCOPE(countQuery, structure) \
+    std::conditional_t<(countQuery), sdflib::QueryStats::internal::QueryScope, sdflib::QueryStats::internal::NullQueryScope> sdflibQueryScope(structure)
+#define SDFLIB_QUERY_STATS_START_NODE(startGridSize) sdflibQueryScope.startNode(startGridSize)
+#define SDFLIB_QUERY_STATS_DESCEND() sdflibQueryScope.descend()
+#define SDFLIB_QUERY_STATS_TRIANGLES_TESTED(num) sdflibQueryScope.trianglesTested += (num)
+#define SDFLIB_QUERY_STATS_OUT_OF_BOX() sdflibQueryScope.outOfBox = true
+#else
+#define SDFLIB_QUERY_STATS_SCOPE(structure) ((void)0)
+#define SDFLIB_QUERY_STATS_OPTIONAL_SCOPE(countQuery, structure) ((void)0)
+#define SDFLIB_QUERY_STATS_START_NODE(startGridSize) ((void)0)
+#define SDFLIB_QUERY_STATS_DESCEND() ((void)0)
+#define SDFLIB_QUERY_STATS_TRIANGLES_TESTED(num) ((void)0)
+#define SDFLIB_QUERY_STATS_OUT_OF_BOX() ((void)0)
+#endif
+
+#endif
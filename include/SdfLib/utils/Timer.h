@@ -2,6 +2,10 @@
 #define TIMER_H
 
 #include <chrono>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <ostream>
 
 namespace sdflib
 {
@@ -14,6 +18,108 @@ public:
 private:
 	std::chrono::time_point<std::chrono::steady_clock> lastTime;
 };
+
+/**
+ * @brief Writes a string between quotes escaping the characters not allowed in a JSON string
+ **/
+void writeJsonString(std::ostream& out, const std::string& str);
+
+/**
+ * @brief Records the time intervals of named scopes of all the threads.
+ *        The intervals can be exported in the Chrome trace format, 
+ *        which can be opened with chrome://tracing or https://ui.perfetto.dev.
+ *        The recording is disabled by default, then the scopes only check a flag.
+ **/
+class Profiler {
+public:
+	typedef std::vector<std::pair<std::string, double>> EventArgs;
+
+	static void setEnabled(bool enabled);
+	static bool isEnabled() { return sEnabled.load(std::memory_order_relaxed); }
+
+	/**
+	 * @brief Adds a complete interval to the calling thread timeline
+	 * @param name The name of the interval
+	 * @param start The start time of the interval
+	 * @param end The end time of the interval
+	 * @param args Values shown with the interval
+	 **/
+	static void addEvent(const std::string& name,
+						 std::chrono::time_point<std::chrono::steady_clock> start,
+						 std::chrono::time_point<std::chrono::steady_clock> end,
+						 EventArgs args = EventArgs());
+
+	/**
+	 * @brief Names the timeline of the calling thread
+	 **/
+	static void setThreadName(const std::string& name);
+
+	/**
+	 * @brief Stores all the recorded intervals in the Chrome trace JSON format
+	 * @param outputPath The file path where the trace should be stored
+	 * @return If the trace has been stored successfully
+	 **/
+	static bool writeChromeTrace(const std::string& outputPath);
+
+	/**
+	 * @brief Removes all the recorded intervals
+	 **/
+	static void clear();
+private:
+	static std::atomic<bool> sEnabled;
+};
+
+/**
+ * @brief Records the interval between its construction and destruction in the Profiler.
+ *        The names are only copied when the Profiler is enabled, so they must be string literals
+ *        or outlive the scope.
+ **/
+class ScopedTimer {
+public:
+	ScopedTimer(const char* name);
+	~ScopedTimer();
+
+	/**
+	 * @brief Adds a value shown with the interval in the trace
+	 **/
+	void addArg(const char* name, double value);
+
+	/**
+	 * @brief Records the interval before the end of the scope
+	 **/
+	void stop();
+private:
+	bool mEnabled;
+	const char* mName;
+	Profiler::EventArgs mArgs;
+	std::chrono::time_point<std::chrono::steady_clock> mStartTime;
+};
+
+/**
+ * @brief Accumulates the time of many short intervals.
+ *        It only measures when the Profiler is enabled.
+ **/
+class AccumulatedTimer {
+public:
+	AccumulatedTimer() : mEnabled(Profiler::isEnabled()) {}
+
+	inline void start()
+	{
+		if(mEnabled) mLastTime = std::chrono::steady_clock::now();
+	}
+
+	inline void stop()
+	{
+		if(mEnabled) mTotalTime += std::chrono::steady_clock::now() - mLastTime;
+	}
+
+	double getSeconds() const { return std::chrono::duration<double>(mTotalTime).count(); }
+	void reset() { mTotalTime = std::chrono::steady_clock::duration::zero(); }
+private:
+	bool mEnabled;
+	std::chrono::time_point<std::chrono::steady_clock> mLastTime;
+	std::chrono::steady_clock::duration mTotalTime = std::chrono::steady_clock::duration::zero();
+};
 }
 
-#endif
\ No newline at end of file
+#endif
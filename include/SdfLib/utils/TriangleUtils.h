@@ -73,6 +73,18 @@ namespace TriangleUtils
 
     std::vector<TriangleData> calculateMeshTriangleData(const Mesh& mesh);
 
+    /**
+     * @brief Computes the triangles data of a mesh given by its arrays. 
+     *        The result only depends on the arrays, so it can be used to rebuild the data stored by a structure.
+     * @param vertices The mesh vertices
+     * @param indices The mesh triangles indices
+     * @param meshBox The mesh bounding box, used to merge the near vertices of the non-manifold edges
+     * @param numThreads The number of threads used to compute the independent parts of each triangle
+     **/
+    std::vector<TriangleData> calculateMeshTriangleData(const std::vector<glm::vec3>& vertices, 
+                                                        const std::vector<uint32_t>& indices,
+                                                        const BoundingBox& meshBox, uint32_t numThreads = 1);
+
     inline float getSqDistPointAndTriangle(glm::vec3 point, const TriangleData& data)
     {
         glm::vec3 projPoint = data.transform * (point - data.origin);
@@ -2,6 +2,13 @@
 #define USEFULL_SERIALIZATIONS_H
 
 #include <glm/glm.hpp>
+#include <cereal/cereal.hpp>
+#include <cereal/types/vector.hpp>
+#include <vector>
+#include <cstdint>
+#include <type_traits>
+
+#include "BlockCompression.h"
 
 namespace glm
 {
@@ -34,4 +41,185 @@ namespace glm
     }
 }
 
+namespace sdflib
+{
+    /**
+     * @brief Stores an array of structures made only of 4-byte words as a single block.
+     *        The output is the same than archiving each element in the portable binary archive,
+     *        so it can load the arrays stored element by element, but the words are only
+     *        converted when the machine endianness differs from the file.
+     *        The serialize function of the structure must archive all its words in memory order.
+     *        If the compression is enabled in the calling thread, the words are compressed with the codec.
+     **/
+    template<class Archive, typename T>
+    void saveBulkArray(Archive& archive, const std::vector<T>& array, BlockCompression::Codec codec)
+    {
+        static_assert(std::is_trivially_copyable<T>::value && sizeof(T) % sizeof(uint32_t) == 0 && alignof(T) == alignof(uint32_t),
+                      "The bulk arrays only support structures made of 4-byte words");
+
+        if constexpr(cereal::traits::is_output_serializable<cereal::BinaryData<const uint32_t*>, Archive>::value)
+        {
+            archive(cereal::make_size_tag(static_cast<cereal::size_type>(array.size())));
+            if(BlockCompression::isEnabled())
+            {
+                BlockCompression::CompressedArray compressed = 
+                    BlockCompression::compress(reinterpret_cast<const uint32_t*>(array.data()), array.size() * sizeof(T) / sizeof(uint32_t), 
+                                               codec, BlockCompression::getNumThreads());
+                archive(compressed.blocksSize, compressed.data);
+            }
+            else
+            {
+                archive(cereal::binary_data(reinterpret_cast<const uint32_t*>(array.data()), array.size() * sizeof(T)));
+            }
+        }
+        else
+        {
+            archive(array);
+        }
+    }
+
+    template<class Archive, typename T>
+    void loadBulkArray(Archive& archive, std::vector<T>& array, BlockCompression::Codec codec)
+    {
+        static_assert(std::is_trivially_copyable<T>::value && sizeof(T) % sizeof(uint32_t) == 0 && alignof(T) == alignof(uint32_t),
+                      "The bulk arrays only support structures made of 4-byte words");
+
+        if constexpr(cereal::traits::is_input_serializable<cereal::BinaryData<uint32_t*>, Archive>::value)
+        {
+            cereal::size_type size;
+            archive(cereal::make_size_tag(size));
+            array.resize(static_cast<size_t>(size));
+            if(BlockCompression::isEnabled())
+            {
+                BlockCompression::CompressedArray compressed;
+                archive(compressed.blocksSize, compressed.data);
+                if(!BlockCompression::decompress(compressed, array.size() * sizeof(T) / sizeof(uint32_t), codec, 
+                                                 reinterpret_cast<uint32_t*>(array.data()), BlockCompression::getNumThreads()))
+                {
+                    throw cereal::Exception("Invalid compressed array");
+                }
+            }
+            else
+            {
+                archive(cereal::binary_data(reinterpret_cast<uint32_t*>(array.data()), array.size() * sizeof(T)));
+            }
+        }
+        else
+        {
+            archive(array);
+        }
+    }
+
+    /**
+     * @brief Stores an array of bytes. If the compression is enabled in the calling thread, 
+     *        the runs of repeated bytes are compressed.
+     **/
+    template<class Archive>
+    void saveBulkBytes(Archive& archive, const std::vector<uint8_t>& array)
+    {
+        if(BlockCompression::isEnabled())
+        {
+            archive(cereal::make_size_tag(static_cast<cereal::size_type>(array.size())));
+            BlockCompression::CompressedArray compressed = 
+                BlockCompression::compressBytes(array.data(), array.size(), BlockCompression::getNumThreads());
+            archive(compressed.blocksSize, compressed.data);
+        }
+        else
+        {
+            archive(array);
+        }
+    }
+
+    template<class Archive>
+    void loadBulkBytes(Archive& archive, std::vector<uint8_t>& array)
+    {
+        if(BlockCompression::isEnabled())
+        {
+            cereal::size_type size;
+            archive(cereal::make_size_tag(size));
+            BlockCompression::CompressedArray compressed;
+            archive(compressed.blocksSize, compressed.data);
+            array.resize(static_cast<size_t>(size));
+            if(!BlockCompression::decompressBytes(compressed, array.size(), array.data(), BlockCompression::getNumThreads()))
+            {
+                throw cereal::Exception("Invalid compressed array");
+            }
+        }
+        else
+        {
+            archive(array);
+        }
+    }
+
+    /**
+     * @brief Stores the triangles sets of an ExactOctreeSdf. If the compression is enabled in the calling thread, 
+     *        the sets are compressed with the triangles sets codec, otherwise they are stored like saveBulkArray.
+     * @param bitsPerIndex The bits used by each packed index of the sets
+     **/
+    template<class Archive>
+    void saveBulkIndexSets(Archive& archive, const std::vector<uint32_t>& array, uint32_t bitsPerIndex)
+    {
+        if(BlockCompression::isEnabled())
+        {
+            archive(cereal::make_size_tag(static_cast<cereal::size_type>(array.size())));
+            BlockCompression::CompressedArray compressed = 
+                BlockCompression::compressIndexSets(array.data(), array.size(), bitsPerIndex, BlockCompression::getNumThreads());
+            archive(compressed.blocksSize, compressed.data);
+        }
+        else
+        {
+            saveBulkArray(archive, array, BlockCompression::Codec::INTEGERS);
+        }
+    }
+
+    template<class Archive>
+    void loadBulkIndexSets(Archive& archive, std::vector<uint32_t>& array, uint32_t bitsPerIndex)
+    {
+        if(BlockCompression::isEnabled())
+        {
+            cereal::size_type size;
+            archive(cereal::make_size_tag(size));
+            BlockCompression::CompressedArray compressed;
+            archive(compressed.blocksSize, compressed.data);
+            array.resize(static_cast<size_t>(size));
+            if(!BlockCompression::decompressIndexSets(compressed, array.size(), bitsPerIndex, array.data(), BlockCompression::getNumThreads()))
+            {
+                throw cereal::Exception("Invalid compressed array");
+            }
+        }
+        else
+        {
+            loadBulkArray(archive, array, BlockCompression::Codec::INTEGERS);
+        }
+    }
+
+    /**
+     * @brief Stores the size of a start grid. The cubic grids are stored as a single size,
+     *        like the files written before the anisotropic grids, and the anisotropic grids
+     *        store a negative size followed by the size of each axis.
+     **/
+    template<class Archive>
+    void saveStartGridSize(Archive& archive, glm::ivec3 size)
+    {
+        if(size.x == size.y && size.x == size.z)
+        {
+            archive(size.x);
+        }
+        else
+        {
+            const int anisotropicMarker = -1;
+            archive(anisotropicMarker, size);
+        }
+    }
+
+    template<class Archive>
+    void loadStartGridSize(Archive& archive, glm::ivec3& size)
+    {
+        int cubicSize;
+        archive(cubicSize);
+        if(cubicSize < 0) archive(size);
+        else size = glm::ivec3(cubicSize);
+    }
+}
+
 #endif
\ No newline at end of file
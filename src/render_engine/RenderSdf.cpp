@@ -19,8 +19,21 @@ RenderSdf::~RenderSdf()
     glDeleteProgram(mRenderProgramId);
 }
 
+bool RenderSdf::isSupported(const OctreeSdf& octreeSdf)
+{
+    return octreeSdf.getInterpolationType() == OctreeSdf::InterpolationType::TRICUBIC && !octreeSdf.hasSharedVertices();
+}
+
 void RenderSdf::start()
 {
+    // The shader reads the 64 coefficients stored inline in each leaf
+    if(mInputOctree == nullptr || !isSupported(*mInputOctree))
+    {
+        SPDLOG_ERROR("The renderer only supports octrees with tricubic interpolation and without shared vertices");
+        mInputOctree = nullptr;
+        return;
+    }
+
     auto checkForOpenGLErrors = []() -> GLenum
     {
         GLenum errorCode;
@@ -117,7 +130,6 @@ void RenderSdf::start()
 
     // Set octree data
     {
-        // Set octree data
         glGenBuffers(1, &mOctreeSSBO);
         glBindBuffer(GL_SHADER_STORAGE_BUFFER, mOctreeSSBO);
         glBufferData(GL_SHADER_STORAGE_BUFFER, mInputOctree->getOctreeData().size() * sizeof(OctreeSdf::OctreeNode), mInputOctree->getOctreeData().data(), GL_STATIC_DRAW);
@@ -125,7 +137,8 @@ void RenderSdf::start()
         glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
 
         mOctreeMatrix = glm::scale(glm::mat4(1.0f), 1.0f / mInputOctree->getGridBoundingBox().getSize()) * glm::translate(glm::mat4(1.0f), -mInputOctree->getGridBoundingBox().min);
-        mOctreeDistanceScale = 1.0f / mInputOctree->getGridBoundingBox().getSize().x;
+        const glm::vec3 octreeSize = mInputOctree->getGridBoundingBox().getSize();
+        mOctreeDistanceScale = 1.0f / glm::max(glm::max(octreeSize.x, octreeSize.y), octreeSize.z);
         mOctreeMinBorderValue = mInputOctree->getOctreeMinBorderValue();
     }
 
@@ -149,6 +162,8 @@ void RenderSdf::start()
 
 void RenderSdf::draw(Camera* camera)
 {
+    if(mOctreeSSBO == 0) return;
+
     glm::ivec2 currentScreenSize = Window::getCurrentWindow().getWindowSize();
 
     if( currentScreenSize.x != mRenderTextureSize.x ||
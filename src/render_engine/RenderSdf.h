@@ -20,6 +20,13 @@ public:
         mInputOctree = inputOctree;
     }
     ~RenderSdf();
+
+    /**
+     * @return If the compute shader can render the octree, 
+     *         it only supports octrees with tricubic interpolation and without shared vertices
+     **/
+    static bool isSupported(const sdflib::OctreeSdf& octreeSdf);
+
     void start() override;
     void draw(Camera* camera) override;
     void drawGui() override;
@@ -27,10 +34,10 @@ public:
 private:
     RenderMesh mRenderMesh;
     ScreenPlaneShader screenPlaneShader;
-    unsigned int mRenderProgramId;
+    unsigned int mRenderProgramId = 0;
     unsigned int mRenderTexture;
     glm::ivec2 mRenderTextureSize;
-    unsigned int mOctreeSSBO;
+    unsigned int mOctreeSSBO = 0; // Zero if the octree has not been uploaded
 
     unsigned int mPixelToViewLocation;
     unsigned int mNearPlaneHalfSizeLocation;
@@ -27,12 +27,21 @@ public:
         minBorderValueLocation = glGetUniformLocation(getProgramId(), "minBorderValue");
         minBorderValue = octreeSdf.getOctreeMinBorderValue();
         distanceScaleLocation = glGetUniformLocation(getProgramId(), "distanceScale");
-        distanceScale = 1.0f / octreeSdf.getGridBoundingBox().getSize().x;
+        // The largest side keeps the steps conservative with an anisotropic start grid
+        const glm::vec3 octreeSize = octreeSdf.getGridBoundingBox().getSize();
+        distanceScale = 1.0f / glm::max(glm::max(octreeSize.x, octreeSize.y), octreeSize.z);
         materialAlbedoColorLocation = glGetUniformLocation(getProgramId(), "materialAlbedoColor");
         materialAlbedoColor = glm::vec3(1.0, 0.0, 0.0);
         timeLocation = glGetUniformLocation(getProgramId(), "time");
         timer.start();
 
+        // The shader reads the 64 coefficients stored inline in each leaf
+        if(!isSupported(octreeSdf))
+        {
+            SPDLOG_ERROR("The shader only supports octrees with tricubic interpolation and without shared vertices");
+            return;
+        }
+
         // Set octree data
         glGenBuffers(1, &mOctreeSSBO);
         glBindBuffer(GL_SHADER_STORAGE_BUFFER, mOctreeSSBO);
@@ -46,6 +55,11 @@ public:
         materialAlbedoColor = color;
     }
 
+    static bool isSupported(const sdflib::OctreeSdf& octreeSdf)
+    {
+        return octreeSdf.getInterpolationType() == sdflib::OctreeSdf::InterpolationType::TRICUBIC && !octreeSdf.hasSharedVertices();
+    }
+
     void bind() override
     {
         glBindBuffer(GL_SHADER_STORAGE_BUFFER, mOctreeSSBO);
@@ -58,7 +72,7 @@ public:
         glUniform1f(timeLocation, timer.getElapsedSeconds());
     }
 private:
-    unsigned int mOctreeSSBO;
+    unsigned int mOctreeSSBO = 0;
 
     glm::mat4x4 worldToStartGridMatrix;
     unsigned int worldToStartGridMatrixLocation;
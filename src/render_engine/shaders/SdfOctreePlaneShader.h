@@ -30,6 +30,13 @@ public:
         printIsolinesLocation = glGetUniformLocation(getProgramId(), "printIsolines");
         printIsolines = true;
 
+        // The shader reads the 64 coefficients stored inline in each leaf
+        if(!isSupported(octreeSdf))
+        {
+            SPDLOG_ERROR("The shader only supports octrees with tricubic interpolation and without shared vertices");
+            return;
+        }
+
         // Set octree data
         glGenBuffers(1, &mOctreeSSBO);
         glBindBuffer(GL_SHADER_STORAGE_BUFFER, mOctreeSSBO);
@@ -46,6 +53,11 @@ public:
     void drawIsolines(bool draw) { printIsolines = draw; }
     bool isDrawingIsolines() { return printIsolines; }
 
+    static bool isSupported(const sdflib::OctreeSdf& octreeSdf)
+    {
+        return octreeSdf.getInterpolationType() == sdflib::OctreeSdf::InterpolationType::TRICUBIC && !octreeSdf.hasSharedVertices();
+    }
+
     void bind() override
     {
         glBindBuffer(GL_SHADER_STORAGE_BUFFER, mOctreeSSBO);
@@ -57,7 +69,7 @@ public:
         glUniform1i(printIsolinesLocation, printIsolines);
     }
 private:
-    unsigned int mOctreeSSBO;
+    unsigned int mOctreeSSBO = 0;
     glm::mat4x4 worldToStartGridMatrix;
     unsigned int worldToStartGridMatrixLocation;
     float octreeValueRange;
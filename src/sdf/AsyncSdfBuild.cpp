@@ -0,0 +1,49 @@
+#include "SdfLib/AsyncSdfBuild.h"
+
+#include <spdlog/spdlog.h>
+
+namespace sdflib
+{
+AsyncSdfBuild::AsyncSdfBuild(BuildFunction buildFunction)
+{
+    mResult = std::async(std::launch::async, [this, buildFunction = std::move(buildFunction)]()
+    {
+        BuildProgress::Scope progressScope(&mProgress);
+        std::unique_ptr<SdfFunction> sdf = buildFunction();
+        mProgress.setFinished();
+        return sdf;
+    });
+}
+
+AsyncSdfBuild::~AsyncSdfBuild()
+{
+    if(mResult.valid())
+    {
+        mProgress.cancel();
+        mResult.wait();
+    }
+}
+
+bool AsyncSdfBuild::isFinished() const
+{
+    return !mResult.valid() || mResult.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+void AsyncSdfBuild::wait() const
+{
+    if(mResult.valid()) mResult.wait();
+}
+
+std::unique_ptr<SdfFunction> AsyncSdfBuild::getResult()
+{
+    if(!mResult.valid()) return nullptr;
+
+    std::unique_ptr<SdfFunction> sdf = mResult.get();
+    if(mProgress.isCancelled())
+    {
+        SPDLOG_INFO("The construction has been cancelled");
+        return nullptr;
+    }
+    return sdf;
+}
+}
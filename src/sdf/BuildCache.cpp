@@ -0,0 +1,259 @@
+#include "SdfLib/BuildCache.h"
+#include "SdfLib/utils/Timer.h"
+#include "SdfLib/utils/BuildProgress.h"
+
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <spdlog/spdlog.h>
+#include <fmt/format.h>
+#ifdef OPENMP_AVAILABLE
+#include <omp.h>
+#endif
+
+namespace sdflib
+{
+namespace
+{
+    inline uint64_t mixBits(uint64_t h)
+    {
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDull;
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53ull;
+        h ^= h >> 33;
+        return h;
+    }
+
+    uint64_t hashBytes(const void* data, size_t size, uint64_t seed)
+    {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        uint64_t h = seed ^ (size * 0x9E3779B97F4A7C15ull);
+        size_t i = 0;
+        for(; i + 8 <= size; i += 8)
+        {
+            uint64_t word;
+            std::memcpy(&word, bytes + i, 8);
+            h = (h ^ mixBits(word)) * 0x9E3779B97F4A7C15ull;
+            h = (h << 27) | (h >> 37);
+        }
+
+        if(i < size)
+        {
+            uint64_t word = 0;
+            std::memcpy(&word, bytes + i, size - i);
+            h ^= mixBits(word);
+        }
+
+        return mixBits(h);
+    }
+
+    // Hashes big arrays in parallel. The array is split in chunks of a fixed size,
+    // so the result does not depend on the number of threads
+    uint64_t hashArray(const void* data, size_t size, uint64_t seed)
+    {
+        constexpr size_t CHUNK_SIZE = 1 << 20;
+        const size_t numChunks = (size + CHUNK_SIZE - 1) / CHUNK_SIZE;
+        if(numChunks <= 1) return hashBytes(data, size, seed);
+
+        std::vector<uint64_t> chunksHash(numChunks);
+        #ifdef OPENMP_AVAILABLE
+        #pragma omp parallel for schedule(static)
+        #endif
+        for(int64_t c=0; c < static_cast<int64_t>(numChunks); c++)
+        {
+            const size_t start = c * CHUNK_SIZE;
+            chunksHash[c] = hashBytes(static_cast<const uint8_t*>(data) + start, std::min(CHUNK_SIZE, size - start), seed);
+        }
+
+        return hashBytes(chunksHash.data(), chunksHash.size() * sizeof(uint64_t), seed);
+    }
+
+    // Accumulates the values identifying a structure
+    class KeyBuilder
+    {
+    public:
+        KeyBuilder(uint64_t seed) : mHash(seed) {}
+
+        template<typename T>
+        KeyBuilder& add(const T& value)
+        {
+            mHash = hashBytes(&value, sizeof(T), mHash);
+            return *this;
+        }
+
+        KeyBuilder& add(const BoundingBox& box)
+        {
+            return add(box.min.x).add(box.min.y).add(box.min.z)
+                  .add(box.max.x).add(box.max.y).add(box.max.z);
+        }
+
+        KeyBuilder& add(const std::vector<OctreeSdf::RefinementRegion>& regions)
+        {
+            add(static_cast<uint64_t>(regions.size()));
+            for(const OctreeSdf::RefinementRegion& region : regions)
+            {
+                add(region.box).add(region.maxDepth).add(region.terminationThreshold);
+            }
+            return *this;
+        }
+
+        uint64_t getKey() const { return mHash; }
+    private:
+        uint64_t mHash;
+    };
+}
+
+BuildCache::BuildCache(const std::string& cacheDirectory)
+    : mCacheDirectory(cacheDirectory)
+{
+    std::error_code error;
+    std::filesystem::create_directories(mCacheDirectory, error);
+    if(error)
+    {
+        SPDLOG_ERROR("Cannot create the cache directory {}: {}", mCacheDirectory, error.message());
+    }
+}
+
+uint64_t BuildCache::hashMesh(const Mesh& mesh)
+{
+    const std::vector<glm::vec3>& vertices = mesh.getVertices();
+    const std::vector<uint32_t>& indices = mesh.getIndices();
+    const uint64_t verticesHash = hashArray(vertices.data(), vertices.size() * sizeof(glm::vec3), 0x5DF1B5C4E2A3F6D1ull);
+    return hashArray(indices.data(), indices.size() * sizeof(uint32_t), verticesHash);
+}
+
+std::string BuildCache::getEntryPath(uint64_t key) const
+{
+    return (std::filesystem::path(mCacheDirectory) / fmt::format("{:016x}.bin", key)).string();
+}
+
+std::unique_ptr<SdfFunction> BuildCache::loadEntry(uint64_t key, SdfFunction::SdfFormat format)
+{
+    mLastResultPartial = false;
+    const std::string path = getEntryPath(key);
+    std::error_code error;
+    if(!std::filesystem::exists(path, error))
+    {
+        mNumMisses++;
+        return nullptr;
+    }
+
+    Timer timer;
+    timer.start();
+    std::unique_ptr<SdfFunction> sdf = SdfFunction::loadFromFile(path);
+    if(sdf == nullptr || sdf->getFormat() != format)
+    {
+        SPDLOG_ERROR("The cache entry {} is not valid, the structure is rebuilt", path);
+        mNumMisses++;
+        return nullptr;
+    }
+
+    mNumHits++;
+    SPDLOG_INFO("Structure loaded from the cache {} in {}s", path, timer.getElapsedSeconds());
+    return sdf;
+}
+
+void BuildCache::storeEntry(uint64_t key, SdfFunction& sdf)
+{
+    // The structure is written in a temporal file and renamed at the end,
+    // so other processes never read a partial entry
+    const std::string path = getEntryPath(key);
+    const std::string tmpPath = path + fmt::format(".{:08x}.tmp", std::random_device()());
+    if(!sdf.saveToFile(tmpPath))
+    {
+        SPDLOG_ERROR("Cannot store the structure in the cache {}", path);
+        return;
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tmpPath, path, error);
+    if(error)
+    {
+        SPDLOG_ERROR("Cannot store the structure in the cache {}: {}", path, error.message());
+        std::filesystem::remove(tmpPath, error);
+    }
+}
+
+void BuildCache::storeBuiltEntry(uint64_t key, SdfFunction& sdf)
+{
+    // A cancelled construction returns a coarser structure that does not match the key parameters
+    const BuildProgress* progress = BuildProgress::getCurrent();
+    if(progress != nullptr && progress->isCancelled())
+    {
+        SPDLOG_INFO("The construction has been cancelled, the structure is not stored in the cache");
+        mLastResultPartial = true;
+        return;
+    }
+
+    storeEntry(key, sdf);
+}
+
+std::unique_ptr<OctreeSdf> BuildCache::getOctreeSdf(const Mesh& mesh, BoundingBox box, uint32_t depth, uint32_t startDepth,
+                                                    float terminationThreshold,
+                                                    OctreeSdf::InitAlgorithm initAlgorithm,
+                                                    uint32_t numThreads,
+                                                    OctreeSdf::InterpolationType interpolationType,
+                                                    float narrowBand,
+                                                    bool anisotropicStartGrid,
+                                                    const std::vector<OctreeSdf::RefinementRegion>& refinementRegions)
+{
+    // The number of threads does not change the resulting structure
+    const uint64_t key = KeyBuilder(hashMesh(mesh))
+                            .add(CACHE_VERSION)
+                            .add(SdfFunction::SdfFormat::OCTREE)
+                            .add(box).add(depth).add(startDepth)
+                            .add(terminationThreshold).add(initAlgorithm)
+                            .add(interpolationType).add(narrowBand)
+                            .add(anisotropicStartGrid).add(refinementRegions)
+                            .getKey();
+
+    std::unique_ptr<SdfFunction> cached = loadEntry(key, SdfFunction::SdfFormat::OCTREE);
+    if(cached != nullptr) return std::unique_ptr<OctreeSdf>(static_cast<OctreeSdf*>(cached.release()));
+
+    std::unique_ptr<OctreeSdf> sdf(new OctreeSdf(mesh, box, depth, startDepth, terminationThreshold, initAlgorithm, numThreads, interpolationType, narrowBand, anisotropicStartGrid, refinementRegions));
+    storeBuiltEntry(key, *sdf);
+    return sdf;
+}
+
+std::unique_ptr<ExactOctreeSdf> BuildCache::getExactOctreeSdf(const Mesh& mesh, BoundingBox box, uint32_t maxDepth,
+                                                              uint32_t startDepth, uint32_t minTrianglesPerNode,
+                                                              uint32_t numThreads, float narrowBand,
+                                                              bool anisotropicStartGrid,
+                                                              bool compactSerialization)
+{
+    // The compact serialization changes the stored file and the loaded structure
+    const uint64_t key = KeyBuilder(hashMesh(mesh))
+                            .add(CACHE_VERSION)
+                            .add(SdfFunction::SdfFormat::EXACT_OCTREE)
+                            .add(box).add(maxDepth).add(startDepth)
+                            .add(minTrianglesPerNode).add(narrowBand)
+                            .add(anisotropicStartGrid).add(compactSerialization)
+                            .getKey();
+
+    std::unique_ptr<SdfFunction> cached = loadEntry(key, SdfFunction::SdfFormat::EXACT_OCTREE);
+    if(cached != nullptr) return std::unique_ptr<ExactOctreeSdf>(static_cast<ExactOctreeSdf*>(cached.release()));
+
+    std::unique_ptr<ExactOctreeSdf> sdf(new ExactOctreeSdf(mesh, box, maxDepth, startDepth, minTrianglesPerNode, numThreads, narrowBand, anisotropicStartGrid, compactSerialization));
+    storeBuiltEntry(key, *sdf);
+    return sdf;
+}
+
+std::unique_ptr<UniformGridSdf> BuildCache::getUniformGridSdf(const Mesh& mesh, BoundingBox box, uint32_t depth,
+                                                              UniformGridSdf::InitAlgorithm initAlgorithm,
+                                                              float narrowBand)
+{
+    const uint64_t key = KeyBuilder(hashMesh(mesh))
+                            .add(CACHE_VERSION)
+                            .add(SdfFunction::SdfFormat::GRID)
+                            .add(box).add(depth).add(initAlgorithm).add(narrowBand)
+                            .getKey();
+
+    std::unique_ptr<SdfFunction> cached = loadEntry(key, SdfFunction::SdfFormat::GRID);
+    if(cached != nullptr) return std::unique_ptr<UniformGridSdf>(static_cast<UniformGridSdf*>(cached.release()));
+
+    std::unique_ptr<UniformGridSdf> sdf(new UniformGridSdf(mesh, box, depth, initAlgorithm, narrowBand));
+    storeBuiltEntry(key, *sdf);
+    return sdf;
+}
+}
@@ -1,33 +1,56 @@
 #include "SdfLib/ExactOctreeSdf.h"
 #include "SdfLib/TrianglesInfluence.h"
 #include "SdfLib/InterpolationMethods.h"
+#include "SdfLib/utils/QueryStatistics.h"
+#include <array>
+#include <functional>
+#include <thread>
 
 namespace sdflib
 {
 ExactOctreeSdf::ExactOctreeSdf(const Mesh& mesh, BoundingBox box, uint32_t maxDepth,
                                uint32_t startDepth, uint32_t minTrianglesPerNode,
-                               uint32_t numThreads)
+                               uint32_t numThreads, float narrowBand,
+                               bool anisotropicStartGrid,
+                               bool compactSerialization)
 {
+    ScopedTimer buildScope("ExactOctreeSdf construction");
+    buildScope.addArg("depth", static_cast<double>(maxDepth));
+    buildScope.addArg("triangles", static_cast<double>(mesh.getIndices().size() / 3));
+
     mMaxDepth = maxDepth;
+    mNarrowBand = glm::max(narrowBand, 0.0f);
 
     const glm::vec3 bbSize = box.getSize();
     const float maxSize = glm::max(glm::max(bbSize.x, bbSize.y), bbSize.z);
-    mBox.min = box.getCenter() - 0.5f * maxSize;
-    mBox.max = box.getCenter() + 0.5f * maxSize;
 
-    mStartGridSize = 1 << startDepth;
-    mStartGridXY = mStartGridSize * mStartGridSize;
     mStartDepth = startDepth;
+    mStartGridCellSize = maxSize / static_cast<float>(1 << startDepth);
+    mStartGridSize = (anisotropicStartGrid)
+                        ? glm::max(glm::ivec3(glm::ceil(bbSize / mStartGridCellSize - 1e-4f)), glm::ivec3(1))
+                        : glm::ivec3(1 << startDepth);
+    mStartGridXY = mStartGridSize.x * mStartGridSize.y;
+
+    const glm::vec3 halfGridSize = 0.5f * mStartGridCellSize * glm::vec3(mStartGridSize);
+    mBox.min = box.getCenter() - halfGridSize;
+    mBox.max = box.getCenter() + halfGridSize;
 
-    mStartGridCellSize = maxSize / static_cast<float>(mStartGridSize);
+    {
+        ScopedTimer trianglesDataScope("Triangles data setup");
+        mTrianglesData = TriangleUtils::calculateMeshTriangleData(mesh.getVertices(), mesh.getIndices(), mesh.getBoundingBox(), numThreads);
+    }
 
-    mTrianglesData = TriangleUtils::calculateMeshTriangleData(mesh);
+    mCompactSerialization = compactSerialization;
+    if(mCompactSerialization)
+    {
+        mMeshVertices = mesh.getVertices();
+        mMeshIndices = mesh.getIndices();
+        mMeshBox = mesh.getBoundingBox();
+    }
 
     initOctree<PerNodeRegionTrianglesInfluence<NoneInterpolation>>(mesh, startDepth, maxDepth, minTrianglesPerNode, numThreads);
     //initOctree<PerVertexTrianglesInfluence<1, NoneInterpolation>>(mesh, startDepth, maxDepth, minTrianglesPerNode);
     // calculateStatistics();
-    mTrianglesCache[0].resize(mMaxTrianglesEncodedInLeafs);
-    mTrianglesCache[1].resize(mMaxTrianglesEncodedInLeafs);
 }
 
 inline uint32_t roundFloat(float a)
@@ -35,20 +58,42 @@ inline uint32_t roundFloat(float a)
     return (a > 0.5f) ? 1 : 0;
 }
 
+// Arrays used to decode the bit encoding during the queries.
+// Each thread has its own arrays, so the same structure can be queried from several threads.
+inline std::array<std::vector<uint32_t>, 2>& getTrianglesCache(uint32_t size)
+{
+    thread_local std::array<std::vector<uint32_t>, 2> trianglesCache;
+    if(trianglesCache[0].size() < size)
+    {
+        trianglesCache[0].resize(size);
+        trianglesCache[1].resize(size);
+    }
+    return trianglesCache;
+}
+
 float ExactOctreeSdf::getDistance(glm::vec3 sample) const
 {
+    return getDistanceKernel<true>(sample);
+}
+
+template<bool COUNT_QUERY>
+float ExactOctreeSdf::getDistanceKernel(glm::vec3 sample) const
+{
+    SDFLIB_QUERY_STATS_OPTIONAL_SCOPE(COUNT_QUERY, QueryStats::EXACT_OCTREE);
     glm::vec3 fracPart = (sample - mBox.min) / mStartGridCellSize;
     glm::ivec3 startArrayPos = glm::floor(fracPart);
     fracPart = glm::fract(fracPart);
 
-    if(startArrayPos.x < 0 || startArrayPos.x >= mStartGridSize ||
-       startArrayPos.y < 0 || startArrayPos.y >= mStartGridSize ||
-       startArrayPos.z < 0 || startArrayPos.z >= mStartGridSize)
+    if(startArrayPos.x < 0 || startArrayPos.x >= mStartGridSize.x ||
+       startArrayPos.y < 0 || startArrayPos.y >= mStartGridSize.y ||
+       startArrayPos.z < 0 || startArrayPos.z >= mStartGridSize.z)
     {
-        return mBox.getDistance(sample) + glm::sqrt(3.0f) * mBox.getSize().x;
+        SDFLIB_QUERY_STATS_OUT_OF_BOX();
+        return mBox.getDistance(sample) + glm::length(mBox.getSize());
     }
 
-    const OctreeNode* currentNode = &mOctreeData[startArrayPos.z * mStartGridXY + startArrayPos.y * mStartGridSize + startArrayPos.x];
+    const OctreeNode* currentNode = &mOctreeData[startArrayPos.z * mStartGridXY + startArrayPos.y * mStartGridSize.x + startArrayPos.x];
+    SDFLIB_QUERY_STATS_START_NODE(1u << mStartDepth);
 
     float minDist = INFINITY;
     uint32_t minIndex = 0;
@@ -61,15 +106,22 @@ float ExactOctreeSdf::getDistance(glm::vec3 sample) const
                                    roundFloat(fracPart.x);
 
         currentNode = &mOctreeData[currentNode->getChildrenIndex() + childIdx];
+        SDFLIB_QUERY_STATS_DESCEND();
         fracPart = glm::fract(2.0f * fracPart);
         depth++;
     }
 
+    if(currentNode->isFarLeaf())
+    {
+        return currentNode->getFarLeafDistance();
+    }
+
     if(currentNode->isLeaf())
     {
         uint32_t leafIndex = currentNode->trianglesArrayIndex;
         const uint32_t numTriangles = mTrianglesSets[leafIndex++];
 
+        SDFLIB_QUERY_STATS_TRIANGLES_TESTED(numTriangles);
         uint32_t bIdx = 0;
         for(uint32_t t=0; t < numTriangles; t++, bIdx += mBitsPerIndex)
         {
@@ -99,11 +151,13 @@ float ExactOctreeSdf::getDistance(glm::vec3 sample) const
                                roundFloat(fracPart.x);
 
     currentNode = &mOctreeData[currentNode->getChildrenIndex() + childIdx];
+    SDFLIB_QUERY_STATS_DESCEND();
     fracPart = glm::fract(2.0f * fracPart);
     }
 
     uint32_t numTriangles = mTrianglesSets[setIndex++];
-    uint32_t* inputTriangles = mTrianglesCache[0].data();
+    std::array<std::vector<uint32_t>, 2>& trianglesCache = getTrianglesCache(mMaxTrianglesEncodedInLeafs);
+    uint32_t* inputTriangles = trianglesCache[0].data();
     {
         const uint8_t* mask = mTrianglesMasks.data() + currentNode->trianglesArrayIndex;
 
@@ -130,7 +184,7 @@ float ExactOctreeSdf::getDistance(glm::vec3 sample) const
         numTriangles = newTriangles;
     }
 
-    uint32_t* outputTriangles = mTrianglesCache[1].data();
+    uint32_t* outputTriangles = trianglesCache[1].data();
     while(!currentNode->isLeaf())
     {
         const uint32_t childIdx = (roundFloat(fracPart.z) << 2) + 
@@ -138,6 +192,7 @@ float ExactOctreeSdf::getDistance(glm::vec3 sample) const
                                    roundFloat(fracPart.x);
 
         currentNode = &mOctreeData[currentNode->getChildrenIndex() + childIdx];
+        SDFLIB_QUERY_STATS_DESCEND();
         fracPart = glm::fract(2.0f * fracPart);
 
         const uint8_t* mask = mTrianglesMasks.data() + currentNode->trianglesArrayIndex;
@@ -163,6 +218,7 @@ float ExactOctreeSdf::getDistance(glm::vec3 sample) const
         std::swap(outputTriangles, inputTriangles);
     }
 
+    SDFLIB_QUERY_STATS_TRIANGLES_TESTED(numTriangles);
     for(uint32_t t=0; t < numTriangles; t++)
     {
         const uint32_t tIndex = inputTriangles[t];
@@ -179,18 +235,21 @@ float ExactOctreeSdf::getDistance(glm::vec3 sample) const
 
 float ExactOctreeSdf::getDistance(glm::vec3 sample, glm::vec3& outGradient) const
 {
+    SDFLIB_QUERY_STATS_SCOPE(QueryStats::EXACT_OCTREE);
     glm::vec3 fracPart = (sample - mBox.min) / mStartGridCellSize;
     glm::ivec3 startArrayPos = glm::floor(fracPart);
     fracPart = glm::fract(fracPart);
 
-    if(startArrayPos.x < 0 || startArrayPos.x >= mStartGridSize ||
-       startArrayPos.y < 0 || startArrayPos.y >= mStartGridSize ||
-       startArrayPos.z < 0 || startArrayPos.z >= mStartGridSize)
+    if(startArrayPos.x < 0 || startArrayPos.x >= mStartGridSize.x ||
+       startArrayPos.y < 0 || startArrayPos.y >= mStartGridSize.y ||
+       startArrayPos.z < 0 || startArrayPos.z >= mStartGridSize.z)
     {
-        return mBox.getDistance(sample) + glm::sqrt(3.0f) * mBox.getSize().x;
+        SDFLIB_QUERY_STATS_OUT_OF_BOX();
+        return mBox.getDistance(sample) + glm::length(mBox.getSize());
     }
 
-    const OctreeNode* currentNode = &mOctreeData[startArrayPos.z * mStartGridXY + startArrayPos.y * mStartGridSize + startArrayPos.x];
+    const OctreeNode* currentNode = &mOctreeData[startArrayPos.z * mStartGridXY + startArrayPos.y * mStartGridSize.x + startArrayPos.x];
+    SDFLIB_QUERY_STATS_START_NODE(1u << mStartDepth);
 
     float minDist = INFINITY;
     uint32_t minIndex = 0;
@@ -203,15 +262,23 @@ float ExactOctreeSdf::getDistance(glm::vec3 sample, glm::vec3& outGradient) cons
                                    roundFloat(fracPart.x);
 
         currentNode = &mOctreeData[currentNode->getChildrenIndex() + childIdx];
+        SDFLIB_QUERY_STATS_DESCEND();
         fracPart = glm::fract(2.0f * fracPart);
         depth++;
     }
 
+    if(currentNode->isFarLeaf())
+    {
+        outGradient = glm::vec3(0.0f);
+        return currentNode->getFarLeafDistance();
+    }
+
     if(currentNode->isLeaf())
     {
         uint32_t leafIndex = currentNode->trianglesArrayIndex;
         const uint32_t numTriangles = mTrianglesSets[leafIndex++];
 
+        SDFLIB_QUERY_STATS_TRIANGLES_TESTED(numTriangles);
         uint32_t bIdx = 0;
         for(uint32_t t=0; t < numTriangles; t++, bIdx += mBitsPerIndex)
         {
@@ -241,11 +308,13 @@ float ExactOctreeSdf::getDistance(glm::vec3 sample, glm::vec3& outGradient) cons
                                    roundFloat(fracPart.x);
 
     currentNode = &mOctreeData[currentNode->getChildrenIndex() + childIdx];
+    SDFLIB_QUERY_STATS_DESCEND();
     fracPart = glm::fract(2.0f * fracPart);
     }
 
     uint32_t numTriangles = mTrianglesSets[setIndex++];
-    uint32_t* inputTriangles = mTrianglesCache[0].data();
+    std::array<std::vector<uint32_t>, 2>& trianglesCache = getTrianglesCache(mMaxTrianglesEncodedInLeafs);
+    uint32_t* inputTriangles = trianglesCache[0].data();
     {
         const uint8_t* mask = mTrianglesMasks.data() + currentNode->trianglesArrayIndex;
 
@@ -272,7 +341,7 @@ float ExactOctreeSdf::getDistance(glm::vec3 sample, glm::vec3& outGradient) cons
         numTriangles = newTriangles;
     }
 
-    uint32_t* outputTriangles = mTrianglesCache[1].data();
+    uint32_t* outputTriangles = trianglesCache[1].data();
     while(!currentNode->isLeaf())
     {
         const uint32_t childIdx = (roundFloat(fracPart.z) << 2) + 
@@ -280,6 +349,7 @@ float ExactOctreeSdf::getDistance(glm::vec3 sample, glm::vec3& outGradient) cons
                                    roundFloat(fracPart.x);
 
         currentNode = &mOctreeData[currentNode->getChildrenIndex() + childIdx];
+        SDFLIB_QUERY_STATS_DESCEND();
         fracPart = glm::fract(2.0f * fracPart);
 
         const uint8_t* mask = mTrianglesMasks.data() + currentNode->trianglesArrayIndex;
@@ -305,6 +375,7 @@ float ExactOctreeSdf::getDistance(glm::vec3 sample, glm::vec3& outGradient) cons
         std::swap(outputTriangles, inputTriangles);
     }
 
+    SDFLIB_QUERY_STATS_TRIANGLES_TESTED(numTriangles);
     for(uint32_t t=0; t < numTriangles; t++)
     {
         const uint32_t tIndex = inputTriangles[t];
@@ -385,4 +456,195 @@ void ExactOctreeSdf::calculateStatistics()
     //     SPDLOG_INFO("Depth {}, mean of merged nodes: {} // mean of different nodes: {}", d, mergedMean, differentMean);
     // }
 }
+
+void ExactOctreeSdf::computeNodesBounds() const
+{
+    ScopedTimer scope("computeNodesBounds");
+
+    mNodesBounds.values.resize(mOctreeData.size());
+    const float halfDiagonalFactor = 0.5f * glm::sqrt(3.0f);
+
+    // List the nodes in preorder, so the children are always after their parent
+    struct NodeToBound
+    {
+        uint32_t nodeIndex;
+        glm::vec3 nodeMin;
+        float nodeSize;
+    };
+    std::vector<NodeToBound> nodes;
+    nodes.reserve(mOctreeData.size());
+    for(int k=0; k < mStartGridSize.z; k++)
+    {
+        for(int j=0; j < mStartGridSize.y; j++)
+        {
+            for(int i=0; i < mStartGridSize.x; i++)
+            {
+                nodes.push_back({static_cast<uint32_t>(k * mStartGridXY + j * mStartGridSize.x + i),
+                                 mBox.min + mStartGridCellSize * glm::vec3(i, j, k),
+                                 mStartGridCellSize});
+            }
+        }
+    }
+
+    for(size_t n=0; n < nodes.size(); n++)
+    {
+        const NodeToBound parent = nodes[n];
+        const OctreeNode& node = mOctreeData[parent.nodeIndex];
+        if(node.isLeaf()) continue;
+
+        const float childSize = 0.5f * parent.nodeSize;
+        for(uint32_t i=0; i < 8; i++)
+        {
+            nodes.push_back({node.getChildrenIndex() + i,
+                             parent.nodeMin + childSize * glm::vec3(i & 1, (i >> 1) & 1, (i >> 2) & 1),
+                             childSize});
+        }
+    }
+
+    // The leaves need an exact query each, they are evaluated in parallel
+    const int64_t numNodes = static_cast<int64_t>(nodes.size());
+    #ifdef OPENMP_AVAILABLE
+    const uint32_t numThreads = glm::max(std::thread::hardware_concurrency(), 1u);
+    #pragma omp parallel for num_threads(numThreads) schedule(dynamic, 256)
+    #endif
+    for(int64_t n=0; n < numNodes; n++)
+    {
+        const NodeToBound& leaf = nodes[n];
+        if(!mOctreeData[leaf.nodeIndex].isLeaf()) continue;
+
+        // The distance field is Lipschitz continuous with constant one
+        const float centerDist = getDistanceKernel<false>(leaf.nodeMin + glm::vec3(0.5f * leaf.nodeSize));
+        const float radius = halfDiagonalFactor * leaf.nodeSize;
+        mNodesBounds.values[leaf.nodeIndex] = glm::vec2(centerDist - radius, centerDist + radius);
+    }
+
+    // The inner nodes store the union of their children, computed from the deepest nodes
+    for(int64_t n=numNodes-1; n >= 0; n--)
+    {
+        const OctreeNode& node = mOctreeData[nodes[n].nodeIndex];
+        if(node.isLeaf()) continue;
+
+        glm::vec2 bounds(INFINITY, -INFINITY);
+        for(uint32_t i=0; i < 8; i++)
+        {
+            const glm::vec2& childBounds = mNodesBounds.values[node.getChildrenIndex() + i];
+            bounds.x = glm::min(bounds.x, childBounds.x);
+            bounds.y = glm::max(bounds.y, childBounds.y);
+        }
+        mNodesBounds.values[nodes[n].nodeIndex] = bounds;
+    }
+}
+
+glm::vec2 ExactOctreeSdf::getDistanceBounds(BoundingBox box) const
+{
+    if(!mNodesBounds.computed.load(std::memory_order_acquire))
+    {
+        std::lock_guard<std::mutex> lock(mNodesBounds.mutex);
+        if(!mNodesBounds.computed.load(std::memory_order_relaxed))
+        {
+            computeNodesBounds();
+            mNodesBounds.computed.store(true, std::memory_order_release);
+        }
+    }
+
+    glm::vec2 bounds(INFINITY, -INFINITY);
+
+    // Outside the octree, the field is the distance to the octree box plus the octree diagonal
+    if(glm::any(glm::lessThan(box.min, mBox.min)) || glm::any(glm::greaterThan(box.max, mBox.max)))
+    {
+        const float outsideOffset = glm::length(mBox.getSize());
+        float maxBoxDist = 0.0f;
+        for(uint32_t i=0; i < 8; i++)
+        {
+            const glm::vec3 corner((i & 1) ? box.max.x : box.min.x,
+                                   (i & 2) ? box.max.y : box.min.y,
+                                   (i & 4) ? box.max.z : box.min.z);
+            maxBoxDist = glm::max(maxBoxDist, mBox.getDistance(corner));
+        }
+        const float minBoxDist = glm::length(glm::max(glm::vec3(0.0f), glm::max(mBox.min - box.max, box.min - mBox.max)));
+        bounds = glm::vec2(outsideOffset + minBoxDist, outsideOffset + maxBoxDist);
+    }
+
+    // Region inside the octree in start grid units
+    const glm::vec3 minPos = (glm::max(box.min, mBox.min) - mBox.min) / mStartGridCellSize;
+    const glm::vec3 maxPos = (glm::min(box.max, mBox.max) - mBox.min) / mStartGridCellSize;
+    if(glm::any(glm::greaterThan(minPos, maxPos))) return bounds;
+
+    std::function<void(uint32_t nIdx, glm::vec3 nodeMin, float nodeSize)> processNode;
+    processNode = [&](uint32_t nIdx, glm::vec3 nodeMin, float nodeSize)
+    {
+        const glm::vec2& nodeBounds = mNodesBounds.values[nIdx];
+        // The node cannot expand the interval
+        if(nodeBounds.x >= bounds.x && nodeBounds.y <= bounds.y) return;
+
+        // The leaves and the nodes inside the region use their own interval
+        const OctreeNode& node = mOctreeData[nIdx];
+        if(node.isLeaf() ||
+           (glm::all(glm::greaterThanEqual(nodeMin, minPos)) && glm::all(glm::lessThanEqual(nodeMin + nodeSize, maxPos))))
+        {
+            bounds.x = glm::min(bounds.x, nodeBounds.x);
+            bounds.y = glm::max(bounds.y, nodeBounds.y);
+            return;
+        }
+
+        const float childSize = 0.5f * nodeSize;
+        for(uint32_t i=0; i < 8; i++)
+        {
+            const glm::vec3 childMin = nodeMin + childSize * glm::vec3(i & 1, (i >> 1) & 1, (i >> 2) & 1);
+            if(glm::all(glm::lessThanEqual(childMin, maxPos)) && glm::all(glm::greaterThanEqual(childMin + childSize, minPos)))
+            {
+                processNode(node.getChildrenIndex() + i, childMin, childSize);
+            }
+        }
+    };
+
+    const glm::ivec3 startMin = glm::clamp(glm::ivec3(glm::floor(minPos)), glm::ivec3(0), mStartGridSize - 1);
+    const glm::ivec3 startMax = glm::clamp(glm::ivec3(glm::floor(maxPos)), glm::ivec3(0), mStartGridSize - 1);
+    for(int k=startMin.z; k <= startMax.z; k++)
+    {
+        for(int j=startMin.y; j <= startMax.y; j++)
+        {
+            for(int i=startMin.x; i <= startMax.x; i++)
+            {
+                processNode(k * mStartGridXY + j * mStartGridSize.x + i, glm::vec3(i, j, k), 1.0f);
+            }
+        }
+    }
+
+    return bounds;
+}
+
+MemoryUsage ExactOctreeSdf::memoryUsage() const
+{
+    MemoryUsage usage;
+    usage.nodes = MemoryUsage::getBytes(mOctreeData);
+    usage.trianglesSets = MemoryUsage::getBytes(mTrianglesSets);
+    usage.trianglesMasks = MemoryUsage::getBytes(mTrianglesMasks);
+    usage.trianglesData = MemoryUsage::getBytes(mTrianglesData) + MemoryUsage::getBytes(mMeshVertices) + MemoryUsage::getBytes(mMeshIndices);
+    usage.nodesBounds = MemoryUsage::getBytes(mNodesBounds.values);
+    usage.constructionPeak = mConstructionPeakMemory;
+    return usage;
+}
+
+void ExactOctreeSdf::setCompactSerialization(bool compact)
+{
+    if(compact && mMeshIndices.empty())
+    {
+        SPDLOG_ERROR("The structure does not have the mesh, it is stored with the triangles data");
+    }
+
+    mCompactSerialization = compact;
+    if(!compact)
+    {
+        std::vector<glm::vec3>().swap(mMeshVertices);
+        std::vector<uint32_t>().swap(mMeshIndices);
+    }
+}
+
+void ExactOctreeSdf::rebuildTrianglesData()
+{
+    ScopedTimer scope("Triangles data rebuild");
+    const uint32_t numThreads = glm::max(std::thread::hardware_concurrency(), 1u);
+    mTrianglesData = TriangleUtils::calculateMeshTriangleData(mMeshVertices, mMeshIndices, mMeshBox, numThreads);
+}
 }
\ No newline at end of file
@@ -1,60 +1,115 @@
 #include "SdfLib/OctreeSdf.h"
 #include "SdfLib/utils/Timer.h"
 #include "SdfLib/utils/GJK.h"
+#include "SdfLib/utils/QueryStatistics.h"
 #include "SdfLib/OctreeSdfUtils.h"
 #include "SdfLib/TrianglesInfluence.h"
 #include "SdfLib/InterpolationMethods.h"
 #include "sdf/OctreeSdfDepthFirst.h"
 #include "sdf/OctreeSdfBreadthFirst.h"
 #include "sdf/OctreeSdfBreadthFirstNoDelay.h"
+#include "sdf/OctreeSdfBestFirst.h"
 #include <array>
 #include <stack>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+#include <algorithm>
+#include <unordered_map>
+#include <atomic>
 
 namespace sdflib
 {
-// typedef TriLinearInterpolation InterpolationMethod;
-typedef TriCubicInterpolation InterpolationMethod;
+namespace
+{
+    std::atomic<uint64_t> nextVerticesPoolId(1);
+
+    // Calls the function with an instance of the interpolation method of the type,
+    // the function is instantiated for each method
+    template<typename Function>
+    inline void dispatchInterpolation(OctreeSdf::InterpolationType interpolationType, Function&& function)
+    {
+        switch(interpolationType)
+        {
+            case OctreeSdf::InterpolationType::TRILINEAR:
+                function(TriLinearInterpolation());
+                break;
+            case OctreeSdf::InterpolationType::TRIQUADRATIC:
+                function(TriQuadraticInterpolation());
+                break;
+            case OctreeSdf::InterpolationType::TRICUBIC:
+                function(TriCubicInterpolation());
+                break;
+        }
+    }
+}
 
 OctreeSdf::OctreeSdf(const Mesh& mesh, BoundingBox box, 
                      uint32_t depth, uint32_t startDepth,
                      float terminationThreshold,
                      OctreeSdf::InitAlgorithm initAlgorithm,
-                     uint32_t numThreads)
+                     uint32_t numThreads,
+                     OctreeSdf::InterpolationType interpolationType,
+                     float narrowBand,
+                     bool anisotropicStartGrid,
+                     const std::vector<RefinementRegion>& refinementRegions)
 {
-    const OctreeSdf::TerminationRule terminationRule = TerminationRule::TRAPEZOIDAL_RULE;
-    mMaxDepth = depth;
+    ScopedTimer buildScope("OctreeSdf construction");
+    buildScope.addArg("depth", static_cast<double>(depth));
+    buildScope.addArg("triangles", static_cast<double>(mesh.getIndices().size() / 3));
 
-    const glm::vec3 bbSize = box.getSize();
-    const float maxSize = glm::max(glm::max(bbSize.x, bbSize.y), bbSize.z);
-    mBox.min = box.getCenter() - 0.5f * maxSize;
-    mBox.max = box.getCenter() + 0.5f * maxSize;
-
-    mStartGridSize = 1 << startDepth;
-    mStartGridXY = mStartGridSize * mStartGridSize;
-
-    mStartGridCellSize = maxSize / static_cast<float>(mStartGridSize);
+    const OctreeSdf::TerminationRule terminationRule = TerminationRule::TRAPEZOIDAL_RULE;
+    mInterpolationType = interpolationType;
+    mNarrowBand = glm::max(narrowBand, 0.0f);
+    setRefinementRegions(refinementRegions, startDepth);
+    mMaxDepth = getRefinementMaxDepth(depth);
+    initGrid(box, startDepth, anisotropicStartGrid);
+    initInterpolationKernels();
 
     switch(initAlgorithm)
     {
         case OctreeSdf::InitAlgorithm::UNIFORM:
-            initUniformOctree(mesh, startDepth, depth);
-            break;
-        case OctreeSdf::InitAlgorithm::NO_CONTINUITY:
-            // initOctree<PerNodeRegionTrianglesInfluence<InterpolationMethod>>(mesh, startDepth, depth, terminationThreshold, terminationRule, numThreads);
-            initOctree<VHQueries<InterpolationMethod>>(mesh, startDepth, depth, terminationThreshold, terminationRule, numThreads);
-            //initOctree<FCPWQueries<InterpolationMethod>>(mesh, startDepth, depth, terminationThreshold, terminationRule, numThreads);
-            break;
-        case OctreeSdf::InitAlgorithm::CONTINUITY:
-            //initOctreeWithContinuity<PerNodeRegionTrianglesInfluence<InterpolationMethod>>(mesh, startDepth, depth, terminationThreshold, terminationRule);
-            if(DELAY_NODE_TERMINATION)
+            // The uniform builder writes the vertices values, which are the trilinear coefficients.
+            // Before the runtime interpolation type, it also wrote 8 values in the tricubic leaves,
+            // which read 64 coefficients, so the other types use the generic builder without termination
+            if(interpolationType == InterpolationType::TRILINEAR)
             {
-                initOctreeWithContinuity<VHQueries<InterpolationMethod>>(mesh, startDepth, depth, terminationThreshold, terminationRule);
+                initUniformOctree(mesh, startDepth, depth);
             }
             else
             {
-                initOctreeWithContinuityNoDelay<VHQueries<InterpolationMethod>>(mesh, startDepth, depth, terminationThreshold, terminationRule, numThreads);
+                dispatchInterpolation(interpolationType, [&](auto method)
+                {
+                    typedef decltype(method) InterpolationMethod;
+                    initOctree<VHQueries<InterpolationMethod>>(mesh, startDepth, depth, terminationThreshold, TerminationRule::NONE, numThreads);
+                });
             }
             break;
+        case OctreeSdf::InitAlgorithm::NO_CONTINUITY:
+            dispatchInterpolation(interpolationType, [&](auto method)
+            {
+                typedef decltype(method) InterpolationMethod;
+                // initOctree<PerNodeRegionTrianglesInfluence<InterpolationMethod>>(mesh, startDepth, depth, terminationThreshold, terminationRule, numThreads);
+                initOctree<VHQueries<InterpolationMethod>>(mesh, startDepth, depth, terminationThreshold, terminationRule, numThreads);
+                //initOctree<FCPWQueries<InterpolationMethod>>(mesh, startDepth, depth, terminationThreshold, terminationRule, numThreads);
+            });
+            break;
+        case OctreeSdf::InitAlgorithm::CONTINUITY:
+            dispatchInterpolation(interpolationType, [&](auto method)
+            {
+                typedef decltype(method) InterpolationMethod;
+                //initOctreeWithContinuity<PerNodeRegionTrianglesInfluence<InterpolationMethod>>(mesh, startDepth, depth, terminationThreshold, terminationRule);
+                if constexpr(DELAY_NODE_TERMINATION)
+                {
+                    initOctreeWithContinuity<VHQueries<InterpolationMethod>>(mesh, startDepth, depth, terminationThreshold, terminationRule);
+                }
+                else
+                {
+                    initOctreeWithContinuityNoDelay<VHQueries<InterpolationMethod>>(mesh, startDepth, depth, terminationThreshold, terminationRule, numThreads);
+                }
+            });
+            break;
         // case OctreeSdf::InitAlgorithm::GPU_IMPLEMENTATION:
         //     Timer time;
         //     time.start();
@@ -66,7 +121,215 @@ OctreeSdf::OctreeSdf(const Mesh& mesh, BoundingBox box,
         //     break;
     }
 
+    applyNarrowBand();
+    computeMinBorderValue();
+    computeNodesBounds();
+}
+
+OctreeSdf::OctreeSdf(const Mesh& mesh, BoundingBox box,
+                     uint32_t depth, uint32_t startDepth,
+                     const BuildBudget& budget,
+                     float terminationThreshold,
+                     OctreeSdf::InterpolationType interpolationType,
+                     float narrowBand,
+                     bool anisotropicStartGrid,
+                     const std::vector<RefinementRegion>& refinementRegions)
+{
+    ScopedTimer buildScope("OctreeSdf construction");
+    buildScope.addArg("depth", static_cast<double>(depth));
+    buildScope.addArg("triangles", static_cast<double>(mesh.getIndices().size() / 3));
+
+    mInterpolationType = interpolationType;
+    mNarrowBand = glm::max(narrowBand, 0.0f);
+    setRefinementRegions(refinementRegions, startDepth);
+    mMaxDepth = getRefinementMaxDepth(depth);
+    initGrid(box, startDepth, anisotropicStartGrid);
+    initInterpolationKernels();
+
+    dispatchInterpolation(interpolationType, [&](auto method)
+    {
+        typedef decltype(method) InterpolationMethod;
+        initOctreeBestFirst<VHQueries<InterpolationMethod>>(mesh, startDepth, depth, terminationThreshold, budget);
+    });
+
+    applyNarrowBand();
+    computeMinBorderValue();
+    computeNodesBounds();
+}
+
+OctreeSdf::OctreeSdf(const DistanceFunction& distanceFunction, BoundingBox box, 
+                     uint32_t depth, uint32_t startDepth,
+                     float terminationThreshold,
+                     OctreeSdf::InitAlgorithm initAlgorithm,
+                     uint32_t numThreads,
+                     OctreeSdf::InterpolationType interpolationType,
+                     float narrowBand,
+                     bool anisotropicStartGrid,
+                     const std::vector<RefinementRegion>& refinementRegions)
+{
+    ScopedTimer buildScope("OctreeSdf construction");
+    buildScope.addArg("depth", static_cast<double>(depth));
+
+    mInterpolationType = interpolationType;
+    mNarrowBand = glm::max(narrowBand, 0.0f);
+    setRefinementRegions(refinementRegions, startDepth);
+    mMaxDepth = getRefinementMaxDepth(depth);
+    initGrid(box, startDepth, anisotropicStartGrid);
+    initInterpolationKernels();
+
+    // The builders scale the termination threshold by the mesh bounding box,
+    // a mesh without triangles covering the box is used
+    Mesh boxMesh;
+    boxMesh.getVertices() = { box.min, box.max };
+    boxMesh.computeBoundingBox();
+
+    dispatchInterpolation(interpolationType, [&](auto method)
+    {
+        DistanceFunctionQueries<decltype(method)> queries;
+        queries.distanceFunction = std::make_shared<const DistanceFunction>(distanceFunction);
+
+        switch(initAlgorithm)
+        {
+            case OctreeSdf::InitAlgorithm::UNIFORM:
+                initOctree(boxMesh, startDepth, depth, terminationThreshold, TerminationRule::NONE, numThreads, queries);
+                break;
+            case OctreeSdf::InitAlgorithm::NO_CONTINUITY:
+                initOctree(boxMesh, startDepth, depth, terminationThreshold, TerminationRule::TRAPEZOIDAL_RULE, numThreads, queries);
+                break;
+            case OctreeSdf::InitAlgorithm::CONTINUITY:
+                initOctreeWithContinuityNoDelay(boxMesh, startDepth, depth, terminationThreshold, TerminationRule::TRAPEZOIDAL_RULE, numThreads, queries);
+                break;
+        }
+    });
+
+    applyNarrowBand();
     computeMinBorderValue();
+    computeNodesBounds();
+}
+
+OctreeSdf::OctreeSdf(const SdfFunction& sdfFunction, BoundingBox box, 
+                     uint32_t depth, uint32_t startDepth,
+                     float terminationThreshold,
+                     OctreeSdf::InitAlgorithm initAlgorithm,
+                     uint32_t numThreads,
+                     OctreeSdf::InterpolationType interpolationType,
+                     float narrowBand,
+                     bool anisotropicStartGrid,
+                     const std::vector<RefinementRegion>& refinementRegions)
+    : OctreeSdf([&sdfFunction](glm::vec3 point, glm::vec3& outGradient) { return sdfFunction.getDistance(point, outGradient); },
+                box, depth, startDepth, terminationThreshold, initAlgorithm,
+                numThreads,
+                interpolationType, narrowBand, anisotropicStartGrid, refinementRegions)
+{}
+
+void OctreeSdf::initInterpolationKernels()
+{
+    dispatchInterpolation(mInterpolationType, [&](auto method)
+    {
+        typedef decltype(method) InterpolationMethod;
+        if(hasSharedVertices())
+        {
+            mDistanceKernel = &OctreeSdf::getDistanceKernel<InterpolationMethod, true>;
+            mDistanceAndGradientKernel = &OctreeSdf::getDistanceAndGradientKernel<InterpolationMethod, true>;
+            mDistanceWithMaxDepthKernel = &OctreeSdf::getDistanceWithMaxDepthKernel<InterpolationMethod, true>;
+        }
+        else
+        {
+            mDistanceKernel = &OctreeSdf::getDistanceKernel<InterpolationMethod, false>;
+            mDistanceAndGradientKernel = &OctreeSdf::getDistanceAndGradientKernel<InterpolationMethod, false>;
+            mDistanceWithMaxDepthKernel = &OctreeSdf::getDistanceWithMaxDepthKernel<InterpolationMethod, false>;
+        }
+    });
+
+    // The fitted leaves cached by the threads are only valid for the same pool
+    mVerticesPoolId = (hasSharedVertices()) ? nextVerticesPoolId++ : 0;
+}
+
+template<typename InterpolationMethod, bool SHARED_VERTICES>
+const std::array<float, InterpolationMethod::NUM_COEFFICIENTS>& OctreeSdf::getLeafCoefficients(const OctreeNode& leaf, float nodeSize) const
+{
+    typedef std::array<float, InterpolationMethod::NUM_COEFFICIENTS> Coefficients;
+    if constexpr(!SHARED_VERTICES)
+    {
+        return *reinterpret_cast<const Coefficients*>(&mOctreeData[leaf.getChildrenIndex()]);
+    }
+    else
+    {
+        // Small direct mapped cache of the last leaves fitted by the thread
+        struct CachedLeaf
+        {
+            uint64_t poolId = 0;
+            uint32_t leafIndex = 0;
+            Coefficients coefficients;
+        };
+        constexpr uint32_t CACHE_SIZE = 16;
+        thread_local std::array<CachedLeaf, CACHE_SIZE> cache;
+
+        const uint32_t leafIndex = leaf.getChildrenIndex();
+        CachedLeaf& entry = cache[(leafIndex >> 3) & (CACHE_SIZE - 1)];
+        if(entry.poolId != mVerticesPoolId || entry.leafIndex != leafIndex)
+        {
+            constexpr uint32_t VALUES_PER_VERTEX = InterpolationMethod::VALUES_PER_VERTEX;
+            std::array<std::array<float, VALUES_PER_VERTEX>, 8> verticesValues;
+            for(uint32_t i=0; i < 8; i++)
+            {
+                std::memcpy(verticesValues[i].data(), &mVerticesValues[VALUES_PER_VERTEX * mOctreeData[leafIndex + i].childrenIndex], VALUES_PER_VERTEX * sizeof(float));
+            }
+
+            // The interpolation methods do not use the triangles to fit the coefficients
+            static const Mesh emptyMesh;
+            static const std::vector<uint32_t> emptyTriangles;
+            static const std::vector<TriangleUtils::TriangleData> emptyTrianglesData;
+            InterpolationMethod::calculateCoefficients(verticesValues, nodeSize, emptyTriangles, emptyMesh, emptyTrianglesData, entry.coefficients);
+            entry.poolId = mVerticesPoolId;
+            entry.leafIndex = leafIndex;
+        }
+        return entry.coefficients;
+    }
+}
+
+uint32_t OctreeSdf::getLeafNumCoefficients() const
+{
+    uint32_t numCoefficients = 0;
+    dispatchInterpolation(mInterpolationType, [&](auto method)
+    {
+        numCoefficients = decltype(method)::NUM_COEFFICIENTS;
+    });
+    return numCoefficients;
+}
+
+void OctreeSdf::initGrid(BoundingBox box, uint32_t startDepth, bool anisotropicStartGrid)
+{
+    const glm::vec3 bbSize = box.getSize();
+    const float maxSize = glm::max(glm::max(bbSize.x, bbSize.y), bbSize.z);
+
+    mStartDepth = startDepth;
+    mStartGridCellSize = maxSize / static_cast<float>(1 << startDepth);
+    if(anisotropicStartGrid)
+    {
+        // Only the cells needed to cover the box in each axis, the tolerance avoids an extra cell by rounding errors
+        mStartGridSize = glm::max(glm::ivec3(glm::ceil(bbSize / mStartGridCellSize - 1e-4f)), glm::ivec3(1));
+    }
+    else
+    {
+        mStartGridSize = glm::ivec3(1 << startDepth);
+    }
+    mStartGridXY = mStartGridSize.x * mStartGridSize.y;
+
+    const glm::vec3 halfGridSize = 0.5f * mStartGridCellSize * glm::vec3(mStartGridSize);
+    mBox.min = box.getCenter() - halfGridSize;
+    mBox.max = box.getCenter() + halfGridSize;
+}
+
+void OctreeSdf::setRefinementRegions(const std::vector<RefinementRegion>& refinementRegions, uint32_t startDepth)
+{
+    mRefinementRegions = refinementRegions;
+    for(RefinementRegion& region : mRefinementRegions)
+    {
+        // The nodes before the start depth are always subdivided
+        region.maxDepth = glm::max(region.maxDepth, startDepth);
+        region.terminationThreshold = glm::max(region.terminationThreshold, 0.0f);
+    }
 }
 
 inline uint32_t roundFloat(float a)
@@ -76,18 +339,38 @@ inline uint32_t roundFloat(float a)
 
 float OctreeSdf::getDistance(glm::vec3 sample) const
 {
+    return (this->*mDistanceKernel)(sample);
+}
+
+float OctreeSdf::getDistance(glm::vec3 sample, glm::vec3& outGradient) const
+{
+    return (this->*mDistanceAndGradientKernel)(sample, outGradient);
+}
+
+float OctreeSdf::getDistance(glm::vec3 sample, uint32_t maxDepth) const
+{
+    return (this->*mDistanceWithMaxDepthKernel)(sample, maxDepth);
+}
+
+template<typename InterpolationMethod, bool SHARED_VERTICES>
+float OctreeSdf::getDistanceKernel(glm::vec3 sample) const
+{
+    SDFLIB_QUERY_STATS_SCOPE(QueryStats::OCTREE);
     glm::vec3 fracPart = (sample - mBox.min) / mStartGridCellSize;
     glm::ivec3 startArrayPos = glm::floor(fracPart);
     fracPart = glm::fract(fracPart);
 
-    if(startArrayPos.x < 0 || startArrayPos.x >= mStartGridSize ||
-       startArrayPos.y < 0 || startArrayPos.y >= mStartGridSize ||
-       startArrayPos.z < 0 || startArrayPos.z >= mStartGridSize)
+    if(startArrayPos.x < 0 || startArrayPos.x >= mStartGridSize.x ||
+       startArrayPos.y < 0 || startArrayPos.y >= mStartGridSize.y ||
+       startArrayPos.z < 0 || startArrayPos.z >= mStartGridSize.z)
     {
+        SDFLIB_QUERY_STATS_OUT_OF_BOX();
         return mBox.getDistance(sample) + mMinBorderValue;
     }
 
-    const OctreeNode* currentNode = &mOctreeData[startArrayPos.z * mStartGridXY + startArrayPos.y * mStartGridSize + startArrayPos.x];
+    const OctreeNode* currentNode = &mOctreeData[startArrayPos.z * mStartGridXY + startArrayPos.y * mStartGridSize.x + startArrayPos.x];
+    SDFLIB_QUERY_STATS_START_NODE(1u << mStartDepth);
+    float nodeSize = mStartGridCellSize;
 
     while(!currentNode->isLeaf())
     {
@@ -96,28 +379,35 @@ float OctreeSdf::getDistance(glm::vec3 sample) const
                                    roundFloat(fracPart.x);
 
         currentNode = &mOctreeData[currentNode->getChildrenIndex() + childIdx];
+        SDFLIB_QUERY_STATS_DESCEND();
         fracPart = glm::fract(2.0f * fracPart);
+        nodeSize *= 0.5f;
     }
 
-    auto& values = *reinterpret_cast<const std::array<float, InterpolationMethod::NUM_COEFFICIENTS>*>(&mOctreeData[currentNode->getChildrenIndex()]);
+    auto& values = getLeafCoefficients<InterpolationMethod, SHARED_VERTICES>(*currentNode, nodeSize);
 
     return InterpolationMethod::interpolateValue(values, fracPart);
 }
 
-float OctreeSdf::getDistance(glm::vec3 sample, glm::vec3& outGradient) const
+template<typename InterpolationMethod, bool SHARED_VERTICES>
+float OctreeSdf::getDistanceAndGradientKernel(glm::vec3 sample, glm::vec3& outGradient) const
 {
+    SDFLIB_QUERY_STATS_SCOPE(QueryStats::OCTREE);
     glm::vec3 fracPart = (sample - mBox.min) / mStartGridCellSize;
     glm::ivec3 startArrayPos = glm::floor(fracPart);
     fracPart = glm::fract(fracPart);
 
-    if(startArrayPos.x < 0 || startArrayPos.x >= mStartGridSize ||
-       startArrayPos.y < 0 || startArrayPos.y >= mStartGridSize ||
-       startArrayPos.z < 0 || startArrayPos.z >= mStartGridSize)
+    if(startArrayPos.x < 0 || startArrayPos.x >= mStartGridSize.x ||
+       startArrayPos.y < 0 || startArrayPos.y >= mStartGridSize.y ||
+       startArrayPos.z < 0 || startArrayPos.z >= mStartGridSize.z)
     {
+        SDFLIB_QUERY_STATS_OUT_OF_BOX();
         return mBox.getDistance(sample, outGradient) + mMinBorderValue;
     }
 
-    const OctreeNode* currentNode = &mOctreeData[startArrayPos.z * mStartGridXY + startArrayPos.y * mStartGridSize + startArrayPos.x];
+    const OctreeNode* currentNode = &mOctreeData[startArrayPos.z * mStartGridXY + startArrayPos.y * mStartGridSize.x + startArrayPos.x];
+    SDFLIB_QUERY_STATS_START_NODE(1u << mStartDepth);
+    float nodeSize = mStartGridCellSize;
 
     while(!currentNode->isLeaf())
     {
@@ -126,18 +416,182 @@ float OctreeSdf::getDistance(glm::vec3 sample, glm::vec3& outGradient) const
                                    roundFloat(fracPart.x);
 
         currentNode = &mOctreeData[currentNode->getChildrenIndex() + childIdx];
+        SDFLIB_QUERY_STATS_DESCEND();
         fracPart = glm::fract(2.0f * fracPart);
+        nodeSize *= 0.5f;
     }
 
-    auto& values = *reinterpret_cast<const std::array<float, InterpolationMethod::NUM_COEFFICIENTS>*>(&mOctreeData[currentNode->getChildrenIndex()]);
+    auto& values = getLeafCoefficients<InterpolationMethod, SHARED_VERTICES>(*currentNode, nodeSize);
 
     outGradient = glm::normalize(InterpolationMethod::interpolateGradient(values, fracPart));
     return InterpolationMethod::interpolateValue(values, fracPart);
 }
 
+template<typename InterpolationMethod, bool SHARED_VERTICES>
+float OctreeSdf::getDistanceWithMaxDepthKernel(glm::vec3 sample, uint32_t maxDepth) const
+{
+    SDFLIB_QUERY_STATS_SCOPE(QueryStats::OCTREE);
+    glm::vec3 fracPart = (sample - mBox.min) / mStartGridCellSize;
+    glm::ivec3 startArrayPos = glm::floor(fracPart);
+    fracPart = glm::fract(fracPart);
+
+    if(startArrayPos.x < 0 || startArrayPos.x >= mStartGridSize.x ||
+       startArrayPos.y < 0 || startArrayPos.y >= mStartGridSize.y ||
+       startArrayPos.z < 0 || startArrayPos.z >= mStartGridSize.z)
+    {
+        SDFLIB_QUERY_STATS_OUT_OF_BOX();
+        return mBox.getDistance(sample) + mMinBorderValue;
+    }
+
+    const OctreeNode* currentNode = &mOctreeData[startArrayPos.z * mStartGridXY + startArrayPos.y * mStartGridSize.x + startArrayPos.x];
+    SDFLIB_QUERY_STATS_START_NODE(1u << mStartDepth);
+    float nodeSize = mStartGridCellSize;
+
+    const uint32_t stopDepth = (mHasLevelOfDetail) ? maxDepth : std::numeric_limits<uint32_t>::max();
+    uint32_t depth = mStartDepth;
+
+    while(!currentNode->isLeaf())
+    {
+        if(depth >= stopDepth)
+        {
+            // The polynomial of the inner node is stored after its children
+            auto& values = *reinterpret_cast<const std::array<float, InterpolationMethod::NUM_COEFFICIENTS>*>(&mOctreeData[currentNode->getChildrenIndex() + 8]);
+            return InterpolationMethod::interpolateValue(values, fracPart);
+        }
+
+        const uint32_t childIdx = (roundFloat(fracPart.z) << 2) + 
+                                  (roundFloat(fracPart.y) << 1) + 
+                                   roundFloat(fracPart.x);
+
+        currentNode = &mOctreeData[currentNode->getChildrenIndex() + childIdx];
+        SDFLIB_QUERY_STATS_DESCEND();
+        fracPart = glm::fract(2.0f * fracPart);
+        nodeSize *= 0.5f;
+        depth++;
+    }
+
+    auto& values = getLeafCoefficients<InterpolationMethod, SHARED_VERTICES>(*currentNode, nodeSize);
+
+    return InterpolationMethod::interpolateValue(values, fracPart);
+}
+
+void OctreeSdf::computeLevelOfDetail()
+{
+    if(hasSharedVertices())
+    {
+        SPDLOG_ERROR("The level of detail cannot be computed after sharing the vertices");
+        return;
+    }
+    dispatchInterpolation(mInterpolationType, [&](auto method) { computeLevelOfDetail<decltype(method)>(); });
+}
+
+template<typename InterpolationMethod>
+void OctreeSdf::computeLevelOfDetail()
+{
+    if(mHasLevelOfDetail) return;
+    ScopedTimer scope("Level of detail");
+
+    constexpr uint32_t NUM_COEFFICIENTS = InterpolationMethod::NUM_COEFFICIENTS;
+    typedef std::array<std::array<float, InterpolationMethod::VALUES_PER_VERTEX>, 8> VerticesValues;
+
+    const std::array<glm::vec3, 8> nodeVertices = 
+    {
+        glm::vec3(0.0f, 0.0f, 0.0f),
+        glm::vec3(1.0f, 0.0f, 0.0f),
+        glm::vec3(0.0f, 1.0f, 0.0f),
+        glm::vec3(1.0f, 1.0f, 0.0f),
+
+        glm::vec3(0.0f, 0.0f, 1.0f),
+        glm::vec3(1.0f, 0.0f, 1.0f),
+        glm::vec3(0.0f, 1.0f, 1.0f),
+        glm::vec3(1.0f, 1.0f, 1.0f)
+    };
+
+    // The polynomials are fitted only from the vertices values, the interpolation methods do not use the triangles
+    const Mesh emptyMesh;
+    const std::vector<uint32_t> emptyTriangles;
+    const std::vector<TriangleUtils::TriangleData> emptyTrianglesData;
+
+    // Count the inner nodes to allocate the new array at once
+    uint64_t numInnerNodes = 0;
+    std::function<void(const OctreeNode&)> countNode;
+    countNode = [&](const OctreeNode& node)
+    {
+        if(node.isLeaf()) return;
+        numInnerNodes++;
+        for(uint32_t i = 0; i < 8; i++)
+        {
+            countNode(mOctreeData[node.getChildrenIndex() + i]);
+        }
+    };
+
+    const uint32_t numStartNodes = mStartGridXY * mStartGridSize.z;
+    for(uint32_t i=0; i < numStartNodes; i++)
+    {
+        countNode(mOctreeData[i]);
+    }
+
+    std::vector<OctreeNode> newOctreeData(numStartNodes);
+    newOctreeData.reserve(mOctreeData.size() + numInnerNodes * NUM_COEFFICIENTS);
+
+    // Copies the subtree to the new array and returns the values at the node vertices
+    std::function<void(uint32_t, uint32_t, float, VerticesValues&)> copyNode;
+    copyNode = [&](uint32_t oldIndex, uint32_t newIndex, float nodeSize, VerticesValues& outVerticesValues)
+    {
+        const OctreeNode node = mOctreeData[oldIndex];
+        if(node.isLeaf())
+        {
+            const uint32_t coeffIndex = newOctreeData.size();
+            newOctreeData.resize(coeffIndex + NUM_COEFFICIENTS);
+            std::memcpy(&newOctreeData[coeffIndex], &mOctreeData[node.getChildrenIndex()], NUM_COEFFICIENTS * sizeof(float));
+            newOctreeData[newIndex].setValues(true, coeffIndex);
+
+            auto& coeff = *reinterpret_cast<const std::array<float, NUM_COEFFICIENTS>*>(&newOctreeData[coeffIndex]);
+            for(uint32_t i=0; i < 8; i++)
+            {
+                InterpolationMethod::interpolateVertexValues(coeff, nodeVertices[i], nodeSize, outVerticesValues[i]);
+            }
+        }
+        else
+        {
+            const uint32_t childrenIndex = newOctreeData.size();
+            newOctreeData.resize(childrenIndex + 8 + NUM_COEFFICIENTS);
+            newOctreeData[newIndex].setValues(false, childrenIndex);
+
+            // The vertex i of the node is the vertex i of the child i
+            VerticesValues childVerticesValues;
+            for(uint32_t i=0; i < 8; i++)
+            {
+                copyNode(node.getChildrenIndex() + i, childrenIndex + i, 0.5f * nodeSize, childVerticesValues);
+                outVerticesValues[i] = childVerticesValues[i];
+            }
+
+            std::array<float, NUM_COEFFICIENTS> coeff;
+            InterpolationMethod::calculateCoefficients(outVerticesValues, nodeSize, emptyTriangles, emptyMesh, emptyTrianglesData, coeff);
+            std::memcpy(&newOctreeData[childrenIndex + 8], coeff.data(), NUM_COEFFICIENTS * sizeof(float));
+        }
+    };
+
+    VerticesValues verticesValues;
+    for(uint32_t i=0; i < numStartNodes; i++)
+    {
+        copyNode(i, i, mStartGridCellSize, verticesValues);
+    }
+
+    mOctreeData = std::move(newOctreeData);
+    mHasLevelOfDetail = true;
+}
+
+void OctreeSdf::computeMinBorderValue()
+{
+    dispatchInterpolation(mInterpolationType, [&](auto method) { computeMinBorderValue<decltype(method)>(); });
+}
 
+template<typename InterpolationMethod>
 void OctreeSdf::computeMinBorderValue()
 {
+    ScopedTimer scope("computeMinBorderValue");
+
     const std::array<glm::vec3, 8> childrens = 
     {
         glm::vec3(-1.0f, -1.0f, -1.0f),
@@ -151,6 +605,15 @@ void OctreeSdf::computeMinBorderValue()
         glm::vec3(1.0f, 1.0f, 1.0f)
     };
 
+    auto getCoefficients = [&](const OctreeNode& leaf, float nodeSize) -> const std::array<float, InterpolationMethod::NUM_COEFFICIENTS>&
+    {
+        return (hasSharedVertices()) ? getLeafCoefficients<InterpolationMethod, true>(leaf, nodeSize)
+                                     : getLeafCoefficients<InterpolationMethod, false>(leaf, nodeSize);
+    };
+
+    // The positions are in start grid cells units
+    const glm::vec3 gridSize = glm::vec3(mStartGridSize);
+
     std::function<float(uint32_t nIdx, glm::vec3 pos, float halfSize)> processNode;
     processNode = [&](uint32_t nIdx, glm::vec3 pos, float halfSize) -> float
     {
@@ -161,7 +624,7 @@ void OctreeSdf::computeMinBorderValue()
             {
                 const glm::vec3 cp = pos + 0.5f * halfSize * childrens[i];
                 if(cp.x < halfSize || cp.y < halfSize || cp.z < halfSize ||
-                   cp.x > (1.0f-halfSize) || cp.y > (1.0f-halfSize) || cp.z > (1.0f-halfSize))
+                   cp.x > (gridSize.x-halfSize) || cp.y > (gridSize.y-halfSize) || cp.z > (gridSize.z-halfSize))
                 {
                     minValue = glm::min(minValue, processNode(mOctreeData[nIdx].getChildrenIndex() + i, cp, 0.5f * halfSize));
                 }
@@ -176,13 +639,10 @@ void OctreeSdf::computeMinBorderValue()
             {
                 const glm::vec3 sp = pos + halfSize * childrens[i];
                 if(sp.x < 1e-4 || sp.y < 1e-4 || sp.z < 1e-4 ||
-                   sp.x > (1.0f-1e-4) || sp.y > (1.0f-1e-4) || sp.z > (1.0f-1e-4))
+                   sp.x > (gridSize.x-1e-4) || sp.y > (gridSize.y-1e-4) || sp.z > (gridSize.z-1e-4))
                 {
-                    std::array<float, InterpolationMethod::NUM_COEFFICIENTS>* coeff = reinterpret_cast<std::array<float, InterpolationMethod::NUM_COEFFICIENTS>*>(
-                                                                                            &mOctreeData[mOctreeData[nIdx].getChildrenIndex()]);
-                    minValue = glm::min(minValue, InterpolationMethod::interpolateValue(*coeff, 0.5f * childrens[i] + glm::vec3(0.5f)));
-
-                    float val = InterpolationMethod::interpolateValue(*coeff, 0.5f * childrens[i] + glm::vec3(0.5f));
+                    auto& coeff = getCoefficients(mOctreeData[nIdx], 2.0f * halfSize * mStartGridCellSize);
+                    minValue = glm::min(minValue, InterpolationMethod::interpolateValue(coeff, 0.5f * childrens[i] + glm::vec3(0.5f)));
                 }
             }
 
@@ -192,20 +652,18 @@ void OctreeSdf::computeMinBorderValue()
         return INFINITY;
     };
 
-    const float gridCellSize = 1.0f / static_cast<float>(mStartGridSize);
-
     float minValue = INFINITY;
-    for(uint32_t k=0; k < mStartGridSize; k++)
+    for(uint32_t k=0; k < mStartGridSize.z; k++)
     {
-        for(uint32_t j=0; j < mStartGridSize; j++)
+        for(uint32_t j=0; j < mStartGridSize.y; j++)
         {
-            for(uint32_t i=0; i < mStartGridSize; i++)
+            for(uint32_t i=0; i < mStartGridSize.x; i++)
             {
-                const uint32_t idx = k * mStartGridXY + j * mStartGridSize + i;
-                const glm::vec3 pos((static_cast<float>(i) + 0.5f) * gridCellSize,
-                                    (static_cast<float>(j) + 0.5f) * gridCellSize,
-                                    (static_cast<float>(k) + 0.5f) * gridCellSize);
-                minValue = glm::min(minValue, processNode(idx, pos, 0.5f * gridCellSize));
+                const uint32_t idx = k * mStartGridXY + j * mStartGridSize.x + i;
+                const glm::vec3 pos(static_cast<float>(i) + 0.5f,
+                                    static_cast<float>(j) + 0.5f,
+                                    static_cast<float>(k) + 0.5f);
+                minValue = glm::min(minValue, processNode(idx, pos, 0.5f));
             }
         }
     }
@@ -213,50 +671,843 @@ void OctreeSdf::computeMinBorderValue()
     mMinBorderValue = minValue;
 }
 
-void OctreeSdf::getDepthDensity(std::vector<float>& depthsDensity)
+void OctreeSdf::computeNodesBounds()
 {
-    depthsDensity.resize(mMaxDepth + 1);
-    std::vector<uint32_t> nodesPerDepth(depthsDensity.size(), 0);
-    uint32_t numLeaves = 0;
-    std::function<void(OctreeNode&, uint32_t)> vistNode;
-    vistNode = [&](OctreeNode& node, uint32_t depth)
-    {
-        node.removeMark();
+    dispatchInterpolation(mInterpolationType, [&](auto method) { computeNodesBounds<decltype(method)>(); });
+}
 
-        // Iterate children
-        if(!node.isLeaf())
+template<typename InterpolationMethod>
+void OctreeSdf::computeNodesBounds()
+{
+    ScopedTimer scope("computeNodesBounds");
+
+    const uint32_t numStartNodes = mStartGridXY * mStartGridSize.z;
+    mNodesBounds.clear();
+    mNodesBounds.resize(numStartNodes);
+    std::vector<uint32_t> sharedChildren(mOctreeData.size(), std::numeric_limits<uint32_t>::max());
+
+    std::function<void(uint32_t nIdx, uint32_t bIdx, float nodeSize)> processNode;
+    processNode = [&](uint32_t nIdx, uint32_t bIdx, float nodeSize)
+    {
+        const OctreeNode& node = mOctreeData[nIdx];
+        if(node.isLeaf())
         {
-            for(uint32_t i = 0; i < 8; i++)
-            {
-                vistNode(mOctreeData[node.getChildrenIndex() + i], depth+1);
-            }
+            auto& coeff = (hasSharedVertices()) ? getLeafCoefficients<InterpolationMethod, true>(node, nodeSize)
+                                                : getLeafCoefficients<InterpolationMethod, false>(node, nodeSize);
+            NodeBounds& bounds = mNodesBounds[bIdx];
+            InterpolationMethod::calculateBounds(coeff, bounds.minValue, bounds.maxValue);
+            bounds.childrenIndex = 0;
         }
         else
         {
-            nodesPerDepth[depth]++;
-            numLeaves++;
+            // The children shared by several nodes are only processed once
+            uint32_t childrenIndex = sharedChildren[node.getChildrenIndex()];
+            if(childrenIndex == std::numeric_limits<uint32_t>::max())
+            {
+                childrenIndex = mNodesBounds.size();
+                sharedChildren[node.getChildrenIndex()] = childrenIndex;
+                mNodesBounds.resize(childrenIndex + 8);
+                for(uint32_t i=0; i < 8; i++)
+                {
+                    processNode(node.getChildrenIndex() + i, childrenIndex + i, 0.5f * nodeSize);
+                }
+            }
+
+            float minValue = INFINITY;
+            float maxValue = -INFINITY;
+            for(uint32_t i=0; i < 8; i++)
+            {
+                minValue = glm::min(minValue, mNodesBounds[childrenIndex + i].minValue);
+                maxValue = glm::max(maxValue, mNodesBounds[childrenIndex + i].maxValue);
+            }
+
+            mNodesBounds[bIdx] = NodeBounds{minValue, maxValue, childrenIndex};
         }
     };
 
-    const uint32_t startDepth = glm::round(glm::log2(static_cast<float>(mStartGridSize)));
+    for(uint32_t i=0; i < numStartNodes; i++)
+    {
+        processNode(i, i, mStartGridCellSize);
+    }
+
+    mNodesBounds.shrink_to_fit();
+}
+
+void OctreeSdf::applyNarrowBand()
+{
+    if(mNarrowBand <= 0.0f) return;
+    dispatchInterpolation(mInterpolationType, [&](auto method) { applyNarrowBand<decltype(method)>(); });
+}
+
+template<typename InterpolationMethod>
+void OctreeSdf::applyNarrowBand()
+{
+    ScopedTimer scope("applyNarrowBand");
 
-    for(uint32_t k=0; k < mStartGridSize; k++)
+    typedef std::array<float, InterpolationMethod::NUM_COEFFICIENTS> Coefficients;
+    const Mesh emptyMesh;
+    const std::vector<uint32_t> emptyTriangles;
+    const std::vector<TriangleUtils::TriangleData> emptyTrianglesData;
+
+    uint32_t numFarLeaves = 0;
+    std::function<void(uint32_t nIdx, float nodeSize)> processNode;
+    processNode = [&](uint32_t nIdx, float nodeSize)
     {
-        for(uint32_t j=0; j < mStartGridSize; j++)
+        const OctreeNode& node = mOctreeData[nIdx];
+        if(!node.isLeaf())
         {
-            for(uint32_t i=0; i < mStartGridSize; i++)
+            for(uint32_t i=0; i < 8; i++)
             {
-                const uint32_t nodeStartIndex = k * mStartGridSize * mStartGridSize + j * mStartGridSize + i;
-                vistNode(mOctreeData[nodeStartIndex], startDepth);
+                processNode(node.getChildrenIndex() + i, 0.5f * nodeSize);
             }
+            return;
+        }
+
+        Coefficients& coeff = *reinterpret_cast<Coefficients*>(&mOctreeData[node.getChildrenIndex()]);
+        std::array<std::array<float, InterpolationMethod::VALUES_PER_VERTEX>, 8> verticesValues;
+        for(uint32_t i=0; i < 8; i++)
+        {
+            verticesValues[i][0] = InterpolationMethod::interpolateValue(coeff, glm::vec3(i & 1, (i >> 1) & 1, (i >> 2) & 1));
+        }
+
+        const float minAbsDistance = getNodeMinAbsDistance(verticesValues, 0.5f * nodeSize);
+        if(minAbsDistance < mNarrowBand) return;
+
+        // The leaf does not cross the surface, so all its vertices have the same sign
+        const float bound = (verticesValues[0][0] < 0.0f) ? -minAbsDistance : minAbsDistance;
+        for(uint32_t i=0; i < 8; i++)
+        {
+            InterpolationMethod::calculatePointValues(bound, glm::vec3(0.0f), verticesValues[i]);
         }
+        InterpolationMethod::calculateCoefficients(verticesValues, nodeSize, emptyTriangles, emptyMesh, emptyTrianglesData, coeff);
+        numFarLeaves++;
+    };
+
+    const uint32_t numStartNodes = mStartGridXY * mStartGridSize.z;
+    for(uint32_t i=0; i < numStartNodes; i++)
+    {
+        processNode(i, mStartGridCellSize);
     }
 
-    float size = 1.0f;
-    for(uint32_t d=0; d < depthsDensity.size(); d++)
+    SPDLOG_INFO("Leaves outside the narrow band: {}", numFarLeaves);
+}
+
+namespace
+{
+    inline uint64_t hashCombine(uint64_t hash, uint64_t value)
     {
-        depthsDensity[d] = size * static_cast<float>(nodesPerDepth[d]);
-        size *= 0.125f;
+        return hash ^ (value + 0x9E3779B97F4A7C15ull + (hash << 6) + (hash >> 2));
     }
 }
+
+void OctreeSdf::deduplicateNodes(float tolerance)
+{
+    if(hasSharedVertices())
+    {
+        SPDLOG_ERROR("The nodes cannot be deduplicated after sharing the vertices");
+        return;
+    }
+
+    ScopedTimer scope("Deduplicate nodes");
+
+    const uint32_t NUM_COEFFICIENTS = getLeafNumCoefficients();
+    constexpr uint32_t NOT_VISITED = std::numeric_limits<uint32_t>::max();
+    const uint32_t numStartNodes = mStartGridXY * mStartGridSize.z;
+    // With the level of detail, the polynomial of the inner node is stored after its children
+    const uint32_t blockSize = (mHasLevelOfDetail) ? 8 + NUM_COEFFICIENTS : 8;
+    const size_t oldSize = mOctreeData.size();
+
+    // Each distinct coefficients array and children block gets an identifier.
+    // The nodes are identified by a token with the leaf mask and the identifier of their array or block
+    std::vector<uint32_t> coeffRepresentative;
+    std::unordered_map<uint64_t, std::vector<uint32_t>> coeffBuckets;
+    std::vector<std::array<uint32_t, 8>> blocks;
+    std::vector<uint32_t> blockRepresentative;
+    std::unordered_map<uint64_t, std::vector<uint32_t>> blockBuckets;
+    std::vector<uint32_t> tokens(oldSize, NOT_VISITED);
+
+    // The leaves are found by the quantized sums of three groups of coefficients.
+    // The tolerances below the float precision of the field are clamped and the cells are limited, so they do not overflow
+    constexpr uint32_t NUM_KEY_SUMS = 3;
+    constexpr double MAX_KEY_CELL = static_cast<double>(1ll << 53);
+    if(tolerance > 0.0f) tolerance = glm::max(tolerance, glm::max(1e-6f * mValueRange, std::numeric_limits<float>::min()));
+    auto hashCells = [](const std::array<int64_t, NUM_KEY_SUMS>& cells)
+    {
+        uint64_t key = 0;
+        for(int64_t c : cells) key = hashCombine(key, static_cast<uint64_t>(c));
+        return key;
+    };
+
+    auto getCoefficients = [&](uint32_t index) -> const float*
+    {
+        return reinterpret_cast<const float*>(&mOctreeData[index]);
+    };
+
+    // The polynomial monomials are less or equal than one inside the node,
+    // so the sum of the coefficients differences bounds the field difference
+    auto areCoefficientsSimilar = [&](const float* a, const float* b)
+    {
+        float diff = 0.0f;
+        for(uint32_t i=0; i < NUM_COEFFICIENTS; i++) diff += glm::abs(a[i] - b[i]);
+        return diff <= tolerance;
+    };
+
+    // Returns the identifier of the coefficients in the bucket similar to the given ones, or NOT_VISITED
+    auto findSimilarLeaf = [&](uint64_t key, const float* coeff) -> uint32_t
+    {
+        auto bucketIt = coeffBuckets.find(key);
+        if(bucketIt == coeffBuckets.end()) return NOT_VISITED;
+
+        auto it = std::find_if(bucketIt->second.begin(), bucketIt->second.end(), [&](uint32_t id)
+        {
+            return areCoefficientsSimilar(coeff, getCoefficients(coeffRepresentative[id]));
+        });
+        return (it != bucketIt->second.end()) ? *it : NOT_VISITED;
+    };
+
+    std::function<uint32_t(uint32_t)> getNodeToken;
+    getNodeToken = [&](uint32_t nIdx) -> uint32_t
+    {
+        const OctreeNode node = mOctreeData[nIdx];
+        const uint32_t childrenIndex = node.getChildrenIndex();
+        if(tokens[childrenIndex] != NOT_VISITED) return tokens[childrenIndex];
+
+        uint32_t token;
+        if(node.isLeaf())
+        {
+            const float* coeff = getCoefficients(childrenIndex);
+            uint32_t id = NOT_VISITED;
+            uint64_t key = 0;
+            if(tolerance > 0.0f)
+            {
+                // The similar leaves have each partial sum at a distance less than the tolerance,
+                // so they are in the same cell or in a neighbour cell of the quantized sums
+                std::array<int64_t, NUM_KEY_SUMS> cell;
+                for(uint32_t j=0; j < NUM_KEY_SUMS; j++)
+                {
+                    double sum = 0.0;
+                    for(uint32_t i=j * NUM_COEFFICIENTS / NUM_KEY_SUMS; i < (j + 1) * NUM_COEFFICIENTS / NUM_KEY_SUMS; i++) sum += coeff[i];
+                    cell[j] = static_cast<int64_t>(glm::clamp(std::floor(sum / tolerance), -MAX_KEY_CELL, MAX_KEY_CELL));
+                }
+
+                for(uint32_t n=0; n < 27 && id == NOT_VISITED; n++)
+                {
+                    const std::array<int64_t, NUM_KEY_SUMS> neighbour = { cell[0] + static_cast<int64_t>(n % 3) - 1,
+                                                                          cell[1] + static_cast<int64_t>((n / 3) % 3) - 1,
+                                                                          cell[2] + static_cast<int64_t>(n / 9) - 1 };
+                    id = findSimilarLeaf(hashCells(neighbour), coeff);
+                }
+                key = hashCells(cell);
+            }
+            else
+            {
+                for(uint32_t i=0; i < NUM_COEFFICIENTS; i++)
+                {
+                    uint64_t bits = 0;
+                    const float value = coeff[i] + 0.0f; // Same key for the negative zero
+                    std::memcpy(&bits, &value, sizeof(float));
+                    key = hashCombine(key, bits);
+                }
+                id = findSimilarLeaf(key, coeff);
+            }
+
+            if(id == NOT_VISITED)
+            {
+                id = coeffRepresentative.size();
+                coeffRepresentative.push_back(childrenIndex);
+                coeffBuckets[key].push_back(id);
+            }
+            token = OctreeNode::IS_LEAF_MASK | id;
+        }
+        else
+        {
+            std::array<uint32_t, 8> children;
+            uint64_t key = 0;
+            for(uint32_t i=0; i < 8; i++)
+            {
+                children[i] = getNodeToken(childrenIndex + i);
+                key = hashCombine(key, children[i]);
+            }
+
+            auto isSameBlock = [&](uint32_t id)
+            {
+                return blocks[id] == children &&
+                       (!mHasLevelOfDetail || std::memcmp(getCoefficients(childrenIndex + 8),
+                                                          getCoefficients(blockRepresentative[id] + 8),
+                                                          NUM_COEFFICIENTS * sizeof(float)) == 0);
+            };
+
+            std::vector<uint32_t>& bucket = blockBuckets[key];
+            auto it = std::find_if(bucket.begin(), bucket.end(), isSameBlock);
+
+            uint32_t id;
+            if(it != bucket.end())
+            {
+                id = *it;
+            }
+            else
+            {
+                id = blocks.size();
+                blocks.push_back(children);
+                blockRepresentative.push_back(childrenIndex);
+                bucket.push_back(id);
+            }
+            token = id;
+        }
+
+        tokens[childrenIndex] = token;
+        return token;
+    };
+
+    std::vector<uint32_t> startTokens(numStartNodes);
+    for(uint32_t i=0; i < numStartNodes; i++)
+    {
+        startTokens[i] = getNodeToken(i);
+    }
+
+    // Write the distinct arrays and blocks in depth first order
+    std::vector<OctreeNode> newOctreeData(numStartNodes);
+    newOctreeData.reserve(numStartNodes + blocks.size() * blockSize + coeffRepresentative.size() * NUM_COEFFICIENTS);
+    std::vector<uint32_t> newCoeffIndex(coeffRepresentative.size(), NOT_VISITED);
+    std::vector<uint32_t> newBlockIndex(blocks.size(), NOT_VISITED);
+
+    std::function<OctreeNode(uint32_t)> writeNode;
+    writeNode = [&](uint32_t token) -> OctreeNode
+    {
+        OctreeNode node;
+        if(token & OctreeNode::IS_LEAF_MASK)
+        {
+            const uint32_t id = token & OctreeNode::CHILDREN_INDEX_MASK;
+            if(newCoeffIndex[id] == NOT_VISITED)
+            {
+                newCoeffIndex[id] = newOctreeData.size();
+                newOctreeData.resize(newOctreeData.size() + NUM_COEFFICIENTS);
+                std::memcpy(&newOctreeData[newCoeffIndex[id]], &mOctreeData[coeffRepresentative[id]], NUM_COEFFICIENTS * sizeof(float));
+            }
+            node.setValues(true, newCoeffIndex[id]);
+        }
+        else
+        {
+            if(newBlockIndex[token] == NOT_VISITED)
+            {
+                const uint32_t childrenIndex = newOctreeData.size();
+                newBlockIndex[token] = childrenIndex;
+                newOctreeData.resize(childrenIndex + blockSize);
+                if(mHasLevelOfDetail)
+                {
+                    std::memcpy(&newOctreeData[childrenIndex + 8], &mOctreeData[blockRepresentative[token] + 8], NUM_COEFFICIENTS * sizeof(float));
+                }
+
+                for(uint32_t i=0; i < 8; i++)
+                {
+                    const OctreeNode child = writeNode(blocks[token][i]);
+                    newOctreeData[childrenIndex + i] = child;
+                }
+            }
+            node.setValues(false, newBlockIndex[token]);
+        }
+        return node;
+    };
+
+    for(uint32_t i=0; i < numStartNodes; i++)
+    {
+        newOctreeData[i] = writeNode(startTokens[i]);
+    }
+
+    mOctreeData = std::move(newOctreeData);
+
+    // The shared leaves can change the field inside the tolerance
+    computeMinBorderValue();
+    computeNodesBounds();
+
+    SPDLOG_INFO("Octree deduplication: {} distinct leaves coefficients, {} distinct children blocks, size reduced from {}MB to {}MB",
+                coeffRepresentative.size(), blocks.size(),
+                oldSize * sizeof(OctreeNode) / 1048576.0f, mOctreeData.size() * sizeof(OctreeNode) / 1048576.0f);
+}
+
+void OctreeSdf::shareVertices(float tolerance)
+{
+    if(hasSharedVertices()) return;
+    if(mMaxDepth > 20)
+    {
+        SPDLOG_ERROR("The vertices can only be shared in octrees with a maximum depth of 20");
+        return;
+    }
+    dispatchInterpolation(mInterpolationType, [&](auto method) { shareVertices<decltype(method)>(tolerance); });
+}
+
+template<typename InterpolationMethod>
+void OctreeSdf::shareVertices(float tolerance)
+{
+    ScopedTimer scope("Share vertices");
+
+    constexpr uint32_t NUM_COEFFICIENTS = InterpolationMethod::NUM_COEFFICIENTS;
+    constexpr uint32_t VALUES_PER_VERTEX = InterpolationMethod::VALUES_PER_VERTEX;
+    static_assert(VALUES_PER_VERTEX == 1 || VALUES_PER_VERTEX == 8, "Unsupported values per vertex");
+    typedef std::array<float, VALUES_PER_VERTEX> VertexValues;
+
+    const std::array<glm::uvec3, 8> nodeVertices = 
+    {
+        glm::uvec3(0, 0, 0),
+        glm::uvec3(1, 0, 0),
+        glm::uvec3(0, 1, 0),
+        glm::uvec3(1, 1, 0),
+
+        glm::uvec3(0, 0, 1),
+        glm::uvec3(1, 0, 1),
+        glm::uvec3(0, 1, 1),
+        glm::uvec3(1, 1, 1)
+    };
+
+    const uint32_t numStartNodes = mStartGridXY * mStartGridSize.z;
+    // With the level of detail, the polynomial of the inner node is stored after its children
+    const uint32_t blockSize = (mHasLevelOfDetail) ? 8 + NUM_COEFFICIENTS : 8;
+    const size_t oldSize = mOctreeData.size();
+    // The tolerance is relative to the longest side of the box
+    const float maxDifference = tolerance * mStartGridCellSize * static_cast<float>(1 << mStartDepth);
+
+    // The vertices are identified by their position in the lattice of the maximum depth,
+    // the leaves in the same position with different values get different vertices
+    std::vector<float> verticesValues;
+    std::unordered_map<uint64_t, std::vector<uint32_t>> verticesByPosition;
+    uint32_t numLeaves = 0;
+
+    // The differences of the derivatives are scaled by the node size to bound their effect on the field inside the node
+    auto isSameVertex = [&](const VertexValues& values, uint32_t vertexIndex, float nodeSize)
+    {
+        const float* vertex = &verticesValues[VALUES_PER_VERTEX * vertexIndex];
+        float diff = glm::abs(values[0] - vertex[0]);
+        if constexpr(VALUES_PER_VERTEX == 8)
+        {
+            const float sqNodeSize = nodeSize * nodeSize;
+            diff += nodeSize * (glm::abs(values[1] - vertex[1]) + glm::abs(values[2] - vertex[2]) + glm::abs(values[3] - vertex[3]));
+            diff += sqNodeSize * (glm::abs(values[4] - vertex[4]) + glm::abs(values[5] - vertex[5]) + glm::abs(values[6] - vertex[6]));
+            diff += sqNodeSize * nodeSize * glm::abs(values[7] - vertex[7]);
+        }
+        return diff <= maxDifference;
+    };
+
+    auto getVertexIndex = [&](glm::uvec3 position, const VertexValues& values, float nodeSize) -> uint32_t
+    {
+        const uint64_t key = (static_cast<uint64_t>(position.z) << 42) | (static_cast<uint64_t>(position.y) << 21) | static_cast<uint64_t>(position.x);
+        std::vector<uint32_t>& candidates = verticesByPosition[key];
+        for(uint32_t vertexIndex : candidates)
+        {
+            if(isSameVertex(values, vertexIndex, nodeSize)) return vertexIndex;
+        }
+
+        const uint32_t vertexIndex = verticesValues.size() / VALUES_PER_VERTEX;
+        verticesValues.insert(verticesValues.end(), values.begin(), values.end());
+        candidates.push_back(vertexIndex);
+        return vertexIndex;
+    };
+
+    std::vector<OctreeNode> newOctreeData(numStartNodes);
+    newOctreeData.reserve(oldSize);
+
+    // Copies the subtree to the new array replacing the leaves coefficients by their vertices indices.
+    // The node sizes are computed like in the queries to fit the same coefficients
+    std::function<void(uint32_t, uint32_t, glm::uvec3, uint32_t, float)> copyNode;
+    copyNode = [&](uint32_t oldIndex, uint32_t newIndex, glm::uvec3 latticeMin, uint32_t latticeSize, float nodeSize)
+    {
+        const OctreeNode node = mOctreeData[oldIndex];
+        if(node.isLeaf())
+        {
+            auto& coeff = *reinterpret_cast<const std::array<float, NUM_COEFFICIENTS>*>(&mOctreeData[node.getChildrenIndex()]);
+            const uint32_t verticesIndex = newOctreeData.size();
+            newOctreeData.resize(verticesIndex + 8);
+            for(uint32_t i=0; i < 8; i++)
+            {
+                VertexValues values;
+                InterpolationMethod::interpolateVertexValues(coeff, glm::vec3(nodeVertices[i]), nodeSize, values);
+                newOctreeData[verticesIndex + i].childrenIndex = getVertexIndex(latticeMin + latticeSize * nodeVertices[i], values, nodeSize);
+            }
+            newOctreeData[newIndex].setValues(true, verticesIndex);
+            numLeaves++;
+        }
+        else
+        {
+            const uint32_t childrenIndex = newOctreeData.size();
+            newOctreeData.resize(childrenIndex + blockSize);
+            newOctreeData[newIndex].setValues(false, childrenIndex);
+            if(mHasLevelOfDetail)
+            {
+                std::memcpy(&newOctreeData[childrenIndex + 8], &mOctreeData[node.getChildrenIndex() + 8], NUM_COEFFICIENTS * sizeof(float));
+            }
+
+            const uint32_t childLatticeSize = latticeSize >> 1;
+            for(uint32_t i=0; i < 8; i++)
+            {
+                copyNode(node.getChildrenIndex() + i, childrenIndex + i,
+                         latticeMin + childLatticeSize * nodeVertices[i], childLatticeSize, 0.5f * nodeSize);
+            }
+        }
+    };
+
+    const uint32_t startLatticeSize = 1 << (mMaxDepth - mStartDepth);
+    for(uint32_t k=0; k < mStartGridSize.z; k++)
+    {
+        for(uint32_t j=0; j < mStartGridSize.y; j++)
+        {
+            for(uint32_t i=0; i < mStartGridSize.x; i++)
+            {
+                const uint32_t idx = k * mStartGridXY + j * mStartGridSize.x + i;
+                copyNode(idx, idx, startLatticeSize * glm::uvec3(i, j, k), startLatticeSize, mStartGridCellSize);
+            }
+        }
+    }
+
+    const size_t oldBytes = MemoryUsage::getBytes(mOctreeData);
+    mOctreeData = std::move(newOctreeData);
+    mVerticesValues = std::move(verticesValues);
+    initInterpolationKernels();
+
+    // The shared vertices can change the field inside the tolerance
+    computeMinBorderValue();
+    computeNodesBounds();
+
+    SPDLOG_INFO("Octree vertices sharing: {} vertices for {} leaves, size reduced from {}MB to {}MB",
+                mVerticesValues.size() / VALUES_PER_VERTEX, numLeaves,
+                oldBytes / 1048576.0f, (MemoryUsage::getBytes(mOctreeData) + MemoryUsage::getBytes(mVerticesValues)) / 1048576.0f);
+}
+
+glm::vec2 OctreeSdf::getDistanceBounds(BoundingBox box) const
+{
+    glm::vec2 bounds(INFINITY, -INFINITY);
+
+    // Outside the octree, the field is the distance to the octree box plus the minimum border value
+    if(glm::any(glm::lessThan(box.min, mBox.min)) || glm::any(glm::greaterThan(box.max, mBox.max)))
+    {
+        float maxBoxDist = 0.0f;
+        for(uint32_t i=0; i < 8; i++)
+        {
+            const glm::vec3 corner((i & 1) ? box.max.x : box.min.x,
+                                   (i & 2) ? box.max.y : box.min.y,
+                                   (i & 4) ? box.max.z : box.min.z);
+            maxBoxDist = glm::max(maxBoxDist, mBox.getDistance(corner));
+        }
+        const float minBoxDist = glm::length(glm::max(glm::vec3(0.0f), glm::max(mBox.min - box.max, box.min - mBox.max)));
+        bounds = glm::vec2(mMinBorderValue + minBoxDist, mMinBorderValue + maxBoxDist);
+    }
+
+    // Region inside the octree in start grid units
+    const glm::vec3 minPos = (glm::max(box.min, mBox.min) - mBox.min) / mStartGridCellSize;
+    const glm::vec3 maxPos = (glm::min(box.max, mBox.max) - mBox.min) / mStartGridCellSize;
+    if(glm::any(glm::greaterThan(minPos, maxPos))) return bounds;
+
+    std::function<void(uint32_t bIdx, glm::vec3 nodeMin, float nodeSize)> processNode;
+    processNode = [&](uint32_t bIdx, glm::vec3 nodeMin, float nodeSize)
+    {
+        const NodeBounds& node = mNodesBounds[bIdx];
+        // The node cannot expand the interval
+        if(node.minValue >= bounds.x && node.maxValue <= bounds.y) return;
+
+        // The leaves and the nodes inside the region use their own interval
+        if(node.childrenIndex == 0 ||
+           (glm::all(glm::greaterThanEqual(nodeMin, minPos)) && glm::all(glm::lessThanEqual(nodeMin + nodeSize, maxPos))))
+        {
+            bounds.x = glm::min(bounds.x, node.minValue);
+            bounds.y = glm::max(bounds.y, node.maxValue);
+            return;
+        }
+
+        const float childSize = 0.5f * nodeSize;
+        for(uint32_t i=0; i < 8; i++)
+        {
+            const glm::vec3 childMin = nodeMin + childSize * glm::vec3(i & 1, (i >> 1) & 1, (i >> 2) & 1);
+            if(glm::all(glm::lessThanEqual(childMin, maxPos)) && glm::all(glm::greaterThanEqual(childMin + childSize, minPos)))
+            {
+                processNode(node.childrenIndex + i, childMin, childSize);
+            }
+        }
+    };
+
+    const glm::ivec3 startMin = glm::clamp(glm::ivec3(glm::floor(minPos)), glm::ivec3(0), mStartGridSize - 1);
+    const glm::ivec3 startMax = glm::clamp(glm::ivec3(glm::floor(maxPos)), glm::ivec3(0), mStartGridSize - 1);
+    for(int k=startMin.z; k <= startMax.z; k++)
+    {
+        for(int j=startMin.y; j <= startMax.y; j++)
+        {
+            for(int i=startMin.x; i <= startMax.x; i++)
+            {
+                processNode(k * mStartGridXY + j * mStartGridSize.x + i, glm::vec3(i, j, k), 1.0f);
+            }
+        }
+    }
+
+    return bounds;
+}
+
+void OctreeSdf::sampleGrid(BoundingBox box, glm::ivec3 resolution, std::vector<float>& outGrid, uint32_t numThreads) const
+{
+    dispatchInterpolation(mInterpolationType, [&](auto method) { sampleGrid<decltype(method)>(box, resolution, outGrid, numThreads); });
+}
+
+template<typename InterpolationMethod>
+void OctreeSdf::sampleGrid(BoundingBox box, glm::ivec3 resolution, std::vector<float>& outGrid, uint32_t numThreads) const
+{
+    if(glm::any(glm::lessThanEqual(resolution, glm::ivec3(0))))
+    {
+        outGrid.clear();
+        return;
+    }
+
+    // The points of the axes without extent are all in the same position,
+    // so the grid is computed with a single point in those axes and copied
+    const glm::bvec3 flatAxes = glm::lessThanEqual(box.getSize(), glm::vec3(0.0f));
+    const glm::ivec3 flatResolution(flatAxes.x ? 1 : resolution.x, flatAxes.y ? 1 : resolution.y, flatAxes.z ? 1 : resolution.z);
+    if(flatResolution != resolution)
+    {
+        std::vector<float> flatGrid;
+        sampleGrid<InterpolationMethod>(box, flatResolution, flatGrid, numThreads);
+
+        outGrid.resize(static_cast<size_t>(resolution.x) * static_cast<size_t>(resolution.y) * static_cast<size_t>(resolution.z));
+        const size_t gridXY = static_cast<size_t>(resolution.x) * static_cast<size_t>(resolution.y);
+        const size_t flatGridXY = static_cast<size_t>(flatResolution.x) * static_cast<size_t>(flatResolution.y);
+        for(int k=0; k < resolution.z; k++)
+        {
+            for(int j=0; j < resolution.y; j++)
+            {
+                for(int i=0; i < resolution.x; i++)
+                {
+                    outGrid[k * gridXY + j * resolution.x + i] = flatGrid[glm::min(k, flatResolution.z - 1) * flatGridXY + 
+                                                                          glm::min(j, flatResolution.y - 1) * flatResolution.x + 
+                                                                          glm::min(i, flatResolution.x - 1)];
+                }
+            }
+        }
+        return;
+    }
+
+    ScopedTimer scope("sampleGrid");
+
+    outGrid.resize(static_cast<size_t>(resolution.x) * static_cast<size_t>(resolution.y) * static_cast<size_t>(resolution.z));
+
+    const size_t gridXY = static_cast<size_t>(resolution.x) * static_cast<size_t>(resolution.y);
+
+    // The grid is computed in start grid units, where the node limits are exact.
+    // The axes without extent have a single point and any positive step gives its ranges
+    const glm::vec3 gridOrigin = (box.min - mBox.min) / mStartGridCellSize;
+    glm::vec3 gridStep = glm::vec3(box.getSize()) / (mStartGridCellSize * glm::max(glm::vec3(resolution - 1), glm::vec3(1.0f)));
+    for(uint32_t a=0; a < 3; a++)
+    {
+        if(flatAxes[a]) gridStep[a] = 1.0f;
+    }
+
+    // The points outside the octree use the regular query.
+    // The ranges are clamped before the conversion, so the boxes far from the octree do not overflow
+    const glm::vec3 maxPointIndex(resolution);
+    const glm::ivec3 insideMin(glm::clamp(glm::ceil(-gridOrigin / gridStep), glm::vec3(0.0f), maxPointIndex));
+    const glm::ivec3 insideMax(glm::clamp(glm::ceil((glm::vec3(mStartGridSize) - gridOrigin) / gridStep), glm::vec3(0.0f), maxPointIndex));
+    #ifdef OPENMP_AVAILABLE
+    #pragma omp parallel for num_threads(numThreads) schedule(static)
+    #endif
+    for(int k=0; k < resolution.z; k++)
+    {
+        for(int j=0; j < resolution.y; j++)
+        {
+            const bool lineInside = k >= insideMin.z && k < insideMax.z && j >= insideMin.y && j < insideMax.y;
+            for(int i=0; i < resolution.x; i++)
+            {
+                if(lineInside && i >= insideMin.x && i < insideMax.x) continue;
+                const glm::vec3 sample = mBox.min + mStartGridCellSize * (gridOrigin + gridStep * glm::vec3(i, j, k));
+                outGrid[k * gridXY + j * resolution.x + i] = getDistance(sample);
+            }
+        }
+    }
+
+    // Collect the leaves covering any grid point
+    struct LeafInfo
+    {
+        OctreeNode node;
+        glm::ivec3 minPoint;
+        glm::ivec3 maxPoint;
+        glm::vec3 nodeMin;
+        float nodeSize;
+    };
+    std::vector<LeafInfo> leaves;
+
+    std::function<void(uint32_t, glm::vec3, float)> collectLeaves;
+    collectLeaves = [&](uint32_t nIdx, glm::vec3 nodeMin, float nodeSize)
+    {
+        // Each point belongs to the node containing it in the interval [nodeMin, nodeMax)
+        const glm::ivec3 minPoint(glm::clamp(glm::ceil((nodeMin - gridOrigin) / gridStep), glm::vec3(0.0f), maxPointIndex));
+        const glm::ivec3 maxPoint(glm::clamp(glm::ceil((nodeMin + nodeSize - gridOrigin) / gridStep), glm::vec3(0.0f), maxPointIndex));
+        if(glm::any(glm::greaterThanEqual(minPoint, maxPoint))) return;
+
+        const OctreeNode& node = mOctreeData[nIdx];
+        if(node.isLeaf())
+        {
+            leaves.push_back(LeafInfo{node, minPoint, maxPoint, nodeMin, nodeSize});
+            return;
+        }
+
+        const float childSize = 0.5f * nodeSize;
+        for(uint32_t c=0; c < 8; c++)
+        {
+            collectLeaves(node.getChildrenIndex() + c, nodeMin + childSize * glm::vec3(c & 1, (c >> 1) & 1, (c >> 2) & 1), childSize);
+        }
+    };
+
+    for(int k=0; k < mStartGridSize.z; k++)
+    {
+        for(int j=0; j < mStartGridSize.y; j++)
+        {
+            for(int i=0; i < mStartGridSize.x; i++)
+            {
+                collectLeaves(k * mStartGridXY + j * mStartGridSize.x + i, glm::vec3(i, j, k), 1.0f);
+            }
+        }
+    }
+
+    #ifdef OPENMP_AVAILABLE
+    #pragma omp parallel for num_threads(numThreads) schedule(dynamic, 64)
+    #endif
+    for(int64_t l=0; l < static_cast<int64_t>(leaves.size()); l++)
+    {
+        const LeafInfo& leaf = leaves[l];
+        auto& values = (hasSharedVertices()) ? getLeafCoefficients<InterpolationMethod, true>(leaf.node, leaf.nodeSize * mStartGridCellSize)
+                                             : getLeafCoefficients<InterpolationMethod, false>(leaf.node, leaf.nodeSize * mStartGridCellSize);
+        const glm::vec3 step = gridStep / leaf.nodeSize;
+        const glm::vec3 startFrac = (gridOrigin + gridStep * glm::vec3(leaf.minPoint) - leaf.nodeMin) / leaf.nodeSize;
+
+        if constexpr(std::is_same<InterpolationMethod, TriCubicInterpolation>::value)
+        {
+            // The polynomial is reduced to a cubic along the x axis for each row,
+            // which is evaluated by forward differencing
+            for(int k=leaf.minPoint.z; k < leaf.maxPoint.z; k++)
+            {
+                const float z = startFrac.z + step.z * static_cast<float>(k - leaf.minPoint.z);
+                std::array<float, 16> coeffXY;
+                for(uint32_t c=0; c < 16; c++)
+                {
+                    coeffXY[c] = values[c] + z * (values[c + 16] + z * (values[c + 32] + z * values[c + 48]));
+                }
+
+                for(int j=leaf.minPoint.y; j < leaf.maxPoint.y; j++)
+                {
+                    const float y = startFrac.y + step.y * static_cast<float>(j - leaf.minPoint.y);
+                    std::array<float, 4> coeffX;
+                    for(uint32_t c=0; c < 4; c++)
+                    {
+                        coeffX[c] = coeffXY[c] + y * (coeffXY[c + 4] + y * (coeffXY[c + 8] + y * coeffXY[c + 12]));
+                    }
+
+                    auto evalX = [&](float x) { return coeffX[0] + x * (coeffX[1] + x * (coeffX[2] + x * coeffX[3])); };
+                    const float x = startFrac.x;
+                    const float f0 = evalX(x);
+                    const float f1 = evalX(x + step.x);
+                    const float f2 = evalX(x + 2.0f * step.x);
+                    const float f3 = evalX(x + 3.0f * step.x);
+                    float value = f0;
+                    float d1 = f1 - f0;
+                    float d2 = f2 - 2.0f * f1 + f0;
+                    const float d3 = f3 - 3.0f * f2 + 3.0f * f1 - f0;
+
+                    float* row = &outGrid[k * gridXY + j * resolution.x];
+                    for(int i=leaf.minPoint.x; i < leaf.maxPoint.x; i++)
+                    {
+                        row[i] = value;
+                        value += d1;
+                        d1 += d2;
+                        d2 += d3;
+                    }
+                }
+            }
+        }
+        else
+        {
+            for(int k=leaf.minPoint.z; k < leaf.maxPoint.z; k++)
+            {
+                for(int j=leaf.minPoint.y; j < leaf.maxPoint.y; j++)
+                {
+                    for(int i=leaf.minPoint.x; i < leaf.maxPoint.x; i++)
+                    {
+                        const glm::vec3 fracPart = startFrac + step * glm::vec3(glm::ivec3(i, j, k) - leaf.minPoint);
+                        outGrid[k * gridXY + j * resolution.x + i] = InterpolationMethod::interpolateValue(values, fracPart);
+                    }
+                }
+            }
+        }
+    }
+}
+
+void OctreeSdf::getDepthDensity(std::vector<float>& depthsDensity)
+{
+    depthsDensity.resize(mMaxDepth + 1);
+    std::vector<uint32_t> nodesPerDepth(depthsDensity.size(), 0);
+    uint32_t numLeaves = 0;
+    std::function<void(OctreeNode&, uint32_t)> vistNode;
+    vistNode = [&](OctreeNode& node, uint32_t depth)
+    {
+        node.removeMark();
+
+        // Iterate children
+        if(!node.isLeaf())
+        {
+            for(uint32_t i = 0; i < 8; i++)
+            {
+                vistNode(mOctreeData[node.getChildrenIndex() + i], depth+1);
+            }
+        }
+        else
+        {
+            nodesPerDepth[depth]++;
+            numLeaves++;
+        }
+    };
+
+    for(uint32_t k=0; k < mStartGridSize.z; k++)
+    {
+        for(uint32_t j=0; j < mStartGridSize.y; j++)
+        {
+            for(uint32_t i=0; i < mStartGridSize.x; i++)
+            {
+                const uint32_t nodeStartIndex = k * mStartGridXY + j * mStartGridSize.x + i;
+                vistNode(mOctreeData[nodeStartIndex], mStartDepth);
+            }
+        }
+    }
+
+    float size = 1.0f;
+    for(uint32_t d=0; d < depthsDensity.size(); d++)
+    {
+        depthsDensity[d] = size * static_cast<float>(nodesPerDepth[d]);
+        size *= 0.125f;
+    }
+}
+
+MemoryUsage OctreeSdf::memoryUsage() const
+{
+    // The nodes and the coefficients are stored in the same array,
+    // the nodes are counted traversing the octree. The shared children are counted once.
+    const size_t numStartNodes = std::min(static_cast<size_t>(mStartGridXY) * static_cast<size_t>(mStartGridSize.z), mOctreeData.size());
+    uint64_t numNodes = numStartNodes;
+    std::vector<bool> visitedChildren(mOctreeData.size(), false);
+    std::function<void(const OctreeNode&)> vistNode;
+    vistNode = [&](const OctreeNode& node)
+    {
+        if(!node.isLeaf() && !visitedChildren[node.getChildrenIndex()])
+        {
+            visitedChildren[node.getChildrenIndex()] = true;
+            numNodes += 8;
+            for(uint32_t i = 0; i < 8; i++)
+            {
+                vistNode(mOctreeData[node.getChildrenIndex() + i]);
+            }
+        }
+    };
+
+    for(size_t i=0; i < numStartNodes; i++)
+    {
+        vistNode(mOctreeData[i]);
+    }
+
+    MemoryUsage usage;
+    usage.nodes = numNodes * sizeof(OctreeNode);
+    usage.coefficients = MemoryUsage::getBytes(mOctreeData) - usage.nodes + MemoryUsage::getBytes(mVerticesValues);
+    usage.nodesBounds = MemoryUsage::getBytes(mNodesBounds);
+    usage.constructionPeak = mConstructionPeakMemory;
+    return usage;
+}
 }
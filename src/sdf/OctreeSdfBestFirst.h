@@ -0,0 +1,354 @@
+#ifndef OCTREE_SDF_BEST_FIRST_H
+#define OCTREE_SDF_BEST_FIRST_H
+
+#include "SdfLib/OctreeSdf.h"
+#include "SdfLib/utils/Timer.h"
+#include "SdfLib/utils/BuildProgress.h"
+#include "SdfLib/OctreeSdfUtils.h"
+#include <array>
+#include <queue>
+#include <cstring>
+#include <functional>
+
+namespace sdflib
+{
+template<typename VertexInfo, int VALUES_PER_VERTEX>
+struct BestFirstNodeInfo
+{
+    uint32_t nodeIndex;
+    uint16_t depth;
+    glm::vec3 center;
+    float size;
+    std::array<std::array<float, VALUES_PER_VERTEX>, 8> verticesValues;
+    std::array<VertexInfo, 8> verticesInfo;
+    std::array<std::array<float, VALUES_PER_VERTEX>, 19> midPointsValues;
+    std::array<VertexInfo, 19> pointsInfo;
+    std::vector<uint32_t> triangles;
+};
+
+template<typename TrianglesInfluenceStrategy>
+void OctreeSdf::initOctreeBestFirst(const Mesh& mesh, uint32_t startDepth, uint32_t maxDepth,
+                                    float terminationThreshold, const BuildBudget& budget,
+                                    const TrianglesInfluenceStrategy& trianglesInfluencePrototype)
+{
+    typedef typename TrianglesInfluenceStrategy::InterpolationMethod InterpolationMethod;
+    typedef BestFirstNodeInfo<typename TrianglesInfluenceStrategy::VertexInfo, InterpolationMethod::VALUES_PER_VERTEX> NodeInfo;
+    typedef std::array<float, InterpolationMethod::NUM_COEFFICIENTS> Coefficients;
+
+    const float thresholdScale = glm::length(mesh.getBoundingBox().getSize());
+    terminationThreshold *= thresholdScale;
+    const float sqTerminationThreshold = terminationThreshold * terminationThreshold;
+
+    ScopedTimer trianglesDataScope("Triangles data setup");
+    std::vector<TriangleUtils::TriangleData> trianglesData(TriangleUtils::calculateMeshTriangleData(mesh));
+
+    TrianglesInfluenceStrategy trianglesInfluence(trianglesInfluencePrototype);
+    trianglesInfluence.initCaches(getStartGridCube(), getRefinementMaxDepth(maxDepth));
+
+    std::vector<uint32_t> startTriangles;
+    startTriangles.reserve(trianglesData.size());
+    for(uint32_t t=0; t < trianglesData.size(); t++)
+    {
+        if(glm::dot(trianglesData[t].getTriangleNormal(), trianglesData[t].getTriangleNormal()) > 1e-3f)
+            startTriangles.push_back(t);
+    }
+    trianglesDataScope.stop();
+
+    const std::array<glm::vec3, 8> childrens =
+    {
+        glm::vec3(-1.0f, -1.0f, -1.0f),
+        glm::vec3(1.0f, -1.0f, -1.0f),
+        glm::vec3(-1.0f, 1.0f, -1.0f),
+        glm::vec3(1.0f, 1.0f, -1.0f),
+
+        glm::vec3(-1.0f, -1.0f, 1.0f),
+        glm::vec3(1.0f, -1.0f, 1.0f),
+        glm::vec3(-1.0f, 1.0f, 1.0f),
+        glm::vec3(1.0f, 1.0f, 1.0f)
+    };
+
+    const std::array<glm::vec3, 19> nodeSamplePoints =
+    {
+        glm::vec3(0.0f, -1.0f, -1.0f),
+        glm::vec3(-1.0f, 0.0f, -1.0f),
+        glm::vec3(0.0f, 0.0f, -1.0f),
+        glm::vec3(1.0f, 0.0f, -1.0f),
+        glm::vec3(0.0f, 1.0f, -1.0f),
+
+        glm::vec3(-1.0f, -1.0f, 0.0f),
+        glm::vec3(0.0f, -1.0f, 0.0f),
+        glm::vec3(1.0f, -1.0f, 0.0f),
+        glm::vec3(-1.0f, 0.0f, 0.0f),
+        glm::vec3(0.0f),
+        glm::vec3(1.0f, 0.0f, 0.0f),
+        glm::vec3(-1.0f, 1.0f, 0.0f),
+        glm::vec3(0.0f, 1.0f, 0.0f),
+        glm::vec3(1.0f, 1.0f, 0.0f),
+
+        glm::vec3(0.0f, -1.0f, 1.0f),
+        glm::vec3(-1.0f, 0.0f, 1.0f),
+        glm::vec3(0.0f, 0.0f, 1.0f),
+        glm::vec3(1.0f, 0.0f, 1.0f),
+        glm::vec3(0.0f, 1.0f, 1.0f),
+    };
+
+    // Sample of each position of the 3x3x3 lattice formed by the node vertices and the middle points.
+    // The values less than 19 are middle points and the rest are the node vertices plus 19
+    const std::array<uint32_t, 27> latticeSamples =
+    {
+        19, 0, 20,   1, 2, 3,      21, 4, 22,
+        5, 6, 7,     8, 9, 10,     11, 12, 13,
+        23, 14, 24,  15, 16, 17,   25, 18, 26
+    };
+
+    // The tree is built in temporal arrays and copied compactly at the end.
+    // The leaves point to an array of coefficients, and the slots of the subdivided leaves are recycled
+    std::vector<OctreeNode> tree(mStartGridXY * mStartGridSize.z);
+    std::vector<Coefficients> leavesCoefficients;
+    std::vector<uint32_t> freeCoefficients;
+
+    // The nodes that can be subdivided wait in the queue sorted by the estimated error integral
+    std::vector<NodeInfo> candidates;
+    std::vector<uint32_t> freeCandidates;
+    std::priority_queue<std::pair<float, uint32_t>> queue;
+
+    const uint64_t nodeBytes = sizeof(OctreeNode);
+    const uint64_t leafBytes = (1 + InterpolationMethod::NUM_COEFFICIENTS) * sizeof(OctreeNode);
+    uint64_t numNodes = 0;
+    uint64_t numLeaves = 0;
+    size_t candidatesTrianglesBytes = 0;
+    size_t candidatesPeakMemory = 0; // The candidates release their triangles when they are subdivided
+    float valueRange = 0.0f;
+
+    AccumulatedTimer fittingTime;
+    AccumulatedTimer terminationTime;
+    BuildProgress* progress = BuildProgress::getCurrent();
+
+    // Fits the node polynomial, making it a leaf, and adds it to the queue when it must be subdivided
+    auto evaluateNode = [&](NodeInfo&& node, const std::vector<uint32_t>& parentTriangles)
+    {
+        if(progress != nullptr) progress->addProcessedNodes(node.depth);
+        trianglesInfluence.filterTriangles(node.center, node.size, parentTriangles, node.triangles,
+                                           node.verticesValues, node.verticesInfo, mesh, trianglesData);
+
+        uint32_t coeffIndex;
+        if(!freeCoefficients.empty())
+        {
+            coeffIndex = freeCoefficients.back();
+            freeCoefficients.pop_back();
+        }
+        else
+        {
+            coeffIndex = leavesCoefficients.size();
+            leavesCoefficients.emplace_back();
+        }
+
+        fittingTime.start();
+        Coefficients& interpolationCoeff = leavesCoefficients[coeffIndex];
+        InterpolationMethod::calculateCoefficients(node.verticesValues, 2.0f * node.size, node.triangles, mesh, trianglesData, interpolationCoeff);
+        fittingTime.stop();
+        tree[node.nodeIndex].setValues(true, coeffIndex);
+        numNodes++;
+        numLeaves++;
+
+        for(uint32_t i=0; i < 8; i++)
+        {
+            valueRange = glm::max(valueRange, glm::abs(node.verticesValues[i][0]));
+        }
+
+        uint32_t nodeMaxDepth = maxDepth;
+        float nodeSqTerminationThreshold = sqTerminationThreshold;
+        getNodeRefinement(node.center, node.size, thresholdScale, nodeMaxDepth, nodeSqTerminationThreshold);
+
+        // The leaves outside the narrow band are never candidates to be subdivided
+        if(node.depth >= nodeMaxDepth || isOutsideNarrowBand(node.verticesValues, node.size, mNarrowBand)) return;
+
+        // The samples in the middle points are used to estimate the node error
+        terminationTime.start();
+        trianglesInfluence.calculateVerticesInfo(node.center, node.size, node.triangles, nodeSamplePoints,
+                                                 0u, interpolationCoeff,
+                                                 node.midPointsValues, node.pointsInfo,
+                                                 mesh, trianglesData);
+        const float error = estimateErrorFunctionIntegralByTrapezoidRule<InterpolationMethod>(interpolationCoeff, node.midPointsValues);
+        terminationTime.stop();
+        if(error < nodeSqTerminationThreshold) return;
+
+        uint32_t candidateIndex;
+        if(!freeCandidates.empty())
+        {
+            candidateIndex = freeCandidates.back();
+            freeCandidates.pop_back();
+            candidates[candidateIndex] = std::move(node);
+        }
+        else
+        {
+            candidateIndex = candidates.size();
+            candidates.push_back(std::move(node));
+        }
+
+        // The error is weighted by the node volume to refine first the nodes contributing more to the total error
+        const float nodeSize = 2.0f * candidates[candidateIndex].size;
+        queue.push(std::make_pair(error * nodeSize * nodeSize * nodeSize, candidateIndex));
+        candidatesTrianglesBytes += MemoryUsage::getBytes(candidates[candidateIndex].triangles);
+        candidatesPeakMemory = glm::max(candidatesPeakMemory, MemoryUsage::getBytes(candidates) + candidatesTrianglesBytes +
+                                                              queue.size() * sizeof(std::pair<float, uint32_t>));
+    };
+
+    // Create the start grid
+    ScopedTimer subdivisionScope("Subdivision");
+    if(progress != nullptr) progress->addEstimatedNodes(startDepth, mStartGridXY * mStartGridSize.z);
+    {
+        const float newSize = 0.5f * mStartGridCellSize;
+        const glm::vec3 startCenter = mBox.min + newSize;
+
+        for(int k=0; k < mStartGridSize.z; k++)
+        {
+            for(int j=0; j < mStartGridSize.y; j++)
+            {
+                for(int i=0; i < mStartGridSize.x; i++)
+                {
+                    NodeInfo node;
+                    node.nodeIndex = k * mStartGridXY + j * mStartGridSize.x + i;
+                    node.depth = startDepth;
+                    node.center = startCenter + glm::vec3(i, j, k) * 2.0f * newSize;
+                    node.size = newSize;
+
+                    Coefficients nullArray;
+                    trianglesInfluence.calculateVerticesInfo(node.center, node.size, startTriangles, childrens,
+                                                             0u, nullArray,
+                                                             node.verticesValues, node.verticesInfo,
+                                                             mesh, trianglesData);
+                    evaluateNode(std::move(node), startTriangles);
+                }
+            }
+        }
+    }
+
+    auto exceedsBudget = [&](uint64_t nodes, uint64_t leaves)
+    {
+        return (budget.maxNodes > 0 && nodes > budget.maxNodes) ||
+               (budget.maxBytes > 0 && nodes * nodeBytes + leaves * (leafBytes - nodeBytes) > budget.maxBytes);
+    };
+
+    if(exceedsBudget(numNodes, numLeaves))
+    {
+        SPDLOG_ERROR("The start grid of depth {} does not fit in the budget, it uses {} nodes and {} bytes",
+                     startDepth, numNodes, numNodes * nodeBytes + numLeaves * (leafBytes - nodeBytes));
+    }
+
+    // Subdivide the leaves with the highest error until the budget is exhausted
+    std::string stopReason = "error below the threshold";
+    while(!queue.empty())
+    {
+        if((budget.stopRequested && budget.stopRequested()) ||
+           (progress != nullptr && progress->isCancelled()))
+        {
+            stopReason = "interruption";
+            break;
+        }
+
+        // All the subdivisions add 8 nodes and 7 leaves
+        if(exceedsBudget(numNodes + 8, numLeaves + 7))
+        {
+            stopReason = "budget";
+            break;
+        }
+
+        const uint32_t candidateIndex = queue.top().second;
+        queue.pop();
+        NodeInfo node = std::move(candidates[candidateIndex]);
+        freeCandidates.push_back(candidateIndex);
+        candidatesTrianglesBytes -= MemoryUsage::getBytes(node.triangles);
+
+        const uint32_t childIndex = tree.size();
+        freeCoefficients.push_back(tree[node.nodeIndex].getChildrenIndex());
+        tree[node.nodeIndex].setValues(false, childIndex);
+        tree.resize(tree.size() + 8);
+        numLeaves--;
+        if(progress != nullptr) progress->addEstimatedNodes(node.depth + 1, 8);
+
+        const float newSize = 0.5f * node.size;
+        for(uint32_t c=0; c < 8; c++)
+        {
+            const glm::ivec3 childPos((c & 1), (c >> 1) & 1, (c >> 2) & 1);
+
+            NodeInfo child;
+            child.nodeIndex = childIndex + c;
+            child.depth = node.depth + 1;
+            child.center = node.center + (2.0f * glm::vec3(childPos) - 1.0f) * newSize;
+            child.size = newSize;
+
+            for(uint32_t v=0; v < 8; v++)
+            {
+                const glm::ivec3 p = childPos + glm::ivec3((v & 1), (v >> 1) & 1, (v >> 2) & 1);
+                const uint32_t sample = latticeSamples[9 * p.z + 3 * p.y + p.x];
+                if(sample < 19)
+                {
+                    child.verticesValues[v] = node.midPointsValues[sample];
+                    child.verticesInfo[v] = node.pointsInfo[sample];
+                }
+                else
+                {
+                    child.verticesValues[v] = node.verticesValues[sample - 19];
+                    child.verticesInfo[v] = node.verticesInfo[sample - 19];
+                }
+            }
+
+            evaluateNode(std::move(child), node.triangles);
+        }
+    }
+
+    const float maxRemainingError = (queue.empty()) ? 0.0f : queue.top().first;
+    subdivisionScope.addArg("coefficients_fitting_s", fittingTime.getSeconds());
+    subdivisionScope.addArg("termination_test_s", terminationTime.getSeconds());
+    subdivisionScope.stop();
+
+    // Copy the tree to the final array with the same layout than the other builders
+    ScopedTimer compactScope("Compact octree");
+    const uint32_t numStartNodes = mStartGridXY * mStartGridSize.z;
+    mOctreeData.clear();
+    mOctreeData.reserve(numNodes + numLeaves * InterpolationMethod::NUM_COEFFICIENTS);
+    mOctreeData.resize(numStartNodes);
+
+    std::function<void(uint32_t, uint32_t)> copyNode;
+    copyNode = [&](uint32_t oldIndex, uint32_t newIndex)
+    {
+        const OctreeNode node = tree[oldIndex];
+        if(node.isLeaf())
+        {
+            const uint32_t coeffIndex = mOctreeData.size();
+            mOctreeData.resize(coeffIndex + InterpolationMethod::NUM_COEFFICIENTS);
+            std::memcpy(&mOctreeData[coeffIndex], leavesCoefficients[node.getChildrenIndex()].data(), InterpolationMethod::NUM_COEFFICIENTS * sizeof(float));
+            mOctreeData[newIndex].setValues(true, coeffIndex);
+        }
+        else
+        {
+            const uint32_t childIndex = mOctreeData.size();
+            mOctreeData.resize(childIndex + 8);
+            mOctreeData[newIndex].setValues(false, childIndex);
+            for(uint32_t i=0; i < 8; i++)
+            {
+                copyNode(node.getChildrenIndex() + i, childIndex + i);
+            }
+        }
+    };
+
+    for(uint32_t i=0; i < numStartNodes; i++)
+    {
+        copyNode(i, i);
+    }
+    compactScope.stop();
+
+    mValueRange = valueRange;
+    // The temporal tree arrays only grow, so they coexist at their final size with the compacted octree
+    mConstructionPeakMemory = MemoryUsage::getBytes(trianglesData) + MemoryUsage::getBytes(mOctreeData) +
+                              MemoryUsage::getBytes(tree) + MemoryUsage::getBytes(leavesCoefficients) +
+                              MemoryUsage::getBytes(freeCoefficients) + MemoryUsage::getBytes(freeCandidates) +
+                              candidatesPeakMemory;
+
+    SPDLOG_INFO("Best-first construction stopped by {}, {} nodes, {} leaves, {} bytes, maximum remaining weighted error {}",
+                stopReason, numNodes, numLeaves, MemoryUsage::getBytes(mOctreeData), maxRemainingError);
+}
+}
+
+#endif
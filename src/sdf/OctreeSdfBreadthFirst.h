@@ -63,7 +63,7 @@ inline void getNeighboursVector(uint32_t outChildId, uint32_t childId, uint32_t
     }
 }
 
-inline void getNeighboursVectorInUniformGrid(uint32_t outChildId, glm::ivec3 currentPos, uint32_t gridSize, std::array<uint32_t, 6>& outNeighbours)
+inline void getNeighboursVectorInUniformGrid(uint32_t outChildId, glm::ivec3 currentPos, glm::ivec3 gridSize, std::array<uint32_t, 6>& outNeighbours)
 {
     for(uint32_t n=1; n <= 6; n++)
     {
@@ -75,11 +75,11 @@ inline void getNeighboursVectorInUniformGrid(uint32_t outChildId, glm::ivec3 cur
                     (n & 0b0100) ? ((outChildId & 0b0100) ? 1 : -1) : 0
                 );
 
-        if(nPos.x >= 0 && nPos.x < gridSize &&
-           nPos.y >= 0 && nPos.y < gridSize &&
-           nPos.z >= 0 && nPos.z < gridSize)
+        if(nPos.x >= 0 && nPos.x < gridSize.x &&
+           nPos.y >= 0 && nPos.y < gridSize.y &&
+           nPos.z >= 0 && nPos.z < gridSize.z)
         {
-            outNeighbours[n - 1] = nPos.z * gridSize * gridSize + nPos.y * gridSize + nPos.x;
+            outNeighbours[n - 1] = nPos.z * gridSize.x * gridSize.y + nPos.y * gridSize.x + nPos.x;
         }
         else
         {
@@ -191,17 +191,14 @@ void OctreeSdf::initOctreeWithContinuity(const Mesh& mesh, uint32_t startDepth,
     }
 
     TrianglesInfluenceStrategy trianglesInfluence;
-    trianglesInfluence.initCaches(mBox, maxDepth);
+    trianglesInfluence.initCaches(getStartGridCube(), maxDepth);
 
     // Create the grid
-    {
-        const uint32_t voxlesPerAxis = 1 << startDepth;
-        mOctreeData.resize(voxlesPerAxis * voxlesPerAxis * voxlesPerAxis);
-    }
+    mOctreeData.resize(mStartGridXY * mStartGridSize.z);
 
     // Create first start nodes
     {        
-        float newSize = 0.5f * mBox.getSize().x * glm::pow(0.5f, startOctreeDepth);
+        float newSize = 0.5f * getStartGridCube().getSize().x * glm::pow(0.5f, startOctreeDepth);
         const glm::vec3 startCenter = mBox.min + newSize;
         const uint32_t voxelsPerAxis = 1 << startOctreeDepth;
 
@@ -213,6 +210,7 @@ void OctreeSdf::initOctreeWithContinuity(const Mesh& mesh, uint32_t startDepth,
             {
                 for(uint32_t i=0; i < voxelsPerAxis; i++)
                 {
+                    if(isOutsideStartGrid(startCenter + glm::vec3(i, j, k) * 2.0f * newSize, newSize)) continue;
                     nodes.push_back(NodeInfo(std::numeric_limits<uint32_t>::max(), 0, startCenter + glm::vec3(i, j, k) * 2.0f * newSize, newSize));
                     NodeInfo& n = nodes.back();
                     n.parentTriangles = &startTriangles;
@@ -235,6 +233,7 @@ void OctreeSdf::initOctreeWithContinuity(const Mesh& mesh, uint32_t startDepth,
 
     std::vector<float> elapsedTime(maxDepth);
     std::vector<uint32_t> numTrianglesEvaluated(maxDepth, 0);
+    size_t buffersPeakMemory = 0; // The nodes buffers are recycled at each depth
     Timer timer;
 
     for(uint32_t currentDepth=startOctreeDepth; currentDepth <= maxDepth; currentDepth++)
@@ -242,6 +241,7 @@ void OctreeSdf::initOctreeWithContinuity(const Mesh& mesh, uint32_t startDepth,
         // Iter 1
         for(NodeInfo& node : nodesBuffer[currentBuffer])
         {
+            if(currentDepth <= startDepth && isOutsideStartGrid(node.center, node.size)) continue;
             OctreeNode* octreeNode = (currentDepth > startDepth) 
                                         ? &mOctreeData[node.parentChildrenIndex + node.childIndex]
                                         : nullptr;
@@ -322,8 +322,8 @@ void OctreeSdf::initOctreeWithContinuity(const Mesh& mesh, uint32_t startDepth,
                 {
                     nodeStartGridPos = glm::floor((node.center - mBox.min) / mStartGridCellSize);
                     const uint32_t nodeStartIndex = 
-                                        nodeStartGridPos.z * mStartGridSize * mStartGridSize + 
-                                        nodeStartGridPos.y * mStartGridSize + 
+                                        nodeStartGridPos.z * mStartGridXY + 
+                                        nodeStartGridPos.y * mStartGridSize.x + 
                                         nodeStartGridPos.x;
                     octreeNode = &mOctreeData[nodeStartIndex];
                 }
@@ -503,11 +503,25 @@ void OctreeSdf::initOctreeWithContinuity(const Mesh& mesh, uint32_t startDepth,
             }
         }
 
+        size_t buffersMemory = 0;
+        for(const std::vector<NodeInfo>& nodes : nodesBuffer)
+        {
+            buffersMemory += MemoryUsage::getBytes(nodes);
+            for(const NodeInfo& node : nodes)
+            {
+                buffersMemory += MemoryUsage::getBytes(node.triangles);
+            }
+        }
+        buffersPeakMemory = glm::max(buffersPeakMemory, buffersMemory);
+
         // Swap buffers
         currentBuffer = (currentBuffer + 1) % 3;
         nextBuffer = (nextBuffer + 1) % 3;
         nodesBuffer[nextBuffer].clear();
     }
+
+    mConstructionPeakMemory = MemoryUsage::getBytes(trianglesData) + MemoryUsage::getBytes(startTriangles) +
+                              MemoryUsage::getBytes(mOctreeData) + buffersPeakMemory;
 }
 }
 
@@ -3,6 +3,7 @@
 
 #include "SdfLib/OctreeSdf.h"
 #include "SdfLib/utils/Timer.h"
+#include "SdfLib/utils/BuildProgress.h"
 #include "SdfLib/utils/GJK.h"
 #include "SdfLib/OctreeSdfUtils.h"
 #include <array>
@@ -83,16 +84,23 @@ struct BreadthFirstNoDelayNodeInfo
 template<typename TrianglesInfluenceStrategy>
 void OctreeSdf::initOctreeWithContinuityNoDelay(const Mesh& mesh, uint32_t startDepth, uint32_t maxDepth,
                               float terminationThreshold, OctreeSdf::TerminationRule terminationRule,
-                              uint32_t numThreads)
+                              uint32_t numThreads,
+                              const TrianglesInfluenceStrategy& trianglesInfluencePrototype)
 {
     typedef typename TrianglesInfluenceStrategy::InterpolationMethod InterpolationMethod;
     typedef BreadthFirstNoDelayNodeInfo<typename TrianglesInfluenceStrategy::VertexInfo, InterpolationMethod::VALUES_PER_VERTEX, InterpolationMethod::NUM_COEFFICIENTS> NodeInfo;
 
     // terminationThreshold = terminationThreshold * glm::length(mesh.getBoundingBox().getSize());
     // const float sqTerminationThreshold = terminationThreshold * terminationThreshold * glm::length(mesh.getBoundingBox().getSize());
-    terminationThreshold *= glm::length(mesh.getBoundingBox().getSize());
+    const float thresholdScale = glm::length(mesh.getBoundingBox().getSize());
+    terminationThreshold *= thresholdScale;
     const float sqTerminationThreshold = terminationThreshold * terminationThreshold;
 
+    // The given depth only applies outside the refinement regions, the buffers are sized for the deepest region
+    const uint32_t defaultMaxDepth = maxDepth;
+    maxDepth = getRefinementMaxDepth(maxDepth);
+
+    ScopedTimer trianglesDataScope("Triangles data setup");
     std::vector<TriangleUtils::TriangleData> trianglesData(TriangleUtils::calculateMeshTriangleData(mesh));
     
     const uint32_t startOctreeDepth = glm::min(startDepth, START_OCTREE_DEPTH);
@@ -187,18 +195,16 @@ void OctreeSdf::initOctreeWithContinuityNoDelay(const Mesh& mesh, uint32_t start
         startTriangles[i] = i;
     }
 
-    TrianglesInfluenceStrategy trianglesInfluence;
-    trianglesInfluence.initCaches(mBox, maxDepth);
+    TrianglesInfluenceStrategy trianglesInfluence(trianglesInfluencePrototype);
+    trianglesInfluence.initCaches(getStartGridCube(), maxDepth);
+    trianglesDataScope.stop();
 
     // Create the grid
-    {
-        const uint32_t voxlesPerAxis = 1 << startDepth;
-        mOctreeData.resize(voxlesPerAxis * voxlesPerAxis * voxlesPerAxis);
-    }
+    mOctreeData.resize(mStartGridXY * mStartGridSize.z);
 
     // Create first start nodes
     {
-        float newSize = 0.5f * mBox.getSize().x * glm::pow(0.5f, startOctreeDepth);
+        float newSize = 0.5f * getStartGridCube().getSize().x * glm::pow(0.5f, startOctreeDepth);
         const glm::vec3 startCenter = mBox.min + newSize;
         const uint32_t voxelsPerAxis = 1 << startOctreeDepth;
 
@@ -210,6 +216,7 @@ void OctreeSdf::initOctreeWithContinuityNoDelay(const Mesh& mesh, uint32_t start
             {
                 for(uint32_t i=0; i < voxelsPerAxis; i++)
                 {
+                    if(isOutsideStartGrid(startCenter + glm::vec3(i, j, k) * 2.0f * newSize, newSize)) continue;
                     nodes.push_back(NodeInfo(std::numeric_limits<uint32_t>::max(), 0, startCenter + glm::vec3(i, j, k) * 2.0f * newSize, newSize));
                     NodeInfo& n = nodes.back();
                     n.parentTriangles = &startTriangles;
@@ -236,6 +243,7 @@ void OctreeSdf::initOctreeWithContinuityNoDelay(const Mesh& mesh, uint32_t start
     std::vector<float> elapsedTime(maxDepth);
     std::vector<uint32_t> numTrianglesEvaluated(maxDepth, 0);
     std::vector<NodeInfo> nodesCache;
+    size_t nodesCachePeakMemory = 0; // The nodes cache is cleared for each subdivided leaf
     Timer timer;
     float iter1TotalTime = 0.0f;
     float iter2TotalTime = 0.0f;
@@ -251,17 +259,32 @@ void OctreeSdf::initOctreeWithContinuityNoDelay(const Mesh& mesh, uint32_t start
 
     std::vector<TrianglesInfluenceStrategy> threadTrianglesInfluence(numThreads, trianglesInfluence);
 
+    BuildProgress* progress = BuildProgress::getCurrent();
+
     for(uint32_t currentDepth=startOctreeDepth; currentDepth <= maxDepth; currentDepth++)
     {
+        ScopedTimer depthScope("Depth");
+        depthScope.addArg("depth", static_cast<double>(currentDepth));
+        depthScope.addArg("nodes", static_cast<double>(nodesBuffer[currentDepth].size()));
+        if(progress != nullptr) progress->addEstimatedNodes(currentDepth, nodesBuffer[currentDepth].size());
+
+        // The nodes beyond an anisotropic start grid are not evaluated
+        if(currentDepth <= startDepth)
+        {
+            for(NodeInfo& node : nodesBuffer[currentDepth])
+            {
+                if(isOutsideStartGrid(node.center, node.size)) node.ignoreNode = true;
+            }
+        }
+
         // Iter 1
         timer.start();
         if(currentDepth < maxDepth)
         {
             const auto nodesBufferSize = nodesBuffer[currentDepth].size();
             #ifdef OPENMP_AVAILABLE
-            #pragma omp parallel for default(shared) schedule(dynamic, 16)
+            #pragma omp parallel default(shared)
             #endif
-            for(uint32_t nId=0; nId < nodesBufferSize; nId++)
             {
                 #ifdef OPENMP_AVAILABLE
                 const uint32_t tId = omp_get_thread_num();
@@ -269,108 +292,146 @@ void OctreeSdf::initOctreeWithContinuityNoDelay(const Mesh& mesh, uint32_t start
                 const uint32_t tId = 0;
                 #endif
 
-                NodeInfo& node = nodesBuffer[currentDepth][nId];
-                if(node.ignoreNode) continue;
+                // Each thread reports the time spent in each step of the nodes evaluation
+                ScopedTimer evaluationScope("Nodes evaluation");
+                AccumulatedTimer filteringTime;
+                AccumulatedTimer fittingTime;
+                AccumulatedTimer terminationTime;
+                uint32_t numNodesEvaluated = 0;
 
-                OctreeNode* octreeNode = (currentDepth > startDepth) 
-                                        ? &mOctreeData[node.parentChildrenIndex + (node.childIndices & 0b0111)]
-                                        : nullptr;
-
-                if(currentDepth == startDepth)
+                #ifdef OPENMP_AVAILABLE
+                #pragma omp for schedule(dynamic, 16)
+                #endif
+                for(uint32_t nId=0; nId < nodesBufferSize; nId++)
                 {
-                    glm::ivec3 nodeStartGridPos = glm::floor((node.center - mBox.min) / mStartGridCellSize);
-                    const uint32_t nodeStartIndex = 
-                                        nodeStartGridPos.z * mStartGridSize * mStartGridSize + 
-                                        nodeStartGridPos.y * mStartGridSize + 
-                                        nodeStartGridPos.x;
-                    octreeNode = &mOctreeData[nodeStartIndex];
-                }
+                    NodeInfo& node = nodesBuffer[currentDepth][nId];
+                    if(progress != nullptr) progress->addProcessedNodes(currentDepth);
+                    if(node.ignoreNode) continue;
 
-                threadTrianglesInfluence[tId].filterTriangles(node.center, node.size, *node.parentTriangles, 
-                                                   node.triangles, node.verticesValues, node.verticesInfo,
-                                                   mesh, trianglesData);
+                    OctreeNode* octreeNode = (currentDepth > startDepth) 
+                                            ? &mOctreeData[node.parentChildrenIndex + (node.childIndices & 0b0111)]
+                                            : nullptr;
 
-                // Get current neighbours
-                if(currentDepth > startDepth)
-                {
-                    for(uint8_t neighbour = 1; neighbour <= 6; neighbour++)
+                    if(currentDepth == startDepth)
                     {
-                        if((((node.neighbourIndices[neighbour - 1]) >> 30) & 0b01) == 0) // Calculate next neigbour
+                        glm::ivec3 nodeStartGridPos = glm::floor((node.center - mBox.min) / mStartGridCellSize);
+                        const uint32_t nodeStartIndex = 
+                                            nodeStartGridPos.z * mStartGridXY + 
+                                            nodeStartGridPos.y * mStartGridSize.x + 
+                                            nodeStartGridPos.x;
+                        octreeNode = &mOctreeData[nodeStartIndex];
+                    }
+
+                    numNodesEvaluated++;
+                    filteringTime.start();
+                    threadTrianglesInfluence[tId].filterTriangles(node.center, node.size, *node.parentTriangles, 
+                                                       node.triangles, node.verticesValues, node.verticesInfo,
+                                                       mesh, trianglesData);
+                    filteringTime.stop();
+
+                    // Get current neighbours
+                    if(currentDepth > startDepth)
+                    {
+                        for(uint8_t neighbour = 1; neighbour <= 6; neighbour++)
                         {
-                            if (mOctreeData[node.neighbourIndices[neighbour - 1] & (~(1 << 31))].isLeaf())
+                            if((((node.neighbourIndices[neighbour - 1]) >> 30) & 0b01) == 0) // Calculate next neigbour
                             {
-                                node.neighbourIndices[neighbour - 1] = (1 << 31) | node.neighbourIndices[neighbour - 1];
-                            }
-                            else
-                            {
-                                node.neighbourIndices[neighbour - 1] = mOctreeData[node.neighbourIndices[neighbour - 1] & (~(1 << 31))].getChildrenIndex();
-                                node.neighbourDepth[neighbour - 1]++;
-
-                                while (node.neighbourDepth[neighbour - 1] < currentDepth)
+                                if (mOctreeData[node.neighbourIndices[neighbour - 1] & (~(1 << 31))].isLeaf())
                                 {
-                                    const uint32_t depthDiff = currentDepth - node.neighbourDepth[neighbour - 1];
-                                    const uint32_t childId = (node.childIndices >> (3 * depthDiff)) & 0b0111;
-                                    node.neighbourIndices[neighbour - 1] += (neighbour ^ childId);
+                                    node.neighbourIndices[neighbour - 1] = (1 << 31) | node.neighbourIndices[neighbour - 1];
+                                }
+                                else
+                                {
+                                    node.neighbourIndices[neighbour - 1] = mOctreeData[node.neighbourIndices[neighbour - 1] & (~(1 << 31))].getChildrenIndex();
+                                    node.neighbourDepth[neighbour - 1]++;
 
-                                    if (mOctreeData[node.neighbourIndices[neighbour - 1] & (~(1 << 31))].isLeaf())
+                                    while (node.neighbourDepth[neighbour - 1] < currentDepth)
                                     {
-                                        node.neighbourIndices[neighbour - 1] = (1 << 31) | node.neighbourIndices[neighbour - 1];
-                                        break;
-                                    }
-                                    else
-                                    {
-                                        node.neighbourIndices[neighbour - 1] = mOctreeData[node.neighbourIndices[neighbour - 1] & (~(1 << 31))].getChildrenIndex();
-                                        node.neighbourDepth[neighbour - 1]++;
+                                        const uint32_t depthDiff = currentDepth - node.neighbourDepth[neighbour - 1];
+                                        const uint32_t childId = (node.childIndices >> (3 * depthDiff)) & 0b0111;
+                                        node.neighbourIndices[neighbour - 1] += (neighbour ^ childId);
+
+                                        if (mOctreeData[node.neighbourIndices[neighbour - 1] & (~(1 << 31))].isLeaf())
+                                        {
+                                            node.neighbourIndices[neighbour - 1] = (1 << 31) | node.neighbourIndices[neighbour - 1];
+                                            break;
+                                        }
+                                        else
+                                        {
+                                            node.neighbourIndices[neighbour - 1] = mOctreeData[node.neighbourIndices[neighbour - 1] & (~(1 << 31))].getChildrenIndex();
+                                            node.neighbourDepth[neighbour - 1]++;
+                                        }
                                     }
                                 }
                             }
                         }
                     }
-                }
 
-                if(currentDepth >= startDepth)
-                {
-                    InterpolationMethod::calculateCoefficients(node.verticesValues, 2.0f * node.size, node.triangles, mesh, trianglesData, node.interpolationCoeff);
-                }
+                    fittingTime.start();
+                    if(currentDepth >= startDepth)
+                    {
+                        InterpolationMethod::calculateCoefficients(node.verticesValues, 2.0f * node.size, node.triangles, mesh, trianglesData, node.interpolationCoeff);
+                    }
+                    fittingTime.stop();
                 
-                threadTrianglesInfluence[tId].calculateVerticesInfo(node.center, node.size, node.triangles, nodeSamplePoints,
-                                                                    0u, node.interpolationCoeff,
-                                                                    node.midPointsValues, node.midPointsInfo,
-                                                                    mesh, trianglesData);
-
-                bool generateTerminalNodes = false;
-                if(currentDepth >= startDepth)
-                {
-                    float value;
-                    switch(terminationRule)
+                    // The samples in the middle points are used to estimate the node error
+                    terminationTime.start();
+                    threadTrianglesInfluence[tId].calculateVerticesInfo(node.center, node.size, node.triangles, nodeSamplePoints,
+                                                                        0u, node.interpolationCoeff,
+                                                                        node.midPointsValues, node.midPointsInfo,
+                                                                        mesh, trianglesData);
+
+                    bool generateTerminalNodes = false;
+                    if(currentDepth >= startDepth)
                     {
-                        case TerminationRule::TRAPEZOIDAL_RULE:
-                            {
-                            // float value1 = estimateFaceErrorFunctionIntegralByTrapezoidRule<InterpolationMethod>(node.interpolationCoeff, node.midPointsValues);
-                            // float value2 = estimateErrorFunctionIntegralByTrapezoidRule<InterpolationMethod>(node.interpolationCoeff, node.midPointsValues);
-                            // generateTerminalNodes = value1 < sqTerminationThreshold && value2 < sqTerminationThreshold;
-                            value = estimateErrorFunctionIntegralByTrapezoidRule<InterpolationMethod>(node.interpolationCoeff, node.midPointsValues);
-                            generateTerminalNodes = value < sqTerminationThreshold;
-                            }
-                            break;
-                        case TerminationRule::SIMPSONS_RULE:
-                            value = estimateErrorFunctionIntegralBySimpsonsRule<InterpolationMethod>(node.interpolationCoeff, node.midPointsValues);
-                            generateTerminalNodes = value < sqTerminationThreshold;
-                            break;
-                        case TerminationRule::NONE:
-                            value = INFINITY;
-                            break;
+                        uint32_t nodeMaxDepth = defaultMaxDepth;
+                        float nodeSqTerminationThreshold = sqTerminationThreshold;
+                        getNodeRefinement(node.center, node.size, thresholdScale, nodeMaxDepth, nodeSqTerminationThreshold);
+
+                        float value;
+                        switch(terminationRule)
+                        {
+                            case TerminationRule::TRAPEZOIDAL_RULE:
+                                {
+                                // float value1 = estimateFaceErrorFunctionIntegralByTrapezoidRule<InterpolationMethod>(node.interpolationCoeff, node.midPointsValues);
+                                // float value2 = estimateErrorFunctionIntegralByTrapezoidRule<InterpolationMethod>(node.interpolationCoeff, node.midPointsValues);
+                                // generateTerminalNodes = value1 < sqTerminationThreshold && value2 < sqTerminationThreshold;
+                                value = estimateErrorFunctionIntegralByTrapezoidRule<InterpolationMethod>(node.interpolationCoeff, node.midPointsValues);
+                                generateTerminalNodes = value < nodeSqTerminationThreshold;
+                                }
+                                break;
+                            case TerminationRule::SIMPSONS_RULE:
+                                value = estimateErrorFunctionIntegralBySimpsonsRule<InterpolationMethod>(node.interpolationCoeff, node.midPointsValues);
+                                generateTerminalNodes = value < nodeSqTerminationThreshold;
+                                break;
+                            case TerminationRule::NONE:
+                                value = INFINITY;
+                                break;
+                        }
+
+                        // A cancelled construction ends the branches at the current depth,
+                        // and the nodes outside the narrow band or at the depth of their region are not refined
+                        generateTerminalNodes = generateTerminalNodes || (progress != nullptr && progress->isCancelled()) ||
+                                                isOutsideNarrowBand(node.verticesValues, node.size, mNarrowBand) ||
+                                                currentDepth >= nodeMaxDepth;
                     }
+                    terminationTime.stop();
+
+                    node.isTerminalNode = generateTerminalNodes;
+                    if(octreeNode != nullptr) octreeNode->setValues(generateTerminalNodes, std::numeric_limits<uint32_t>::max());
                 }
 
-                node.isTerminalNode = generateTerminalNodes;
-                if(octreeNode != nullptr) octreeNode->setValues(generateTerminalNodes, std::numeric_limits<uint32_t>::max());
+                evaluationScope.addArg("nodes", static_cast<double>(numNodesEvaluated));
+                evaluationScope.addArg("triangles_filtering_s", filteringTime.getSeconds());
+                evaluationScope.addArg("coefficients_fitting_s", fittingTime.getSeconds());
+                evaluationScope.addArg("termination_test_s", terminationTime.getSeconds());
             }
         }
         iter1TotalTime += timer.getElapsedSeconds();
 
         // Iter 2
         timer.start();
+        ScopedTimer subdivisionScope("Subdivision");
         nodesToSubdivide.clear();
         for(uint32_t nId=0; nId < nodesBuffer[currentDepth].size(); nId++)
         {
@@ -388,8 +449,8 @@ void OctreeSdf::initOctreeWithContinuityNoDelay(const Mesh& mesh, uint32_t start
             {
                 nodeStartGridPos = glm::floor((node.center - mBox.min) / mStartGridCellSize);
                 const uint32_t nodeStartIndex = 
-                                    nodeStartGridPos.z * mStartGridSize * mStartGridSize + 
-                                    nodeStartGridPos.y * mStartGridSize + 
+                                    nodeStartGridPos.z * mStartGridXY + 
+                                    nodeStartGridPos.y * mStartGridSize.x + 
                                     nodeStartGridPos.x;
                 octreeNodeIndex = nodeStartIndex;
             }
@@ -439,16 +500,16 @@ void OctreeSdf::initOctreeWithContinuityNoDelay(const Mesh& mesh, uint32_t start
                 }
                 else if(currentDepth == startDepth)
                 {
-                    const int gridSize = mStartGridSize;
+                    const glm::ivec3 gridSize = mStartGridSize;
                     auto getNeighbourMask = [&](glm::ivec3 nPos, uint8_t dir, uint8_t sign) -> uint32_t
                     {
-                        if (nPos.x >= 0 && nPos.x < gridSize &&
-                            nPos.y >= 0 && nPos.y < gridSize &&
-                            nPos.z >= 0 && nPos.z < gridSize)
+                        if (nPos.x >= 0 && nPos.x < gridSize.x &&
+                            nPos.y >= 0 && nPos.y < gridSize.y &&
+                            nPos.z >= 0 && nPos.z < gridSize.z)
                         {
-                            if(octreeData[nPos.z * gridSize * gridSize + nPos.y * gridSize + nPos.x].isLeaf())
+                            if(octreeData[nPos.z * gridSize.x * gridSize.y + nPos.y * gridSize.x + nPos.x].isLeaf())
                             {
-                                neighbourIds[4 * (dir - 1) + sign] = nPos.z * gridSize * gridSize + nPos.y * gridSize + nPos.x;
+                                neighbourIds[4 * (dir - 1) + sign] = nPos.z * gridSize.x * gridSize.y + nPos.y * gridSize.x + nPos.x;
                                 return neigbourMasks[4 * (dir - 1) + sign];
                             }
                             return 0;
@@ -483,6 +544,10 @@ void OctreeSdf::initOctreeWithContinuityNoDelay(const Mesh& mesh, uint32_t start
 
                 // Change distance if required
                 {
+                    uint32_t nodeMaxDepth = defaultMaxDepth;
+                    float nodeSqTerminationThreshold = sqTerminationThreshold;
+                    getNodeRefinement(node.center, node.size, thresholdScale, nodeMaxDepth, nodeSqTerminationThreshold);
+
                     uint32_t subdivisionMask = 0; // Calculate which sample points cannot be interpolated
                     for(uint32_t i=0; i < 19; i++)
                     {
@@ -491,7 +556,7 @@ void OctreeSdf::initOctreeWithContinuityNoDelay(const Mesh& mesh, uint32_t start
                             // InterpolationMethod::interpolateVertexValues(node.interpolationCoeff, 0.5f * nodeSamplePoints[i] + 0.5f, 2.0f * node.size, node.midPointsValues[i]);
                             const float interValue = InterpolationMethod::interpolateValue(node.interpolationCoeff, 0.5f * nodeSamplePoints[i] + 0.5f);
                             // Test if the node can be interpolated regarding the error
-                            if(pow2(node.midPointsValues[i][0] - interValue) > sqTerminationThreshold)
+                            if(pow2(node.midPointsValues[i][0] - interValue) > nodeSqTerminationThreshold)
                             {
                                 subdivisionMask |= (samplesMask & (1 << (18-i)));
                             }
@@ -734,7 +799,12 @@ void OctreeSdf::initOctreeWithContinuityNoDelay(const Mesh& mesh, uint32_t start
         }
 
         iter2TotalTime += timer.getElapsedSeconds();
+        // The nodes of the last depth are not evaluated, they directly become leaves
+        if(progress != nullptr && currentDepth >= maxDepth) progress->addProcessedNodes(currentDepth, nodesBuffer[currentDepth].size());
+        subdivisionScope.stop();
         timer.start();
+        ScopedTimer afterSubdivisionScope("Continuity subdivision");
+        afterSubdivisionScope.addArg("nodes", static_cast<double>(nodesToSubdivide.size()));
 
         numNodesSubdividedAfterDecision += nodesToSubdivide.size();
 
@@ -759,8 +829,8 @@ void OctreeSdf::initOctreeWithContinuityNoDelay(const Mesh& mesh, uint32_t start
             {
                 glm::ivec3 nodeStartGridPos = glm::floor((parentNode.center - mBox.min) / mStartGridCellSize);
                 const uint32_t nodeStartIndex = 
-                                    nodeStartGridPos.z * mStartGridSize * mStartGridSize + 
-                                    nodeStartGridPos.y * mStartGridSize + 
+                                    nodeStartGridPos.z * mStartGridXY + 
+                                    nodeStartGridPos.y * mStartGridSize.x + 
                                     nodeStartGridPos.x;
                 parentOctreeNode = &mOctreeData[nodeStartIndex];
             }
@@ -783,8 +853,8 @@ void OctreeSdf::initOctreeWithContinuityNoDelay(const Mesh& mesh, uint32_t start
                 {
                     nodeStartGridPos = glm::floor((node.center - mBox.min) / mStartGridCellSize);
                     const uint32_t nodeStartIndex = 
-                                        nodeStartGridPos.z * mStartGridSize * mStartGridSize + 
-                                        nodeStartGridPos.y * mStartGridSize + 
+                                        nodeStartGridPos.z * mStartGridXY + 
+                                        nodeStartGridPos.y * mStartGridSize.x + 
                                         nodeStartGridPos.x;
                     octreeNode = &mOctreeData[nodeStartIndex];
                 }
@@ -872,15 +942,15 @@ void OctreeSdf::initOctreeWithContinuityNoDelay(const Mesh& mesh, uint32_t start
                     }
                     else if(depth == startDepth)
                     {
-                        const int gridSize = mStartGridSize;
+                        const glm::ivec3 gridSize = mStartGridSize;
                         auto updateNeighbourMask = [&](glm::ivec3 nPos, uint8_t dir, uint8_t sign)
                         {
-                            if (nPos.x >= 0 && nPos.x < gridSize &&
-                                nPos.y >= 0 && nPos.y < gridSize &&
-                                nPos.z >= 0 && nPos.z < gridSize)
+                            if (nPos.x >= 0 && nPos.x < gridSize.x &&
+                                nPos.y >= 0 && nPos.y < gridSize.y &&
+                                nPos.z >= 0 && nPos.z < gridSize.z)
                             {
-                                subdividedMask |= (mOctreeData[nPos.z * gridSize * gridSize + nPos.y * gridSize + nPos.x].isLeaf() ||
-                                                   mOctreeData[nPos.z * gridSize * gridSize + nPos.y * gridSize + nPos.x].isMarked())
+                                subdividedMask |= (mOctreeData[nPos.z * gridSize.x * gridSize.y + nPos.y * gridSize.x + nPos.x].isLeaf() ||
+                                                   mOctreeData[nPos.z * gridSize.x * gridSize.y + nPos.y * gridSize.x + nPos.x].isMarked())
                                                     ? 0 : neigbourMasks[4 * (dir - 1) + sign];
                             }
                         };
@@ -1177,6 +1247,13 @@ void OctreeSdf::initOctreeWithContinuityNoDelay(const Mesh& mesh, uint32_t start
 
                 firstIteration = false;
             }
+
+            size_t nodesCacheMemory = MemoryUsage::getBytes(nodesCache);
+            for(const NodeInfo& node : nodesCache)
+            {
+                nodesCacheMemory += MemoryUsage::getBytes(node.triangles);
+            }
+            nodesCachePeakMemory = glm::max(nodesCachePeakMemory, nodesCacheMemory);
         }
 
         afterSubdivisionTime += timer.getElapsedSeconds();
@@ -1203,18 +1280,36 @@ void OctreeSdf::initOctreeWithContinuityNoDelay(const Mesh& mesh, uint32_t start
         }
     };
 
-    for(uint32_t k=0; k < mStartGridSize; k++)
+    for(uint32_t k=0; k < mStartGridSize.z; k++)
     {
-        for(uint32_t j=0; j < mStartGridSize; j++)
+        for(uint32_t j=0; j < mStartGridSize.y; j++)
         {
-            for(uint32_t i=0; i < mStartGridSize; i++)
+            for(uint32_t i=0; i < mStartGridSize.x; i++)
             {
-                const uint32_t nodeStartIndex = k * mStartGridSize * mStartGridSize + j * mStartGridSize + i;
+                const uint32_t nodeStartIndex = k * mStartGridXY + j * mStartGridSize.x + i;
                 vistNode(mOctreeData[nodeStartIndex]);
             }
         }
     }
 
+    // The per-depth buffers are never released during the construction, so they are at their peak now.
+    // The nodes cache is the only one that shrinks, so its high-water mark is used instead
+    {
+        size_t peakMemory = MemoryUsage::getBytes(trianglesData) + MemoryUsage::getBytes(startTriangles) +
+                            MemoryUsage::getBytes(mOctreeData) + nodesCachePeakMemory +
+                            MemoryUsage::getBytes(nodesToSubdivide) +
+                            leavesData.size() * (sizeof(typename decltype(leavesData)::value_type) + 4 * sizeof(void*));
+        for(const std::vector<NodeInfo>& nodes : nodesBuffer)
+        {
+            peakMemory += MemoryUsage::getBytes(nodes);
+            for(const NodeInfo& node : nodes)
+            {
+                peakMemory += MemoryUsage::getBytes(node.triangles);
+            }
+        }
+        mConstructionPeakMemory = peakMemory;
+    }
+
 #ifdef SDFLIB_PRINT_STATISTICS
     SPDLOG_INFO("Iter 1 {}s // Iter 2 {}s // After {}s // {}", iter1TotalTime, iter2TotalTime, afterSubdivisionTime, iter1TotalTime/(iter2TotalTime + afterSubdivisionTime));
     SPDLOG_INFO("Num nodes subdivided after desicion: {}", numNodesSubdividedAfterDecision);
@@ -3,10 +3,12 @@
 
 #include "SdfLib/OctreeSdf.h"
 #include "SdfLib/utils/Timer.h"
+#include "SdfLib/utils/BuildProgress.h"
 #include "SdfLib/utils/GJK.h"
 #include "SdfLib/OctreeSdfUtils.h"
 #include <array>
 #include <stack>
+#include <string>
 #ifdef OPENMP_AVAILABLE
 #include <omp.h>
 #endif    
@@ -31,15 +33,23 @@ struct DepthFirstNodeInfo
 template<typename TrianglesInfluenceStrategy>
 void OctreeSdf::initOctree(const Mesh& mesh, uint32_t startDepth, uint32_t maxDepth,
                            float terminationThreshold, OctreeSdf::TerminationRule terminationRule,
-                           uint32_t numThreads)
+                           uint32_t numThreads,
+                           const TrianglesInfluenceStrategy& trianglesInfluence)
 {
     typedef typename TrianglesInfluenceStrategy::InterpolationMethod InterpolationMethod;
     typedef DepthFirstNodeInfo<typename TrianglesInfluenceStrategy::VertexInfo, InterpolationMethod::VALUES_PER_VERTEX> NodeInfo;
 
-    terminationThreshold *= glm::length(mesh.getBoundingBox().getSize());
+    const float thresholdScale = glm::length(mesh.getBoundingBox().getSize());
+    terminationThreshold *= thresholdScale;
+
+    // The given depth only applies outside the refinement regions, the buffers are sized for the deepest region
+    const uint32_t defaultMaxDepth = maxDepth;
+    maxDepth = getRefinementMaxDepth(maxDepth);
 
     struct ThreadContext
     {
+        ThreadContext(const TrianglesInfluenceStrategy& trianglesInfluence) : trianglesInfluence(trianglesInfluence) {}
+
         std::vector<std::vector<uint32_t>> triangles;
         TrianglesInfluenceStrategy trianglesInfluence;
         std::stack<NodeInfo> nodesStack;
@@ -48,7 +58,15 @@ void OctreeSdf::initOctree(const Mesh& mesh, uint32_t startDepth, uint32_t maxDe
         uint32_t maxDepth;
         OctreeSdf::TerminationRule terminationRule;
         float sqTerminationThreshold;
+        float thresholdScale;
+        float narrowBand;
         float valueRange;
+        size_t peakMemory; // High-water mark of the thread buffers
+        AccumulatedTimer filteringTime;
+        AccumulatedTimer fittingTime;
+        AccumulatedTimer terminationTime;
+        // The nodes of all the depths are interleaved, so the time of each depth is accumulated instead of a scope
+        std::vector<AccumulatedTimer> depthTime;
         uint32_t padding[16];
 
 #ifdef SDFLIB_PRINT_STATISTICS
@@ -60,18 +78,24 @@ void OctreeSdf::initOctree(const Mesh& mesh, uint32_t startDepth, uint32_t maxDe
 #endif
     };
 
+    ScopedTimer trianglesDataScope("Triangles data setup");
     std::vector<TriangleUtils::TriangleData> trianglesData(TriangleUtils::calculateMeshTriangleData(mesh));
     const uint32_t startOctreeDepth = glm::min(startDepth, START_OCTREE_DEPTH);
+    BuildProgress* progress = BuildProgress::getCurrent();
 
-    ThreadContext mainThread;
+    ThreadContext mainThread(trianglesInfluence);
     mainThread.triangles.resize(maxDepth - startOctreeDepth + 1);
-    mainThread.trianglesInfluence.initCaches(mBox, maxDepth);
+    mainThread.trianglesInfluence.initCaches(getStartGridCube(), maxDepth);
     mainThread.startDepth = startDepth;
     mainThread.startOctreeDepth = startOctreeDepth;
-    mainThread.maxDepth = maxDepth;
+    mainThread.maxDepth = defaultMaxDepth;
     mainThread.terminationRule = terminationRule;
     mainThread.sqTerminationThreshold = terminationThreshold * terminationThreshold;
+    mainThread.thresholdScale = thresholdScale;
+    mainThread.narrowBand = mNarrowBand;
     mainThread.valueRange = 0.0f;
+    mainThread.peakMemory = 0;
+    mainThread.depthTime.resize(maxDepth + 1);
 
     #ifdef SDFLIB_PRINT_STATISTICS
         mainThread.verticesStatistics.resize(maxDepth, std::make_pair(0, 0));
@@ -92,6 +116,7 @@ void OctreeSdf::initOctree(const Mesh& mesh, uint32_t startDepth, uint32_t maxDe
         }
         mainThread.triangles[0].resize(triIndex);
     }
+    trianglesDataScope.stop();
 
     const std::array<glm::vec3, 8> childrens = 
     {
@@ -108,7 +133,7 @@ void OctreeSdf::initOctree(const Mesh& mesh, uint32_t startDepth, uint32_t maxDe
     
     {
         std::stack<NodeInfo>& nodes = mainThread.nodesStack;
-        float newSize = 0.5f * mBox.getSize().x * glm::pow(0.5f, startOctreeDepth);
+        float newSize = 0.5f * getStartGridCube().getSize().x * glm::pow(0.5f, startOctreeDepth);
         const glm::vec3 startCenter = mBox.min + newSize;
         const uint32_t voxlesPerAxis = 1 << startOctreeDepth;
 
@@ -118,6 +143,7 @@ void OctreeSdf::initOctree(const Mesh& mesh, uint32_t startDepth, uint32_t maxDe
             {
                 for(uint32_t i=0; i < voxlesPerAxis; i++)
                 {
+                    if(isOutsideStartGrid(startCenter + glm::vec3(i, j, k) * 2.0f * newSize, newSize)) continue;
                     nodes.push(NodeInfo(std::numeric_limits<uint32_t>::max(), startOctreeDepth, startCenter + glm::vec3(i, j, k) * 2.0f * newSize, newSize));
                     NodeInfo& n = nodes.top();
 					std::array<float, InterpolationMethod::NUM_COEFFICIENTS> nullArray;
@@ -128,9 +154,23 @@ void OctreeSdf::initOctree(const Mesh& mesh, uint32_t startDepth, uint32_t maxDe
                 }
             }
         }
+
+        if(progress != nullptr) progress->addEstimatedNodes(startOctreeDepth, nodes.size());
     }
 
-    auto processNode = [&mesh, &trianglesData] (const NodeInfo& node, ThreadContext& tContext, std::vector<OctreeNode>& outputOctree)
+    // Current size of the thread buffers. The stack and the triangles arrays shrink or are replaced
+    // during the construction, so each thread samples it after growing them to keep its high-water mark
+    auto getContextMemory = [](const ThreadContext& tContext) -> size_t
+    {
+        size_t bytes = tContext.nodesStack.size() * sizeof(NodeInfo);
+        for(const std::vector<uint32_t>& triangles : tContext.triangles)
+        {
+            bytes += MemoryUsage::getBytes(triangles);
+        }
+        return bytes;
+    };
+
+    auto processNode = [this, &mesh, &trianglesData, progress, &getContextMemory] (const NodeInfo& node, ThreadContext& tContext, std::vector<OctreeNode>& outputOctree)
     {
         const std::array<glm::vec3, 19> nodeSamplePoints =
         {
@@ -167,25 +207,43 @@ void OctreeSdf::initOctree(const Mesh& mesh, uint32_t startDepth, uint32_t maxDe
 
         const uint32_t rDepth = node.depth - tContext.startOctreeDepth + 1;
         std::array<float, InterpolationMethod::NUM_COEFFICIENTS> interpolationCoeff;
+        if(progress != nullptr) progress->addProcessedNodes(node.depth);
 
-        if(!node.isTerminalNode && node.depth < tContext.maxDepth)
+        // The nodes outside the narrow band end without evaluating their error
+        const bool isFarNode = node.depth >= tContext.startDepth &&
+                               isOutsideNarrowBand(node.verticesValues, node.size, tContext.narrowBand);
+
+        uint32_t nodeMaxDepth = tContext.maxDepth;
+        float nodeSqTerminationThreshold = tContext.sqTerminationThreshold;
+        getNodeRefinement(node.center, node.size, tContext.thresholdScale, nodeMaxDepth, nodeSqTerminationThreshold);
+
+        if(!node.isTerminalNode && !isFarNode && node.depth < nodeMaxDepth)
         {
+            tContext.filteringTime.start();
             tContext.trianglesInfluence.filterTriangles(node.center, node.size, tContext.triangles[rDepth-1], 
                                                tContext.triangles[rDepth], node.verticesValues, node.verticesInfo,
                                                mesh, trianglesData);
+            tContext.filteringTime.stop();
 
             std::array<std::array<float, InterpolationMethod::VALUES_PER_VERTEX>, 19> midPointsValues;
             std::array<typename TrianglesInfluenceStrategy::VertexInfo, 19> pointsInfo;
 
+            // The samples in the middle points are used to estimate the node error
+            tContext.terminationTime.start();
             tContext.trianglesInfluence.calculateVerticesInfo(node.center, node.size, tContext.triangles[rDepth], nodeSamplePoints,
                                                      0u, interpolationCoeff,
                                                      midPointsValues, pointsInfo,
                                                      mesh, trianglesData);
+            tContext.terminationTime.stop();
             
             bool generateTerminalNodes = false;
             if(node.depth >= tContext.startDepth)
             {
+                tContext.fittingTime.start();
                 InterpolationMethod::calculateCoefficients(node.verticesValues, 2.0f * node.size, tContext.triangles[rDepth], mesh, trianglesData, interpolationCoeff);
+                tContext.fittingTime.stop();
+
+                tContext.terminationTime.start();
                 float value;
                 switch(tContext.terminationRule)
                 {
@@ -200,7 +258,10 @@ void OctreeSdf::initOctree(const Mesh& mesh, uint32_t startDepth, uint32_t maxDe
                         break;
                 }
 
-                generateTerminalNodes = value < tContext.sqTerminationThreshold;
+                // A cancelled construction ends the branches at the current depth
+                generateTerminalNodes = value < nodeSqTerminationThreshold ||
+                                        (progress != nullptr && progress->isCancelled());
+                tContext.terminationTime.stop();
             }
 
 			if(DELAY_NODE_TERMINATION || !generateTerminalNodes) 
@@ -213,6 +274,7 @@ void OctreeSdf::initOctree(const Mesh& mesh, uint32_t startDepth, uint32_t maxDe
 				if(octreeNode != nullptr) octreeNode->setValues(false, childIndex);
 
 				if(node.depth >= tContext.startDepth) outputOctree.resize(outputOctree.size() + 8);
+                if(progress != nullptr) progress->addEstimatedNodes(node.depth + 1, 8);
 
 				// Low Z children
 				tContext.nodesStack.push(NodeInfo(childIndex, node.depth + 1, node.center + glm::vec3(-newSize, -newSize, -newSize), newSize, generateTerminalNodes));
@@ -360,6 +422,7 @@ void OctreeSdf::initOctree(const Mesh& mesh, uint32_t startDepth, uint32_t maxDe
                 tContext.numTrianglesEvaluated[node.depth] += tContext.triangles[rDepth-1].size();
             }
 #endif
+            tContext.peakMemory = glm::max(tContext.peakMemory, getContextMemory(tContext));
         }
         else
         {
@@ -383,29 +446,57 @@ void OctreeSdf::initOctree(const Mesh& mesh, uint32_t startDepth, uint32_t maxDe
         }
     };
 
-    const uint32_t voxlesPerAxis = 1 << startDepth;
+    auto processTimedNode = [&processNode] (const NodeInfo& node, ThreadContext& tContext, std::vector<OctreeNode>& outputOctree)
+    {
+        AccumulatedTimer& depthTime = tContext.depthTime[node.depth];
+        depthTime.start();
+        processNode(node, tContext, outputOctree);
+        depthTime.stop();
+    };
+
+    auto addDepthTimeArgs = [] (ScopedTimer& scope, const ThreadContext& tContext)
+    {
+        for(uint32_t d=0; d < tContext.depthTime.size(); d++)
+        {
+            const double seconds = tContext.depthTime[d].getSeconds();
+            if(seconds > 0.0) scope.addArg(("depth_" + std::to_string(d) + "_s").c_str(), seconds);
+        }
+    };
+
+    const uint32_t numStartNodes = mStartGridXY * mStartGridSize.z;
 #ifdef OPENMP_AVAILABLE
     if(numThreads < 2)
 #endif
     {
+        ScopedTimer subdivisionScope("Subdivision");
+
         // Create the grid
-        mOctreeData.resize(voxlesPerAxis * voxlesPerAxis * voxlesPerAxis);
+        mOctreeData.resize(numStartNodes);
 
         while(!mainThread.nodesStack.empty())
         {
             NodeInfo node = mainThread.nodesStack.top();
             mainThread.nodesStack.pop();
+            if(node.depth <= startDepth && isOutsideStartGrid(node.center, node.size)) continue;
             
             if(node.depth == startDepth)
             {
                 glm::ivec3 startArrayPos = glm::floor((node.center - mBox.min) / mStartGridCellSize);
-                node.nodeIndex = startArrayPos.z * mStartGridXY + startArrayPos.y * mStartGridSize + startArrayPos.x;
+                node.nodeIndex = startArrayPos.z * mStartGridXY + startArrayPos.y * mStartGridSize.x + startArrayPos.x;
             }
 
-            processNode(node, mainThread, mOctreeData);
+            processTimedNode(node, mainThread, mOctreeData);
         }
 
         mValueRange = mainThread.valueRange;
+        // The output octree only grows, so the peak is reached with its final size
+        mConstructionPeakMemory = MemoryUsage::getBytes(trianglesData) + MemoryUsage::getBytes(mOctreeData) +
+                                  mainThread.peakMemory;
+
+        subdivisionScope.addArg("triangles_filtering_s", mainThread.filteringTime.getSeconds());
+        subdivisionScope.addArg("coefficients_fitting_s", mainThread.fittingTime.getSeconds());
+        subdivisionScope.addArg("termination_test_s", mainThread.terminationTime.getSeconds());
+        addDepthTimeArgs(subdivisionScope, mainThread);
     }
 #ifdef OPENMP_AVAILABLE
     else 
@@ -418,7 +509,7 @@ void OctreeSdf::initOctree(const Mesh& mesh, uint32_t startDepth, uint32_t maxDe
             std::vector<OctreeNode> octreeData;
             uint32_t padding[16];
         };
-        std::vector<OctreeDataWithPadding> subOctrees(voxlesPerAxis * voxlesPerAxis * voxlesPerAxis);
+        std::vector<OctreeDataWithPadding> subOctrees(numStartNodes);
 
         omp_set_dynamic(0);
         omp_set_num_threads(numThreads);
@@ -429,12 +520,13 @@ void OctreeSdf::initOctree(const Mesh& mesh, uint32_t startDepth, uint32_t maxDe
         {
             NodeInfo node = mainThread.nodesStack.top();
             mainThread.nodesStack.pop();
+            if(node.depth <= startDepth && isOutsideStartGrid(node.center, node.size)) continue;
             
             if(node.depth == startDepth)
             {
                 glm::ivec3 startArrayPos = glm::floor((node.center - mBox.min) / mStartGridCellSize);
                 node.nodeIndex = 0;
-                std::vector<OctreeNode>* subOctreePtr = &subOctrees[startArrayPos.z * mStartGridXY + startArrayPos.y * mStartGridSize + startArrayPos.x].octreeData;
+                std::vector<OctreeNode>* subOctreePtr = &subOctrees[startArrayPos.z * mStartGridXY + startArrayPos.y * mStartGridSize.x + startArrayPos.x].octreeData;
                 subOctreePtr->resize(1);
                 const uint32_t rDepth = startDepth - mainThread.startOctreeDepth;
                 std::vector<uint32_t> startTriangles = mainThread.triangles[rDepth];
@@ -443,6 +535,11 @@ void OctreeSdf::initOctree(const Mesh& mesh, uint32_t startDepth, uint32_t maxDe
                     std::vector<OctreeNode>& subOctree = *subOctreePtr;
                     const uint32_t tId = omp_get_thread_num();
                     ThreadContext& threadContext = threadsContext[tId];
+                    ScopedTimer subtreeScope("Subtree");
+                    threadContext.filteringTime.reset();
+                    threadContext.fittingTime.reset();
+                    threadContext.terminationTime.reset();
+                    for(AccumulatedTimer& depthTime : threadContext.depthTime) depthTime.reset();
                     threadContext.triangles[rDepth] = std::move(startTriangles);
                     threadContext.nodesStack = std::stack<NodeInfo>(); // Reset stack
                     threadContext.nodesStack.push(node);
@@ -451,18 +548,37 @@ void OctreeSdf::initOctree(const Mesh& mesh, uint32_t startDepth, uint32_t maxDe
                         NodeInfo node1 = threadContext.nodesStack.top();
                         threadContext.nodesStack.pop();
 
-                        processNode(node1, threadContext, subOctree);
+                        processTimedNode(node1, threadContext, subOctree);
                     }
+
+                    subtreeScope.addArg("nodes", static_cast<double>(subOctree.size()));
+                    subtreeScope.addArg("triangles_filtering_s", threadContext.filteringTime.getSeconds());
+                    subtreeScope.addArg("coefficients_fitting_s", threadContext.fittingTime.getSeconds());
+                    subtreeScope.addArg("termination_test_s", threadContext.terminationTime.getSeconds());
+                    addDepthTimeArgs(subtreeScope, threadContext);
                 }
             }
             else
             {
-                processNode(node, mainThread, mOctreeData);
+                processTimedNode(node, mainThread, mOctreeData);
             }
         }
 
+        // Upper bound of the memory used while the threads were subdividing
+        size_t subdivisionPeakMemory = MemoryUsage::getBytes(trianglesData) + MemoryUsage::getBytes(mOctreeData) +
+                                       mainThread.peakMemory;
+        for(const OctreeDataWithPadding& subOctree : subOctrees)
+        {
+            subdivisionPeakMemory += MemoryUsage::getBytes(subOctree.octreeData);
+        }
+        for(const ThreadContext& tCtx : threadsContext)
+        {
+            subdivisionPeakMemory += tCtx.peakMemory;
+        }
+
         // Merge all the subtrees
-        mOctreeData.resize(voxlesPerAxis * voxlesPerAxis * voxlesPerAxis);
+        ScopedTimer mergeScope("Merge subtrees");
+        mOctreeData.resize(numStartNodes);
         for(uint32_t i=0; i < subOctrees.size(); i++)
         {
             std::vector<OctreeNode>& octreeData = subOctrees[i].octreeData;
@@ -494,6 +610,20 @@ void OctreeSdf::initOctree(const Mesh& mesh, uint32_t startDepth, uint32_t maxDe
             // Copy to final array
             mOctreeData.insert(mOctreeData.end(), octreeData.begin()+1, octreeData.end());
         }
+        mergeScope.stop();
+
+        // The subtrees and the final octree coexist at the end of the merge
+        size_t mergePeakMemory = MemoryUsage::getBytes(trianglesData) + MemoryUsage::getBytes(mOctreeData) +
+                                 getContextMemory(mainThread);
+        for(const OctreeDataWithPadding& subOctree : subOctrees)
+        {
+            mergePeakMemory += MemoryUsage::getBytes(subOctree.octreeData);
+        }
+        for(const ThreadContext& tCtx : threadsContext)
+        {
+            mergePeakMemory += getContextMemory(tCtx);
+        }
+        mConstructionPeakMemory = glm::max(subdivisionPeakMemory, mergePeakMemory);
 
         mValueRange = 0.0f;
         for(ThreadContext& tCtx : threadsContext)
@@ -1,5 +1,6 @@
 #include "SdfLib/OctreeSdf.h"
 #include "SdfLib/utils/Timer.h"
+#include "SdfLib/utils/BuildProgress.h"
 #include "SdfLib/utils/GJK.h"
 #include "SdfLib/OctreeSdfUtils.h"
 #include <array>
@@ -29,6 +30,11 @@ void OctreeSdf::initUniformOctree(const Mesh& mesh, uint32_t startDepth, uint32_
     std::vector<TriangleUtils::TriangleData> trianglesData(TriangleUtils::calculateMeshTriangleData(mesh));
 
     const uint32_t startOctreeDepth = glm::min(startDepth, START_OCTREE_DEPTH);
+    BuildProgress* progress = BuildProgress::getCurrent();
+
+    // The given depth only applies outside the refinement regions, the buffers are sized for the deepest region
+    const uint32_t defaultMaxDepth = maxDepth;
+    maxDepth = getRefinementMaxDepth(maxDepth);
 
     const uint32_t numTriangles = trianglesData.size();
     std::vector<std::vector<std::pair<float, uint32_t>>> triangles(maxDepth - START_OCTREE_DEPTH + 1);
@@ -52,14 +58,11 @@ void OctreeSdf::initUniformOctree(const Mesh& mesh, uint32_t startDepth, uint32_
     };
 
     // Create the grid
-    {
-        const uint32_t voxlesPerAxis = 1 << startDepth;
-        mOctreeData.resize(voxlesPerAxis * voxlesPerAxis * voxlesPerAxis);
-    }
+    mOctreeData.resize(mStartGridXY * mStartGridSize.z);
 
     std::stack<NodeInfo> nodes;
     {
-        float newSize = 0.5f * mBox.getSize().x * glm::pow(0.5f, startOctreeDepth);
+        float newSize = 0.5f * getStartGridCube().getSize().x * glm::pow(0.5f, startOctreeDepth);
         const glm::vec3 startCenter = mBox.min + newSize;
         const uint32_t voxlesPerAxis = 1 << startOctreeDepth;
 
@@ -69,10 +72,13 @@ void OctreeSdf::initUniformOctree(const Mesh& mesh, uint32_t startDepth, uint32_
             {
                 for(uint32_t i=0; i < voxlesPerAxis; i++)
                 {
+                    if(isOutsideStartGrid(startCenter + glm::vec3(i, j, k) * 2.0f * newSize, newSize)) continue;
                     nodes.push(NodeInfo(std::numeric_limits<uint32_t>::max(), startOctreeDepth, startCenter + glm::vec3(i, j, k) * 2.0f * newSize, newSize));
                 }
             }
         }
+
+        if(progress != nullptr) progress->addEstimatedNodes(startOctreeDepth, nodes.size());
     }
 
     mValueRange = 0.0f;
@@ -88,13 +94,52 @@ void OctreeSdf::initUniformOctree(const Mesh& mesh, uint32_t startDepth, uint32_
 
     std::vector<float> elapsedTime(maxDepth);
     std::vector<uint32_t> numTrianglesEvaluated(maxDepth, 0);
+    size_t maxStackSize = nodes.size(); // The stack is the only buffer that shrinks
     Timer timer;
 
+    // Stores the vertices values of the node, which are the trilinear coefficients
+    auto generateLeaf = [&](const NodeInfo& node, OctreeNode* octreeNode, const std::vector<std::pair<float, uint32_t>>& nodeTriangles)
+    {
+        assert(node.depth >= startDepth);
+        uint32_t childIndex = mOctreeData.size();
+        assert(octreeNode != nullptr);
+        octreeNode->setValues(true, childIndex);
+
+        mOctreeData.resize(mOctreeData.size() + 8);
+
+        float* values = reinterpret_cast<float*>(&mOctreeData[childIndex]);
+        for(uint32_t i=0; i < 8; i++)
+        {
+            values[i] = INFINITY;
+        }
+        std::array<uint32_t, 8> minIndex;
+
+        for(std::pair<float, uint32_t> p : nodeTriangles)
+        {
+            for(uint32_t i=0; i < 8; i++)
+            {
+                const float dist = TriangleUtils::getSqDistPointAndTriangle(node.center + childrens[i] * node.size, trianglesData[p.second]);
+                if(dist < values[i])
+                {
+                    minIndex[i] = p.second;
+                    values[i] = dist;
+                }
+            }
+        }
+
+        for(uint32_t i=0; i < 8; i++)
+        {
+            values[i] = TriangleUtils::getSignedDistPointAndTriangle(node.center + childrens[i] * node.size, trianglesData[minIndex[i]]);
+            mValueRange = glm::max(mValueRange, glm::abs(values[i]));
+        }
+    };
+
     while(!nodes.empty())
     {
         timer.start();
         const NodeInfo node = nodes.top();
         nodes.pop();
+        if(node.depth <= startDepth && isOutsideStartGrid(node.center, node.size)) continue;
 
         OctreeNode* octreeNode = (node.nodeIndex < std::numeric_limits<uint32_t>::max()) 
                                     ? &mOctreeData[node.nodeIndex]
@@ -104,12 +149,21 @@ void OctreeSdf::initUniformOctree(const Mesh& mesh, uint32_t startDepth, uint32_
         {
             assert(octreeNode == nullptr);
             glm::ivec3 startArrayPos = glm::floor((node.center - mBox.min) / mStartGridCellSize);
-            octreeNode = &mOctreeData[startArrayPos.z * mStartGridXY + startArrayPos.y * mStartGridSize + startArrayPos.x];
+            octreeNode = &mOctreeData[startArrayPos.z * mStartGridXY + startArrayPos.y * mStartGridSize.x + startArrayPos.x];
         }
 
         const uint32_t rDepth = node.depth - startOctreeDepth + 1;
+        if(progress != nullptr) progress->addProcessedNodes(node.depth);
+
+        // A cancelled construction ends the branches at the current depth
+        const bool cancelled = progress != nullptr && progress->isCancelled() && node.depth >= startDepth;
+
+        // The uniform subdivision has no error threshold, only the depth of the regions is used
+        uint32_t nodeMaxDepth = defaultMaxDepth;
+        float nodeSqTerminationThreshold = 0.0f;
+        getNodeRefinement(node.center, node.size, 0.0f, nodeMaxDepth, nodeSqTerminationThreshold);
         
-        if(node.depth < maxDepth)
+        if(node.depth < nodeMaxDepth && !cancelled)
         {
             triangles[rDepth].resize(0);
             float minMaxDist = INFINITY;
@@ -139,6 +193,14 @@ void OctreeSdf::initUniformOctree(const Mesh& mesh, uint32_t startDepth, uint32_
 
             triangles[rDepth].resize(s);
 
+            // The first triangle gives the minimum distance to the node,
+            // so the nodes outside the narrow band end without being subdivided
+            if(node.depth >= startDepth && mNarrowBand > 0.0f && triangles[rDepth][0].first >= mNarrowBand)
+            {
+                generateLeaf(node, octreeNode, triangles[rDepth]);
+                continue;
+            }
+
             const float newSize = 0.5f * node.size;
 
             uint32_t childIndex = (node.depth >= startDepth) ? mOctreeData.size() : std::numeric_limits<uint32_t>::max();
@@ -146,11 +208,13 @@ void OctreeSdf::initUniformOctree(const Mesh& mesh, uint32_t startDepth, uint32_
             if(octreeNode != nullptr) octreeNode->setValues(false, childIndex);
 
             if(node.depth >= startDepth) mOctreeData.resize(mOctreeData.size() + 8);
+            if(progress != nullptr) progress->addEstimatedNodes(node.depth + 1, 8);
 
             for(uint32_t c=0; c < 8; c++)
             {
                 nodes.push(NodeInfo(childIndex + (childOffsetMask & c), node.depth + 1, node.center + childrens[c] * newSize, newSize, false));
             }
+            maxStackSize = glm::max(maxStackSize, nodes.size());
 
             verticesStatistics[node.depth].first += triangles[rDepth].size();
             verticesStatistics[node.depth].second += 1;
@@ -159,41 +223,17 @@ void OctreeSdf::initUniformOctree(const Mesh& mesh, uint32_t startDepth, uint32_
         }
         else
         {     
-            assert(node.depth >= startDepth);
-            uint32_t childIndex = mOctreeData.size();
-            assert(octreeNode != nullptr);
-			octreeNode->setValues(true, childIndex);
-
-            mOctreeData.resize(mOctreeData.size() + 8);
-
-            float* values = reinterpret_cast<float*>(&mOctreeData[childIndex]);
-            for(uint32_t i=0; i < 8; i++)
-            {
-                values[i] = INFINITY;
-            }
-            std::array<uint32_t, 8> minIndex;
-
-            for(std::pair<float, uint32_t> p : triangles[rDepth-1])
-            {
-                for(uint32_t i=0; i < 8; i++)
-                {
-                    const float dist = TriangleUtils::getSqDistPointAndTriangle(node.center + childrens[i] * node.size, trianglesData[p.second]);
-                    if(dist < values[i])
-                    {
-                        minIndex[i] = p.second;
-                        values[i] = dist;
-                    }
-                }
-            }
-
-            for(uint32_t i=0; i < 8; i++)
-            {
-                values[i] = TriangleUtils::getSignedDistPointAndTriangle(node.center + childrens[i] * node.size, trianglesData[minIndex[i]]);
-                mValueRange = glm::max(mValueRange, glm::abs(values[i]));
-            }
+            generateLeaf(node, octreeNode, triangles[rDepth-1]);
         }
     }
 
+    mConstructionPeakMemory = MemoryUsage::getBytes(trianglesData) + MemoryUsage::getBytes(mOctreeData) +
+                              maxStackSize * sizeof(NodeInfo);
+    for(const std::vector<std::pair<float, uint32_t>>& depthTriangles : triangles)
+    {
+        mConstructionPeakMemory += MemoryUsage::getBytes(depthTriangles);
+    }
+
     SPDLOG_INFO("Used an octree of depth {}", maxDepth);
     for(uint32_t d=0; d < maxDepth; d++)
     {
@@ -1,14 +1,26 @@
 #include "SdfLib/RealSdf.h"
+#include "SdfLib/utils/QueryStatistics.h"
 
 namespace sdflib
 {
 RealSdf::RealSdf(const Mesh& mesh)
 {
     mTriangles = std::move(TriangleUtils::calculateMeshTriangleData(mesh));
+    mConstructionPeakMemory = MemoryUsage::getBytes(mTriangles);
+}
+
+MemoryUsage RealSdf::memoryUsage() const
+{
+    MemoryUsage usage;
+    usage.trianglesData = MemoryUsage::getBytes(mTriangles);
+    usage.constructionPeak = mConstructionPeakMemory;
+    return usage;
 }
 
 float RealSdf::getDistance(glm::vec3 sample) const
 {
+    SDFLIB_QUERY_STATS_SCOPE(QueryStats::REAL);
+    SDFLIB_QUERY_STATS_TRIANGLES_TESTED(mTriangles.size());
     float minDist = INFINITY;
 	uint32_t nearestTriangle = 0;
     for(uint32_t t=0; t < mTriangles.size(); t++)
@@ -26,6 +38,7 @@ float RealSdf::getDistance(glm::vec3 sample) const
 
 float RealSdf::getDistance(glm::vec3 sample, glm::vec3& outGradient) const
 {
+    SDFLIB_QUERY_STATS_SCOPE(QueryStats::REAL);
     // TODO
     return 0.0f;
 }
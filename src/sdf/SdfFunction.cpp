@@ -4,40 +4,252 @@
 #include "SdfLib/OctreeSdf.h"
 #include "SdfLib/ExactOctreeSdf.h"
 
+#include "SdfLib/utils/BlockCompression.h"
+
+#include <cstring>
+#include <algorithm>
+#include <thread>
+
 namespace sdflib
 {
-bool SdfFunction::saveToFile(const std::string& outputPath)
+void MemoryUsage::print() const
 {
-    std::ofstream os(outputPath, std::ios::out | std::ios::binary);
-    if(!os.is_open())
+    SPDLOG_INFO("Nodes: {}MB", static_cast<float>(nodes) / 1048576.0f);
+    SPDLOG_INFO("Coefficients: {}MB", static_cast<float>(coefficients) / 1048576.0f);
+    SPDLOG_INFO("Triangle Sets: {}MB", static_cast<float>(trianglesSets) / 1048576.0f);
+    SPDLOG_INFO("Triangle Masks: {}MB", static_cast<float>(trianglesMasks) / 1048576.0f);
+    SPDLOG_INFO("Triangle Data: {}MB", static_cast<float>(trianglesData) / 1048576.0f);
+    SPDLOG_INFO("Caches: {}MB", static_cast<float>(caches) / 1048576.0f);
+    SPDLOG_INFO("Nodes Bounds: {}MB", static_cast<float>(nodesBounds) / 1048576.0f);
+    SPDLOG_INFO("Total: {}MB", static_cast<float>(getTotal()) / 1048576.0f);
+    if(constructionPeak > 0)
     {
-        SPDLOG_ERROR("Cannot open file {}", outputPath);
-        return false;
+        SPDLOG_INFO("Construction peak: {}MB", static_cast<float>(constructionPeak) / 1048576.0f);
     }
-    cereal::PortableBinaryOutputArchive archive(os);
-    SdfFormat format = getFormat();
+}
 
-    if(format == SdfFormat::GRID)
+namespace
+{
+    constexpr char FILE_MAGIC[4] = { 'S', 'D', 'F', 'L' };
+
+    inline bool isLittleEndian()
     {
-        archive(format);
-        archive(*reinterpret_cast<UniformGridSdf*>(this));
+        const uint16_t value = 1;
+        return *reinterpret_cast<const uint8_t*>(&value) == 1;
     }
-    else if(format == SdfFormat::OCTREE)
+
+    inline uint64_t mixBits(uint64_t h)
     {
-        archive(format);
-        archive(*reinterpret_cast<OctreeSdf*>(this));
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDull;
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53ull;
+        h ^= h >> 33;
+        return h;
     }
-    else if(format == SdfFormat::EXACT_OCTREE)
+
+    // 64-bit checksum of a stream of bytes. The bytes are read as little-endian words,
+    // so the result does not depend on the machine
+    class StreamHasher
     {
+    public:
+        void update(const char* data, size_t size)
+        {
+            mSize += size;
+            if(mPendingBytes > 0)
+            {
+                const size_t n = std::min(size, 8 - mPendingBytes);
+                std::memcpy(mPending + mPendingBytes, data, n);
+                mPendingBytes += n;
+                data += n;
+                size -= n;
+                if(mPendingBytes < 8) return;
+                addWord(mPending);
+                mPendingBytes = 0;
+            }
+
+            for(; size >= 8; data += 8, size -= 8) addWord(data);
+
+            std::memcpy(mPending, data, size);
+            mPendingBytes = size;
+        }
+
+        uint64_t getChecksum() const
+        {
+            uint64_t tail = 0;
+            for(size_t i=0; i < mPendingBytes; i++) tail |= static_cast<uint64_t>(static_cast<uint8_t>(mPending[i])) << (8 * i);
+            return mixBits(mHash ^ mixBits(tail) ^ (mSize * 0x9E3779B97F4A7C15ull));
+        }
+    private:
+        uint64_t mHash = 0x5DF1B5C4E2A3F6D1ull;
+        uint64_t mSize = 0;
+        char mPending[8];
+        size_t mPendingBytes = 0;
+
+        void addWord(const char* bytes)
+        {
+            uint64_t word;
+            std::memcpy(&word, bytes, 8);
+            if(!isLittleEndian())
+            {
+                uint64_t swapped = 0;
+                for(uint32_t i=0; i < 8; i++) swapped = (swapped << 8) | ((word >> (8 * i)) & 0xFF);
+                word = swapped;
+            }
+            mHash = (mHash ^ mixBits(word)) * 0x9E3779B97F4A7C15ull;
+            mHash = (mHash << 27) | (mHash >> 37);
+        }
+    };
+
+    // Forwards the data to another buffer while it computes its checksum
+    class ChecksumStreamBuf : public std::streambuf
+    {
+    public:
+        ChecksumStreamBuf(std::streambuf* target) : mTarget(target) {}
+        uint64_t getChecksum() const { return mHasher.getChecksum(); }
+    protected:
+        std::streamsize xsputn(const char* data, std::streamsize size) override
+        {
+            const std::streamsize written = mTarget->sputn(data, size);
+            mHasher.update(data, static_cast<size_t>(written));
+            return written;
+        }
+
+        int_type overflow(int_type c) override
+        {
+            if(traits_type::eq_int_type(c, traits_type::eof())) return traits_type::not_eof(c);
+            const char value = traits_type::to_char_type(c);
+            return (xsputn(&value, 1) == 1) ? c : traits_type::eof();
+        }
+
+        std::streamsize xsgetn(char* data, std::streamsize size) override
+        {
+            std::streamsize count = 0;
+            if(gptr() < egptr() && size > 0)
+            {
+                *data = *gptr();
+                gbump(1);
+                count = 1;
+            }
+            const std::streamsize read = mTarget->sgetn(data + count, size - count);
+            mHasher.update(data + count, static_cast<size_t>(read));
+            return count + read;
+        }
+
+        int_type underflow() override
+        {
+            if(gptr() < egptr()) return traits_type::to_int_type(*gptr());
+            const int_type c = mTarget->sbumpc();
+            if(traits_type::eq_int_type(c, traits_type::eof())) return c;
+            mChar = traits_type::to_char_type(c);
+            mHasher.update(&mChar, 1);
+            setg(&mChar, &mChar, &mChar + 1);
+            return c;
+        }
+    private:
+        std::streambuf* mTarget;
+        StreamHasher mHasher;
+        char mChar;
+    };
+
+    void writeLittleEndian(std::ostream& os, uint64_t value, uint32_t numBytes)
+    {
+        for(uint32_t i=0; i < numBytes; i++) os.put(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+
+    bool readLittleEndian(std::istream& is, uint64_t& value, uint32_t numBytes)
+    {
+        value = 0;
+        for(uint32_t i=0; i < numBytes; i++)
+        {
+            const int c = is.get();
+            if(c == std::char_traits<char>::eof()) return false;
+            value |= static_cast<uint64_t>(static_cast<uint8_t>(c)) << (8 * i);
+        }
+        return true;
+    }
+
+    std::unique_ptr<SdfFunction> loadArchive(std::istream& is, uint32_t fileVersion)
+    {
+        cereal::PortableBinaryInputArchive archive(is);
+        SdfFunction::SdfFormat format = SdfFunction::SdfFormat::NONE;
         archive(format);
-        archive(*reinterpret_cast<ExactOctreeSdf*>(this));
+
+        if(format == SdfFunction::SdfFormat::GRID)
+        {
+            std::unique_ptr<UniformGridSdf> obj(new UniformGridSdf());
+            archive(*obj);
+            return obj;
+        }
+        else if(format == SdfFunction::SdfFormat::OCTREE)
+        {
+            std::unique_ptr<OctreeSdf> obj(new OctreeSdf());
+            obj->loadVersion(archive, fileVersion);
+            return obj;
+        }
+        else if(format == SdfFunction::SdfFormat::EXACT_OCTREE)
+        {
+            std::unique_ptr<ExactOctreeSdf> obj(new ExactOctreeSdf());
+            obj->loadVersion(archive, fileVersion);
+            return obj;
+        }
+        else
+        {
+            SPDLOG_ERROR("Unknown file format");
+            return std::unique_ptr<SdfFunction>();
+        }
     }
-    else
+}
+
+bool SdfFunction::saveToFile(const std::string& outputPath, bool compress)
+{
+    SdfFormat format = getFormat();
+    if(format != SdfFormat::GRID && format != SdfFormat::OCTREE && format != SdfFormat::EXACT_OCTREE)
     {
         SPDLOG_ERROR("Unknown format to save");
         return false;
     }
 
+    std::ofstream os(outputPath, std::ios::out | std::ios::binary);
+    if(!os.is_open())
+    {
+        SPDLOG_ERROR("Cannot open file {}", outputPath);
+        return false;
+    }
+
+    os.write(FILE_MAGIC, sizeof(FILE_MAGIC));
+    writeLittleEndian(os, FILE_VERSION, 4);
+    writeLittleEndian(os, (compress) ? FILE_FLAG_COMPRESSED : 0, 4);
+
+    ChecksumStreamBuf checksumBuffer(os.rdbuf());
+    {
+        BlockCompression::Scope compressionScope(compress, std::thread::hardware_concurrency());
+        std::ostream payload(&checksumBuffer);
+        cereal::PortableBinaryOutputArchive archive(payload);
+        archive(format);
+
+        if(format == SdfFormat::GRID)
+        {
+            archive(*reinterpret_cast<UniformGridSdf*>(this));
+        }
+        else if(format == SdfFormat::OCTREE)
+        {
+            archive(*reinterpret_cast<OctreeSdf*>(this));
+        }
+        else
+        {
+            archive(*reinterpret_cast<ExactOctreeSdf*>(this));
+        }
+    }
+
+    writeLittleEndian(os, checksumBuffer.getChecksum(), 8);
+    os.flush();
+    if(!os)
+    {
+        SPDLOG_ERROR("Cannot write the file {}", outputPath);
+        return false;
+    }
+
     return true;
 }
 
@@ -49,32 +261,62 @@ std::unique_ptr<SdfFunction> SdfFunction::loadFromFile(const std::string& inputP
         SPDLOG_ERROR("Cannot open file {}", inputPath);
         return std::unique_ptr<SdfFunction>();
     }
-    cereal::PortableBinaryInputArchive archive(is);
-    SdfFunction::SdfFormat format = SdfFunction::SdfFormat::NONE;
-    archive(format);
 
-    if(format == SdfFormat::GRID)
+    char magic[sizeof(FILE_MAGIC)];
+    is.read(magic, sizeof(FILE_MAGIC));
+    if(is.gcount() != sizeof(FILE_MAGIC) || std::memcmp(magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0)
+    {
+        // The files stored before the header start directly with the archive
+        is.clear();
+        is.seekg(0);
+        try
+        {
+            return loadArchive(is, LEGACY_FILE_VERSION);
+        }
+        catch(std::exception& e)
+        {
+            SPDLOG_ERROR("Cannot read the file {}: {}", inputPath, e.what());
+            return std::unique_ptr<SdfFunction>();
+        }
+    }
+
+    uint64_t version;
+    if(!readLittleEndian(is, version, 4) || version == LEGACY_FILE_VERSION || version > FILE_VERSION)
+    {
+        SPDLOG_ERROR("The file {} has an unsupported version", inputPath);
+        return std::unique_ptr<SdfFunction>();
+    }
+
+    // The first version of the container has no flags
+    uint64_t flags = 0;
+    if(version >= 2 && !readLittleEndian(is, flags, 4))
     {
-        std::unique_ptr<UniformGridSdf> obj(new UniformGridSdf());
-        archive(*obj);
-        return obj;
+        SPDLOG_ERROR("Cannot read the file {}", inputPath);
+        return std::unique_ptr<SdfFunction>();
     }
-    else if(format == SdfFormat::OCTREE)
+
+    ChecksumStreamBuf checksumBuffer(is.rdbuf());
+    std::unique_ptr<SdfFunction> sdf;
+    try
     {
-        std::unique_ptr<OctreeSdf> obj(new OctreeSdf());
-        archive(*obj);
-        return obj;
+        BlockCompression::Scope compressionScope(flags & FILE_FLAG_COMPRESSED, std::thread::hardware_concurrency());
+        std::istream payload(&checksumBuffer);
+        sdf = loadArchive(payload, static_cast<uint32_t>(version));
     }
-    else if(format == SdfFormat::EXACT_OCTREE)
+    // A corrupted array size can also make the allocations fail
+    catch(std::exception& e)
     {
-        std::unique_ptr<ExactOctreeSdf> obj(new ExactOctreeSdf());
-        archive(*obj);
-        return obj;
+        SPDLOG_ERROR("Cannot read the file {}: {}", inputPath, e.what());
+        return std::unique_ptr<SdfFunction>();
     }
-    else
+
+    uint64_t checksum;
+    if(sdf != nullptr && (!readLittleEndian(is, checksum, 8) || checksum != checksumBuffer.getChecksum()))
     {
-        SPDLOG_ERROR("Unknown file format");
+        SPDLOG_ERROR("The file {} is corrupted, its checksum does not match", inputPath);
         return std::unique_ptr<SdfFunction>();
     }
+
+    return sdf;
 }
 }
\ No newline at end of file
@@ -1,6 +1,8 @@
 #include "SdfLib/UniformGridSdf.h"
+#include "SdfLib/OctreeSdf.h"
 #include "SdfLib/utils/TriangleUtils.h"
 #include "SdfLib/utils/UsefullSerializations.h"
+#include "SdfLib/utils/QueryStatistics.h"
 
 #include <iostream>
 #include <spdlog/spdlog.h>
@@ -8,7 +10,7 @@
 namespace sdflib
 {
 UniformGridSdf::UniformGridSdf(const Mesh& mesh, BoundingBox box, uint32_t depth, 
-                   InitAlgorithm initAlgorithm)
+                   InitAlgorithm initAlgorithm, float narrowBand)
 {
     mGridSize = glm::ivec3(1 << depth);
     SPDLOG_INFO("Uniform grid size: {}, {}, {}", mGridSize.x, mGridSize.y, mGridSize.z);
@@ -30,12 +32,14 @@ UniformGridSdf::UniformGridSdf(const Mesh& mesh, BoundingBox box, uint32_t depth
             basicInit(trianglesData);
             break;
         case InitAlgorithm::OCTREE:
-            octreeInit(mesh, trianglesData);
+            octreeInit(mesh, trianglesData, narrowBand);
             break;
     }
+
+    mConstructionPeakMemory = MemoryUsage::getBytes(mGrid) + MemoryUsage::getBytes(trianglesData);
 }
 
-UniformGridSdf::UniformGridSdf(const Mesh& mesh, BoundingBox box, float cellSize, InitAlgorithm initAlgorithm)
+UniformGridSdf::UniformGridSdf(const Mesh& mesh, BoundingBox box, float cellSize, InitAlgorithm initAlgorithm, float narrowBand)
     : mCellSize(cellSize)
 {
     mGridSize = glm::ivec3(glm::ceil((box.max - box.min) / cellSize)) + glm::ivec3(1);
@@ -55,9 +59,51 @@ UniformGridSdf::UniformGridSdf(const Mesh& mesh, BoundingBox box, float cellSize
             basicInit(trianglesData);
             break;
         case InitAlgorithm::OCTREE:
-            octreeInit(mesh, trianglesData);
+            octreeInit(mesh, trianglesData, narrowBand);
             break;
     }
+
+    mConstructionPeakMemory = MemoryUsage::getBytes(mGrid) + MemoryUsage::getBytes(trianglesData);
+}
+
+UniformGridSdf::UniformGridSdf(const OctreeSdf& octreeSdf, BoundingBox box, float cellSize, uint32_t numThreads)
+    : mCellSize(cellSize)
+{
+    mGridSize = glm::ivec3(glm::ceil((box.max - box.min) / cellSize)) + glm::ivec3(1);
+    SPDLOG_INFO("Uniform grid size: {}, {}, {}", mGridSize.x, mGridSize.y, mGridSize.z);
+
+    mBox.min = box.min;
+    mBox.max = box.min + mCellSize * glm::vec3(mGridSize - 1);
+    mGridXY = mGridSize.x * mGridSize.y;
+
+    octreeSdf.sampleGrid(mBox, mGridSize, mGrid, numThreads);
+
+    mConstructionPeakMemory = MemoryUsage::getBytes(mGrid);
+}
+
+UniformGridSdf::UniformGridSdf(BoundingBox box, glm::ivec3 gridSize, std::vector<float> grid)
+    : mBox(box), mGridSize(gridSize), mGrid(std::move(grid))
+{
+    if(glm::any(glm::lessThan(mGridSize, glm::ivec3(2))) ||
+       mGrid.size() != static_cast<size_t>(mGridSize.x) * static_cast<size_t>(mGridSize.y) * static_cast<size_t>(mGridSize.z))
+    {
+        SPDLOG_ERROR("The grid has {} values, but its size is {}, {}, {}", mGrid.size(), mGridSize.x, mGridSize.y, mGridSize.z);
+        // The queries are guarded against the empty grid
+        mGrid.clear();
+        mGridSize = glm::ivec3(0);
+    }
+
+    mCellSize = mBox.getSize().x / static_cast<float>(glm::max(mGridSize.x - 1, 1));
+    mGridXY = mGridSize.x * mGridSize.y;
+    mConstructionPeakMemory = MemoryUsage::getBytes(mGrid);
+}
+
+MemoryUsage UniformGridSdf::memoryUsage() const
+{
+    MemoryUsage usage;
+    usage.coefficients = MemoryUsage::getBytes(mGrid);
+    usage.constructionPeak = mConstructionPeakMemory;
+    return usage;
 }
 
 void UniformGridSdf::basicInit(const std::vector<TriangleUtils::TriangleData>& trianglesData)
@@ -92,6 +138,9 @@ void UniformGridSdf::basicInit(const std::vector<TriangleUtils::TriangleData>& t
 
 float UniformGridSdf::getDistance(glm::vec3 sample) const
 {
+    SDFLIB_QUERY_STATS_SCOPE(QueryStats::GRID);
+    if(mGrid.empty()) return INFINITY;
+
     glm::vec3 fracPart = (sample - mBox.min) / mCellSize;
     glm::ivec3 arrayPos = glm::floor(fracPart);
     fracPart = glm::fract(fracPart);
@@ -113,6 +162,7 @@ float UniformGridSdf::getDistance(glm::vec3 sample) const
 
 float UniformGridSdf::getDistance(glm::vec3 sample, glm::vec3& outGradient) const
 {
+    SDFLIB_QUERY_STATS_SCOPE(QueryStats::GRID);
     // TODO
     return 0.0f;
 }
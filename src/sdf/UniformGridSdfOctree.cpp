@@ -39,7 +39,7 @@ struct OctreeNode
 
 constexpr uint32_t START_OCTREE_DEPTH = 1;
 
-void UniformGridSdf::octreeInit(const Mesh& mesh, const std::vector<TriangleUtils::TriangleData>& trianglesData)
+void UniformGridSdf::octreeInit(const Mesh& mesh, const std::vector<TriangleUtils::TriangleData>& trianglesData, float narrowBand)
 {
     // Calculate octree properties
     int octreeSize = glm::max(glm::max(mGridSize.x, mGridSize.y), mGridSize.z);
@@ -145,10 +145,47 @@ void UniformGridSdf::octreeInit(const Mesh& mesh, const std::vector<TriangleUtil
 
             triangles[rDepth].resize(s);
 
-            const float newSize = 0.5f * (node.size - 0.5f * mCellSize);
-            for(glm::vec3& c : childrens)
+            // The node covers its grid points, so the first triangle gives the minimum distance to all of them
+            if(narrowBand > 0.0f && triangles[rDepth][0].first >= narrowBand)
             {
-                nodes.push(OctreeNode(node.depth + 1, node.center + c * (newSize + 0.5f * mCellSize), newSize));
+                float minDist = INFINITY;
+                uint32_t minIndex = 0;
+                for(const std::pair<float, uint32_t>& p : triangles[rDepth])
+                {
+                    const float dist = TriangleUtils::getSqDistPointAndTriangle(node.center, trianglesData[p.second]);
+                    if(dist < minDist)
+                    {
+                        minDist = dist;
+                        minIndex = p.second;
+                    }
+                }
+                const float centerDist = TriangleUtils::getSignedDistPointAndTriangle(node.center, trianglesData[minIndex]);
+                const float sign = (centerDist < 0.0f) ? -1.0f : 1.0f;
+
+                // The grid points store the lower bound minus the cell diagonal
+                const glm::ivec3 startPos(glm::round((node.center - node.size - mBox.min) / mCellSize));
+                const glm::ivec3 endPos = glm::min(startPos + glm::ivec3(glm::round(2.0f * node.size / mCellSize)), mGridSize - 1);
+                for(int k=startPos.z; k <= endPos.z; k++)
+                {
+                    for(int j=startPos.y; j <= endPos.y; j++)
+                    {
+                        for(int i=startPos.x; i <= endPos.x; i++)
+                        {
+                            const glm::vec3 point = mBox.min + mCellSize * glm::vec3(i, j, k);
+                            const float bound = glm::max(triangles[rDepth][0].first, glm::abs(centerDist) - glm::length(point - node.center));
+                            mGrid[k * mGridXY + j * mGridSize.x + i] = sign * glm::max(bound - voxelDiagonal * mCellSize, 0.0f);
+                            numVoxelsCalculated++;
+                        }
+                    }
+                }
+            }
+            else
+            {
+                const float newSize = 0.5f * (node.size - 0.5f * mCellSize);
+                for(glm::vec3& c : childrens)
+                {
+                    nodes.push(OctreeNode(node.depth + 1, node.center + c * (newSize + 0.5f * mCellSize), newSize));
+                }
             }
         }
         else
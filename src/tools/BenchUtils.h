@@ -0,0 +1,149 @@
+#ifndef BENCH_UTILS_H
+#define BENCH_UTILS_H
+
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "SdfLib/utils/Timer.h"
+
+/**
+ * @brief Helpers shared by the benchmark tools to parse the parameter lists and print the results
+ **/
+namespace BenchUtils
+{
+/**
+ * @brief Named value of a result. The strings are quoted in the JSON output
+ **/
+struct Field
+{
+    Field(const char* name, const std::string& value) : name(name), value(value), isString(true) {}
+    Field(const char* name, const char* value) : name(name), value(value), isString(true) {}
+
+    template<typename T>
+    Field(const char* name, T value) : name(name), isString(false)
+    {
+        std::ostringstream ss;
+        ss << value;
+        this->value = ss.str();
+    }
+
+    std::string name;
+    std::string value;
+    bool isString;
+};
+
+// Fields of a result, all the rows of the same output have the same fields
+typedef std::vector<Field> Row;
+
+inline std::vector<std::string> splitList(const std::string& str)
+{
+    std::vector<std::string> res;
+    std::stringstream ss(str);
+    std::string item;
+    while(std::getline(ss, item, ','))
+    {
+        if(!item.empty()) res.push_back(item);
+    }
+    return res;
+}
+
+inline void writeJsonField(std::ostream& out, const Field& field)
+{
+    sdflib::writeJsonString(out, field.name);
+    out << ": ";
+    if(field.isString) sdflib::writeJsonString(out, field.value);
+    else out << field.value;
+}
+
+/**
+ * @brief Prints the fields as a single JSON object
+ **/
+inline void writeJsonObject(std::ostream& out, const Row& row)
+{
+    out << "{\n";
+    for(size_t f=0; f < row.size(); f++)
+    {
+        out << "  ";
+        writeJsonField(out, row[f]);
+        out << ((f + 1 < row.size()) ? ",\n" : "\n");
+    }
+    out << "}\n";
+}
+
+/**
+ * @brief Prints the rows in a results array
+ * @param header Fields printed before the results array
+ **/
+inline void writeJson(std::ostream& out, const std::vector<Row>& rows, const Row& header = Row())
+{
+    out << "{\n";
+    for(const Field& field : header)
+    {
+        out << "  ";
+        writeJsonField(out, field);
+        out << ",\n";
+    }
+
+    out << "  \"results\": [\n";
+    for(size_t i=0; i < rows.size(); i++)
+    {
+        out << "    {";
+        for(size_t f=0; f < rows[i].size(); f++)
+        {
+            if(f > 0) out << ", ";
+            writeJsonField(out, rows[i][f]);
+        }
+        out << "}" << ((i + 1 < rows.size()) ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+}
+
+/**
+ * @brief Prints a CSV value, between quotes if it contains separators or quotes
+ **/
+inline void writeCsvValue(std::ostream& out, const std::string& value)
+{
+    if(value.find_first_of(",\"\r\n") == std::string::npos)
+    {
+        out << value;
+        return;
+    }
+
+    out << "\"";
+    for(char c : value)
+    {
+        if(c == '"') out << '"';
+        out << c;
+    }
+    out << "\"";
+}
+
+/**
+ * @brief Prints the rows with a first line containing the fields names
+ **/
+inline void writeCsv(std::ostream& out, const std::vector<Row>& rows)
+{
+    if(rows.empty()) return;
+
+    for(size_t f=0; f < rows[0].size(); f++)
+    {
+        if(f > 0) out << ",";
+        writeCsvValue(out, rows[0][f].name);
+    }
+    out << "\n";
+
+    for(const Row& row : rows)
+    {
+        for(size_t f=0; f < row.size(); f++)
+        {
+            if(f > 0) out << ",";
+            writeCsvValue(out, row[f].value);
+        }
+        out << "\n";
+    }
+}
+}
+
+#endif
@@ -0,0 +1,454 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <random>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <string>
+#include <args.hxx>
+#include <spdlog/spdlog.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "SdfLib/UniformGridSdf.h"
+#include "SdfLib/RealSdf.h"
+#include "SdfLib/OctreeSdf.h"
+#include "SdfLib/ExactOctreeSdf.h"
+#include "SdfLib/utils/Mesh.h"
+#include "SdfLib/utils/PrimitivesFactory.h"
+#include "SdfLib/utils/Timer.h"
+#include "SdfLib/utils/QueryStatistics.h"
+#include "../BenchUtils.h"
+
+#ifdef OPENMP_AVAILABLE
+#include <omp.h>
+#endif
+
+using namespace sdflib;
+
+namespace
+{
+
+// Prevents the compiler from removing the queries whose result is never used
+volatile float resultSink = 0.0f;
+
+struct BenchCase
+{
+    std::string structure;
+    std::unique_ptr<SdfFunction> sdf;
+    uint32_t maxQueries;
+};
+
+struct BenchResult
+{
+    std::string mesh;
+    uint32_t numTriangles;
+    std::string structure;
+    std::string pattern;
+    std::string mode;
+    uint32_t numQueries;
+    uint32_t numThreads;
+    float mean;
+    float p50;
+    float p90;
+    float p99;
+    float min;
+    float max;
+};
+
+float percentile(const std::vector<float>& sortedValues, float p)
+{
+    if(sortedValues.empty()) return 0.0f;
+    const float pos = p * static_cast<float>(sortedValues.size() - 1);
+    const size_t idx = static_cast<size_t>(pos);
+    const float t = pos - static_cast<float>(idx);
+    if(idx + 1 >= sortedValues.size()) return sortedValues.back();
+    return (1.0f - t) * sortedValues[idx] + t * sortedValues[idx + 1];
+}
+
+/**
+ * @brief Samples uniformly distributed points inside the box
+ **/
+std::vector<glm::vec3> generateUniformQueries(const BoundingBox& box, uint32_t numQueries, std::mt19937& gen)
+{
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+    std::vector<glm::vec3> queries(numQueries);
+    for(glm::vec3& p : queries)
+    {
+        p = box.min + glm::vec3(dist(gen), dist(gen), dist(gen)) * box.getSize();
+    }
+    return queries;
+}
+
+/**
+ * @brief Samples points on the mesh triangles displaced along the triangle normal
+ *        following a normal distribution of deviation sigma
+ **/
+std::vector<glm::vec3> generateNearSurfaceQueries(const Mesh& mesh, const BoundingBox& box,
+                                                  uint32_t numQueries, float sigma, std::mt19937& gen)
+{
+    const std::vector<glm::vec3>& vertices = mesh.getVertices();
+    const std::vector<uint32_t>& indices = mesh.getIndices();
+    const uint32_t numTriangles = indices.size() / 3;
+
+    // Sample the triangles proportionally to its area
+    std::vector<float> areas(numTriangles);
+    for(uint32_t t=0; t < numTriangles; t++)
+    {
+        const glm::vec3 v1 = vertices[indices[3 * t]];
+        const glm::vec3 v2 = vertices[indices[3 * t + 1]];
+        const glm::vec3 v3 = vertices[indices[3 * t + 2]];
+        areas[t] = 0.5f * glm::length(glm::cross(v2 - v1, v3 - v1));
+    }
+
+    std::discrete_distribution<uint32_t> triDist(areas.begin(), areas.end());
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+    std::normal_distribution<float> offsetDist(0.0f, sigma);
+
+    std::vector<glm::vec3> queries(numQueries);
+    for(glm::vec3& p : queries)
+    {
+        const uint32_t t = triDist(gen);
+        const glm::vec3 v1 = vertices[indices[3 * t]];
+        const glm::vec3 v2 = vertices[indices[3 * t + 1]];
+        const glm::vec3 v3 = vertices[indices[3 * t + 2]];
+
+        float u = dist(gen); float v = dist(gen);
+        if(u + v > 1.0f) { u = 1.0f - u; v = 1.0f - v; }
+
+        const glm::vec3 normal = glm::normalize(glm::cross(v2 - v1, v3 - v1));
+        p = glm::clamp(v1 + u * (v2 - v1) + v * (v3 - v1) + offsetDist(gen) * normal, box.min, box.max);
+    }
+    return queries;
+}
+
+/**
+ * @brief Generates the points visited by rays crossing the box with a constant step,
+ *        the consecutive queries are spatially coherent like in a sphere tracing loop
+ **/
+std::vector<glm::vec3> generateRayQueries(const BoundingBox& box, uint32_t numQueries, uint32_t stepsPerRay, std::mt19937& gen)
+{
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+    std::vector<glm::vec3> queries;
+    queries.reserve(numQueries);
+
+    const glm::vec3 size = box.getSize();
+    while(queries.size() < numQueries)
+    {
+        const glm::vec3 start = box.min + glm::vec3(dist(gen), dist(gen), dist(gen)) * size;
+        const glm::vec3 end = box.min + glm::vec3(dist(gen), dist(gen), dist(gen)) * size;
+        for(uint32_t s=0; s < stepsPerRay && queries.size() < numQueries; s++)
+        {
+            queries.push_back(glm::mix(start, end, static_cast<float>(s) / static_cast<float>(stepsPerRay - 1)));
+        }
+    }
+    return queries;
+}
+
+/**
+ * @brief Measures the queries in chunks and returns the nanoseconds per query of each chunk.
+ *        Timing every query alone would be dominated by the clock overhead.
+ **/
+template<bool Gradient>
+std::vector<float> measureQueries(const SdfFunction& sdf, const std::vector<glm::vec3>& queries, uint32_t chunkSize)
+{
+    std::vector<float> samples;
+    samples.reserve(queries.size() / chunkSize + 1);
+    float accum = 0.0f;
+    glm::vec3 gradient;
+    for(size_t c=0; c < queries.size(); c += chunkSize)
+    {
+        const size_t cEnd = std::min(queries.size(), c + chunkSize);
+        const auto start = std::chrono::steady_clock::now();
+        for(size_t i=c; i < cEnd; i++)
+        {
+            if(Gradient)
+            {
+                accum += sdf.getDistance(queries[i], gradient);
+                accum += gradient.x;
+            }
+            else
+            {
+                accum += sdf.getDistance(queries[i]);
+            }
+        }
+        const auto end = std::chrono::steady_clock::now();
+        samples.push_back(static_cast<float>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()) /
+                          static_cast<float>(cEnd - c));
+    }
+    resultSink = resultSink + accum;
+    return samples;
+}
+
+/**
+ * @brief Evaluates the whole query array in one call per repetition, using several threads if requested.
+ *        Returns the amortized nanoseconds per query of each repetition.
+ **/
+std::vector<float> measureBatchQueries(const SdfFunction& sdf, const std::vector<glm::vec3>& queries,
+                                       uint32_t repetitions, uint32_t numThreads)
+{
+    std::vector<float> distances(queries.size());
+    std::vector<float> samples;
+
+    const int64_t numQueries = static_cast<int64_t>(queries.size());
+    for(uint32_t r=0; r < repetitions; r++)
+    {
+        Timer timer;
+        timer.start();
+        #ifdef OPENMP_AVAILABLE
+        #pragma omp parallel for num_threads(numThreads) schedule(static)
+        #endif
+        for(int64_t i=0; i < numQueries; i++)
+        {
+            distances[i] = sdf.getDistance(queries[i]);
+        }
+        samples.push_back(1000.0f * timer.getElapsedMicroseconds() / static_cast<float>(queries.size()));
+    }
+
+    float accum = 0.0f;
+    for(float d : distances) accum += d;
+    resultSink = resultSink + accum;
+    return samples;
+}
+
+QueryStats::Structure getStatsStructure(const SdfFunction& sdf)
+{
+    switch(sdf.getFormat())
+    {
+        case SdfFunction::SdfFormat::GRID: return QueryStats::GRID;
+        case SdfFunction::SdfFormat::OCTREE: return QueryStats::OCTREE;
+        case SdfFunction::SdfFormat::EXACT_OCTREE: return QueryStats::EXACT_OCTREE;
+        default: return QueryStats::REAL;
+    }
+}
+
+BenchResult summarize(std::vector<float> samples)
+{
+    BenchResult res;
+    std::sort(samples.begin(), samples.end());
+    double sum = 0.0;
+    for(float s : samples) sum += s;
+    res.mean = (samples.empty()) ? 0.0f : static_cast<float>(sum / samples.size());
+    res.p50 = percentile(samples, 0.5f);
+    res.p90 = percentile(samples, 0.9f);
+    res.p99 = percentile(samples, 0.99f);
+    res.min = (samples.empty()) ? 0.0f : samples.front();
+    res.max = (samples.empty()) ? 0.0f : samples.back();
+    return res;
+}
+
+BenchUtils::Row toRow(const BenchResult& r)
+{
+    return { {"mesh", r.mesh}, {"triangles", r.numTriangles}, {"structure", r.structure},
+             {"pattern", r.pattern}, {"mode", r.mode}, {"queries", r.numQueries},
+             {"threads", r.numThreads}, {"mean", r.mean}, {"p50", r.p50}, {"p90", r.p90},
+             {"p99", r.p99}, {"min", r.min}, {"max", r.max} };
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    #ifdef SDFLIB_PRINT_STATISTICS
+        spdlog::set_pattern("[%^%l%$] [%s:%#] %v");
+    #else
+        spdlog::set_pattern("[%^%l%$] %v");
+    #endif
+
+    args::ArgumentParser parser("sdflib_bench measures the query time of the sdf structures", "");
+    args::HelpFlag help(parser, "help", "Display help menu", {'h', "help"});
+    args::ValueFlag<std::string> structuresArg(parser, "structures", "Comma separated list of structures: octree, octree_trilinear, octree_triquadratic, exact_octree, grid, real", {"structures"});
+    args::ValueFlag<std::string> subdivisionsArg(parser, "subdivisions", "Comma separated list of isosphere subdivisions used as test meshes", {"subdivisions"});
+    args::ValueFlag<std::string> patternsArg(parser, "patterns", "Comma separated list of access patterns: uniform, near_surface, ray", {"patterns"});
+    args::ValueFlag<std::string> modesArg(parser, "modes", "Comma separated list of query modes: value, gradient, batch", {"modes"});
+    args::ValueFlag<uint32_t> numQueriesArg(parser, "num_queries", "Number of queries per test", {"num_queries"});
+    args::ValueFlag<uint32_t> realSdfQueriesArg(parser, "real_sdf_queries", "Maximum number of queries per test for the brute force structure", {"real_sdf_queries"});
+    args::ValueFlag<uint32_t> chunkSizeArg(parser, "chunk_size", "Number of queries measured together in the value and gradient modes", {"chunk_size"});
+    args::ValueFlag<uint32_t> repetitionsArg(parser, "repetitions", "Number of repetitions of the batch mode", {"repetitions"});
+    args::ValueFlag<uint32_t> depthArg(parser, "depth", "The octree subdivision depth", {'d', "depth"});
+    args::ValueFlag<uint32_t> startDepthArg(parser, "start_depth", "The octree start depth", {"start_depth"});
+    args::ValueFlag<uint32_t> gridDepthArg(parser, "grid_depth", "The uniform grid depth", {"grid_depth"});
+    args::ValueFlag<float> terminationThresholdArg(parser, "termination_threshold", "Octree generation termination threshold", {"termination_threshold"});
+    args::ValueFlag<uint32_t> minTrianglesPerNode(parser, "min_triangles_per_node", "The minimum acceptable number of triangles per leaf in the exact octree", {"min_triangles_per_node"});
+    args::ValueFlag<uint32_t> numThreadsArg(parser, "num_threads", "Number of threads used in the construction and in the batch mode", {"num_threads"});
+    args::ValueFlag<uint32_t> seedArg(parser, "seed", "Seed of the queries generator", {"seed"});
+    args::ValueFlag<std::string> formatArg(parser, "format", "Output format: json or csv", {"format"});
+    args::ValueFlag<std::string> outputPathArg(parser, "output_path", "Output file, by default the results are printed in the standard output", {'o', "output"});
+
+    try
+    {
+        parser.ParseCLI(argc, argv);
+    }
+    catch(args::Help)
+    {
+        std::cerr << parser;
+        return 0;
+    }
+
+    const std::vector<std::string> structures = BenchUtils::splitList((structuresArg) ? args::get(structuresArg) : "octree,exact_octree,grid,real");
+    const std::vector<std::string> subdivisions = BenchUtils::splitList((subdivisionsArg) ? args::get(subdivisionsArg) : "2,5");
+    const std::vector<std::string> patterns = BenchUtils::splitList((patternsArg) ? args::get(patternsArg) : "uniform,near_surface,ray");
+    const std::vector<std::string> modes = BenchUtils::splitList((modesArg) ? args::get(modesArg) : "value,gradient,batch");
+    const uint32_t numQueries = (numQueriesArg) ? args::get(numQueriesArg) : 1000000;
+    const uint32_t realSdfQueries = (realSdfQueriesArg) ? args::get(realSdfQueriesArg) : 10000;
+    const uint32_t chunkSize = glm::max((chunkSizeArg) ? args::get(chunkSizeArg) : 64u, 1u);
+    const uint32_t repetitions = glm::max((repetitionsArg) ? args::get(repetitionsArg) : 10u, 1u);
+    const uint32_t numThreads = glm::max((numThreadsArg) ? args::get(numThreadsArg) : 1u, 1u);
+    const uint32_t seed = (seedArg) ? args::get(seedArg) : 123;
+    const std::string format = (formatArg) ? args::get(formatArg) : "json";
+
+    // Keep the standard output clean for the results
+    if(!outputPathArg)
+    {
+        spdlog::set_default_logger(spdlog::stderr_color_mt("stderr"));
+    }
+
+    std::vector<BenchResult> results;
+
+    for(const std::string& subdivisionStr : subdivisions)
+    {
+        const uint32_t subdivision = static_cast<uint32_t>(std::stoul(subdivisionStr));
+        std::shared_ptr<Mesh> mesh = PrimitivesFactory::getIsosphere(subdivision);
+        mesh->computeBoundingBox();
+        const std::string meshName = "isosphere_" + subdivisionStr;
+        const uint32_t numTriangles = mesh->getIndices().size() / 3;
+
+        // Same normalization and margin than the SdfExporter
+        BoundingBox box = mesh->getBoundingBox();
+        {
+            const glm::vec3 boxSize = box.getSize();
+            const float maxSize = glm::max(glm::max(boxSize.x, boxSize.y), boxSize.z);
+            mesh->applyTransform(glm::scale(glm::mat4(1.0), glm::vec3(2.0f/maxSize)) *
+                                 glm::translate(glm::mat4(1.0), -box.getCenter()));
+            box = mesh->getBoundingBox();
+            const glm::vec3 modelBBSize = box.getSize();
+            box.addMargin(0.2f * glm::max(glm::max(modelBBSize.x, modelBBSize.y), modelBBSize.z));
+        }
+
+        // Generate the queries with a fixed seed to get reproducible results
+        std::mt19937 gen(seed);
+        std::vector<std::pair<std::string, std::vector<glm::vec3>>> queriesSets;
+        for(const std::string& pattern : patterns)
+        {
+            if(pattern == "uniform") queriesSets.push_back(std::make_pair(pattern, generateUniformQueries(box, numQueries, gen)));
+            else if(pattern == "near_surface") queriesSets.push_back(std::make_pair(pattern, generateNearSurfaceQueries(*mesh, box, numQueries, 0.01f * glm::length(box.getSize()), gen)));
+            else if(pattern == "ray") queriesSets.push_back(std::make_pair(pattern, generateRayQueries(box, numQueries, 256, gen)));
+            else SPDLOG_ERROR("Unknown access pattern {}", pattern);
+        }
+
+        for(const std::string& structure : structures)
+        {
+            Timer timer;
+            timer.start();
+            BenchCase bench;
+            bench.structure = structure;
+            bench.maxQueries = numQueries;
+            if(structure == "octree" || structure == "octree_trilinear" || structure == "octree_triquadratic")
+            {
+                // The octree uses the tricubic interpolation unless the structure name selects another one
+                const OctreeSdf::InterpolationType interpolationType = (structure == "octree") ? OctreeSdf::InterpolationType::TRICUBIC :
+                                    OctreeSdf::stringToInterpolationType(structure.substr(std::string("octree_").size())).value();
+                bench.sdf = std::make_unique<OctreeSdf>(*mesh, box,
+                                (depthArg) ? args::get(depthArg) : 8,
+                                (startDepthArg) ? args::get(startDepthArg) : 3,
+                                (terminationThresholdArg) ? args::get(terminationThresholdArg) : 1e-3f,
+                                OctreeSdf::InitAlgorithm::CONTINUITY, numThreads, interpolationType);
+            }
+            else if(structure == "exact_octree")
+            {
+                bench.sdf = std::make_unique<ExactOctreeSdf>(*mesh, box,
+                                (depthArg) ? args::get(depthArg) : 8,
+                                (startDepthArg) ? args::get(startDepthArg) : 3,
+                                (minTrianglesPerNode) ? args::get(minTrianglesPerNode) : 32,
+                                numThreads);
+            }
+            else if(structure == "grid")
+            {
+                bench.sdf = std::make_unique<UniformGridSdf>(*mesh, box, (gridDepthArg) ? args::get(gridDepthArg) : 7u,
+                                                             UniformGridSdf::InitAlgorithm::OCTREE);
+            }
+            else if(structure == "real")
+            {
+                bench.sdf = std::make_unique<RealSdf>(*mesh);
+                bench.maxQueries = glm::min(numQueries, realSdfQueries);
+            }
+            else
+            {
+                SPDLOG_ERROR("Unknown structure {}", structure);
+                continue;
+            }
+            SPDLOG_INFO("Built {} for {} in {}s", structure, meshName, timer.getElapsedSeconds());
+
+            for(const auto& querySet : queriesSets)
+            {
+                const std::vector<glm::vec3> queries(querySet.second.begin(),
+                                                     querySet.second.begin() + glm::min<size_t>(bench.maxQueries, querySet.second.size()));
+                for(const std::string& mode : modes)
+                {
+                    QueryStats::reset();
+                    std::vector<float> samples;
+                    uint32_t modeThreads = 1;
+                    if(mode == "value") samples = measureQueries<false>(*bench.sdf, queries, chunkSize);
+                    else if(mode == "gradient") samples = measureQueries<true>(*bench.sdf, queries, chunkSize);
+                    else if(mode == "batch")
+                    {
+                        modeThreads = numThreads;
+                        samples = measureBatchQueries(*bench.sdf, queries, repetitions, numThreads);
+                    }
+                    else
+                    {
+                        SPDLOG_ERROR("Unknown query mode {}", mode);
+                        continue;
+                    }
+
+                    BenchResult res = summarize(std::move(samples));
+                    res.mesh = meshName;
+                    res.numTriangles = numTriangles;
+                    res.structure = structure;
+                    res.pattern = querySet.first;
+                    res.mode = mode;
+                    res.numQueries = queries.size();
+                    res.numThreads = modeThreads;
+                    results.push_back(res);
+
+                    SPDLOG_INFO("{} {} {} {}: mean {}ns p50 {}ns p99 {}ns", meshName, structure, querySet.first, mode,
+                                res.mean, res.p50, res.p99);
+
+                    if(QueryStats::isEnabled())
+                    {
+                        const QueryStatistics stats = QueryStats::collect(getStatsStructure(*bench.sdf));
+                        SPDLOG_INFO("Nodes visited: {}, mean depth: {}, triangles tested: {}, out of box: {}, sampled latency p50 {}ns p99 {}ns",
+                                    stats.getMeanNodesVisited(), stats.getMeanDepth(), stats.getMeanTrianglesTested(),
+                                    stats.numOutOfBoxQueries, stats.getLatencyPercentile(0.5f), stats.getLatencyPercentile(0.99f));
+                    }
+                }
+            }
+        }
+    }
+
+    std::vector<BenchUtils::Row> rows;
+    for(const BenchResult& result : results) rows.push_back(toRow(result));
+    const BenchUtils::Row header = { {"unit", "ns/query"} };
+
+    if(outputPathArg)
+    {
+        std::ofstream file(args::get(outputPathArg));
+        if(!file.is_open())
+        {
+            SPDLOG_ERROR("Cannot open the output file {}", args::get(outputPathArg));
+            return 1;
+        }
+        if(format == "csv") BenchUtils::writeCsv(file, rows);
+        else BenchUtils::writeJson(file, rows, header);
+    }
+    else
+    {
+        if(format == "csv") BenchUtils::writeCsv(std::cout, rows);
+        else BenchUtils::writeJson(std::cout, rows, header);
+    }
+
+    return 0;
+}
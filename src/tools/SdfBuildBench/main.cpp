@@ -0,0 +1,371 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include <string>
+#include <functional>
+#include <args.hxx>
+#include <spdlog/spdlog.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "SdfLib/UniformGridSdf.h"
+#include "SdfLib/OctreeSdf.h"
+#include "SdfLib/ExactOctreeSdf.h"
+#include "SdfLib/utils/Mesh.h"
+#include "SdfLib/utils/PrimitivesFactory.h"
+#include "SdfLib/utils/Timer.h"
+#include "../BenchUtils.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#elif defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+using namespace sdflib;
+
+namespace
+{
+
+struct BuildResult
+{
+    std::string model;
+    uint32_t numTriangles;
+    std::string structure;
+    uint32_t depth;
+    float threshold;
+    uint32_t numThreads;
+    float wallTime; // Median of the repetitions in seconds
+    float minWallTime;
+    uint64_t peakRss;
+    uint64_t constructionPeak; // Peak reported by the structure
+    uint64_t numNodes;
+    uint64_t numBytes;
+    float speedup;
+    float efficiency;
+};
+
+/**
+ * @brief Resets the peak resident set size of the process.
+ *        Only supported in Linux, in other systems the peak is the one of the whole process.
+ **/
+void resetPeakRss()
+{
+#if defined(__linux__)
+    std::ofstream file("/proc/self/clear_refs");
+    if(file.is_open()) file << "5";
+#endif
+}
+
+/**
+ * @return The peak resident set size of the process in bytes
+ **/
+uint64_t getPeakRss()
+{
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS info;
+    GetProcessMemoryInfo(GetCurrentProcess(), &info, sizeof(info));
+    return static_cast<uint64_t>(info.PeakWorkingSetSize);
+#elif defined(__linux__)
+    std::ifstream file("/proc/self/status");
+    std::string line;
+    while(std::getline(file, line))
+    {
+        if(line.rfind("VmHWM:", 0) == 0)
+        {
+            return 1024ull * std::stoull(line.substr(6));
+        }
+    }
+    return 0;
+#elif defined(__APPLE__)
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<uint64_t>(usage.ru_maxrss);
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief Counts the nodes of the octree, the coefficients of the leaves are stored
+ *        in the same array and must be skipped
+ **/
+uint64_t countOctreeNodes(const OctreeSdf& octree)
+{
+    const std::vector<OctreeSdf::OctreeNode>& data = octree.getOctreeData();
+    const glm::ivec3 startGridSize = octree.getStartGridSize();
+    uint64_t numNodes = 0;
+
+    std::function<void(uint32_t)> countNodes;
+    countNodes = [&](uint32_t nodeIndex)
+    {
+        numNodes++;
+        const OctreeSdf::OctreeNode& node = data[nodeIndex];
+        if(node.isLeaf()) return;
+        for(uint32_t c=0; c < 8; c++)
+        {
+            countNodes(node.getChildrenIndex() + c);
+        }
+    };
+
+    for(uint32_t i=0; i < static_cast<uint32_t>(startGridSize.x * startGridSize.y * startGridSize.z); i++)
+    {
+        countNodes(i);
+    }
+
+    return numNodes;
+}
+
+std::shared_ptr<Mesh> loadMesh(const std::string& model)
+{
+    std::shared_ptr<Mesh> mesh;
+    if(model.rfind("isosphere:", 0) == 0)
+    {
+        mesh = PrimitivesFactory::getIsosphere(static_cast<uint32_t>(std::stoul(model.substr(10))));
+        mesh->computeBoundingBox();
+    }
+    else
+    {
+        mesh = std::make_shared<Mesh>(model);
+        if(mesh->getIndices().empty()) return nullptr;
+    }
+    return mesh;
+}
+
+BenchUtils::Row toRow(const BuildResult& r)
+{
+    return { {"model", r.model}, {"triangles", r.numTriangles}, {"structure", r.structure},
+             {"depth", r.depth}, {"threshold", r.threshold}, {"threads", r.numThreads},
+             {"wall_time_s", r.wallTime}, {"min_wall_time_s", r.minWallTime},
+             {"peak_rss_bytes", r.peakRss}, {"construction_peak_bytes", r.constructionPeak},
+             {"nodes", r.numNodes}, {"bytes", r.numBytes}, {"speedup", r.speedup},
+             {"parallel_efficiency", r.efficiency} };
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    #ifdef SDFLIB_PRINT_STATISTICS
+        spdlog::set_pattern("[%^%l%$] [%s:%#] %v");
+    #else
+        spdlog::set_pattern("[%^%l%$] %v");
+    #endif
+
+    args::ArgumentParser parser("SdfBuildBench measures the construction of the sdf structures over a matrix of parameters", "");
+    args::HelpFlag help(parser, "help", "Display help menu", {'h', "help"});
+    args::ValueFlag<std::string> modelsArg(parser, "models", "Comma separated list of model paths. Use isosphere:N for a procedural sphere with N subdivisions", {"models"});
+    args::ValueFlag<std::string> sdfFormatArg(parser, "sdf_format", "Comma separated list of formats: octree, grid, exact_octree", {"sdf_format"});
+    args::ValueFlag<std::string> depthsArg(parser, "depths", "Comma separated list of octree subdivision depths", {'d', "depths"});
+    args::ValueFlag<uint32_t> startDepthArg(parser, "start_depth", "The octree start depth", {"start_depth"});
+    args::ValueFlag<std::string> thresholdsArg(parser, "termination_thresholds", "Comma separated list of octree generation termination thresholds", {"termination_thresholds"});
+    args::ValueFlag<std::string> octreeAlgorithmArg(parser, "algorithm", "Select the algoirthm to generate the octree. It supports: uniform, no_continuity, continuity", {"algorithm"});
+    args::ValueFlag<uint32_t> minTrianglesPerNode(parser, "min_triangles_per_node", "The minimum acceptable number of triangles per leaf in the octree", {"min_triangles_per_node"});
+    args::ValueFlag<std::string> numThreadsArg(parser, "num_threads", "Comma separated list of thread counts", {"num_threads"});
+    args::ValueFlag<float> bbMarginArg(parser, "bb_margin", "Percentage of margin added between the structure BB and the model BB", {"bb_margin"});
+    args::ValueFlag<uint32_t> repetitionsArg(parser, "repetitions", "Number of times each configuration is built", {"repetitions"});
+    args::ValueFlag<std::string> formatArg(parser, "format", "Output format: json or csv", {"format"});
+    args::ValueFlag<std::string> outputPathArg(parser, "output_path", "Output file, by default the results are printed in the standard output", {'o', "output"});
+
+    try
+    {
+        parser.ParseCLI(argc, argv);
+    }
+    catch(args::Help)
+    {
+        std::cerr << parser;
+        return 0;
+    }
+
+    const std::vector<std::string> models = BenchUtils::splitList((modelsArg) ? args::get(modelsArg) : "isosphere:4");
+    const std::vector<std::string> sdfFormats = BenchUtils::splitList((sdfFormatArg) ? args::get(sdfFormatArg) : "octree,exact_octree");
+    const std::vector<std::string> depths = BenchUtils::splitList((depthsArg) ? args::get(depthsArg) : "6,8");
+    const std::vector<std::string> thresholds = BenchUtils::splitList((thresholdsArg) ? args::get(thresholdsArg) : "1e-3");
+    std::vector<uint32_t> threadsList;
+    for(const std::string& t : BenchUtils::splitList((numThreadsArg) ? args::get(numThreadsArg) : "1,2,4,8"))
+    {
+        threadsList.push_back(glm::max(static_cast<uint32_t>(std::stoul(t)), 1u));
+    }
+    std::sort(threadsList.begin(), threadsList.end());
+    const uint32_t startDepth = (startDepthArg) ? args::get(startDepthArg) : 1;
+    const uint32_t repetitions = glm::max((repetitionsArg) ? args::get(repetitionsArg) : 1u, 1u);
+    const std::string format = (formatArg) ? args::get(formatArg) : "json";
+
+    std::string initAlgorithmStr = (octreeAlgorithmArg) ? args::get(octreeAlgorithmArg) : "continuity";
+    OctreeSdf::InitAlgorithm initAlgorithm;
+    if(initAlgorithmStr == "uniform") initAlgorithm = OctreeSdf::InitAlgorithm::UNIFORM;
+    else if(initAlgorithmStr == "no_continuity") initAlgorithm = OctreeSdf::InitAlgorithm::NO_CONTINUITY;
+    else if(initAlgorithmStr == "continuity") initAlgorithm = OctreeSdf::InitAlgorithm::CONTINUITY;
+    else
+    {
+        std::cerr << initAlgorithmStr << " is not a valid supported octree generation algorithm" << std::endl;
+        return 0;
+    }
+
+    // Keep the standard output clean for the results
+    if(!outputPathArg)
+    {
+        spdlog::set_default_logger(spdlog::stderr_color_mt("stderr"));
+    }
+
+    std::vector<BuildResult> results;
+
+    for(const std::string& model : models)
+    {
+        std::shared_ptr<Mesh> mesh = loadMesh(model);
+        if(mesh == nullptr) continue;
+
+        // Normalize the model like the SdfExporter does
+        BoundingBox box = mesh->getBoundingBox();
+        {
+            const glm::vec3 boxSize = box.getSize();
+            const float maxSize = glm::max(glm::max(boxSize.x, boxSize.y), boxSize.z);
+            mesh->applyTransform(glm::scale(glm::mat4(1.0), glm::vec3(2.0f/maxSize)) *
+                                 glm::translate(glm::mat4(1.0), -box.getCenter()));
+            box = mesh->getBoundingBox();
+        }
+
+        const glm::vec3 modelBBSize = box.getSize();
+        const float margin = ((bbMarginArg) ? args::get(bbMarginArg) : 20.0f) / 100.0f;
+        box.addMargin(margin * glm::max(glm::max(modelBBSize.x, modelBBSize.y), modelBBSize.z));
+
+        const uint32_t numTriangles = mesh->getIndices().size() / 3;
+
+        for(const std::string& sdfFormat : sdfFormats)
+        {
+            // The threshold only affects the approximated octree
+            const std::vector<std::string> formatThresholds = (sdfFormat == "octree") ? thresholds : std::vector<std::string>{"0"};
+            // The uniform grid is built without threads
+            const std::vector<uint32_t> formatThreads = (sdfFormat == "grid") ? std::vector<uint32_t>{1} : threadsList;
+
+            for(const std::string& depthStr : depths)
+            for(const std::string& thresholdStr : formatThresholds)
+            {
+                const uint32_t depth = static_cast<uint32_t>(std::stoul(depthStr));
+                const float threshold = std::stof(thresholdStr);
+                const size_t firstResult = results.size();
+
+                for(uint32_t numThreads : formatThreads)
+                {
+                    BuildResult res;
+                    res.model = model;
+                    res.numTriangles = numTriangles;
+                    res.structure = sdfFormat;
+                    res.depth = depth;
+                    res.threshold = threshold;
+                    res.numThreads = numThreads;
+                    res.peakRss = 0;
+                    res.constructionPeak = 0;
+
+                    std::vector<float> times;
+                    for(uint32_t r=0; r < repetitions; r++)
+                    {
+                        resetPeakRss();
+                        Timer timer;
+                        std::unique_ptr<SdfFunction> sdfFunc;
+                        if(sdfFormat == "grid")
+                        {
+                            timer.start();
+                            sdfFunc = std::make_unique<UniformGridSdf>(*mesh, box, depth, UniformGridSdf::InitAlgorithm::OCTREE);
+                        }
+                        else if(sdfFormat == "octree")
+                        {
+                            timer.start();
+                            sdfFunc = std::make_unique<OctreeSdf>(*mesh, box, depth, startDepth, threshold,
+                                                                  initAlgorithm, numThreads);
+                        }
+                        else if(sdfFormat == "exact_octree")
+                        {
+                            timer.start();
+                            sdfFunc = std::make_unique<ExactOctreeSdf>(*mesh, box, depth, startDepth,
+                                                                       (minTrianglesPerNode) ? args::get(minTrianglesPerNode) : 32,
+                                                                       numThreads);
+                        }
+                        else
+                        {
+                            SPDLOG_ERROR("Unknown sdf format {}", sdfFormat);
+                            break;
+                        }
+                        times.push_back(timer.getElapsedSeconds());
+                        res.peakRss = std::max(res.peakRss, getPeakRss());
+
+                        if(r == 0)
+                        {
+                            if(sdfFormat == "grid")
+                            {
+                                const UniformGridSdf& grid = static_cast<const UniformGridSdf&>(*sdfFunc);
+                                res.numNodes = grid.getGrid().size();
+                            }
+                            else if(sdfFormat == "octree")
+                            {
+                                const OctreeSdf& octree = static_cast<const OctreeSdf&>(*sdfFunc);
+                                res.numNodes = countOctreeNodes(octree);
+                            }
+                            else
+                            {
+                                ExactOctreeSdf& octree = static_cast<ExactOctreeSdf&>(*sdfFunc);
+                                res.numNodes = octree.getOctreeData().size();
+                            }
+
+                            const MemoryUsage usage = sdfFunc->memoryUsage();
+                            res.numBytes = usage.getTotal();
+                            res.constructionPeak = usage.constructionPeak;
+                        }
+                    }
+
+                    if(times.empty()) break;
+                    std::sort(times.begin(), times.end());
+                    res.wallTime = times[times.size() / 2];
+                    res.minWallTime = times.front();
+                    res.speedup = 1.0f;
+                    res.efficiency = 1.0f;
+                    results.push_back(res);
+
+                    SPDLOG_INFO("{} {} depth {} threshold {} threads {}: {}s, {} nodes, {}MB",
+                                model, sdfFormat, depth, threshold, numThreads, res.wallTime,
+                                res.numNodes, static_cast<float>(res.numBytes) / 1048576.0f);
+                }
+
+                // The parallel efficiency is relative to the configuration with less threads
+                if(firstResult < results.size())
+                {
+                    const BuildResult& base = results[firstResult];
+                    for(size_t i=firstResult; i < results.size(); i++)
+                    {
+                        BuildResult& r = results[i];
+                        r.speedup = base.wallTime / r.wallTime;
+                        r.efficiency = r.speedup * static_cast<float>(base.numThreads) / static_cast<float>(r.numThreads);
+                    }
+                }
+            }
+        }
+    }
+
+    std::vector<BenchUtils::Row> rows;
+    for(const BuildResult& result : results) rows.push_back(toRow(result));
+
+    if(outputPathArg)
+    {
+        std::ofstream file(args::get(outputPathArg));
+        if(!file.is_open())
+        {
+            SPDLOG_ERROR("Cannot open the output file {}", args::get(outputPathArg));
+            return 1;
+        }
+        if(format == "csv") BenchUtils::writeCsv(file, rows);
+        else BenchUtils::writeJson(file, rows);
+    }
+    else
+    {
+        if(format == "csv") BenchUtils::writeCsv(std::cout, rows);
+        else BenchUtils::writeJson(std::cout, rows);
+    }
+
+    return 0;
+}
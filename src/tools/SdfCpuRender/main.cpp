@@ -0,0 +1,386 @@
+#include <iostream>
+#include <fstream>
+#include <memory>
+#include <vector>
+#include <string>
+#include <args.hxx>
+#include <spdlog/spdlog.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "SdfLib/OctreeSdf.h"
+#include "SdfLib/ExactOctreeSdf.h"
+#include "SdfLib/utils/Mesh.h"
+#include "SdfLib/utils/PrimitivesFactory.h"
+#include "SdfLib/utils/Timer.h"
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb/stb_image_write.h"
+#include "../BenchUtils.h"
+
+#ifdef OPENMP_AVAILABLE
+#include <omp.h>
+#endif
+
+using namespace sdflib;
+
+namespace
+{
+
+struct RenderSettings
+{
+    uint32_t width;
+    uint32_t height;
+    uint32_t tileSize;
+    uint32_t maxSteps;
+    bool shadows;
+    bool ambientOcclusion;
+    glm::vec3 cameraPos;
+    glm::mat3 cameraRotation; // Columns: right, up and backward directions
+    float tanHalfFov;
+    glm::vec3 lightPos;
+};
+
+// Number of queries of each type done by a thread, aligned to a cache line to avoid false sharing
+struct alignas(64) RenderCounters
+{
+    uint64_t primaryRays = 0;
+    uint64_t hits = 0;
+    uint64_t shadowRays = 0;
+    uint64_t queries = 0;
+};
+
+/**
+ * @brief Casts the rays of the image tiles against a distance field,
+ *        with a simplified version of the sdfOctreeLight shader shading
+ **/
+class CpuRenderer
+{
+public:
+    CpuRenderer(const SdfFunction& sdf, const RenderSettings& settings)
+        : mSdf(sdf), mSettings(settings)
+    {
+        mBox = sdf.getSampleArea();
+        const glm::vec3 boxSize = mBox.getSize();
+        mBoxSize = glm::max(glm::max(boxSize.x, boxSize.y), boxSize.z);
+    }
+
+    glm::vec3 renderPixel(uint32_t x, uint32_t y, RenderCounters& counters) const
+    {
+        const glm::vec2 ndc = 2.0f * (glm::vec2(x, y) + 0.5f) / glm::vec2(mSettings.width, mSettings.height) - 1.0f;
+        const float aspectRatio = static_cast<float>(mSettings.width) / static_cast<float>(mSettings.height);
+        const glm::vec3 dir = glm::normalize(mSettings.cameraRotation *
+                                             glm::vec3(ndc.x * aspectRatio * mSettings.tanHalfFov, -ndc.y * mSettings.tanHalfFov, -1.0f));
+
+        counters.primaryRays++;
+        // The rays hit the surface when the distance is below the pixel footprint
+        const float pixelAngle = 2.0f * mSettings.tanHalfFov / static_cast<float>(mSettings.height);
+        float t;
+        if(!raymarch(mSettings.cameraPos, dir, pixelAngle, t, counters))
+        {
+            // Same background than the viewers
+            return glm::vec3(0.9f);
+        }
+
+        counters.hits++;
+        return shade(mSettings.cameraPos + t * dir, dir, counters);
+    }
+
+private:
+    const SdfFunction& mSdf;
+    const RenderSettings& mSettings;
+    BoundingBox mBox;
+    float mBoxSize;
+
+    bool intersectBox(glm::vec3 origin, glm::vec3 dir, float& tNear, float& tFar) const
+    {
+        const glm::vec3 invDir = 1.0f / dir;
+        const glm::vec3 t0 = (mBox.min - origin) * invDir;
+        const glm::vec3 t1 = (mBox.max - origin) * invDir;
+        const glm::vec3 tMin = glm::min(t0, t1);
+        const glm::vec3 tMax = glm::max(t0, t1);
+        tNear = glm::max(glm::max(glm::max(tMin.x, tMin.y), tMin.z), 0.0f);
+        tFar = glm::min(glm::min(tMax.x, tMax.y), tMax.z);
+        return tNear < tFar;
+    }
+
+    bool raymarch(glm::vec3 origin, glm::vec3 dir, float pixelAngle, float& outT, RenderCounters& counters) const
+    {
+        float tNear, tFar;
+        if(!intersectBox(origin, dir, tNear, tFar)) return false;
+
+        const float minThreshold = 1e-5f * mBoxSize;
+        float t = tNear;
+        for(uint32_t i=0; i < mSettings.maxSteps && t < tFar; i++)
+        {
+            const float dist = mSdf.getDistance(origin + t * dir);
+            counters.queries++;
+            if(dist < glm::max(pixelAngle * t, minThreshold))
+            {
+                outT = t;
+                return true;
+            }
+            t += glm::max(dist, minThreshold);
+        }
+        return false;
+    }
+
+    float softShadow(glm::vec3 origin, glm::vec3 dir, float far, RenderCounters& counters) const
+    {
+        counters.shadowRays++;
+        float tNear, tFar;
+        if(!intersectBox(origin, dir, tNear, tFar)) return 1.0f;
+        tFar = glm::min(tFar, far);
+
+        float res = 1.0f;
+        float t = glm::max(tNear, 5e-3f * mBoxSize);
+        for(uint32_t i=0; i < mSettings.maxSteps && t < tFar; i++)
+        {
+            const float h = mSdf.getDistance(origin + t * dir);
+            counters.queries++;
+            if(h < 1e-3f * mBoxSize) return 0.0f;
+            res = glm::min(res, 8.0f * h / t);
+            t += h;
+        }
+        return res;
+    }
+
+    float ambientOcclusion(glm::vec3 pos, glm::vec3 normal, RenderCounters& counters) const
+    {
+        float occ = 0.0f;
+        for(uint32_t i=0; i < 8; i++)
+        {
+            const float h = mBoxSize * (0.005f + 0.05f * static_cast<float>(i) / 8.0f);
+            const float d = glm::max(mSdf.getDistance(pos + normal * h), 0.0f);
+            occ += glm::max(h - d, 0.0f) / mBoxSize;
+        }
+        counters.queries += 8;
+        return glm::max(1.0f - 1.7f * occ, 0.0f);
+    }
+
+    glm::vec3 shade(glm::vec3 pos, glm::vec3 rayDir, RenderCounters& counters) const
+    {
+        const glm::vec3 albedo(0.72f, 0.45f, 0.20f);
+
+        glm::vec3 gradient;
+        mSdf.getDistance(pos, gradient);
+        counters.queries++;
+        const float gradientLength = glm::length(gradient);
+        const glm::vec3 N = (gradientLength > 1e-8f) ? gradient / gradientLength : -rayDir;
+        const glm::vec3 V = -rayDir;
+
+        const float distToLight = glm::length(mSettings.lightPos - pos);
+        const glm::vec3 L = (mSettings.lightPos - pos) / distToLight;
+        const glm::vec3 H = glm::normalize(V + L);
+
+        const float NdotL = glm::max(glm::dot(N, L), 0.0f);
+        float intensity = 1.0f;
+        if(mSettings.shadows && NdotL > 0.0f)
+        {
+            intensity = softShadow(pos + 3e-4f * mBoxSize * N, L, distToLight, counters);
+        }
+
+        const float specular = 0.3f * glm::pow(glm::max(glm::dot(N, H), 0.0f), 32.0f);
+        const glm::vec3 radiance = 3.0f * glm::vec3(1.0f, 0.8f, 0.6f) * intensity;
+        const float ao = (mSettings.ambientOcclusion) ? ambientOcclusion(pos, N, counters) : 1.0f;
+
+        glm::vec3 color = 0.5f * albedo * ao + (albedo + specular) * radiance * NdotL;
+
+        // Tone mapping and gamma correction
+        color = color / (color + glm::vec3(1.0f));
+        return glm::pow(color, glm::vec3(1.0f / 2.2f));
+    }
+};
+
+}
+
+int main(int argc, char** argv)
+{
+    #ifdef SDFLIB_PRINT_STATISTICS
+        spdlog::set_pattern("[%^%l%$] [%s:%#] %v");
+    #else
+        spdlog::set_pattern("[%^%l%$] %v");
+    #endif
+
+    args::ArgumentParser parser("SdfCpuRender ray marches an sdf in the CPU and stores the image", "");
+    args::HelpFlag help(parser, "help", "Display help menu", {'h', "help"});
+    args::Positional<std::string> sdfPathArg(parser, "sdf_path", "The sdf path");
+    args::ValueFlag<std::string> outputPathArg(parser, "output_path", "The PNG image path", {'o', "output"});
+    args::ValueFlag<uint32_t> isosphereArg(parser, "isosphere", "Render an octree built over an isosphere with this number of subdivisions instead of loading an sdf", {"isosphere"});
+    args::ValueFlag<uint32_t> depthArg(parser, "depth", "The octree subdivision depth of the isosphere", {'d', "depth"});
+    args::ValueFlag<uint32_t> widthArg(parser, "width", "Image width", {"width"});
+    args::ValueFlag<uint32_t> heightArg(parser, "height", "Image height", {"height"});
+    args::ValueFlag<uint32_t> tileSizeArg(parser, "tile_size", "Size of the square tiles distributed between the threads", {"tile_size"});
+    args::ValueFlag<uint32_t> maxStepsArg(parser, "max_steps", "Maximum number of steps of each ray", {"max_steps"});
+    args::ValueFlag<uint32_t> framesArg(parser, "frames", "Number of times the image is rendered to measure the time", {"frames"});
+    args::ValueFlag<uint32_t> numThreadsArg(parser, "num_threads", "Number of rendering threads", {"num_threads"});
+    args::ValueFlag<float> yawArg(parser, "yaw", "Camera rotation around the vertical axis in degrees", {"yaw"});
+    args::ValueFlag<float> pitchArg(parser, "pitch", "Camera elevation in degrees", {"pitch"});
+    args::ValueFlag<float> fovArg(parser, "fov", "Camera vertical field of view in degrees", {"fov"});
+    args::Flag noShadowsArg(parser, "no_shadows", "Disable the soft shadows", {"no_shadows"});
+    args::Flag noAOArg(parser, "no_ao", "Disable the ambient occlusion", {"no_ao"});
+    args::ValueFlag<std::string> statsPathArg(parser, "stats_path", "Store the rendering statistics in a JSON file", {"stats"});
+
+    try
+    {
+        parser.ParseCLI(argc, argv);
+    }
+    catch(args::Help)
+    {
+        std::cerr << parser;
+        return 0;
+    }
+
+    std::unique_ptr<SdfFunction> sdf;
+    if(isosphereArg)
+    {
+        std::shared_ptr<Mesh> mesh = PrimitivesFactory::getIsosphere(args::get(isosphereArg));
+        mesh->computeBoundingBox();
+        BoundingBox box = mesh->getBoundingBox();
+        const glm::vec3 modelBBSize = box.getSize();
+        box.addMargin(0.2f * glm::max(glm::max(modelBBSize.x, modelBBSize.y), modelBBSize.z));
+        sdf = std::make_unique<OctreeSdf>(*mesh, box, (depthArg) ? args::get(depthArg) : 6, 3, 1e-3f,
+                                          OctreeSdf::InitAlgorithm::CONTINUITY,
+                                          (numThreadsArg) ? args::get(numThreadsArg) : 1);
+    }
+    else if(sdfPathArg)
+    {
+        sdf = SdfFunction::loadFromFile(args::get(sdfPathArg));
+    }
+    else
+    {
+        std::cerr << "An sdf path or the isosphere option is needed" << std::endl;
+        return 1;
+    }
+
+    if(sdf == nullptr)
+    {
+        SPDLOG_ERROR("The sdf could not be loaded");
+        return 1;
+    }
+
+    const std::string outputPath = (outputPathArg) ? args::get(outputPathArg) : "render.png";
+    const uint32_t numFrames = glm::max((framesArg) ? args::get(framesArg) : 1u, 1u);
+    uint32_t numThreads = glm::max((numThreadsArg) ? args::get(numThreadsArg) : 1u, 1u);
+
+    RenderSettings settings;
+    settings.width = glm::max((widthArg) ? args::get(widthArg) : 512u, 1u);
+    settings.height = glm::max((heightArg) ? args::get(heightArg) : 512u, 1u);
+    settings.tileSize = glm::max((tileSizeArg) ? args::get(tileSizeArg) : 16u, 1u);
+    settings.maxSteps = (maxStepsArg) ? args::get(maxStepsArg) : 256;
+    settings.shadows = !noShadowsArg;
+    settings.ambientOcclusion = !noAOArg;
+    settings.tanHalfFov = glm::tan(0.5f * glm::radians((fovArg) ? args::get(fovArg) : 45.0f));
+
+    // Orbit camera looking at the center of the structure
+    const BoundingBox box = sdf->getSampleArea();
+    const glm::vec3 boxCenter = box.getCenter();
+    const float boxSize = glm::max(glm::max(box.getSize().x, box.getSize().y), box.getSize().z);
+    {
+        const float yaw = glm::radians((yawArg) ? args::get(yawArg) : 30.0f);
+        const float pitch = glm::radians(glm::clamp((pitchArg) ? args::get(pitchArg) : 20.0f, -90.0f, 90.0f));
+        const glm::vec3 backward(glm::cos(pitch) * glm::sin(yaw), glm::sin(pitch), glm::cos(pitch) * glm::cos(yaw));
+        const float cameraDistance = 0.6f * boxSize / settings.tanHalfFov;
+        settings.cameraPos = boxCenter + cameraDistance * backward;
+        // The right direction only depends on the yaw, so the basis is also valid looking straight up or down
+        const glm::vec3 right(glm::cos(yaw), 0.0f, -glm::sin(yaw));
+        const glm::vec3 up = glm::cross(backward, right);
+        settings.cameraRotation = glm::mat3(right, up, backward);
+    }
+    settings.lightPos = boxCenter + boxSize * glm::vec3(0.37f, 0.93f, 0.59f);
+
+    #ifndef OPENMP_AVAILABLE
+    numThreads = 1;
+    #endif
+
+    // The renderer is read only, each thread only needs its own counters
+    const CpuRenderer renderer(*sdf, settings);
+
+    const uint32_t tilesX = (settings.width + settings.tileSize - 1) / settings.tileSize;
+    const uint32_t tilesY = (settings.height + settings.tileSize - 1) / settings.tileSize;
+    const int64_t numTiles = static_cast<int64_t>(tilesX) * tilesY;
+
+    std::vector<uint8_t> image(3 * settings.width * settings.height);
+    std::vector<RenderCounters> counters(numThreads);
+    std::vector<float> framesTime;
+
+    for(uint32_t f=0; f < numFrames; f++)
+    {
+        Timer timer;
+        timer.start();
+        #ifdef OPENMP_AVAILABLE
+        #pragma omp parallel for num_threads(numThreads) schedule(dynamic, 1)
+        #endif
+        for(int64_t tile=0; tile < numTiles; tile++)
+        {
+            #ifdef OPENMP_AVAILABLE
+            const uint32_t tId = omp_get_thread_num();
+            #else
+            const uint32_t tId = 0;
+            #endif
+            const uint32_t startX = (tile % tilesX) * settings.tileSize;
+            const uint32_t startY = (tile / tilesX) * settings.tileSize;
+            const uint32_t endX = glm::min(startX + settings.tileSize, settings.width);
+            const uint32_t endY = glm::min(startY + settings.tileSize, settings.height);
+            for(uint32_t y=startY; y < endY; y++)
+            {
+                for(uint32_t x=startX; x < endX; x++)
+                {
+                    const glm::vec3 color = glm::clamp(renderer.renderPixel(x, y, counters[tId]), 0.0f, 1.0f);
+                    uint8_t* pixel = &image[3 * (y * settings.width + x)];
+                    pixel[0] = static_cast<uint8_t>(255.0f * color.r + 0.5f);
+                    pixel[1] = static_cast<uint8_t>(255.0f * color.g + 0.5f);
+                    pixel[2] = static_cast<uint8_t>(255.0f * color.b + 0.5f);
+                }
+            }
+        }
+        framesTime.push_back(timer.getElapsedSeconds());
+    }
+
+    RenderCounters total;
+    for(const RenderCounters& c : counters)
+    {
+        total.primaryRays += c.primaryRays;
+        total.hits += c.hits;
+        total.shadowRays += c.shadowRays;
+        total.queries += c.queries;
+    }
+
+    float totalTime = 0.0f;
+    for(float t : framesTime) totalTime += t;
+    const float raysPerSecond = static_cast<float>(total.primaryRays) / totalTime;
+    const float queriesPerSecond = static_cast<float>(total.queries) / totalTime;
+
+    SPDLOG_INFO("Rendered {} frames of {}x{} with {} threads in {}s", numFrames, settings.width, settings.height, numThreads, totalTime);
+    SPDLOG_INFO("{:.0f} primary rays/s, {:.0f} shadow rays/s, {:.0f} queries/s, {:.1f} queries per pixel",
+                raysPerSecond, static_cast<float>(total.shadowRays) / totalTime, queriesPerSecond,
+                static_cast<float>(total.queries) / static_cast<float>(total.primaryRays));
+
+    if(!stbi_write_png(outputPath.c_str(), settings.width, settings.height, 3, image.data(), 3 * settings.width))
+    {
+        SPDLOG_ERROR("The image could not be stored in {}", outputPath);
+        return 1;
+    }
+    SPDLOG_INFO("Image stored in {}", outputPath);
+
+    if(statsPathArg)
+    {
+        std::ofstream file(args::get(statsPathArg));
+        if(!file.is_open())
+        {
+            SPDLOG_ERROR("The statistics could not be stored in {}", args::get(statsPathArg));
+            return 1;
+        }
+
+        const std::string model = (isosphereArg) ? "isosphere:" + std::to_string(args::get(isosphereArg)) : args::get(sdfPathArg);
+        BenchUtils::writeJsonObject(file, {
+            {"model", model}, {"width", settings.width}, {"height", settings.height},
+            {"frames", numFrames}, {"threads", numThreads}, {"seconds", totalTime},
+            {"primary_rays", total.primaryRays}, {"hits", total.hits},
+            {"shadow_rays", total.shadowRays}, {"queries", total.queries},
+            {"rays_per_second", raysPerSecond}, {"queries_per_second", queriesPerSecond}
+        });
+    }
+
+    return 0;
+}
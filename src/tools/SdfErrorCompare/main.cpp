@@ -1,5 +1,10 @@
 #include <random>
 #include <vector>
+#include <fstream>
+#include <sstream>
+#include <functional>
+#include <memory>
+#include <cmath>
 #include <args.hxx>
 #include <spdlog/spdlog.h>
 #include <algorithm>
@@ -7,6 +12,7 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <cstring>
+#include <limits>
 
 #include "SdfLib/SdfFunction.h"
 #include "SdfLib/OctreeSdf.h"
@@ -14,12 +20,15 @@
 #include "SdfLib/utils/Timer.h"
 #include "SdfLib/utils/Mesh.h"
 
+#ifdef OPENMP_AVAILABLE
+#include <omp.h>
+#endif
+
 using namespace sdflib;
 
 //#define TEST_ICG
 //#define TEST_CGAL
 #define TEST_OCTREE_SDF
-#define TEST_EXACT_OCTREE_SDF
 // #define TEST_OPENVDB
 
 #ifdef TEST_ICG
@@ -96,6 +105,8 @@ public:
         }
 
         tree = Tree(triangles.begin(), triangles.end());
+        // Build the search structure now, it cannot be built lazily during the parallel queries
+        tree.accelerate_distance_queries();
     }
 
     inline float getDistance(glm::vec3 samplePoint)
@@ -137,7 +148,256 @@ private:
 //     std::cout << value << std::endl;
 // }
 
-#define MAKE_HISTOGRAM
+namespace
+{
+
+/**
+ * @brief Accumulates the error statistics of a set of samples.
+ *        The percentiles are estimated with a logarithmic histogram to keep
+ *        a constant memory usage independently of the number of samples.
+ **/
+struct ErrorStats
+{
+    static constexpr uint32_t BINS_PER_DECADE = 100;
+    static constexpr int MIN_DECADE = -10;
+    static constexpr uint32_t NUM_BINS = 10 * BINS_PER_DECADE;
+
+    uint64_t count = 0;
+    double sumAbs = 0.0;
+    double sumSq = 0.0;
+    double sumSqSq = 0.0;
+    float maxError = 0.0f;
+    std::vector<uint64_t> histogram = std::vector<uint64_t>(NUM_BINS, 0);
+
+    inline void add(float error)
+    {
+        const double absError = static_cast<double>(glm::abs(error));
+        const double sqError = absError * absError;
+        count++;
+        sumAbs += absError;
+        sumSq += sqError;
+        sumSqSq += sqError * sqError;
+        maxError = glm::max(maxError, static_cast<float>(absError));
+
+        const int bin = (absError > 0.0)
+                        ? static_cast<int>(std::floor((std::log10(absError) - MIN_DECADE) * BINS_PER_DECADE))
+                        : 0;
+        histogram[glm::clamp(bin, 0, static_cast<int>(NUM_BINS) - 1)]++;
+    }
+
+    void merge(const ErrorStats& other)
+    {
+        count += other.count;
+        sumAbs += other.sumAbs;
+        sumSq += other.sumSq;
+        sumSqSq += other.sumSqSq;
+        maxError = glm::max(maxError, other.maxError);
+        for(uint32_t i=0; i < NUM_BINS; i++) histogram[i] += other.histogram[i];
+    }
+
+    double getMAE() const { return (count > 0) ? sumAbs / static_cast<double>(count) : 0.0; }
+    double getRMSE() const { return (count > 0) ? std::sqrt(sumSq / static_cast<double>(count)) : 0.0; }
+
+    // Half width of the 95% confidence interval of the mean absolute error
+    double getMAEConfidence() const
+    {
+        if(count < 2) return 0.0;
+        const double n = static_cast<double>(count);
+        const double mean = sumAbs / n;
+        const double variance = glm::max(sumSq / n - mean * mean, 0.0);
+        return 1.96 * std::sqrt(variance / n);
+    }
+
+    // 95% confidence interval of the RMSE computed from the interval of the mean squared error
+    std::pair<double, double> getRMSEConfidence() const
+    {
+        if(count < 2) return std::make_pair(getRMSE(), getRMSE());
+        const double n = static_cast<double>(count);
+        const double mean = sumSq / n;
+        const double variance = glm::max(sumSqSq / n - mean * mean, 0.0);
+        const double halfWidth = 1.96 * std::sqrt(variance / n);
+        return std::make_pair(std::sqrt(glm::max(mean - halfWidth, 0.0)), std::sqrt(mean + halfWidth));
+    }
+
+    // Returns the upper limit of the histogram bin containing the percentile
+    double getPercentile(double p) const
+    {
+        if(count == 0) return 0.0;
+        const uint64_t target = static_cast<uint64_t>(std::ceil(p * static_cast<double>(count)));
+        uint64_t accum = 0;
+        for(uint32_t i=0; i < NUM_BINS; i++)
+        {
+            accum += histogram[i];
+            if(accum >= target)
+            {
+                return glm::min(std::pow(10.0, static_cast<double>(i + 1) / BINS_PER_DECADE + MIN_DECADE),
+                                static_cast<double>(maxError));
+            }
+        }
+        return static_cast<double>(maxError);
+    }
+};
+
+// Statistics of one method for each sampling strategy, distance region and octree leaf depth
+struct MethodStats
+{
+    MethodStats(uint32_t numRegions, uint32_t numDepths)
+        : uniform(numRegions + 1), nearSurface(numRegions + 1), depths(numDepths)
+    {}
+
+    std::vector<ErrorStats> uniform; // The last element contains all the uniform samples
+    std::vector<ErrorStats> nearSurface; // The last element contains all the near surface samples
+    std::vector<ErrorStats> depths; // All the samples grouped by the depth of the leaf containing them
+    double queryTime = 0.0;
+    uint64_t numQueries = 0;
+
+    void merge(const MethodStats& other)
+    {
+        for(uint32_t i=0; i < uniform.size(); i++) uniform[i].merge(other.uniform[i]);
+        for(uint32_t i=0; i < nearSurface.size(); i++) nearSurface[i].merge(other.nearSurface[i]);
+        for(uint32_t i=0; i < depths.size(); i++) depths[i].merge(other.depths[i]);
+        queryTime += other.queryTime;
+        numQueries += other.numQueries;
+    }
+};
+
+// Evaluates distances, one instance is created per thread
+typedef std::function<float(glm::vec3)> DistanceEvaluator;
+
+// Returns the depth of the octree leaf containing a point, or NO_DEPTH if the point is outside the octree
+typedef std::function<uint32_t(glm::vec3)> DepthEvaluator;
+constexpr uint32_t NO_DEPTH = std::numeric_limits<uint32_t>::max();
+
+struct Method
+{
+    std::string name;
+    std::function<DistanceEvaluator()> createEvaluator;
+    DepthEvaluator getLeafDepth; // Only set for the methods using an octree
+    uint32_t numDepths = 0;
+};
+
+/**
+ * @brief Returns a function creating evaluators of the sdf. The structures queries are thread safe,
+ *        so all the evaluators share the same structure.
+ **/
+std::function<DistanceEvaluator()> getSdfEvaluatorFactory(const SdfFunction& sdf)
+{
+    return [&sdf]() -> DistanceEvaluator
+    {
+        return [&sdf](glm::vec3 p) { return sdf.getDistance(p); };
+    };
+}
+
+/**
+ * @brief Returns a function computing the depth of the leaf containing each point, 
+ *        following the same path as the octree queries
+ **/
+DepthEvaluator getOctreeDepthEvaluator(const OctreeSdf& octree)
+{
+    const glm::ivec3 startGridSize = octree.getStartGridSize();
+    const uint32_t maxGridSize = glm::max(glm::max(startGridSize.x, startGridSize.y), startGridSize.z);
+    const uint32_t startDepth = static_cast<uint32_t>(glm::round(glm::log2(static_cast<float>(maxGridSize))));
+    const float startGridCellSize = octree.getGridBoundingBox().getSize().x / static_cast<float>(startGridSize.x);
+
+    return [&octree, startGridSize, startDepth, startGridCellSize](glm::vec3 p) -> uint32_t
+    {
+        const std::vector<OctreeSdf::OctreeNode>& data = octree.getOctreeData();
+        glm::vec3 fracPart = (p - octree.getGridBoundingBox().min) / startGridCellSize;
+        const glm::ivec3 startArrayPos = glm::floor(fracPart);
+        fracPart = glm::fract(fracPart);
+
+        if(glm::any(glm::lessThan(startArrayPos, glm::ivec3(0))) || 
+           glm::any(glm::greaterThanEqual(startArrayPos, startGridSize)))
+        {
+            return NO_DEPTH;
+        }
+
+        const OctreeSdf::OctreeNode* node = &data[startArrayPos.z * startGridSize.x * startGridSize.y + 
+                                                  startArrayPos.y * startGridSize.x + startArrayPos.x];
+        uint32_t depth = startDepth;
+        while(!node->isLeaf())
+        {
+            const uint32_t childIdx = ((fracPart.z > 0.5f) ? 4 : 0) + 
+                                      ((fracPart.y > 0.5f) ? 2 : 0) + 
+                                      ((fracPart.x > 0.5f) ? 1 : 0);
+            node = &data[node->getChildrenIndex() + childIdx];
+            fracPart = glm::fract(2.0f * fracPart);
+            depth++;
+        }
+        return depth;
+    };
+}
+
+std::vector<float> splitFloatList(const std::string& str)
+{
+    std::vector<float> res;
+    std::stringstream ss(str);
+    std::string item;
+    while(std::getline(ss, item, ','))
+    {
+        if(!item.empty()) res.push_back(std::stof(item));
+    }
+    return res;
+}
+
+void writeStatsJson(std::ostream& out, const ErrorStats& stats, const std::string& indent)
+{
+    const std::pair<double, double> rmseInterval = stats.getRMSEConfidence();
+    out << indent << "\"samples\": " << stats.count << ",\n"
+        << indent << "\"mae\": " << stats.getMAE() << ",\n"
+        << indent << "\"mae_ci95\": [" << stats.getMAE() - stats.getMAEConfidence() << ", " << stats.getMAE() + stats.getMAEConfidence() << "],\n"
+        << indent << "\"rmse\": " << stats.getRMSE() << ",\n"
+        << indent << "\"rmse_ci95\": [" << rmseInterval.first << ", " << rmseInterval.second << "],\n"
+        << indent << "\"p50\": " << stats.getPercentile(0.5) << ",\n"
+        << indent << "\"p90\": " << stats.getPercentile(0.9) << ",\n"
+        << indent << "\"p99\": " << stats.getPercentile(0.99) << ",\n"
+        << indent << "\"p999\": " << stats.getPercentile(0.999) << ",\n"
+        << indent << "\"max\": " << stats.maxError << "\n";
+}
+
+void writeStrategyJson(std::ostream& out, const std::vector<ErrorStats>& stats, const std::vector<float>& regions)
+{
+    out << "      {\n        \"all\": {\n";
+    writeStatsJson(out, stats.back(), "          ");
+    out << "        },\n        \"regions\": [\n";
+    for(uint32_t r=0; r < regions.size() + 1; r++)
+    {
+        out << "          {\n            \"min_distance\": " << ((r == 0) ? 0.0f : regions[r - 1]) << ",\n"
+            << "            \"max_distance\": ";
+        if(r < regions.size()) out << regions[r]; else out << "null";
+        out << ",\n";
+        writeStatsJson(out, stats[r], "            ");
+        out << "          }" << ((r < regions.size()) ? ",\n" : "\n");
+    }
+    out << "        ]\n      }";
+}
+
+void writeDepthsJson(std::ostream& out, const std::vector<ErrorStats>& depths)
+{
+    // Only the depths containing leaves are written
+    std::vector<uint32_t> usedDepths;
+    for(uint32_t d=0; d < depths.size(); d++)
+    {
+        if(depths[d].count > 0) usedDepths.push_back(d);
+    }
+
+    for(uint32_t i=0; i < usedDepths.size(); i++)
+    {
+        out << "        {\n          \"depth\": " << usedDepths[i] << ",\n";
+        writeStatsJson(out, depths[usedDepths[i]], "          ");
+        out << "        }" << ((i + 1 < usedDepths.size()) ? ",\n" : "\n");
+    }
+}
+
+void printStats(const std::string& name, const ErrorStats& stats)
+{
+    const std::pair<double, double> rmseInterval = stats.getRMSEConfidence();
+    SPDLOG_INFO("{} samples: {}, RMSE: {} [{}, {}], MAE: {} +- {}, p99: {}, max error: {}", name, stats.count,
+                stats.getRMSE(), rmseInterval.first, rmseInterval.second,
+                stats.getMAE(), stats.getMAEConfidence(), stats.getPercentile(0.99), stats.maxError);
+}
+
+}
 
 int main(int argc, char** argv)
 {
@@ -153,6 +413,12 @@ int main(int argc, char** argv)
     args::Positional<std::string> exactSdfPathArg(parser, "exact_sdf_path", "Exact sdf path");
     args::Positional<std::string> modelPathArg(parser, "model_path", "Mesh model path");
     args::Positional<uint32_t> millionsOfSamplesArg(parser, "num_samples_in_millions", "Number of samples to made in millions");
+    args::ValueFlag<uint32_t> numThreadsArg(parser, "num_threads", "Set the application maximum number of threads", {"num_threads"});
+    args::ValueFlag<uint32_t> seedArg(parser, "seed", "Seed of the samples generator", {"seed"});
+    args::ValueFlag<float> nearSurfaceRatioArg(parser, "near_surface_ratio", "Fraction of the samples placed near the model surface", {"near_surface_ratio"});
+    args::ValueFlag<float> bandArg(parser, "band", "Standard deviation of the near surface samples offset relative to the model diagonal", {"band"});
+    args::ValueFlag<std::string> regionsArg(parser, "regions", "Comma separated distances to the surface, relative to the model diagonal, limiting the error regions. The octree errors are also reported by leaf depth", {"regions"});
+    args::ValueFlag<std::string> outputPathArg(parser, "output_path", "Path of the JSON report", {'o', "output"});
 
     try
     {
@@ -164,27 +430,6 @@ int main(int argc, char** argv)
         return 0;
     }
 
-#ifdef MAKE_HISTOGRAM
-    std::array<float, 40> histMeanTimeExact;
-	histMeanTimeExact.fill(0.0f);
-
-    std::array<float, 40> histMeanTimeICG;
-	histMeanTimeICG.fill(0.0f);
-
-    std::array<float, 40> histMeanTimeCGAL;
-	histMeanTimeCGAL.fill(0.0f);
-
-    std::array<float, 40> histRSMEOctreeSdf;
-    histRSMEOctreeSdf.fill(0.0f);
-    std::array<uint32_t, 40> histNumSamplesOctreeSdf;
-    histNumSamplesOctreeSdf.fill(0);
-
-    std::array<float, 40> histRSMEOpenVdb;
-    histRSMEOpenVdb.fill(0.0f);
-    std::array<uint32_t, 40> histNumSamplesOpenVdb;
-    histNumSamplesOpenVdb.fill(0);
-	
-#endif
     Mesh mesh(args::get(modelPathArg));
 
     // Normalize model units
@@ -193,22 +438,29 @@ int main(int argc, char** argv)
                                     glm::translate(glm::mat4(1.0), -mesh.getBoundingBox().getCenter()));
     
     BoundingBox box = mesh.getBoundingBox();
-    float invModelDiagonal = 1.0f / glm::length(box.getSize());
-    // float invModelDiagonal = 1.0f;
+    const float modelDiagonal = glm::length(box.getSize());
+    const float invModelDiagonal = 1.0f / modelDiagonal;
+
+    Timer timer;
+    std::vector<Method> methods;
+
 #ifdef TEST_OCTREE_SDF
     std::unique_ptr<SdfFunction> sdf = SdfFunction::loadFromFile(args::get(sdfPathArg));
+    if(sdf == nullptr) return 1;
     box = sdf->getSampleArea();
+    methods.push_back(Method{ "sdf", getSdfEvaluatorFactory(*sdf) });
+    if(sdf->getFormat() == SdfFunction::SdfFormat::OCTREE)
+    {
+        const OctreeSdf& octree = *static_cast<OctreeSdf*>(sdf.get());
+        methods.back().getLeafDepth = getOctreeDepthEvaluator(octree);
+        methods.back().numDepths = octree.getOctreeMaxDepth() + 1;
+    }
 #endif
 
-#ifdef TEST_EXACT_OCTREE_SDF
     std::unique_ptr<SdfFunction> exactSdf = SdfFunction::loadFromFile(args::get(exactSdfPathArg));
+    if(exactSdf == nullptr) return 1;
     box = exactSdf->getSampleArea();
-    exactSdf->getDistance(glm::vec3(0.0f, 0.0f, 0.0f));
-#endif
-
-    float invDiag = 1.0f / glm::length(box.max - box.min);
-
-    Timer timer;
+    std::function<DistanceEvaluator()> createExactEvaluator = getSdfEvaluatorFactory(*exactSdf);
 
 #ifdef TEST_OPENVDB
     openvdb::initialize();
@@ -216,7 +468,7 @@ int main(int argc, char** argv)
     const float voxelSize = box.getSize().x / gridSize;
     float exteriorNarrowBand = gridSize;
     float interiorNarrowBand = gridSize;
-#ifdef TEST_EXACT_OCTREE_SDF
+
     // Compute the smallest narrow bands possible
     exteriorNarrowBand = 0.0f;
     interiorNarrowBand = 0.0f;
@@ -245,7 +497,6 @@ int main(int argc, char** argv)
     // Add error margin and transform to voxel space
     exteriorNarrowBand = (exteriorNarrowBand + box.getSize().x / 32.0f) / voxelSize;
     interiorNarrowBand = (interiorNarrowBand + box.getSize().x / 32.0f) / voxelSize;
-#endif
 
     openvdb::math::Transform::Ptr linearTransform = openvdb::math::Transform::createLinearTransform(voxelSize);
     glm::vec3 gridCenter = box.getCenter() + 0.5f * voxelSize;
@@ -267,294 +518,273 @@ int main(int argc, char** argv)
     vdbGrid->print();
     SPDLOG_INFO("OpenVDB mem usage: {}", vdbGrid->memUsage());
 
-    openvdb::tools::GridSampler<openvdb::FloatGrid, openvdb::tools::BoxSampler> vdbSampler(*vdbGrid);
+    // The grid samplers cache the accessed nodes, each thread needs its own sampler
+    methods.push_back(Method{ "openvdb", [&vdbGrid]() -> DistanceEvaluator
+    {
+        auto sampler = std::make_shared<openvdb::tools::GridSampler<openvdb::FloatGrid, openvdb::tools::BoxSampler>>(*vdbGrid);
+        return [sampler](glm::vec3 p) 
+        { 
+            return static_cast<float>(sampler->wsSample(openvdb::Vec3R(static_cast<double>(p.x), static_cast<double>(p.y), static_cast<double>(p.z))));
+        };
+    }});
 #endif
 
 #ifdef TEST_ICG
 	timer.start();
     ICG icg(mesh);
 	SPDLOG_INFO("ICG init time: {}", timer.getElapsedSeconds());
+    methods.push_back(Method{ "icg", [&icg]() -> DistanceEvaluator { return [&icg](glm::vec3 p) { return icg.getDistance(p); }; } });
 #endif
 
 #ifdef TEST_CGAL
 	timer.start();
     CGALtree cgalTree(mesh);
 	SPDLOG_INFO("CGAL init time: {}", timer.getElapsedSeconds());
+    methods.push_back(Method{ "cgal", [&cgalTree]() -> DistanceEvaluator { return [&cgalTree](glm::vec3 p) { return cgalTree.getDistance(p); }; } });
 #endif
 
 	SPDLOG_INFO("Models Loaded");
 
-    const uint32_t numSamples = 1000000 * ((millionsOfSamplesArg) ? args::get(millionsOfSamplesArg) : 1);
-    // const uint32_t numSamples = 100000 * ((millionsOfSamplesArg) ? args::get(millionsOfSamplesArg) : 1);
-    std::vector<glm::vec3> samples(numSamples);
-    
-    glm::vec3 center = box.getCenter();
-    glm::vec3 size = box.getSize() - glm::vec3(1e-5);
+    const uint64_t numSamples = 1000000ull * ((millionsOfSamplesArg) ? args::get(millionsOfSamplesArg) : 1);
+    const float nearSurfaceRatio = glm::clamp((nearSurfaceRatioArg) ? args::get(nearSurfaceRatioArg) : 0.5f, 0.0f, 1.0f);
+    const float band = ((bandArg) ? args::get(bandArg) : 0.01f) * modelDiagonal;
+    const uint32_t seed = (seedArg) ? args::get(seedArg) : 123;
+    const std::vector<float> regions = splitFloatList((regionsArg) ? args::get(regionsArg) : "0.0025,0.005,0.01,0.02,0.05,0.1");
+    const uint32_t numRegions = regions.size() + 1;
+
+#ifdef OPENMP_AVAILABLE
+    const uint32_t numThreads = (numThreadsArg) ? args::get(numThreadsArg) : omp_get_max_threads();
+#else
+    const uint32_t numThreads = 1;
+#endif
+
+    // The samples are generated in chunks with its own seed, 
+    // this way the results do not depend on the number of threads
+    const uint64_t chunkSize = 1 << 16;
+    const uint64_t numChunks = (numSamples + chunkSize - 1) / chunkSize;
+    const uint64_t numNearSurfaceSamples = static_cast<uint64_t>(nearSurfaceRatio * static_cast<double>(numSamples));
+    const uint64_t numUniformSamples = numSamples - numNearSurfaceSamples;
+
+    // Uniform samples are stratified in a grid of cells, each sample is jittered inside its cell.
+    // All the cells receive the same number of samples, the remaining ones are placed over the whole box
+    // to not favour the first cells
+    const uint32_t strataPerAxis = glm::max(1u, static_cast<uint32_t>(std::floor(std::cbrt(static_cast<double>(numUniformSamples)))));
+    const uint64_t numStrata = static_cast<uint64_t>(strataPerAxis) * strataPerAxis * strataPerAxis;
+    const uint64_t numStratifiedSamples = numStrata * (numUniformSamples / numStrata);
+    const glm::vec3 strataSize = (box.getSize() - glm::vec3(1e-5f)) / static_cast<float>(strataPerAxis);
+
+    // Near surface samples are stratified over the model surface area
+    const std::vector<glm::vec3>& vertices = mesh.getVertices();
+    const std::vector<uint32_t>& indices = mesh.getIndices();
+    const uint32_t numTriangles = indices.size() / 3;
+    std::vector<double> areaCdf(numTriangles);
+    {
+        double accumArea = 0.0;
+        for(uint32_t t=0; t < numTriangles; t++)
+        {
+            const glm::vec3 v1 = vertices[indices[3 * t]];
+            const glm::vec3 v2 = vertices[indices[3 * t + 1]];
+            const glm::vec3 v3 = vertices[indices[3 * t + 2]];
+            accumArea += 0.5 * static_cast<double>(glm::length(glm::cross(v2 - v1, v3 - v1)));
+            areaCdf[t] = accumArea;
+        }
+        for(double& a : areaCdf) a /= accumArea;
+    }
 
-    auto getRandomSample = [&] () -> glm::vec3
+    auto getRegion = [&](float exactDist) -> uint32_t
     {
-        glm::vec3 p =  glm::vec3(static_cast<float>(rand())/static_cast<float>(RAND_MAX),
-                            static_cast<float>(rand())/static_cast<float>(RAND_MAX),
-                            static_cast<float>(rand())/static_cast<float>(RAND_MAX));
-        return center + (p - 0.5f) * size;
+        const float relDist = glm::abs(exactDist) * invModelDiagonal;
+        return static_cast<uint32_t>(std::upper_bound(regions.begin(), regions.end(), relDist) - regions.begin());
     };
 
-    std::generate(samples.begin(), samples.end(), getRandomSample);
-
-#ifdef TEST_OCTREE_SDF
-    std::vector<float> sdfDist(numSamples);
-    timer.start();
-    for(uint32_t s=0; s < numSamples; s++)
+    auto createStats = [&]()
     {
-        sdfDist[s] = sdf->getDistance(samples[s]);
-    }
-    float sdfTimePerSample = (timer.getElapsedSeconds() * 1.0e6f) / static_cast<float>(numSamples);
-	SPDLOG_INFO("Sdf us per query: {}", sdfTimePerSample, timer.getElapsedSeconds());
-#endif
+        std::vector<MethodStats> res;
+        for(const Method& m : methods) res.push_back(MethodStats(numRegions, m.numDepths));
+        return res;
+    };
 
-#ifdef TEST_EXACT_OCTREE_SDF
-    std::vector<float> exactSdfDist(numSamples);
-    timer.start();
-    for(uint32_t s=0; s < numSamples; s++)
-    {
-        exactSdfDist[s] = exactSdf->getDistance(samples[s]);
-    }
-    float exactSdfTimePerSample = (timer.getElapsedSeconds() * 1.0e6f) / static_cast<float>(numSamples);
-	SPDLOG_INFO("Exact Sdf us per query: {}", exactSdfTimePerSample, timer.getElapsedSeconds());
-    SPDLOG_INFO("Exact Sdf: {}s", timer.getElapsedSeconds());
-#endif
+    std::vector<MethodStats> stats = createStats();
+    double exactQueryTime = 0.0;
 
-#ifdef TEST_ICG
-    std::vector<float> exactSdfDist1(numSamples);
     timer.start();
-    for(uint32_t s=0; s < numSamples; s++)
-    {
-        exactSdfDist1[s] = icg.getDistance(samples[s]);
-    }
-    float exact1SdfTimePerSample = (timer.getElapsedSeconds() * 1.0e6f) / static_cast<float>(numSamples);
-	SPDLOG_INFO("ICG us per query: {}", exact1SdfTimePerSample, timer.getElapsedSeconds());
-    SPDLOG_INFO("ICG: {}s", timer.getElapsedSeconds());
+#ifdef OPENMP_AVAILABLE
+    #pragma omp parallel num_threads(numThreads)
 #endif
-
-#ifdef TEST_CGAL
-    std::vector<float> exactSdfDist2(numSamples);
-    timer.start();
-    for(uint32_t s=0; s < numSamples; s++)
     {
-        exactSdfDist2[s] = cgalTree.getDistance(samples[s]);
-    }
-    float exact2SdfTimePerSample = (timer.getElapsedSeconds() * 1.0e6f) / static_cast<float>(numSamples);
-	SPDLOG_INFO("CGal us per query: {}", exact2SdfTimePerSample, timer.getElapsedSeconds());
-    SPDLOG_INFO("CGal: {}s", timer.getElapsedSeconds());
-#endif
+        DistanceEvaluator exactEvaluator = createExactEvaluator();
+        std::vector<DistanceEvaluator> evaluators;
+        for(const Method& m : methods) evaluators.push_back(m.createEvaluator());
 
-#ifdef TEST_OPENVDB
-    std::vector<float> sdfDist2(numSamples);
-    timer.start();
-    for(uint32_t s=0; s < numSamples; s++)
-    {
-        sdfDist2[s] = vdbSampler.wsSample(openvdb::Vec3R(static_cast<double>(samples[s].x), static_cast<double>(samples[s].y), static_cast<double>(samples[s].z)));
-    }
-    float exact3SdfTimePerSample = (timer.getElapsedSeconds() * 1.0e6f) / static_cast<float>(numSamples);
-	SPDLOG_INFO("OpenVDB us per query: {}", exact3SdfTimePerSample, timer.getElapsedSeconds());
+        std::vector<MethodStats> threadStats = createStats();
+        double threadExactQueryTime = 0.0;
+
+        std::vector<glm::vec3> points(chunkSize);
+        std::vector<float> exactDist(chunkSize);
+        std::vector<uint32_t> pointRegions(chunkSize);
+        std::vector<float> errors(chunkSize);
+        Timer queryTimer;
+
+#ifdef OPENMP_AVAILABLE
+        #pragma omp for schedule(dynamic, 1)
 #endif
+        for(int64_t c=0; c < static_cast<int64_t>(numChunks); c++)
+        {
+            std::mt19937 gen(seed ^ static_cast<uint32_t>(0x9E3779B9u * static_cast<uint32_t>(c + 1)));
+            std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+            std::normal_distribution<float> offsetDist(0.0f, band);
 
-    // Calculate error
-    auto pow2 = [](float a) { return a * a; };
-    
-    double sdfRMSE = 0.0;
-    double icgRMSE = 0.0f;
-    double cgalRMSE = 0.0f;
-    double vdbRMSE = 0.0f;
+            const uint64_t firstSample = static_cast<uint64_t>(c) * chunkSize;
+            const uint64_t lastSample = glm::min(firstSample + chunkSize, numSamples);
+            const uint32_t chunkSamples = static_cast<uint32_t>(lastSample - firstSample);
 
-    double sdfMAE = 0.0f;
-    double icgMAE = 0.0f;
-    double cgalMAE = 0.0f;
-    double vdbMAE = 0.0f;
+            for(uint32_t i=0; i < chunkSamples; i++)
+            {
+                const uint64_t s = firstSample + i;
+                if(s < numNearSurfaceSamples)
+                {
+                    const double u = (static_cast<double>(s) + static_cast<double>(dist(gen))) / static_cast<double>(numNearSurfaceSamples);
+                    const uint32_t t = glm::min(static_cast<uint32_t>(std::lower_bound(areaCdf.begin(), areaCdf.end(), u) - areaCdf.begin()), numTriangles - 1);
+                    const glm::vec3 v1 = vertices[indices[3 * t]];
+                    const glm::vec3 v2 = vertices[indices[3 * t + 1]];
+                    const glm::vec3 v3 = vertices[indices[3 * t + 2]];
+                    float a = dist(gen); float b = dist(gen);
+                    if(a + b > 1.0f) { a = 1.0f - a; b = 1.0f - b; }
+                    const glm::vec3 normal = glm::normalize(glm::cross(v2 - v1, v3 - v1));
+                    points[i] = glm::clamp(v1 + a * (v2 - v1) + b * (v3 - v1) + offsetDist(gen) * normal, 
+                                           box.min + glm::vec3(1e-5f), box.max - glm::vec3(1e-5f));
+                }
+                else if(s - numNearSurfaceSamples < numStratifiedSamples)
+                {
+                    const uint64_t stratum = (s - numNearSurfaceSamples) % numStrata;
+                    const glm::vec3 cell(static_cast<float>(stratum % strataPerAxis),
+                                         static_cast<float>((stratum / strataPerAxis) % strataPerAxis),
+                                         static_cast<float>(stratum / (static_cast<uint64_t>(strataPerAxis) * strataPerAxis)));
+                    points[i] = box.min + glm::vec3(5e-6f) + (cell + glm::vec3(dist(gen), dist(gen), dist(gen))) * strataSize;
+                }
+                else
+                {
+                    points[i] = box.min + glm::vec3(5e-6f) + glm::vec3(dist(gen), dist(gen), dist(gen)) * (box.getSize() - glm::vec3(1e-5f));
+                }
+            }
 
-    float sdfMaxError = 0.0f;
-    float icgMaxError = 0.0f;
-    float cgalMaxError = 0.0f;
-    float vdbMaxError = 0.0f;
+            queryTimer.start();
+            for(uint32_t i=0; i < chunkSamples; i++)
+            {
+                exactDist[i] = exactEvaluator(points[i]);
+            }
+            threadExactQueryTime += 1.0e-6 * queryTimer.getElapsedMicroseconds();
 
-    float maxError = 0.0f;
+            for(uint32_t i=0; i < chunkSamples; i++)
+            {
+                pointRegions[i] = getRegion(exactDist[i]);
+            }
 
-    std::array<std::vector<glm::vec3>, 40> samplesPerDist;
-    samplesPerDist.fill(std::vector<glm::vec3>());
+            for(uint32_t m=0; m < methods.size(); m++)
+            {
+                MethodStats& mStats = threadStats[m];
+                queryTimer.start();
+                for(uint32_t i=0; i < chunkSamples; i++)
+                {
+                    const float error = (evaluators[m](points[i]) - exactDist[i]) * invModelDiagonal;
+                    errors[i] = error;
+                    std::vector<ErrorStats>& strategyStats = (firstSample + i < numNearSurfaceSamples) ? mStats.nearSurface : mStats.uniform;
+                    strategyStats[pointRegions[i]].add(error);
+                    strategyStats.back().add(error);
+                }
+                mStats.queryTime += 1.0e-6 * queryTimer.getElapsedMicroseconds();
+                mStats.numQueries += chunkSamples;
 
-    std::array<std::vector<float>, 40> samplesExactDist;
-    samplesExactDist.fill(std::vector<float>());
+                // The leaf depths are computed out of the timed loop
+                if(methods[m].getLeafDepth)
+                {
+                    for(uint32_t i=0; i < chunkSamples; i++)
+                    {
+                        const uint32_t depth = methods[m].getLeafDepth(points[i]);
+                        if(depth < mStats.depths.size()) mStats.depths[depth].add(errors[i]);
+                    }
+                }
+            }
+        }
 
-    for(uint32_t s=0; s < numSamples; s++)
-    {
-#ifdef TEST_OCTREE_SDF
-        sdfRMSE += static_cast<double>(pow2((sdfDist[s] - exactSdfDist[s])));
-        sdfMAE += static_cast<double>(glm::abs((sdfDist[s] - exactSdfDist[s])));
-        sdfMaxError = glm::max(sdfMaxError, glm::abs((sdfDist[s] - exactSdfDist[s])));
-        // sdfRMSE += static_cast<double>(pow2((sdfDist[s] - exactSdfDist1[s])));
-        // sdfMAE += static_cast<double>(glm::abs((sdfDist[s] - exactSdfDist1[s])));
-        // sdfMaxError = glm::max(sdfMaxError, glm::abs((sdfDist[s] - exactSdfDist1[s])));
-#endif
-#ifdef TEST_ICG
-        // icgRMSE += static_cast<double>(pow2((exactSdfDist1[s] - exactSdfDist[s])));
-        // icgMAE += static_cast<double>(glm::abs((exactSdfDist1[s] - exactSdfDist[s])));
-        // icgMaxError = glm::max(icgMaxError, glm::abs((exactSdfDist1[s] - exactSdfDist[s])));
-#endif
-#ifdef TEST_CGAL
-        cgalRMSE += static_cast<double>(pow2((exactSdfDist2[s] - exactSdfDist[s])));
-        cgalMAE += static_cast<double>(glm::abs((exactSdfDist2[s] - exactSdfDist[s])));
-        cgalMaxError = glm::max(cgalMaxError, glm::abs((exactSdfDist2[s] - exactSdfDist[s])));
-#endif
-#ifdef TEST_OPENVDB
-        vdbRMSE += static_cast<double>(pow2((sdfDist2[s] - exactSdfDist[s])));
-        vdbMAE += static_cast<double>(glm::abs((sdfDist2[s] - exactSdfDist[s])));
-        vdbMaxError = glm::max(vdbMaxError, glm::abs((sdfDist2[s] - exactSdfDist[s])));
+#ifdef OPENMP_AVAILABLE
+        #pragma omp critical
 #endif
-#ifdef TEST_ICG
-#ifdef TEST_CGAL
-        maxError = glm::max(maxError, glm::abs((exactSdfDist1[s]-exactSdfDist2[s])));
-#endif
-#endif
-#ifdef MAKE_HISTOGRAM
-        uint32_t idx = glm::min(static_cast<uint32_t>(glm::round((exactSdfDist[s] * invModelDiagonal + 1.0f) * 20.0f)), 39u);
-        // uint32_t idx = static_cast<uint32_t>(glm::round((exactSdfDist[s] * invDiag + 1.0f) * 100.0f)) - 80;
-        // samplesPerDist[idx].push_back(samples[s]);
-        if(idx >= 0 && idx < 40)
         {
-            samplesPerDist[idx].push_back(samples[s]);
-            samplesExactDist[idx].push_back(exactSdfDist[s]);
+            for(uint32_t m=0; m < methods.size(); m++) stats[m].merge(threadStats[m]);
+            exactQueryTime += threadExactQueryTime;
         }
-#endif
     }
+    const float totalTime = timer.getElapsedSeconds();
 
-#ifdef MAKE_HISTOGRAM
-    for(uint32_t r=0; r < 40; r++)
-    {
-        std::vector<glm::vec3>& s = samplesPerDist[r];
-        uint32_t len = s.size();
+    SPDLOG_INFO("Evaluated {} samples with {} threads in {}s", numSamples, numThreads, totalTime);
+    SPDLOG_INFO("Exact sdf us per query: {}", 1.0e6 * exactQueryTime / static_cast<double>(numSamples));
 
-#ifdef TEST_EXACT_OCTREE_SDF
-        timer.start();
-        for(uint32_t i=0; i < len; i++)
+    // The errors are relative to the model diagonal
+    for(uint32_t m=0; m < methods.size(); m++)
+    {
+        const MethodStats& mStats = stats[m];
+        // The measured time also contains the statistics computation
+        SPDLOG_INFO("{} us per query: {}", methods[m].name, 1.0e6 * mStats.queryTime / static_cast<double>(glm::max(mStats.numQueries, uint64_t(1))));
+        printStats(methods[m].name + " uniform", mStats.uniform.back());
+        printStats(methods[m].name + " near surface", mStats.nearSurface.back());
+        for(uint32_t r=0; r < numRegions; r++)
         {
-            exactSdf->getDistance(s[i]);
+            ErrorStats regionStats = mStats.uniform[r];
+            regionStats.merge(mStats.nearSurface[r]);
+            printStats(fmt::format("{} region [{}, {})", methods[m].name, 
+                                   (r == 0) ? 0.0f : regions[r - 1], 
+                                   (r < regions.size()) ? regions[r] : INFINITY), regionStats);
         }
-        histMeanTimeExact[r] = timer.getElapsedSeconds() / static_cast<float>(len);
-#endif
-
-#ifdef TEST_ICG
-        timer.start();
-        for(uint32_t i=0; i < len; i++)
+        for(uint32_t d=0; d < mStats.depths.size(); d++)
         {
-            icg.getDistance(s[i]);
+            if(mStats.depths[d].count > 0) printStats(fmt::format("{} leaf depth {}", methods[m].name, d), mStats.depths[d]);
         }
-        histMeanTimeICG[r] = timer.getElapsedSeconds() / static_cast<float>(len);
-#endif
-
-#ifdef TEST_CGAL
-        timer.start();
-        for(uint32_t i=0; i < len; i++)
-        {
-            cgalTree.getDistance(s[i]);
-        }
-        histMeanTimeCGAL[r] = timer.getElapsedSeconds() / static_cast<float>(len);
-#endif
+    }
 
-#ifdef TEST_OCTREE_SDF
-        for(uint32_t i=0; i < len; i++)
+    if(outputPathArg)
+    {
+        std::ofstream file(args::get(outputPathArg));
+        if(!file.is_open())
         {
-            const float dist = sdf->getDistance(s[i]);
-            histRSMEOctreeSdf[r] += pow2(dist - samplesExactDist[r][i]);
-            histNumSamplesOctreeSdf[r]++;
+            SPDLOG_ERROR("Cannot open the output file {}", args::get(outputPathArg));
+            return 1;
         }
-#endif
 
-#ifdef TEST_OPENVDB
-        for(uint32_t i=0; i < len; i++)
+        file << "{\n  \"sdf_path\": ";
+        writeJsonString(file, args::get(sdfPathArg));
+        file << ",\n  \"exact_sdf_path\": ";
+        writeJsonString(file, args::get(exactSdfPathArg));
+        file << ",\n  \"model_path\": ";
+        writeJsonString(file, args::get(modelPathArg));
+        file << ",\n"
+             << "  \"error_unit\": \"model_diagonal\",\n"
+             << "  \"samples\": " << numSamples << ",\n"
+             << "  \"near_surface_samples\": " << numNearSurfaceSamples << ",\n"
+             << "  \"uniform_samples\": " << numUniformSamples << ",\n"
+             << "  \"seed\": " << seed << ",\n"
+             << "  \"threads\": " << numThreads << ",\n"
+             << "  \"total_time_s\": " << totalTime << ",\n"
+             << "  \"exact_us_per_query\": " << 1.0e6 * exactQueryTime / static_cast<double>(numSamples) << ",\n"
+             << "  \"methods\": [\n";
+        for(uint32_t m=0; m < methods.size(); m++)
         {
-            const float dist = vdbSampler.wsSample(openvdb::Vec3R(static_cast<double>(s[i].x), static_cast<double>(s[i].y), static_cast<double>(s[i].z)));
-            histRSMEOpenVdb[r] += pow2(dist - samplesExactDist[r][i]);
-            histNumSamplesOpenVdb[r]++;
+            file << "    {\n      \"name\": ";
+            writeJsonString(file, methods[m].name);
+            file << ",\n"
+                 << "      \"us_per_query\": " << 1.0e6 * stats[m].queryTime / static_cast<double>(glm::max(stats[m].numQueries, uint64_t(1))) << ",\n"
+                 << "      \"uniform\":\n";
+            writeStrategyJson(file, stats[m].uniform, regions);
+            file << ",\n      \"near_surface\":\n";
+            writeStrategyJson(file, stats[m].nearSurface, regions);
+            if(methods[m].getLeafDepth)
+            {
+                file << ",\n      \"leaf_depths\": [\n";
+                writeDepthsJson(file, stats[m].depths);
+                file << "      ]";
+            }
+            file << "\n    }" << ((m + 1 < methods.size()) ? ",\n" : "\n");
         }
-#endif
-    }
-
-#ifdef TEST_EXACT_OCTREE_SDF
-    for(int i=0; i < 40; i++)
-    {
-        SPDLOG_INFO("{}%: {}", 5*(i-20), histMeanTimeExact[i] * 1e6);
-    }
-#endif
-
-#ifdef TEST_ICG
-    for(int i=0; i < 40; i++)
-    {
-        SPDLOG_INFO("{}%: {}", 5*(i-20), histMeanTimeICG[i] * 1e6);
-    }
-#endif
-
-#ifdef TEST_OCTREE_SDF
-    for(int i=0; i < 40; i++)
-    {
-        SPDLOG_INFO("{}%: {}", 5*(i-20), glm::sqrt(histRSMEOctreeSdf[i] / static_cast<float>(histNumSamplesOctreeSdf[i])) * invModelDiagonal);
-    }
-#endif
-
-#ifdef TEST_OPENVDB
-    for(int i=0; i < 40; i++)
-    {
-        SPDLOG_INFO("{}%: {}", 5*(i-20), glm::sqrt(histRSMEOpenVdb[i] / static_cast<float>(histNumSamplesOpenVdb[i])) * invModelDiagonal);
-    }
-#endif
-
-
-#ifdef TEST_CGAL
-    for(int i=0; i < 40; i++)
-    {
-        SPDLOG_INFO("{}%: {}", 5*(i-20), histMeanTimeCGAL[i] * 1e6);
+        file << "  ]\n}\n";
     }
-#endif
-
-    // for(int i=0; i < 40; i++)
-    // {
-    //     SPDLOG_INFO("{}%: {}", (i-20), histMeanTimeExact[i] * 1e6);
-    // }
-
-    // for(int i=0; i < 40; i++)
-    // {
-    //     SPDLOG_INFO("{}%: {}", (i-20), histMeanTimeICG[i] * 1e6);
-    // }
-
-    // for(int i=0; i < 40; i++)
-    // {
-    //     SPDLOG_INFO("{}%: {}", (i-20), histMeanTimeCGAL[i] * 1e6);
-    // }
-#endif
-
-#ifdef TEST_OCTREE_SDF
-    SPDLOG_INFO("Octree Sdf RMSE: {}", glm::sqrt(sdfRMSE / static_cast<double>(numSamples)) * invModelDiagonal);
-    SPDLOG_INFO("Octree Sdf MAE: {}", (sdfMAE / static_cast<double>(numSamples)) * invModelDiagonal);
-    SPDLOG_INFO("Octree Sdf max error: {}", sdfMaxError * invModelDiagonal);
-#endif
-#ifdef TEST_ICG
-    SPDLOG_INFO("ICG RMSE: {}", glm::sqrt(icgRMSE / static_cast<double>(numSamples)) * invModelDiagonal);
-    SPDLOG_INFO("ICG MAE: {}", (icgMAE / static_cast<double>(numSamples)) * invModelDiagonal);
-    SPDLOG_INFO("ICG max error: {}", icgMaxError * invModelDiagonal);
-#endif
-#ifdef TEST_CGAL
-    SPDLOG_INFO("CGAL RMSE: {}", glm::sqrt(cgalRMSE / static_cast<double>(numSamples)) * invModelDiagonal);
-    SPDLOG_INFO("CGAL MAE: {}", (cgalMAE / static_cast<double>(numSamples)) * invModelDiagonal);
-    SPDLOG_INFO("CGAL max error: {}", cgalMaxError * invModelDiagonal);
-#endif
-#ifdef TEST_OPENVDB
-    SPDLOG_INFO("VDB RMSE: {}", glm::sqrt(vdbRMSE / static_cast<double>(numSamples)) * invModelDiagonal);
-    SPDLOG_INFO("VDB MAE: {}", (vdbMAE / static_cast<double>(numSamples)) * invModelDiagonal);
-    SPDLOG_INFO("VDB max error: {}", vdbMaxError * invModelDiagonal);
-#endif
-
-#ifdef TEST_ICG
-#ifdef TEST_CGAL
-    SPDLOG_INFO("Methods Max error: {}", maxError);
-#endif
-#endif
-}
\ No newline at end of file
+}
@@ -2,10 +2,13 @@
 #include <random>
 #include <algorithm>
 #include <optional>
+#include <sstream>
+#include <cstdlib>
 #include "SdfLib/UniformGridSdf.h"
 #include "SdfLib/RealSdf.h"
 #include "SdfLib/OctreeSdf.h"
 #include "SdfLib/ExactOctreeSdf.h"
+#include "SdfLib/BuildCache.h"
 #include "SdfLib/utils/Mesh.h"
 #include <iostream>
 #include <random>
@@ -39,6 +42,18 @@ int main(int argc, char** argv)
     args::Flag normalizeBBArg(parser, "normalize_model", "Normalize the model coordinates", {'n', "normalize"});
     args::ValueFlag<uint32_t> numThreadsArg(parser, "num_threads", "Set the application maximum number of threads", {"num_threads"});
     args::ValueFlag<float> bbMarginArg(parser, "bb_margin", "Percentage of margin added between the structure BB and the model BB", {"bb_margin"});
+    args::ValueFlag<std::string> tracePathArg(parser, "trace_path", "Store the construction phases timings in a Chrome trace JSON file", {"trace"});
+    args::ValueFlag<std::string> cacheDirArg(parser, "cache_dir", "Reuse the structures already built with the same mesh and parameters from this directory", {"cache_dir"});
+    args::ValueFlag<uint64_t> maxBytesArg(parser, "max_bytes", "Build the octree refining first the nodes with more error until it reaches this size in bytes", {"max_bytes"});
+    args::ValueFlag<float> dedupToleranceArg(parser, "dedup_tolerance", "Share the octree leaves with a field difference less than this tolerance", {"dedup_tolerance"});
+    args::ValueFlag<uint64_t> maxNodesArg(parser, "max_nodes", "Build the octree refining first the nodes with more error until it reaches this number of nodes", {"max_nodes"});
+    args::Flag shareVerticesArg(parser, "share_vertices", "Store the values of the octree leaves vertices in a shared pool instead of their coefficients", {"share_vertices"});
+    args::Flag fullTrianglesDataArg(parser, "full_triangles_data", "Store the triangles data of the exact octree instead of the mesh, which is larger but faster to load", {"full_triangles_data"});
+    args::Flag compressArg(parser, "compress", "Compress the structure arrays in blocks that are decompressed in parallel when the file is loaded", {"compress"});
+    args::ValueFlag<float> narrowBandArg(parser, "narrow_band", "Only refine the regions nearer than this distance to the surface, in the model units. The rest store a lower bound of the distance", {"narrow_band"});
+    args::Flag anisotropicStartGridArg(parser, "anisotropic_start_grid", "Fit the octree start grid to the model box instead of using a cube", {"anisotropic_start_grid"});
+    args::ValueFlagList<std::string> refinementRegionArg(parser, "refinement_region", "Region of the model with its own octree depth and termination threshold, in the model coordinates: min_x,min_y,min_z,max_x,max_y,max_z,depth[,threshold]. It can be repeated", {"refinement_region"});
+    args::ValueFlag<std::string> interpolationArg(parser, "interpolation", "The polynomial stored in the octree leaves. It supports: trilinear, triquadratic, tricubic", {"interpolation"});
 
     try
     {
@@ -54,17 +69,54 @@ int main(int argc, char** argv)
     std::string modelPath = (modelPathArg) ? args::get(modelPathArg) : "../models/bunny.ply";
     std::string outputPath = (outputPathArg) ? args::get(outputPathArg) : "../output/sdfOctreeBunny.bin";
 
+    if(tracePathArg)
+    {
+        Profiler::setEnabled(true);
+        Profiler::setThreadName("Main thread");
+    }
+
     Mesh mesh(modelPath);
     BoundingBox box = mesh.getBoundingBox();
+    glm::mat4 modelTransform(1.0f);
+    float modelScale = 1.0f;
     if(true || normalizeBBArg) {
         // Normalize model units
         const glm::vec3 boxSize = box.getSize();
         const float maxSize = glm::max(glm::max(boxSize.x, boxSize.y), boxSize.z);
-        mesh.applyTransform(	glm::scale(glm::mat4(1.0), glm::vec3(2.0f/maxSize)) *
-                                glm::translate(glm::mat4(1.0), -box.getCenter()));
+        modelScale = 2.0f / maxSize;
+        modelTransform = glm::scale(glm::mat4(1.0), glm::vec3(modelScale)) *
+                         glm::translate(glm::mat4(1.0), -box.getCenter());
+        mesh.applyTransform(modelTransform);
         box = mesh.getBoundingBox();
     }
 
+    // The regions are given in the model coordinates, so they are normalized like the model
+    std::vector<OctreeSdf::RefinementRegion> refinementRegions;
+    for(const std::string& regionStr : args::get(refinementRegionArg))
+    {
+        std::vector<float> values;
+        std::stringstream regionStream(regionStr);
+        std::string value;
+        while(std::getline(regionStream, value, ','))
+        {
+            values.push_back(std::strtof(value.c_str(), nullptr));
+        }
+
+        if(values.size() < 7 || values.size() > 8)
+        {
+            std::cerr << regionStr << " is not a valid refinement region" << std::endl;
+            return 0;
+        }
+
+        OctreeSdf::RefinementRegion region;
+        region.box.min = glm::vec3(modelTransform * glm::vec4(values[0], values[1], values[2], 1.0f));
+        region.box.max = glm::vec3(modelTransform * glm::vec4(values[3], values[4], values[5], 1.0f));
+        region.maxDepth = static_cast<uint32_t>(values[6]);
+        region.terminationThreshold = (values.size() > 7) ? values[7] :
+                                      (terminationThresholdArg) ? args::get(terminationThresholdArg) : 1e-3f;
+        refinementRegions.push_back(region);
+    }
+
     const glm::vec3 modelBBSize = box.getSize();
     // box.addMargin(0.12f * glm::max(glm::max(modelBBSize.x, modelBBSize.y), modelBBSize.z));
     const float margin = ((bbMarginArg) ? args::get(bbMarginArg) : 20.0f) / 100.0f;
@@ -73,14 +125,26 @@ int main(int argc, char** argv)
 
     Timer timer;
     std::unique_ptr<SdfFunction> sdfFunc;
+    std::optional<BuildCache> cache;
+    if(cacheDirArg) cache.emplace(args::get(cacheDirArg));
+
+    // The band is given in the model units, like the regions
+    const float narrowBand = (narrowBandArg) ? modelScale * args::get(narrowBandArg) : 0.0f;
+    const bool anisotropicStartGrid = args::get(anisotropicStartGridArg);
 
     if(sdfFormat == "grid")
     {
         timer.start();
-        sdfFunc = std::unique_ptr<UniformGridSdf>((cellSizeArg) ? 
-                    new UniformGridSdf(mesh, box, args::get(cellSizeArg), UniformGridSdf::InitAlgorithm::OCTREE) :
-                    new UniformGridSdf(mesh, box, (depthArg) ? args::get(depthArg) : 6, UniformGridSdf::InitAlgorithm::OCTREE));
-        
+        if(cache && !cellSizeArg)
+        {
+            sdfFunc = cache->getUniformGridSdf(mesh, box, (depthArg) ? args::get(depthArg) : 6, UniformGridSdf::InitAlgorithm::OCTREE, narrowBand);
+        }
+        else
+        {
+            sdfFunc = std::unique_ptr<UniformGridSdf>((cellSizeArg) ? 
+                        new UniformGridSdf(mesh, box, args::get(cellSizeArg), UniformGridSdf::InitAlgorithm::OCTREE, narrowBand) :
+                        new UniformGridSdf(mesh, box, (depthArg) ? args::get(depthArg) : 6, UniformGridSdf::InitAlgorithm::OCTREE, narrowBand));
+        }
     }
     else if(sdfFormat == "octree")
     {
@@ -95,26 +159,70 @@ int main(int argc, char** argv)
             return 0;
         }
 
+        std::string interpolationStr = (interpolationArg) ? args::get(interpolationArg) : "tricubic";
+        std::optional<OctreeSdf::InterpolationType> interpolationType = OctreeSdf::stringToInterpolationType(interpolationStr);
+        if(!interpolationType.has_value())
+        {
+            std::cerr << interpolationStr << " is not a valid supported interpolation method" << std::endl;
+            return 0;
+        }
+
+        const uint32_t depth = (depthArg) ? args::get(depthArg) : 8;
+        const uint32_t startDepth = (startDepthArg) ? args::get(startDepthArg) : 1;
+        const float terminationThreshold = (terminationThresholdArg) ? args::get(terminationThresholdArg) : 1e-3f;
+        const uint32_t numThreads = (numThreadsArg) ? args::get(numThreadsArg) : 1;
+
         timer.start();
-        sdfFunc = std::unique_ptr<OctreeSdf>(new OctreeSdf(
-            mesh, box, 
-            (depthArg) ? args::get(depthArg) : 8,
-            (startDepthArg) ? args::get(startDepthArg) : 1,
-            (terminationThresholdArg) ? args::get(terminationThresholdArg) : 1e-3f,
-            initAlgorithm,
-            (numThreadsArg) ? args::get(numThreadsArg) : 1
-        ));
+        if(maxBytesArg || maxNodesArg)
+        {
+            // The termination threshold only applies when it is given explicitly
+            OctreeSdf::BuildBudget budget;
+            budget.maxBytes = (maxBytesArg) ? args::get(maxBytesArg) : 0;
+            budget.maxNodes = (maxNodesArg) ? args::get(maxNodesArg) : 0;
+            sdfFunc = std::unique_ptr<OctreeSdf>(new OctreeSdf(
+                mesh, box, depth, startDepth, budget, (terminationThresholdArg) ? args::get(terminationThresholdArg) : 0.0f,
+                interpolationType.value(), narrowBand, anisotropicStartGrid, refinementRegions
+            ));
+        }
+        else if(cache)
+        {
+            sdfFunc = cache->getOctreeSdf(mesh, box, depth, startDepth, terminationThreshold, initAlgorithm, numThreads, interpolationType.value(), narrowBand, anisotropicStartGrid, refinementRegions);
+        }
+        else
+        {
+            sdfFunc = std::unique_ptr<OctreeSdf>(new OctreeSdf(
+                mesh, box, depth, startDepth, terminationThreshold, initAlgorithm, numThreads, interpolationType.value(), narrowBand, anisotropicStartGrid, refinementRegions
+            ));
+        }
+
+        if(dedupToleranceArg)
+        {
+            static_cast<OctreeSdf*>(sdfFunc.get())->deduplicateNodes(args::get(dedupToleranceArg));
+        }
+
+        if(shareVerticesArg)
+        {
+            static_cast<OctreeSdf*>(sdfFunc.get())->shareVertices();
+        }
     }
     else if(sdfFormat == "exact_octree")
     {
+        const uint32_t maxDepth = (depthArg) ? args::get(depthArg) : 5;
+        const uint32_t startDepth = (startDepthArg) ? args::get(startDepthArg) : 1;
+        const uint32_t minTriangles = (minTrianglesPerNode) ? args::get(minTrianglesPerNode) : 32;
+        const uint32_t numThreads = (numThreadsArg) ? args::get(numThreadsArg) : 1;
+
         timer.start();
-        sdfFunc = std::unique_ptr<ExactOctreeSdf>(new ExactOctreeSdf(
-            mesh, box,
-            (depthArg) ? args::get(depthArg) : 5,
-            (startDepthArg) ? args::get(startDepthArg) : 1,
-            (minTrianglesPerNode) ? args::get(minTrianglesPerNode) : 32,
-            (numThreadsArg) ? args::get(numThreadsArg) : 1
-        ));
+        if(cache)
+        {
+            sdfFunc = cache->getExactOctreeSdf(mesh, box, maxDepth, startDepth, minTriangles, numThreads, narrowBand, anisotropicStartGrid, !fullTrianglesDataArg);
+        }
+        else
+        {
+            sdfFunc = std::unique_ptr<ExactOctreeSdf>(new ExactOctreeSdf(
+                mesh, box, maxDepth, startDepth, minTriangles, numThreads, narrowBand, anisotropicStartGrid, !fullTrianglesDataArg
+            ));
+        }
     }
     else
     {
@@ -122,7 +230,13 @@ int main(int argc, char** argv)
     }
 
     SPDLOG_INFO("Computation time {}s", timer.getElapsedSeconds());
+    sdfFunc->memoryUsage().print();
+
+    if(tracePathArg && Profiler::writeChromeTrace(args::get(tracePathArg)))
+    {
+        SPDLOG_INFO("Construction trace stored in {}", args::get(tracePathArg));
+    }
     
     SPDLOG_INFO("Saving the model");
-    sdfFunc->saveToFile(outputPath);
+    sdfFunc->saveToFile(outputPath, args::get(compressArg));
 }
\ No newline at end of file
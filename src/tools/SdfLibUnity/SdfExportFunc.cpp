@@ -1,5 +1,7 @@
 #include "SdfExportFunc.h"
 #include "spdlog/sinks/rotating_file_sink.h"
+#include <future>
+#include <algorithm>
 
 #include <InteractiveComputerGraphics/TriangleMeshDistance.h>
 
@@ -128,6 +130,180 @@ EXPORT float getDistanceAndGradient(SdfFunction* sdfPointer, float pointX, float
     // return reinterpret_cast<ICG*>(sdfPointer)->getDistance(glm::vec3(pointX, pointY, pointZ), outGradient);
 }
 
+namespace
+{
+    void evaluatePoints(const SdfFunction& sdf, const float* points, uint32_t numPoints,
+                        float* outDistances, float* outGradients, uint32_t numThreads)
+    {
+        numThreads = std::max(numThreads, 1u);
+        const int64_t numQueries = static_cast<int64_t>(numPoints);
+        if(outGradients == nullptr)
+        {
+            #ifdef OPENMP_AVAILABLE
+            #pragma omp parallel for num_threads(numThreads) schedule(static) if(numThreads > 1)
+            #endif
+            for(int64_t i=0; i < numQueries; i++)
+            {
+                outDistances[i] = sdf.getDistance(glm::vec3(points[3 * i], points[3 * i + 1], points[3 * i + 2]));
+            }
+        }
+        else
+        {
+            #ifdef OPENMP_AVAILABLE
+            #pragma omp parallel for num_threads(numThreads) schedule(static) if(numThreads > 1)
+            #endif
+            for(int64_t i=0; i < numQueries; i++)
+            {
+                glm::vec3 gradient;
+                outDistances[i] = sdf.getDistance(glm::vec3(points[3 * i], points[3 * i + 1], points[3 * i + 2]), gradient);
+                outGradients[3 * i] = gradient.x;
+                outGradients[3 * i + 1] = gradient.y;
+                outGradients[3 * i + 2] = gradient.z;
+            }
+        }
+    }
+}
+
+struct SdfQueryJob
+{
+    std::future<void> result;
+};
+
+EXPORT void getDistances(SdfFunction* sdfPointer, const float* points, uint32_t numPoints,
+                         float* outDistances, uint32_t numThreads)
+{
+    evaluatePoints(*sdfPointer, points, numPoints, outDistances, nullptr, numThreads);
+}
+
+EXPORT void getDistancesAndGradients(SdfFunction* sdfPointer, const float* points, uint32_t numPoints,
+                                     float* outDistances, float* outGradients, uint32_t numThreads)
+{
+    evaluatePoints(*sdfPointer, points, numPoints, outDistances, outGradients, numThreads);
+}
+
+EXPORT SdfQueryJob* startDistancesQuery(SdfFunction* sdfPointer, const float* points, uint32_t numPoints,
+                                        float* outDistances, float* outGradients, uint32_t numThreads)
+{
+    SdfQueryJob* job = new SdfQueryJob();
+    job->result = std::async(std::launch::async, [=]()
+    {
+        evaluatePoints(*sdfPointer, points, numPoints, outDistances, outGradients, numThreads);
+    });
+    return job;
+}
+
+EXPORT uint32_t isQueryFinished(SdfQueryJob* job)
+{
+    return (job->result.wait_for(std::chrono::seconds(0)) == std::future_status::ready) ? 1 : 0;
+}
+
+EXPORT void waitQuery(SdfQueryJob* job)
+{
+    job->result.wait();
+}
+
+EXPORT void deleteQuery(SdfQueryJob* job)
+{
+    job->result.wait();
+    delete job;
+}
+
+EXPORT AsyncSdfBuild* startExactOctreeSdfBuild(glm::vec3* vertices, uint32_t numVertices, 
+                                               uint32_t* indices, uint32_t numIndices,
+                                               float bbMinX, float bbMinY, float bbMinZ,
+                                               float bbMaxX, float bbMaxY, float bbMaxZ,
+                                               uint32_t startOctreeDepth,
+                                               uint32_t maxOctreeDepth,
+                                               uint32_t minTrianglesPerNode,
+                                               uint32_t numThreads)
+{
+    BoundingBox octreeBox(
+        glm::vec3(bbMinX, bbMinY, bbMinZ),
+        glm::vec3(bbMaxX, bbMaxY, bbMaxZ)
+    );
+
+    std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>(vertices, numVertices,
+                                                        indices, numIndices);
+
+    return new AsyncSdfBuild([=]() -> std::unique_ptr<SdfFunction>
+    {
+        return std::make_unique<ExactOctreeSdf>(*mesh, octreeBox, maxOctreeDepth, startOctreeDepth, minTrianglesPerNode, numThreads);
+    });
+}
+
+EXPORT AsyncSdfBuild* startOctreeSdfBuild(glm::vec3* vertices, uint32_t numVertices,
+                                          uint32_t* indices, uint32_t numIndices,
+                                          float bbMinX, float bbMinY, float bbMinZ,
+                                          float bbMaxX, float bbMaxY, float bbMaxZ,
+                                          uint32_t startOctreeDepth,
+                                          uint32_t maxOctreeDepth,
+                                          float maxError,
+                                          uint32_t numThreads)
+{
+    BoundingBox octreeBox(
+        glm::vec3(bbMinX, bbMinY, bbMinZ),
+        glm::vec3(bbMaxX, bbMaxY, bbMaxZ)
+    );
+
+    std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>(vertices, numVertices,
+                                                        indices, numIndices);
+
+    return new AsyncSdfBuild([=]() -> std::unique_ptr<SdfFunction>
+    {
+        return std::make_unique<OctreeSdf>(*mesh, octreeBox, maxOctreeDepth, startOctreeDepth, maxError, 
+                                           OctreeSdf::InitAlgorithm::CONTINUITY, 
+                                           numThreads);
+    });
+}
+
+EXPORT float getBuildProgress(AsyncSdfBuild* job)
+{
+    return job->getProgress().getFraction();
+}
+
+EXPORT uint64_t getBuildProcessedNodes(AsyncSdfBuild* job, uint32_t depth)
+{
+    return job->getProgress().getProcessedNodes(depth);
+}
+
+EXPORT uint64_t getBuildEstimatedNodes(AsyncSdfBuild* job, uint32_t depth)
+{
+    return job->getProgress().getEstimatedNodes(depth);
+}
+
+EXPORT void cancelBuild(AsyncSdfBuild* job)
+{
+    job->cancel();
+}
+
+EXPORT uint32_t isBuildFinished(AsyncSdfBuild* job)
+{
+    return (job->isFinished()) ? 1 : 0;
+}
+
+EXPORT SdfFunction* getBuildResult(AsyncSdfBuild* job)
+{
+    // The exceptions thrown by the construction cannot cross the C interface
+    try
+    {
+        return job->getResult().release();
+    }
+    catch(const std::exception& e)
+    {
+        SPDLOG_ERROR("The construction has failed: {}", e.what());
+    }
+    catch(...)
+    {
+        SPDLOG_ERROR("The construction has failed");
+    }
+    return nullptr;
+}
+
+EXPORT void deleteBuild(AsyncSdfBuild* job)
+{
+    delete job;
+}
+
 EXPORT glm::vec3 getBBMinPoint(SdfFunction* sdfPointer)
 {
     return sdfPointer->getSampleArea().min;
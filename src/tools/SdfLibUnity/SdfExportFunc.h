@@ -4,6 +4,7 @@
 #include "SdfLib/utils/Mesh.h"
 #include "SdfLib/ExactOctreeSdf.h"
 #include "SdfLib/OctreeSdf.h"
+#include "SdfLib/AsyncSdfBuild.h"
 #include <vector>
 
 #if _WIN32
@@ -45,6 +46,69 @@ extern "C" EXPORT float getDistance(sdflib::SdfFunction* sdfPointer, float point
 
 extern "C" EXPORT float getDistanceAndGradient(sdflib::SdfFunction* sdfPointer, float pointX, float pointY, float pointZ, glm::vec3* outGradient);
 
+// Evaluates an array of points, stored as 3 consecutive floats per point, in one call.
+extern "C" EXPORT void getDistances(sdflib::SdfFunction* sdfPointer, const float* points, uint32_t numPoints,
+                                    float* outDistances, uint32_t numThreads);
+
+// The gradients are stored as 3 consecutive floats per point
+extern "C" EXPORT void getDistancesAndGradients(sdflib::SdfFunction* sdfPointer, const float* points, uint32_t numPoints,
+                                                float* outDistances, float* outGradients, uint32_t numThreads);
+
+// Non-blocking version of the array queries. The arrays must be kept alive and pinned until the query finishes.
+// The outGradients array can be null to only compute the distances
+struct SdfQueryJob;
+
+extern "C" EXPORT SdfQueryJob* startDistancesQuery(sdflib::SdfFunction* sdfPointer, const float* points, uint32_t numPoints,
+                                                   float* outDistances, float* outGradients, uint32_t numThreads);
+
+// Returns 1 if the query has finished and 0 otherwise
+extern "C" EXPORT uint32_t isQueryFinished(SdfQueryJob* job);
+
+extern "C" EXPORT void waitQuery(SdfQueryJob* job);
+
+// Waits the query if it has not finished
+extern "C" EXPORT void deleteQuery(SdfQueryJob* job);
+
+// Non-blocking versions of the create functions. The mesh is copied, so the arrays can be released after the call
+extern "C" EXPORT sdflib::AsyncSdfBuild* startExactOctreeSdfBuild(glm::vec3* vertices, uint32_t numVertices, 
+                                                    uint32_t* indices, uint32_t numIndices,
+                                                    float bbMinX, float bbMinY, float bbMinZ,
+                                                    float bbMaxX, float bbMaxY, float bbMaxZ,
+                                                    uint32_t startOctreeDepth,
+                                                    uint32_t maxOctreeDepth,
+                                                    uint32_t minTrianglesPerNode,
+                                                    uint32_t numThreads);
+
+extern "C" EXPORT sdflib::AsyncSdfBuild* startOctreeSdfBuild(glm::vec3* vertices, uint32_t numVertices,
+                                               uint32_t* indices, uint32_t numIndices,
+                                               float bbMinX, float bbMinY, float bbMinZ,
+                                               float bbMaxX, float bbMaxY, float bbMaxZ,
+                                               uint32_t startOctreeDepth,
+                                               uint32_t maxOctreeDepth,
+                                               float maxError,
+                                               uint32_t numThreads);
+
+// Returns an estimation of the completed fraction of the construction, between 0 and 1
+extern "C" EXPORT float getBuildProgress(sdflib::AsyncSdfBuild* job);
+
+// Returns the number of nodes already processed and the number of nodes expected at the depth
+extern "C" EXPORT uint64_t getBuildProcessedNodes(sdflib::AsyncSdfBuild* job, uint32_t depth);
+
+extern "C" EXPORT uint64_t getBuildEstimatedNodes(sdflib::AsyncSdfBuild* job, uint32_t depth);
+
+// The construction stops subdividing the nodes, so it finishes shortly after the call
+extern "C" EXPORT void cancelBuild(sdflib::AsyncSdfBuild* job);
+
+// Returns 1 if the construction has finished and 0 otherwise
+extern "C" EXPORT uint32_t isBuildFinished(sdflib::AsyncSdfBuild* job);
+
+// Waits the construction and returns the structure, which must be deleted with deleteSdf.
+// Returns null if the construction has been cancelled or has failed
+extern "C" EXPORT sdflib::SdfFunction* getBuildResult(sdflib::AsyncSdfBuild* job);
+
+// Cancels the construction if it has not finished and waits for it
+extern "C" EXPORT void deleteBuild(sdflib::AsyncSdfBuild* job);
+
 extern "C" EXPORT glm::vec3 getBBMinPoint(sdflib::SdfFunction* sdfPointer);
 
 extern "C" EXPORT glm::vec3 getBBSize(sdflib::SdfFunction* sdfPointer);
@@ -51,6 +51,11 @@ public:
         std::unique_ptr<SdfFunction> sdfUnique = SdfFunction::loadFromFile(mSdfPath);
         std::shared_ptr<SdfFunction> sdf = std::move(sdfUnique);
         std::shared_ptr<OctreeSdf> octreeSdf = std::dynamic_pointer_cast<OctreeSdf>(sdf);
+        if(octreeSdf == nullptr || !SdfOctreeLightShader::isSupported(*octreeSdf))
+        {
+            SPDLOG_ERROR("Only the octrees with tricubic interpolation and without shared vertices are supported.");
+            return;
+        }
 
         mOctreeLightShader = std::make_unique<SdfOctreeLightShader>(*octreeSdf);
 
@@ -133,6 +138,12 @@ public:
 
     virtual void draw() override
     {
+        if(mOctreeLightShader == nullptr)
+        {
+            Scene::draw();
+            return;
+        }
+
         // Set albedo color at each object
         mOctreeLightShader->setAlbedoColor(glm::vec3(0.4707, 0.173, 0.554));
         mModelRenderer->draw(getMainCamera());
@@ -0,0 +1,309 @@
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <random>
+#include <cstring>
+#include <vector>
+#include <string>
+#include <args.hxx>
+#include <spdlog/spdlog.h>
+#include <glm/glm.hpp>
+#include <cereal/archives/portable_binary.hpp>
+#include <cereal/types/vector.hpp>
+
+#include "SdfLib/OctreeSdf.h"
+#include "SdfLib/ExactOctreeSdf.h"
+#include "SdfLib/UniformGridSdf.h"
+#include "SdfLib/utils/Mesh.h"
+#include "SdfLib/utils/PrimitivesFactory.h"
+
+using namespace sdflib;
+
+namespace
+{
+
+template<typename T>
+bool sameArray(const std::vector<T>& a, const std::vector<T>& b)
+{
+    return a.size() == b.size() && (a.empty() || std::memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+}
+
+bool sameBox(const BoundingBox& a, const BoundingBox& b)
+{
+    return a.min == b.min && a.max == b.max;
+}
+
+// The loaded structure must return exactly the same distances than the stored one
+bool sameQueries(const SdfFunction& expected, const SdfFunction& loaded, uint32_t numSamples)
+{
+    const BoundingBox box = expected.getSampleArea();
+    std::mt19937 gen(1234);
+    std::uniform_real_distribution<float> dis(0.0f, 1.0f);
+    for(uint32_t i=0; i < numSamples; i++)
+    {
+        const glm::vec3 sample = box.min + glm::vec3(dis(gen), dis(gen), dis(gen)) * box.getSize();
+        const float d1 = expected.getDistance(sample);
+        const float d2 = loaded.getDistance(sample);
+        if(d1 != d2)
+        {
+            SPDLOG_ERROR("The distance at {}, {}, {} is {} before saving and {} after loading",
+                         sample.x, sample.y, sample.z, d1, d2);
+            return false;
+        }
+    }
+    return true;
+}
+
+std::unique_ptr<SdfFunction> saveAndLoad(SdfFunction& sdf, const std::string& path, bool compress)
+{
+    if(!sdf.saveToFile(path, compress)) return nullptr;
+    return SdfFunction::loadFromFile(path);
+}
+
+bool compareOctrees(const OctreeSdf& expected, const SdfFunction* loadedSdf, uint32_t numSamples)
+{
+    const OctreeSdf* loaded = dynamic_cast<const OctreeSdf*>(loadedSdf);
+    if(loaded == nullptr)
+    {
+        SPDLOG_ERROR("The file has not been loaded as an octree");
+        return false;
+    }
+
+    return sameBox(expected.getGridBoundingBox(), loaded->getGridBoundingBox()) &&
+           expected.getStartGridSize() == loaded->getStartGridSize() &&
+           expected.getOctreeMaxDepth() == loaded->getOctreeMaxDepth() &&
+           expected.getOctreeValueRange() == loaded->getOctreeValueRange() &&
+           expected.getOctreeMinBorderValue() == loaded->getOctreeMinBorderValue() &&
+           expected.getInterpolationType() == loaded->getInterpolationType() &&
+           sameArray(expected.getOctreeData(), loaded->getOctreeData()) &&
+           sameArray(expected.getVerticesValues(), loaded->getVerticesValues()) &&
+           sameQueries(expected, *loaded, numSamples);
+}
+
+// The loaded octree must keep the inner polynomials and return the same coarse distances
+bool sameLevelOfDetail(const OctreeSdf& expected, const SdfFunction* loadedSdf, uint32_t numSamples)
+{
+    const OctreeSdf* loaded = dynamic_cast<const OctreeSdf*>(loadedSdf);
+    if(loaded == nullptr || !loaded->hasLevelOfDetail())
+    {
+        SPDLOG_ERROR("The file has not been loaded with the level of detail");
+        return false;
+    }
+
+    const BoundingBox box = expected.getSampleArea();
+    std::mt19937 gen(4321);
+    std::uniform_real_distribution<float> dis(0.0f, 1.0f);
+    for(uint32_t i=0; i < numSamples; i++)
+    {
+        const glm::vec3 sample = box.min + glm::vec3(dis(gen), dis(gen), dis(gen)) * box.getSize();
+        const uint32_t maxDepth = i % (expected.getOctreeMaxDepth() + 1);
+        const float d1 = expected.getDistance(sample, maxDepth);
+        const float d2 = loaded->getDistance(sample, maxDepth);
+        if(d1 != d2)
+        {
+            SPDLOG_ERROR("The distance at {}, {}, {} with depth {} is {} before saving and {} after loading",
+                         sample.x, sample.y, sample.z, maxDepth, d1, d2);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool compareExactOctrees(const ExactOctreeSdf& expected, const SdfFunction* loadedSdf, uint32_t numSamples)
+{
+    const ExactOctreeSdf* loaded = dynamic_cast<const ExactOctreeSdf*>(loadedSdf);
+    if(loaded == nullptr)
+    {
+        SPDLOG_ERROR("The file has not been loaded as an exact octree");
+        return false;
+    }
+
+    return sameBox(expected.getGridBoundingBox(), loaded->getGridBoundingBox()) &&
+           expected.getStartGridSize() == loaded->getStartGridSize() &&
+           expected.getOctreeMaxDepth() == loaded->getOctreeMaxDepth() &&
+           expected.getMaxTrianglesInLeafs() == loaded->getMaxTrianglesInLeafs() &&
+           expected.hasCompactSerialization() == loaded->hasCompactSerialization() &&
+           sameArray(expected.getOctreeData(), loaded->getOctreeData()) &&
+           sameArray(expected.getTrianglesSets(), loaded->getTrianglesSets()) &&
+           sameArray(expected.getTrianglesMasks(), loaded->getTrianglesMasks()) &&
+           sameQueries(expected, *loaded, numSamples);
+}
+
+bool compareGrids(const UniformGridSdf& expected, const SdfFunction* loadedSdf, uint32_t numSamples)
+{
+    const UniformGridSdf* loaded = dynamic_cast<const UniformGridSdf*>(loadedSdf);
+    if(loaded == nullptr)
+    {
+        SPDLOG_ERROR("The file has not been loaded as a grid");
+        return false;
+    }
+
+    return sameBox(expected.getGridBoundingBox(), loaded->getGridBoundingBox()) &&
+           expected.getGridSize() == loaded->getGridSize() &&
+           sameArray(expected.getGrid(), loaded->getGrid()) &&
+           sameQueries(expected, *loaded, numSamples);
+}
+
+// Writes the octree like the versions before the file header, which only supported tricubic octrees
+bool saveLegacyOctree(const OctreeSdf& octree, const std::string& path)
+{
+    std::ofstream os(path, std::ios::out | std::ios::binary);
+    if(!os.is_open()) return false;
+
+    cereal::PortableBinaryOutputArchive archive(os);
+    SdfFunction::SdfFormat format = SdfFunction::SdfFormat::OCTREE;
+    archive(format);
+    archive(octree.getGridBoundingBox(), octree.getStartGridSize().x);
+    archive(octree.getOctreeMaxDepth(), octree.getOctreeValueRange(), octree.getOctreeMinBorderValue());
+    archive(octree.getOctreeData());
+    return static_cast<bool>(os);
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    spdlog::set_pattern("[%^%l%$] %v");
+
+    args::ArgumentParser parser("SdfSerializationTest saves and loads the structures with all the file variants and checks that they do not change", "");
+    args::HelpFlag help(parser, "help", "Display help menu", {'h', "help"});
+    args::Positional<std::string> modelPathArg(parser, "model_path", "The model used to build the structures. By default, an isosphere is used");
+    args::ValueFlag<std::string> outputFolderArg(parser, "output_folder", "Folder where the temporal files are stored", {'o', "output_folder"});
+    args::ValueFlag<uint32_t> depthArg(parser, "depth", "The maximum depth of the octrees", {'d', "depth"});
+    args::ValueFlag<uint32_t> numSamplesArg(parser, "num_samples", "Number of queries compared for each structure", {"num_samples"});
+    args::ValueFlag<uint32_t> numThreadsArg(parser, "num_threads", "Number of threads used to build the structures", {"num_threads"});
+
+    try
+    {
+        parser.ParseCLI(argc, argv);
+    }
+    catch(args::Help)
+    {
+        std::cerr << parser;
+        return 0;
+    }
+    catch(args::Error& e)
+    {
+        std::cerr << e.what() << std::endl;
+        std::cerr << parser;
+        return 1;
+    }
+
+    const uint32_t depth = (depthArg) ? args::get(depthArg) : 6;
+    const uint32_t numSamples = (numSamplesArg) ? args::get(numSamplesArg) : 10000;
+    const uint32_t numThreads = (numThreadsArg) ? args::get(numThreadsArg) : 1;
+    const std::filesystem::path outputFolder = (outputFolderArg) ? std::filesystem::path(args::get(outputFolderArg))
+                                                                 : std::filesystem::temp_directory_path();
+
+    std::shared_ptr<Mesh> mesh = (modelPathArg) ? std::make_shared<Mesh>(args::get(modelPathArg))
+                                                : PrimitivesFactory::getIsosphere(3);
+    mesh->computeBoundingBox();
+    BoundingBox box = mesh->getBoundingBox();
+    const glm::vec3 modelBBSize = box.getSize();
+    box.addMargin(0.2f * glm::max(glm::max(modelBBSize.x, modelBBSize.y), modelBBSize.z));
+
+    // The anisotropic start grid needs a box longer in one axis
+    BoundingBox longBox = box;
+    longBox.max.x += box.getSize().x;
+
+    OctreeSdf octree(*mesh, box, depth, 3, 1e-3f, OctreeSdf::InitAlgorithm::CONTINUITY, numThreads);
+    OctreeSdf sharedOctree(*mesh, box, depth, 3, 1e-3f, OctreeSdf::InitAlgorithm::CONTINUITY, numThreads,
+                           OctreeSdf::InterpolationType::TRILINEAR);
+    sharedOctree.shareVertices();
+    OctreeSdf lodOctree(*mesh, box, depth, 3, 1e-3f, OctreeSdf::InitAlgorithm::CONTINUITY, numThreads);
+    lodOctree.computeLevelOfDetail();
+    OctreeSdf anisotropicOctree(*mesh, longBox, depth, 3, 1e-3f, OctreeSdf::InitAlgorithm::CONTINUITY, numThreads,
+                                OctreeSdf::InterpolationType::TRICUBIC, 0.0f, true);
+    ExactOctreeSdf exactOctree(*mesh, box, depth, 3, 32, numThreads, 0.0f, false, true);
+    ExactOctreeSdf anisotropicExactOctree(*mesh, longBox, depth, 3, 32, numThreads, 0.0f, true);
+    UniformGridSdf grid(*mesh, box, 5u);
+
+    struct Check
+    {
+        std::string name;
+        std::function<bool(const std::string& path)> run;
+    };
+
+    const std::vector<Check> checks =
+    {
+        { "grid", [&](const std::string& path) {
+            return compareGrids(grid, saveAndLoad(grid, path, false).get(), numSamples);
+        }},
+        { "grid_compressed", [&](const std::string& path) {
+            return compareGrids(grid, saveAndLoad(grid, path, true).get(), numSamples);
+        }},
+        { "octree", [&](const std::string& path) {
+            return compareOctrees(octree, saveAndLoad(octree, path, false).get(), numSamples);
+        }},
+        { "octree_compressed", [&](const std::string& path) {
+            return compareOctrees(octree, saveAndLoad(octree, path, true).get(), numSamples);
+        }},
+        { "octree_shared_vertices", [&](const std::string& path) {
+            return compareOctrees(sharedOctree, saveAndLoad(sharedOctree, path, false).get(), numSamples);
+        }},
+        { "octree_shared_vertices_compressed", [&](const std::string& path) {
+            return compareOctrees(sharedOctree, saveAndLoad(sharedOctree, path, true).get(), numSamples);
+        }},
+        { "octree_level_of_detail", [&](const std::string& path) {
+            std::unique_ptr<SdfFunction> loaded = saveAndLoad(lodOctree, path, false);
+            return compareOctrees(lodOctree, loaded.get(), numSamples) &&
+                   sameLevelOfDetail(lodOctree, loaded.get(), numSamples);
+        }},
+        { "octree_anisotropic", [&](const std::string& path) {
+            return compareOctrees(anisotropicOctree, saveAndLoad(anisotropicOctree, path, false).get(), numSamples);
+        }},
+        { "octree_legacy", [&](const std::string& path) {
+            if(!saveLegacyOctree(octree, path)) return false;
+            return compareOctrees(octree, SdfFunction::loadFromFile(path).get(), numSamples);
+        }},
+        { "exact_octree_compact", [&](const std::string& path) {
+            return compareExactOctrees(exactOctree, saveAndLoad(exactOctree, path, false).get(), numSamples);
+        }},
+        { "exact_octree_compact_compressed", [&](const std::string& path) {
+            return compareExactOctrees(exactOctree, saveAndLoad(exactOctree, path, true).get(), numSamples);
+        }},
+        { "exact_octree_triangles_data", [&](const std::string& path) {
+            // It releases the mesh, so it runs after the compact checks
+            exactOctree.setCompactSerialization(false);
+            return compareExactOctrees(exactOctree, saveAndLoad(exactOctree, path, false).get(), numSamples);
+        }},
+        { "exact_octree_anisotropic", [&](const std::string& path) {
+            return compareExactOctrees(anisotropicExactOctree, saveAndLoad(anisotropicExactOctree, path, false).get(), numSamples);
+        }},
+        { "truncated_file", [&](const std::string& path) {
+            // A truncated file must be rejected instead of returning a broken structure
+            if(!octree.saveToFile(path)) return false;
+            std::filesystem::resize_file(path, std::filesystem::file_size(path) / 2);
+            return SdfFunction::loadFromFile(path) == nullptr;
+        }},
+        { "corrupted_array_size", [&](const std::string& path) {
+            // A huge size of the octree array must be rejected instead of throwing the allocation error.
+            // The size follows the header, the archive endianness, the format, the box and the octree properties
+            if(!octree.saveToFile(path)) return false;
+            constexpr std::streamoff OCTREE_SIZE_OFFSET = 12 + 1 + 4 + 24 + 4 + 12;
+            std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+            file.seekp(OCTREE_SIZE_OFFSET);
+            const char hugeSize[8] = { -1, -1, -1, -1, -1, -1, -1, 0x7F };
+            file.write(hugeSize, sizeof(hugeSize));
+            file.close();
+            return SdfFunction::loadFromFile(path) == nullptr;
+        }}
+    };
+
+    uint32_t numFailed = 0;
+    for(const Check& check : checks)
+    {
+        const std::string path = (outputFolder / ("sdflib_serialization_" + check.name + ".bin")).string();
+        const bool passed = check.run(path);
+        std::error_code error;
+        std::filesystem::remove(path, error);
+
+        std::cout << ((passed) ? "[PASS] " : "[FAIL] ") << check.name << std::endl;
+        if(!passed) numFailed++;
+    }
+
+    std::cout << checks.size() - numFailed << "/" << checks.size() << " checks passed" << std::endl;
+    return (numFailed > 0) ? 1 : 0;
+}
@@ -122,6 +122,11 @@ public:
 					break;
 				case SdfFunction::SdfFormat::OCTREE:
 					mSdfFormat = SdfFormat::OCTREE;
+					if(!SdfOctreePlaneShader::isSupported(*reinterpret_cast<OctreeSdf*>(sdfFunc.get())))
+					{
+						SPDLOG_ERROR("Only the octrees with tricubic interpolation and without shared vertices are supported.");
+						return;
+					}
 					octreeSdf = std::move(*reinterpret_cast<OctreeSdf*>(sdfFunc.get()));
 					sdfBB = octreeSdf.getGridBoundingBox();
 					viewBB = octreeSdf.getGridBoundingBox();
@@ -0,0 +1,622 @@
+#include "SdfLib/utils/BlockCompression.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <limits>
+
+namespace sdflib
+{
+namespace BlockCompression
+{
+namespace
+{
+    thread_local bool compressionEnabled = false;
+    thread_local uint32_t compressionNumThreads = 1;
+
+    inline uint32_t floatToOrderedInt(uint32_t bits)
+    {
+        return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+    }
+
+    inline uint32_t orderedIntToFloat(uint32_t value)
+    {
+        return (value & 0x80000000u) ? (value & 0x7FFFFFFFu) : ~value;
+    }
+
+    inline uint32_t zigZagEncode(uint32_t delta)
+    {
+        const int32_t d = static_cast<int32_t>(delta);
+        return (static_cast<uint32_t>(d) << 1) ^ static_cast<uint32_t>(d >> 31);
+    }
+
+    inline uint32_t zigZagDecode(uint32_t value)
+    {
+        return (value >> 1) ^ (~(value & 1) + 1);
+    }
+
+    inline uint32_t getBitsWidth(uint32_t value)
+    {
+        uint32_t width = 0;
+        while(value > 0) { width++; value >>= 1; }
+        return width;
+    }
+
+    // Frame of reference of a group of values
+    inline void getGroupRange(const uint32_t* values, uint32_t numValues, uint32_t& outMin, uint32_t& outWidth)
+    {
+        uint32_t minValue = values[0];
+        uint32_t maxValue = values[0];
+        for(uint32_t i=1; i < numValues; i++)
+        {
+            minValue = std::min(minValue, values[i]);
+            maxValue = std::max(maxValue, values[i]);
+        }
+        outMin = minValue;
+        outWidth = getBitsWidth(maxValue - minValue);
+    }
+
+    void writeVarInt(std::vector<uint8_t>& out, uint32_t value)
+    {
+        while(value >= 0x80)
+        {
+            out.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    bool readVarInt(const uint8_t*& data, const uint8_t* end, uint32_t& outValue)
+    {
+        outValue = 0;
+        for(uint32_t shift=0; shift < 35; shift += 7)
+        {
+            if(data >= end) return false;
+            const uint8_t byte = *data++;
+            outValue |= static_cast<uint32_t>(byte & 0x7F) << shift;
+            if((byte & 0x80) == 0) return true;
+        }
+        return false;
+    }
+
+    // Float words are divided in the sign and exponent plane and the mantissa plane, which are coded separately
+    static constexpr uint32_t MANTISSA_BITS = 23;
+    static constexpr uint32_t MANTISSA_MASK = (1u << MANTISSA_BITS) - 1;
+
+    // Writes a group of values using the values or their differences, the one needing less bits
+    void compressGroup(const uint32_t* values, uint32_t numValues, uint32_t& previous, std::vector<uint8_t>& out)
+    {
+        std::array<uint32_t, GROUP_VALUES> deltas;
+        for(uint32_t i=0; i < numValues; i++)
+        {
+            deltas[i] = zigZagEncode(values[i] - previous);
+            previous = values[i];
+        }
+
+        uint32_t valuesMin, valuesWidth;
+        getGroupRange(values, numValues, valuesMin, valuesWidth);
+        uint32_t deltasMin, deltasWidth;
+        getGroupRange(deltas.data(), numValues, deltasMin, deltasWidth);
+
+        const bool useDeltas = deltasWidth < valuesWidth;
+        const uint32_t* groupValues = (useDeltas) ? deltas.data() : values;
+        const uint32_t groupMin = (useDeltas) ? deltasMin : valuesMin;
+        const uint32_t width = (useDeltas) ? deltasWidth : valuesWidth;
+
+        // Group header: the delta coding flag and the bits per value
+        out.push_back(static_cast<uint8_t>(((useDeltas) ? 0x80 : 0) | width));
+        writeVarInt(out, groupMin);
+
+        // The values are packed starting from the least significant bit
+        uint64_t bitsBuffer = 0;
+        uint32_t bitsInBuffer = 0;
+        for(uint32_t i=0; i < numValues && width > 0; i++)
+        {
+            bitsBuffer |= static_cast<uint64_t>(groupValues[i] - groupMin) << bitsInBuffer;
+            bitsInBuffer += width;
+            while(bitsInBuffer >= 8)
+            {
+                out.push_back(static_cast<uint8_t>(bitsBuffer & 0xFF));
+                bitsBuffer >>= 8;
+                bitsInBuffer -= 8;
+            }
+        }
+        if(bitsInBuffer > 0) out.push_back(static_cast<uint8_t>(bitsBuffer & 0xFF));
+    }
+
+    bool decompressGroup(const uint8_t*& data, const uint8_t* end, uint32_t numValues, uint32_t& previous, uint32_t* outValues)
+    {
+        if(data >= end) return false;
+        const uint8_t header = *data++;
+        const bool useDeltas = (header & 0x80) != 0;
+        const uint32_t width = header & 0x3F;
+        uint32_t groupMin;
+        if(width > 32 || !readVarInt(data, end, groupMin)) return false;
+
+        const size_t groupBytes = (static_cast<size_t>(numValues) * width + 7) / 8;
+        if(static_cast<size_t>(end - data) < groupBytes) return false;
+
+        const uint64_t mask = (width == 32) ? 0xFFFFFFFFull : ((1ull << width) - 1);
+        uint64_t bitsBuffer = 0;
+        uint32_t bitsInBuffer = 0;
+        for(uint32_t i=0; i < numValues; i++)
+        {
+            while(bitsInBuffer < width)
+            {
+                bitsBuffer |= static_cast<uint64_t>(*data++) << bitsInBuffer;
+                bitsInBuffer += 8;
+            }
+
+            const uint32_t value = groupMin + static_cast<uint32_t>(bitsBuffer & mask);
+            bitsBuffer >>= width;
+            bitsInBuffer -= width;
+
+            outValues[i] = (useDeltas) ? previous + zigZagDecode(value) : value;
+            previous = outValues[i];
+        }
+        return true;
+    }
+
+    void compressBlock(const uint32_t* values, uint32_t numValues, Codec codec, std::vector<uint8_t>& out)
+    {
+        std::array<uint32_t, GROUP_VALUES> highPlane;
+        std::array<uint32_t, GROUP_VALUES> lowPlane;
+        uint32_t previousHigh = 0;
+        uint32_t previousLow = 0;
+        for(uint32_t g=0; g < numValues; g += GROUP_VALUES)
+        {
+            const uint32_t groupSize = std::min(GROUP_VALUES, numValues - g);
+            if(codec == Codec::FLOATS)
+            {
+                for(uint32_t i=0; i < groupSize; i++)
+                {
+                    const uint32_t word = floatToOrderedInt(values[g + i]);
+                    highPlane[i] = word >> MANTISSA_BITS;
+                    lowPlane[i] = word & MANTISSA_MASK;
+                }
+                compressGroup(highPlane.data(), groupSize, previousHigh, out);
+                compressGroup(lowPlane.data(), groupSize, previousLow, out);
+            }
+            else
+            {
+                compressGroup(values + g, groupSize, previousLow, out);
+            }
+        }
+    }
+
+    bool decompressBlock(const uint8_t* blockData, size_t blockSize, uint32_t numValues, Codec codec, uint32_t* outValues)
+    {
+        const uint8_t* data = blockData;
+        const uint8_t* end = blockData + blockSize;
+        std::array<uint32_t, GROUP_VALUES> highPlane;
+        uint32_t previousHigh = 0;
+        uint32_t previousLow = 0;
+        for(uint32_t g=0; g < numValues; g += GROUP_VALUES)
+        {
+            const uint32_t groupSize = std::min(GROUP_VALUES, numValues - g);
+            if(codec == Codec::FLOATS)
+            {
+                if(!decompressGroup(data, end, groupSize, previousHigh, highPlane.data()) ||
+                   !decompressGroup(data, end, groupSize, previousLow, outValues + g))
+                {
+                    return false;
+                }
+
+                for(uint32_t i=0; i < groupSize; i++)
+                {
+                    outValues[g + i] = orderedIntToFloat((highPlane[i] << MANTISSA_BITS) | (outValues[g + i] & MANTISSA_MASK));
+                }
+            }
+            else if(!decompressGroup(data, end, groupSize, previousLow, outValues + g))
+            {
+                return false;
+            }
+        }
+
+        return data == end;
+    }
+
+    CompressedArray joinBlocks(const std::vector<std::vector<uint8_t>>& blocks)
+    {
+        CompressedArray array;
+        array.blocksSize.resize(blocks.size());
+        size_t totalSize = 0;
+        for(size_t b=0; b < blocks.size(); b++)
+        {
+            array.blocksSize[b] = static_cast<uint32_t>(blocks[b].size());
+            totalSize += blocks[b].size();
+        }
+
+        array.data.reserve(totalSize);
+        for(const std::vector<uint8_t>& block : blocks)
+        {
+            array.data.insert(array.data.end(), block.begin(), block.end());
+        }
+
+        return array;
+    }
+
+    // Returns the start of each block in the compressed data
+    bool getBlocksStart(const CompressedArray& array, std::vector<size_t>& outBlocksStart)
+    {
+        outBlocksStart.assign(array.blocksSize.size() + 1, 0);
+        for(size_t b=0; b < array.blocksSize.size(); b++) outBlocksStart[b + 1] = outBlocksStart[b] + array.blocksSize[b];
+        return outBlocksStart.back() == array.data.size();
+    }
+
+    // Bytes are coded as runs of a repeated byte or sequences of literal bytes.
+    // The token header stores the length and if it is a run in the lowest bit
+    static constexpr uint32_t MIN_RUN_BYTES = 3;
+
+    void compressBytesBlock(const uint8_t* values, uint32_t numValues, std::vector<uint8_t>& out)
+    {
+        uint32_t literalStart = 0;
+        uint32_t i = 0;
+        auto writeLiterals = [&](uint32_t literalEnd)
+        {
+            if(literalEnd == literalStart) return;
+            writeVarInt(out, (literalEnd - literalStart) << 1);
+            out.insert(out.end(), values + literalStart, values + literalEnd);
+        };
+
+        while(i < numValues)
+        {
+            uint32_t runEnd = i + 1;
+            while(runEnd < numValues && values[runEnd] == values[i]) runEnd++;
+
+            if(runEnd - i >= MIN_RUN_BYTES)
+            {
+                writeLiterals(i);
+                writeVarInt(out, ((runEnd - i) << 1) | 1);
+                out.push_back(values[i]);
+                literalStart = runEnd;
+            }
+            i = runEnd;
+        }
+        writeLiterals(numValues);
+    }
+
+    bool decompressBytesBlock(const uint8_t* blockData, size_t blockSize, uint32_t numValues, uint8_t* outValues)
+    {
+        const uint8_t* data = blockData;
+        const uint8_t* end = blockData + blockSize;
+        uint32_t numDecoded = 0;
+        while(numDecoded < numValues)
+        {
+            uint32_t header;
+            if(!readVarInt(data, end, header)) return false;
+            const uint32_t length = header >> 1;
+            if(length == 0 || length > numValues - numDecoded) return false;
+
+            if(header & 1)
+            {
+                if(data >= end) return false;
+                std::fill(outValues + numDecoded, outValues + numDecoded + length, *data++);
+            }
+            else
+            {
+                if(static_cast<size_t>(end - data) < length) return false;
+                std::copy(data, data + length, outValues + numDecoded);
+                data += length;
+            }
+            numDecoded += length;
+        }
+
+        return data == end;
+    }
+
+    // Each triangles set block starts with its mode and its number of words
+    enum IndexSetsBlockMode : uint8_t
+    {
+        INDEX_SETS_BLOCK = 0,
+        INTEGERS_BLOCK = 1
+    };
+
+    // The number of indices, the packed indices and an empty word read by the queries unpacking the last index
+    inline uint64_t getSetWords(uint32_t numIndices, uint32_t bitsPerIndex)
+    {
+        return 2 + (static_cast<uint64_t>(numIndices) * bitsPerIndex + 31) / 32;
+    }
+
+    // Unpacks an index like the ExactOctreeSdf queries
+    inline uint32_t unpackIndex(const uint32_t* words, uint32_t bIdx, uint32_t bitsPerIndex)
+    {
+        const uint32_t idx = bIdx >> 5;
+        const uint32_t bit = bIdx & 0b0011111;
+        return ((words[idx] << bit) >> (32 - bitsPerIndex)) |
+               static_cast<uint32_t>(static_cast<uint64_t>(words[idx + 1]) >> (64 - (bit + bitsPerIndex)));
+    }
+
+    // Packs an index like the ExactOctreeSdf construction
+    inline void packIndex(uint32_t* words, uint32_t bIdx, uint32_t bitsPerIndex, uint32_t index)
+    {
+        const uint32_t idx = bIdx >> 5;
+        const uint32_t bit = bIdx & 0b0011111;
+        words[idx] |= (index << (32 - bitsPerIndex)) >> bit;
+        words[idx + 1] |= static_cast<uint32_t>(static_cast<uint64_t>(index) << (64 - (bit + bitsPerIndex)));
+    }
+
+    void compressIndexSetsBlock(const uint32_t* values, uint32_t numValues, uint32_t bitsPerIndex, std::vector<uint8_t>& out)
+    {
+        out.push_back(IndexSetsBlockMode::INDEX_SETS_BLOCK);
+        writeVarInt(out, numValues);
+        uint32_t pos = 0;
+        while(pos < numValues)
+        {
+            const uint32_t numIndices = values[pos];
+            writeVarInt(out, numIndices);
+            uint32_t previous = 0;
+            for(uint32_t t=0; t < numIndices; t++)
+            {
+                const uint32_t index = unpackIndex(values + pos + 1, t * bitsPerIndex, bitsPerIndex);
+                writeVarInt(out, zigZagEncode(index - previous));
+                previous = index;
+            }
+            pos += static_cast<uint32_t>(getSetWords(numIndices, bitsPerIndex));
+        }
+    }
+
+    bool decompressIndexSetsBlock(const uint8_t* blockData, size_t blockSize, uint32_t numValues, uint32_t bitsPerIndex, uint32_t* outValues)
+    {
+        const uint8_t* data = blockData;
+        const uint8_t* end = blockData + blockSize;
+        if(data >= end) return false;
+        const uint8_t mode = *data++;
+        uint32_t blockValues;
+        if(!readVarInt(data, end, blockValues) || blockValues != numValues) return false;
+
+        if(mode == IndexSetsBlockMode::INTEGERS_BLOCK)
+        {
+            return decompressBlock(data, static_cast<size_t>(end - data), numValues, Codec::INTEGERS, outValues);
+        }
+        else if(mode != IndexSetsBlockMode::INDEX_SETS_BLOCK || bitsPerIndex == 0 || bitsPerIndex > 32)
+        {
+            return false;
+        }
+
+        uint32_t pos = 0;
+        while(pos < numValues)
+        {
+            uint32_t numIndices;
+            if(!readVarInt(data, end, numIndices)) return false;
+            const uint64_t setWords = getSetWords(numIndices, bitsPerIndex);
+            if(setWords > numValues - pos) return false;
+
+            uint32_t* setValues = outValues + pos;
+            std::fill(setValues, setValues + setWords, 0u);
+            setValues[0] = numIndices;
+            uint32_t previous = 0;
+            for(uint32_t t=0; t < numIndices; t++)
+            {
+                uint32_t delta;
+                if(!readVarInt(data, end, delta)) return false;
+                previous += zigZagDecode(delta);
+                if(bitsPerIndex < 32 && (previous >> bitsPerIndex) != 0) return false;
+                packIndex(setValues + 1, t * bitsPerIndex, bitsPerIndex, previous);
+            }
+            pos += static_cast<uint32_t>(setWords);
+        }
+
+        return data == end;
+    }
+
+    /**
+     * @brief Divides the triangles sets in blocks of whole sets with around BLOCK_VALUES words
+     * @return If the array is a sequence of sets, otherwise the blocks have BLOCK_VALUES words
+     **/
+    bool getIndexSetsBlocks(const uint32_t* values, size_t numValues, uint32_t bitsPerIndex, std::vector<size_t>& outBlocksStart)
+    {
+        outBlocksStart.clear();
+        bool validSets = bitsPerIndex > 0 && bitsPerIndex <= 32;
+        size_t pos = 0;
+        size_t blockStart = 0;
+        while(validSets && pos < numValues)
+        {
+            if(pos - blockStart >= BLOCK_VALUES)
+            {
+                outBlocksStart.push_back(blockStart);
+                blockStart = pos;
+            }
+
+            const uint64_t setWords = getSetWords(values[pos], bitsPerIndex);
+            // The blocks store their number of words in 32 bits
+            validSets = setWords <= numValues - pos && pos + setWords - blockStart <= std::numeric_limits<uint32_t>::max();
+            pos += static_cast<size_t>(setWords);
+        }
+
+        if(validSets)
+        {
+            if(numValues > 0) outBlocksStart.push_back(blockStart);
+        }
+        else
+        {
+            outBlocksStart.clear();
+            for(size_t start=0; start < numValues; start += BLOCK_VALUES) outBlocksStart.push_back(start);
+        }
+        outBlocksStart.push_back(numValues);
+
+        return validSets;
+    }
+}
+
+CompressedArray compress(const uint32_t* values, size_t numValues, Codec codec, uint32_t numThreads)
+{
+    const size_t numBlocks = (numValues + BLOCK_VALUES - 1) / BLOCK_VALUES;
+    std::vector<std::vector<uint8_t>> blocks(numBlocks);
+
+    #ifdef OPENMP_AVAILABLE
+    #pragma omp parallel for num_threads(numThreads) schedule(dynamic, 1)
+    #endif
+    for(int b=0; b < static_cast<int>(numBlocks); b++)
+    {
+        const size_t start = static_cast<size_t>(b) * BLOCK_VALUES;
+        const uint32_t blockValues = static_cast<uint32_t>(std::min(static_cast<size_t>(BLOCK_VALUES), numValues - start));
+        compressBlock(values + start, blockValues, codec, blocks[b]);
+    }
+
+    return joinBlocks(blocks);
+}
+
+bool decompress(const CompressedArray& array, size_t numValues, Codec codec, uint32_t* outValues, uint32_t numThreads)
+{
+    const size_t numBlocks = (numValues + BLOCK_VALUES - 1) / BLOCK_VALUES;
+    std::vector<size_t> blocksStart;
+    if(array.blocksSize.size() != numBlocks || !getBlocksStart(array, blocksStart)) return false;
+
+    std::atomic<bool> valid(true);
+    #ifdef OPENMP_AVAILABLE
+    #pragma omp parallel for num_threads(numThreads) schedule(dynamic, 1)
+    #endif
+    for(int b=0; b < static_cast<int>(numBlocks); b++)
+    {
+        const size_t start = static_cast<size_t>(b) * BLOCK_VALUES;
+        const uint32_t blockValues = static_cast<uint32_t>(std::min(static_cast<size_t>(BLOCK_VALUES), numValues - start));
+        if(!decompressBlock(array.data.data() + blocksStart[b], array.blocksSize[b], blockValues, codec, outValues + start))
+        {
+            valid.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    return valid.load();
+}
+
+CompressedArray compressBytes(const uint8_t* values, size_t numValues, uint32_t numThreads)
+{
+    const size_t numBlocks = (numValues + BLOCK_BYTES - 1) / BLOCK_BYTES;
+    std::vector<std::vector<uint8_t>> blocks(numBlocks);
+
+    #ifdef OPENMP_AVAILABLE
+    #pragma omp parallel for num_threads(numThreads) schedule(dynamic, 1)
+    #endif
+    for(int b=0; b < static_cast<int>(numBlocks); b++)
+    {
+        const size_t start = static_cast<size_t>(b) * BLOCK_BYTES;
+        const uint32_t blockValues = static_cast<uint32_t>(std::min(static_cast<size_t>(BLOCK_BYTES), numValues - start));
+        compressBytesBlock(values + start, blockValues, blocks[b]);
+    }
+
+    return joinBlocks(blocks);
+}
+
+bool decompressBytes(const CompressedArray& array, size_t numValues, uint8_t* outValues, uint32_t numThreads)
+{
+    const size_t numBlocks = (numValues + BLOCK_BYTES - 1) / BLOCK_BYTES;
+    std::vector<size_t> blocksStart;
+    if(array.blocksSize.size() != numBlocks || !getBlocksStart(array, blocksStart)) return false;
+
+    std::atomic<bool> valid(true);
+    #ifdef OPENMP_AVAILABLE
+    #pragma omp parallel for num_threads(numThreads) schedule(dynamic, 1)
+    #endif
+    for(int b=0; b < static_cast<int>(numBlocks); b++)
+    {
+        const size_t start = static_cast<size_t>(b) * BLOCK_BYTES;
+        const uint32_t blockValues = static_cast<uint32_t>(std::min(static_cast<size_t>(BLOCK_BYTES), numValues - start));
+        if(!decompressBytesBlock(array.data.data() + blocksStart[b], array.blocksSize[b], blockValues, outValues + start))
+        {
+            valid.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    return valid.load();
+}
+
+CompressedArray compressIndexSets(const uint32_t* values, size_t numValues, uint32_t bitsPerIndex, uint32_t numThreads)
+{
+    std::vector<size_t> valuesStart;
+    const bool validSets = getIndexSetsBlocks(values, numValues, bitsPerIndex, valuesStart);
+    const size_t numBlocks = valuesStart.size() - 1;
+    std::vector<std::vector<uint8_t>> blocks(numBlocks);
+
+    #ifdef OPENMP_AVAILABLE
+    #pragma omp parallel for num_threads(numThreads) schedule(dynamic, 1)
+    #endif
+    for(int b=0; b < static_cast<int>(numBlocks); b++)
+    {
+        const uint32_t* blockValues = values + valuesStart[b];
+        const uint32_t blockNumValues = static_cast<uint32_t>(valuesStart[b + 1] - valuesStart[b]);
+        std::vector<uint8_t>& block = blocks[b];
+
+        block.push_back(IndexSetsBlockMode::INTEGERS_BLOCK);
+        writeVarInt(block, blockNumValues);
+        compressBlock(blockValues, blockNumValues, Codec::INTEGERS, block);
+
+        // The sets with bits outside their indices cannot be rebuilt from the indices.
+        // The integers coding is also kept when it is smaller, like with very few bits per index
+        if(validSets)
+        {
+            std::vector<uint8_t> setsBlock;
+            compressIndexSetsBlock(blockValues, blockNumValues, bitsPerIndex, setsBlock);
+            if(setsBlock.size() < block.size())
+            {
+                std::vector<uint32_t> decoded(blockNumValues);
+                if(decompressIndexSetsBlock(setsBlock.data(), setsBlock.size(), blockNumValues, bitsPerIndex, decoded.data()) &&
+                   std::equal(decoded.begin(), decoded.end(), blockValues))
+                {
+                    block.swap(setsBlock);
+                }
+            }
+        }
+    }
+
+    return joinBlocks(blocks);
+}
+
+bool decompressIndexSets(const CompressedArray& array, size_t numValues, uint32_t bitsPerIndex, uint32_t* outValues, uint32_t numThreads)
+{
+    std::vector<size_t> blocksStart;
+    if(!getBlocksStart(array, blocksStart)) return false;
+
+    // The blocks have different sizes, their words are read from their headers
+    const size_t numBlocks = array.blocksSize.size();
+    std::vector<size_t> valuesStart(numBlocks + 1, 0);
+    for(size_t b=0; b < numBlocks; b++)
+    {
+        if(array.blocksSize[b] == 0) return false;
+        const uint8_t* data = array.data.data() + blocksStart[b] + 1;
+        uint32_t blockValues;
+        if(!readVarInt(data, array.data.data() + blocksStart[b + 1], blockValues)) return false;
+        valuesStart[b + 1] = valuesStart[b] + blockValues;
+    }
+    if(valuesStart.back() != numValues) return false;
+
+    std::atomic<bool> valid(true);
+    #ifdef OPENMP_AVAILABLE
+    #pragma omp parallel for num_threads(numThreads) schedule(dynamic, 1)
+    #endif
+    for(int b=0; b < static_cast<int>(numBlocks); b++)
+    {
+        const uint32_t blockValues = static_cast<uint32_t>(valuesStart[b + 1] - valuesStart[b]);
+        if(!decompressIndexSetsBlock(array.data.data() + blocksStart[b], array.blocksSize[b], blockValues, bitsPerIndex, outValues + valuesStart[b]))
+        {
+            valid.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    return valid.load();
+}
+
+bool isEnabled()
+{
+    return compressionEnabled;
+}
+
+uint32_t getNumThreads()
+{
+    return compressionNumThreads;
+}
+
+Scope::Scope(bool enabled, uint32_t numThreads)
+    : mPreviousEnabled(compressionEnabled), mPreviousNumThreads(compressionNumThreads)
+{
+    compressionEnabled = enabled;
+    compressionNumThreads = std::max(numThreads, 1u);
+}
+
+Scope::~Scope()
+{
+    compressionEnabled = mPreviousEnabled;
+    compressionNumThreads = mPreviousNumThreads;
+}
+}
+}
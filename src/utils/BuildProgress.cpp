@@ -0,0 +1,52 @@
+#include "SdfLib/utils/BuildProgress.h"
+
+#include <algorithm>
+
+namespace sdflib
+{
+namespace
+{
+    thread_local BuildProgress* currentProgress = nullptr;
+}
+
+BuildProgress::BuildProgress() : mCancelled(false), mFinished(false)
+{
+    for(uint32_t d=0; d <= MAX_DEPTH; d++)
+    {
+        mProcessedNodes[d].store(0, std::memory_order_relaxed);
+        mEstimatedNodes[d].store(0, std::memory_order_relaxed);
+    }
+}
+
+float BuildProgress::getFraction() const
+{
+    if(isFinished()) return 1.0f;
+
+    uint64_t processed = 0;
+    uint64_t estimated = 0;
+    for(uint32_t d=0; d <= MAX_DEPTH; d++)
+    {
+        processed += getProcessedNodes(d);
+        estimated += getEstimatedNodes(d);
+    }
+
+    if(estimated == 0) return 0.0f;
+    // The last steps after the subdivision are not counted
+    return 0.99f * static_cast<float>(std::min(processed, estimated)) / static_cast<float>(estimated);
+}
+
+BuildProgress* BuildProgress::getCurrent()
+{
+    return currentProgress;
+}
+
+BuildProgress::Scope::Scope(BuildProgress* progress) : mPrevious(currentProgress)
+{
+    currentProgress = progress;
+}
+
+BuildProgress::Scope::~Scope()
+{
+    currentProgress = mPrevious;
+}
+}
@@ -1,13 +1,31 @@
 #include "SdfLib/utils/Mesh.h"
+#include "SdfLib/utils/MeshLoader.h"
 #include <iostream>
 #include <assert.h>
 #include <spdlog/spdlog.h>
 
 namespace sdflib
 {
-#ifdef SDFLIB_ASSIMP_AVAILABLE
 Mesh::Mesh(std::string filePath)
 {
+    if(MeshLoader::isFormatSupported(filePath))
+    {
+        if(MeshLoader::load(filePath, *this))
+        {
+            SPDLOG_INFO("Model num vertices: {}", mVertices.size());
+            SPDLOG_INFO("Model num faces: {}", mIndices.size() / 3);
+            computeBoundingBox();
+            SPDLOG_INFO("BB min: {}, {}, {}", mBBox.min.x, mBBox.min.y, mBBox.min.z);
+            SPDLOG_INFO("BB max: {}, {}, {}", mBBox.max.x, mBBox.max.y, mBBox.max.z);
+            computeNormals();
+            return;
+        }
+    #ifdef SDFLIB_ASSIMP_AVAILABLE
+        SPDLOG_INFO("Loading the model {} with assimp", filePath);
+    #endif
+    }
+
+#ifdef SDFLIB_ASSIMP_AVAILABLE
     Assimp::Importer import;
     const aiScene *scene = import.ReadFile(filePath, aiProcess_Triangulate | aiProcess_FlipUVs);
     
@@ -23,8 +41,12 @@ Mesh::Mesh(std::string filePath)
     }
 
     initMesh(scene->mMeshes[0]);       
+#else
+    SPDLOG_ERROR("Cannot load the model {}, the format requires assimp", filePath);
+#endif
 }
 
+#ifdef SDFLIB_ASSIMP_AVAILABLE
 Mesh::Mesh(const aiMesh* mesh)
 {
     initMesh(mesh);
@@ -0,0 +1,980 @@
+#include "SdfLib/utils/MeshLoader.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <sstream>
+#include <string_view>
+#include <spdlog/spdlog.h>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef OPENMP_AVAILABLE
+#include <omp.h>
+#endif
+
+namespace sdflib
+{
+namespace MeshLoader
+{
+namespace
+{
+    // Read only view of a file mapped in memory
+    class MappedFile
+    {
+    public:
+        MappedFile() {}
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        ~MappedFile()
+        {
+        #ifdef _WIN32
+            if(mData != nullptr) UnmapViewOfFile(mData);
+            if(mMapping != NULL) CloseHandle(mMapping);
+            if(mFile != INVALID_HANDLE_VALUE) CloseHandle(mFile);
+        #else
+            if(mData != nullptr) munmap(const_cast<char*>(mData), mSize);
+            if(mFd >= 0) close(mFd);
+        #endif
+        }
+
+        bool open(const std::string& filePath)
+        {
+        #ifdef _WIN32
+            mFile = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                                OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+            if(mFile == INVALID_HANDLE_VALUE) return false;
+            LARGE_INTEGER fileSize;
+            if(!GetFileSizeEx(mFile, &fileSize)) return false;
+            mSize = static_cast<size_t>(fileSize.QuadPart);
+            if(mSize == 0) return true;
+            mMapping = CreateFileMappingA(mFile, NULL, PAGE_READONLY, 0, 0, NULL);
+            if(mMapping == NULL) return false;
+            mData = static_cast<const char*>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+            return mData != nullptr;
+        #else
+            mFd = ::open(filePath.c_str(), O_RDONLY);
+            if(mFd < 0) return false;
+            struct stat fileStat;
+            if(fstat(mFd, &fileStat) != 0) return false;
+            mSize = static_cast<size_t>(fileStat.st_size);
+            if(mSize == 0) return true;
+            void* data = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, mFd, 0);
+            if(data == MAP_FAILED) return false;
+            madvise(data, mSize, MADV_SEQUENTIAL);
+            mData = static_cast<const char*>(data);
+            return true;
+        #endif
+        }
+
+        const char* data() const { return mData; }
+        size_t size() const { return mSize; }
+    private:
+        const char* mData = nullptr;
+        size_t mSize = 0;
+    #ifdef _WIN32
+        HANDLE mFile = INVALID_HANDLE_VALUE;
+        HANDLE mMapping = NULL;
+    #else
+        int mFd = -1;
+    #endif
+    };
+
+    uint32_t getNumThreads(uint32_t numThreads)
+    {
+    #ifdef OPENMP_AVAILABLE
+        return (numThreads > 0) ? numThreads : static_cast<uint32_t>(omp_get_max_threads());
+    #else
+        return 1;
+    #endif
+    }
+
+    // Range of elements processed by a thread
+    inline std::pair<size_t, size_t> getThreadRange(size_t numElements, uint32_t threadId, uint32_t numThreads)
+    {
+        return std::make_pair((numElements * threadId) / numThreads, (numElements * (threadId + 1)) / numThreads);
+    }
+
+    bool isHostLittleEndian()
+    {
+        const uint16_t value = 1;
+        uint8_t firstByte;
+        std::memcpy(&firstByte, &value, 1);
+        return firstByte == 1;
+    }
+
+    template<typename T>
+    inline T readValue(const char* ptr, bool swapBytes)
+    {
+        std::array<char, sizeof(T)> bytes;
+        std::memcpy(bytes.data(), ptr, sizeof(T));
+        if(swapBytes) std::reverse(bytes.begin(), bytes.end());
+        T value;
+        std::memcpy(&value, bytes.data(), sizeof(T));
+        return value;
+    }
+
+    std::string getExtension(const std::string& filePath)
+    {
+        const size_t dotPos = filePath.find_last_of('.');
+        if(dotPos == std::string::npos) return "";
+        std::string ext = filePath.substr(dotPos + 1);
+        std::transform(ext.begin(), ext.end(), ext.begin(), [](char c) { return static_cast<char>(std::tolower(c)); });
+        return ext;
+    }
+
+    // Binary STL
+
+    bool loadBinaryStl(const MappedFile& file, std::vector<glm::vec3>& vertices, std::vector<uint32_t>& indices, uint32_t numThreads)
+    {
+        const size_t headerSize = 84;
+        const size_t triangleSize = 50;
+        if(file.size() < headerSize)
+        {
+            SPDLOG_ERROR("The STL file is too small");
+            return false;
+        }
+
+        const bool swapBytes = !isHostLittleEndian();
+        const uint32_t numTriangles = readValue<uint32_t>(file.data() + 80, swapBytes);
+        const size_t expectedSize = headerSize + triangleSize * static_cast<size_t>(numTriangles);
+
+        // Some binary headers also start with "solid", the ASCII files have the first facet just after the name
+        const std::string_view start(file.data(), std::min(file.size(), static_cast<size_t>(512)));
+        const bool isAscii = start.compare(0, 5, "solid") == 0 && start.find("facet") != std::string_view::npos;
+        if(isAscii && expectedSize != file.size())
+        {
+            SPDLOG_ERROR("ASCII STL files are not supported by the native loader");
+            return false;
+        }
+
+        // Some exporters add padding or extra bytes after the triangles
+        if(file.size() < expectedSize)
+        {
+            SPDLOG_ERROR("The STL file is smaller than its number of triangles");
+            return false;
+        }
+
+        vertices.resize(3 * static_cast<size_t>(numTriangles));
+        indices.resize(3 * static_cast<size_t>(numTriangles));
+        const char* data = file.data() + headerSize;
+
+        #ifdef OPENMP_AVAILABLE
+        #pragma omp parallel for num_threads(numThreads) schedule(static)
+        #endif
+        for(int64_t t=0; t < static_cast<int64_t>(numTriangles); t++)
+        {
+            // Skip the normal of the face
+            const char* triangle = data + triangleSize * t + 12;
+            for(uint32_t v=0; v < 3; v++)
+            {
+                glm::vec3& vertex = vertices[3 * t + v];
+                vertex.x = readValue<float>(triangle + 12 * v, swapBytes);
+                vertex.y = readValue<float>(triangle + 12 * v + 4, swapBytes);
+                vertex.z = readValue<float>(triangle + 12 * v + 8, swapBytes);
+                indices[3 * t + v] = static_cast<uint32_t>(3 * t + v);
+            }
+        }
+
+        return true;
+    }
+
+    // Binary PLY
+
+    enum class PlyType { INT8, UINT8, INT16, UINT16, INT32, UINT32, FLOAT32, FLOAT64, INVALID };
+
+    struct PlyProperty
+    {
+        std::string name;
+        PlyType type = PlyType::INVALID;
+        bool isList = false;
+        PlyType countType = PlyType::INVALID;
+    };
+
+    struct PlyElement
+    {
+        std::string name;
+        size_t count = 0;
+        std::vector<PlyProperty> properties;
+    };
+
+    PlyType getPlyType(const std::string& name)
+    {
+        if(name == "char" || name == "int8") return PlyType::INT8;
+        if(name == "uchar" || name == "uint8") return PlyType::UINT8;
+        if(name == "short" || name == "int16") return PlyType::INT16;
+        if(name == "ushort" || name == "uint16") return PlyType::UINT16;
+        if(name == "int" || name == "int32") return PlyType::INT32;
+        if(name == "uint" || name == "uint32") return PlyType::UINT32;
+        if(name == "float" || name == "float32") return PlyType::FLOAT32;
+        if(name == "double" || name == "float64") return PlyType::FLOAT64;
+        return PlyType::INVALID;
+    }
+
+    size_t getPlyTypeSize(PlyType type)
+    {
+        switch(type)
+        {
+            case PlyType::INT8: case PlyType::UINT8: return 1;
+            case PlyType::INT16: case PlyType::UINT16: return 2;
+            case PlyType::INT32: case PlyType::UINT32: case PlyType::FLOAT32: return 4;
+            case PlyType::FLOAT64: return 8;
+            default: return 0;
+        }
+    }
+
+    inline double readPlyValue(const char* ptr, PlyType type, bool swapBytes)
+    {
+        switch(type)
+        {
+            case PlyType::INT8: return static_cast<double>(readValue<int8_t>(ptr, false));
+            case PlyType::UINT8: return static_cast<double>(readValue<uint8_t>(ptr, false));
+            case PlyType::INT16: return static_cast<double>(readValue<int16_t>(ptr, swapBytes));
+            case PlyType::UINT16: return static_cast<double>(readValue<uint16_t>(ptr, swapBytes));
+            case PlyType::INT32: return static_cast<double>(readValue<int32_t>(ptr, swapBytes));
+            case PlyType::UINT32: return static_cast<double>(readValue<uint32_t>(ptr, swapBytes));
+            case PlyType::FLOAT32: return static_cast<double>(readValue<float>(ptr, swapBytes));
+            case PlyType::FLOAT64: return readValue<double>(ptr, swapBytes);
+            default: return 0.0;
+        }
+    }
+
+    inline uint32_t readPlyIndex(const char* ptr, PlyType type, bool swapBytes)
+    {
+        switch(type)
+        {
+            case PlyType::INT8: return static_cast<uint32_t>(readValue<int8_t>(ptr, false));
+            case PlyType::UINT8: return readValue<uint8_t>(ptr, false);
+            case PlyType::INT16: return static_cast<uint32_t>(readValue<int16_t>(ptr, swapBytes));
+            case PlyType::UINT16: return readValue<uint16_t>(ptr, swapBytes);
+            case PlyType::INT32: return static_cast<uint32_t>(readValue<int32_t>(ptr, swapBytes));
+            case PlyType::UINT32: return readValue<uint32_t>(ptr, swapBytes);
+            default: return static_cast<uint32_t>(readPlyValue(ptr, type, swapBytes));
+        }
+    }
+
+    bool loadBinaryPly(const MappedFile& file, std::vector<glm::vec3>& vertices, std::vector<uint32_t>& indices, uint32_t numThreads)
+    {
+        const char* data = file.data();
+        const char* end = file.data() + file.size();
+
+        // Parse the header
+        const char* headerEndStr = "end_header";
+        const char* headerEnd = std::search(data, end, headerEndStr, headerEndStr + std::strlen(headerEndStr));
+        if(file.size() < 3 || std::strncmp(data, "ply", 3) != 0 || headerEnd == end)
+        {
+            SPDLOG_ERROR("Invalid PLY header");
+            return false;
+        }
+
+        std::vector<PlyElement> elements;
+        bool littleEndian = true;
+        {
+            std::string header(data, headerEnd);
+            std::istringstream headerStream(header);
+            std::string line;
+            while(std::getline(headerStream, line))
+            {
+                std::istringstream lineStream(line);
+                std::string keyword;
+                lineStream >> keyword;
+                if(keyword == "format")
+                {
+                    std::string format;
+                    lineStream >> format;
+                    if(format == "binary_little_endian") littleEndian = true;
+                    else if(format == "binary_big_endian") littleEndian = false;
+                    else
+                    {
+                        SPDLOG_ERROR("The PLY format {} is not supported by the native loader", format);
+                        return false;
+                    }
+                }
+                else if(keyword == "element")
+                {
+                    PlyElement element;
+                    lineStream >> element.name >> element.count;
+                    elements.push_back(element);
+                }
+                else if(keyword == "property" && !elements.empty())
+                {
+                    PlyProperty property;
+                    std::string type;
+                    lineStream >> type;
+                    if(type == "list")
+                    {
+                        std::string countType;
+                        lineStream >> countType >> type;
+                        property.isList = true;
+                        property.countType = getPlyType(countType);
+                        if(property.countType == PlyType::INVALID)
+                        {
+                            SPDLOG_ERROR("Unknown PLY type {}", countType);
+                            return false;
+                        }
+                    }
+                    property.type = getPlyType(type);
+                    if(property.type == PlyType::INVALID)
+                    {
+                        SPDLOG_ERROR("Unknown PLY type {}", type);
+                        return false;
+                    }
+                    lineStream >> property.name;
+                    elements.back().properties.push_back(property);
+                }
+            }
+        }
+
+        const bool swapBytes = littleEndian != isHostLittleEndian();
+
+        // The body starts after the end of the header line
+        const char* ptr = std::find(headerEnd, end, '\n');
+        if(ptr == end)
+        {
+            SPDLOG_ERROR("Invalid PLY header");
+            return false;
+        }
+        ptr++;
+
+        bool verticesFound = false;
+        bool facesFound = false;
+        for(const PlyElement& element : elements)
+        {
+            bool hasLists = false;
+            size_t stride = 0;
+            for(const PlyProperty& p : element.properties)
+            {
+                hasLists = hasLists || p.isList;
+                stride += getPlyTypeSize(p.type);
+            }
+
+            if(element.name == "vertex" && !hasLists)
+            {
+                std::array<int, 3> offsets = {-1, -1, -1};
+                std::array<PlyType, 3> types;
+                size_t offset = 0;
+                for(const PlyProperty& p : element.properties)
+                {
+                    const int axis = (p.name == "x") ? 0 : (p.name == "y") ? 1 : (p.name == "z") ? 2 : -1;
+                    if(axis >= 0)
+                    {
+                        offsets[axis] = static_cast<int>(offset);
+                        types[axis] = p.type;
+                    }
+                    offset += getPlyTypeSize(p.type);
+                }
+
+                if(offsets[0] < 0 || offsets[1] < 0 || offsets[2] < 0)
+                {
+                    SPDLOG_ERROR("The PLY vertices do not have the x, y, z properties");
+                    return false;
+                }
+
+                if(static_cast<size_t>(end - ptr) < stride * element.count)
+                {
+                    SPDLOG_ERROR("The PLY file is truncated");
+                    return false;
+                }
+
+                vertices.resize(element.count);
+                #ifdef OPENMP_AVAILABLE
+                #pragma omp parallel for num_threads(numThreads) schedule(static)
+                #endif
+                for(int64_t v=0; v < static_cast<int64_t>(element.count); v++)
+                {
+                    const char* vertex = ptr + stride * v;
+                    vertices[v] = glm::vec3(static_cast<float>(readPlyValue(vertex + offsets[0], types[0], swapBytes)),
+                                            static_cast<float>(readPlyValue(vertex + offsets[1], types[1], swapBytes)),
+                                            static_cast<float>(readPlyValue(vertex + offsets[2], types[2], swapBytes)));
+                }
+
+                ptr += stride * element.count;
+                verticesFound = true;
+            }
+            else if(element.name == "face" &&
+                    element.properties.size() == 1 && element.properties[0].isList &&
+                    static_cast<size_t>(end - ptr) >= element.count * (getPlyTypeSize(element.properties[0].countType) + 3 * getPlyTypeSize(element.properties[0].type)) &&
+                    (element.count == 0 || readPlyIndex(ptr, element.properties[0].countType, swapBytes) == 3))
+            {
+                // Fast path for the meshes only containing triangles,
+                // the faces have a fixed size and can be parsed in parallel
+                const PlyProperty& p = element.properties[0];
+                const size_t countSize = getPlyTypeSize(p.countType);
+                const size_t indexSize = getPlyTypeSize(p.type);
+                const size_t faceSize = countSize + 3 * indexSize;
+
+                indices.resize(3 * element.count);
+                bool onlyTriangles = true;
+                #ifdef OPENMP_AVAILABLE
+                #pragma omp parallel for num_threads(numThreads) schedule(static) reduction(&&:onlyTriangles)
+                #endif
+                for(int64_t f=0; f < static_cast<int64_t>(element.count); f++)
+                {
+                    const char* face = ptr + faceSize * f;
+                    onlyTriangles = onlyTriangles && readPlyIndex(face, p.countType, swapBytes) == 3;
+                    for(uint32_t i=0; i < 3; i++)
+                    {
+                        indices[3 * f + i] = readPlyIndex(face + countSize + indexSize * i, p.type, swapBytes);
+                    }
+                }
+
+                if(!onlyTriangles)
+                {
+                    // Parse again with the general path
+                    indices.clear();
+                    const char* facePtr = ptr;
+                    for(size_t f=0; f < element.count; f++)
+                    {
+                        const uint32_t numFaceVertices = readPlyIndex(facePtr, p.countType, swapBytes);
+                        facePtr += countSize;
+                        if(static_cast<size_t>(end - facePtr) < numFaceVertices * indexSize)
+                        {
+                            SPDLOG_ERROR("The PLY file is truncated");
+                            return false;
+                        }
+                        // Triangulate the polygon as a fan
+                        const uint32_t first = readPlyIndex(facePtr, p.type, swapBytes);
+                        for(uint32_t i=2; i < numFaceVertices; i++)
+                        {
+                            indices.push_back(first);
+                            indices.push_back(readPlyIndex(facePtr + indexSize * (i - 1), p.type, swapBytes));
+                            indices.push_back(readPlyIndex(facePtr + indexSize * i, p.type, swapBytes));
+                        }
+                        facePtr += numFaceVertices * indexSize;
+                    }
+                    ptr = facePtr;
+                }
+                else
+                {
+                    ptr += faceSize * element.count;
+                }
+                facesFound = true;
+            }
+            else if(!hasLists)
+            {
+                ptr += stride * element.count;
+            }
+            else
+            {
+                // Elements with lists have a variable size and must be read sequentially
+                const bool isFace = element.name == "face";
+                for(size_t e=0; e < element.count; e++)
+                {
+                    for(const PlyProperty& p : element.properties)
+                    {
+                        const size_t typeSize = getPlyTypeSize(p.type);
+                        if(!p.isList)
+                        {
+                            ptr += typeSize;
+                            continue;
+                        }
+
+                        if(ptr + getPlyTypeSize(p.countType) > end)
+                        {
+                            SPDLOG_ERROR("The PLY file is truncated");
+                            return false;
+                        }
+                        const uint32_t listSize = readPlyIndex(ptr, p.countType, swapBytes);
+                        ptr += getPlyTypeSize(p.countType);
+                        if(static_cast<size_t>(end - ptr) < listSize * typeSize)
+                        {
+                            SPDLOG_ERROR("The PLY file is truncated");
+                            return false;
+                        }
+
+                        if(isFace && (p.name == "vertex_indices" || p.name == "vertex_index") && listSize >= 3)
+                        {
+                            const uint32_t first = readPlyIndex(ptr, p.type, swapBytes);
+                            for(uint32_t i=2; i < listSize; i++)
+                            {
+                                indices.push_back(first);
+                                indices.push_back(readPlyIndex(ptr + typeSize * (i - 1), p.type, swapBytes));
+                                indices.push_back(readPlyIndex(ptr + typeSize * i, p.type, swapBytes));
+                            }
+                        }
+                        ptr += listSize * typeSize;
+                    }
+                }
+                facesFound = facesFound || isFace;
+            }
+
+            if(ptr > end)
+            {
+                SPDLOG_ERROR("The PLY file is truncated");
+                return false;
+            }
+        }
+
+        if(!verticesFound || !facesFound)
+        {
+            SPDLOG_ERROR("The PLY file does not contain a triangle mesh");
+            return false;
+        }
+
+        return true;
+    }
+
+    // OBJ
+
+    inline bool isLineSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+    inline void skipSpaces(const char*& ptr, const char* end)
+    {
+        while(ptr < end && isLineSpace(*ptr)) ptr++;
+    }
+
+    inline void skipLine(const char*& ptr, const char* end)
+    {
+        while(ptr < end && *ptr != '\n') ptr++;
+        if(ptr < end) ptr++;
+    }
+
+    // Fast locale independent float parsing, the result can differ from strtof in the last bit
+    inline bool parseFloat(const char*& ptr, const char* end, float& outValue)
+    {
+        static const double powersOf10[] =
+        {
+            1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+            1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+        };
+
+        skipSpaces(ptr, end);
+        bool negative = false;
+        if(ptr < end && (*ptr == '-' || *ptr == '+'))
+        {
+            negative = *ptr == '-';
+            ptr++;
+        }
+
+        uint64_t mantissa = 0;
+        int exponent = 0;
+        uint32_t numDigits = 0;
+        while(ptr < end && *ptr >= '0' && *ptr <= '9')
+        {
+            if(numDigits < 19) { mantissa = 10 * mantissa + (*ptr - '0'); numDigits++; }
+            else exponent++;
+            ptr++;
+        }
+        bool hasDigits = numDigits > 0 || exponent > 0;
+
+        if(ptr < end && *ptr == '.')
+        {
+            ptr++;
+            while(ptr < end && *ptr >= '0' && *ptr <= '9')
+            {
+                if(numDigits < 19) { mantissa = 10 * mantissa + (*ptr - '0'); numDigits++; exponent--; }
+                ptr++;
+                hasDigits = true;
+            }
+        }
+
+        if(!hasDigits) return false;
+
+        if(ptr < end && (*ptr == 'e' || *ptr == 'E'))
+        {
+            ptr++;
+            bool negativeExp = false;
+            if(ptr < end && (*ptr == '-' || *ptr == '+'))
+            {
+                negativeExp = *ptr == '-';
+                ptr++;
+            }
+            int exp = 0;
+            while(ptr < end && *ptr >= '0' && *ptr <= '9')
+            {
+                if(exp < 10000) exp = 10 * exp + (*ptr - '0');
+                ptr++;
+            }
+            exponent += (negativeExp) ? -exp : exp;
+        }
+
+        double value = static_cast<double>(mantissa);
+        if(exponent < 0) value = (exponent >= -22) ? value / powersOf10[-exponent] : value * std::pow(10.0, exponent);
+        else if(exponent > 0) value = (exponent <= 22) ? value * powersOf10[exponent] : value * std::pow(10.0, exponent);
+
+        outValue = static_cast<float>((negative) ? -value : value);
+        return true;
+    }
+
+    inline bool parseInt(const char*& ptr, const char* end, int64_t& outValue)
+    {
+        skipSpaces(ptr, end);
+        bool negative = false;
+        if(ptr < end && (*ptr == '-' || *ptr == '+'))
+        {
+            negative = *ptr == '-';
+            ptr++;
+        }
+        if(ptr >= end || *ptr < '0' || *ptr > '9') return false;
+        int64_t value = 0;
+        while(ptr < end && *ptr >= '0' && *ptr <= '9')
+        {
+            value = 10 * value + (*ptr - '0');
+            ptr++;
+        }
+        outValue = (negative) ? -value : value;
+        return true;
+    }
+
+    inline bool isVertexLine(const char* ptr, const char* end)
+    {
+        return ptr + 1 < end && ptr[0] == 'v' && isLineSpace(ptr[1]);
+    }
+
+    bool loadObj(const MappedFile& file, std::vector<glm::vec3>& vertices, std::vector<uint32_t>& indices, uint32_t numThreads)
+    {
+        const char* data = file.data();
+        const char* end = file.data() + file.size();
+
+        // Split the file in chunks starting at the beginning of a line
+        const uint32_t numChunks = std::max(1u, std::min(4 * numThreads, static_cast<uint32_t>(file.size() / 65536) + 1));
+        std::vector<const char*> chunksStart(numChunks + 1);
+        chunksStart[0] = data;
+        chunksStart[numChunks] = end;
+        for(uint32_t c=1; c < numChunks; c++)
+        {
+            const char* ptr = data + (file.size() * c) / numChunks;
+            ptr = std::max(ptr, chunksStart[c-1]);
+            while(ptr < end && *(ptr - 1) != '\n') ptr++;
+            chunksStart[c] = ptr;
+        }
+
+        // The relative indices need the number of vertices defined before each chunk
+        std::vector<uint64_t> chunkVerticesStart(numChunks + 1, 0);
+        #ifdef OPENMP_AVAILABLE
+        #pragma omp parallel for num_threads(numThreads) schedule(dynamic, 1)
+        #endif
+        for(int32_t c=0; c < static_cast<int32_t>(numChunks); c++)
+        {
+            uint64_t numVertices = 0;
+            const char* ptr = chunksStart[c];
+            while(ptr < chunksStart[c+1])
+            {
+                skipSpaces(ptr, chunksStart[c+1]);
+                if(isVertexLine(ptr, chunksStart[c+1])) numVertices++;
+                skipLine(ptr, chunksStart[c+1]);
+            }
+            chunkVerticesStart[c+1] = numVertices;
+        }
+
+        for(uint32_t c=0; c < numChunks; c++)
+        {
+            chunkVerticesStart[c+1] += chunkVerticesStart[c];
+        }
+
+        const uint64_t numVertices = chunkVerticesStart[numChunks];
+        if(numVertices >= std::numeric_limits<uint32_t>::max())
+        {
+            SPDLOG_ERROR("The OBJ file has too many vertices");
+            return false;
+        }
+        vertices.resize(numVertices);
+
+        std::vector<std::vector<uint32_t>> chunkIndices(numChunks);
+        bool validFile = true;
+        #ifdef OPENMP_AVAILABLE
+        #pragma omp parallel for num_threads(numThreads) schedule(dynamic, 1) reduction(&&:validFile)
+        #endif
+        for(int32_t c=0; c < static_cast<int32_t>(numChunks); c++)
+        {
+            const char* chunkEnd = chunksStart[c+1];
+            const char* ptr = chunksStart[c];
+            uint64_t vertexIndex = chunkVerticesStart[c];
+            std::vector<uint32_t>& outIndices = chunkIndices[c];
+            std::vector<uint32_t> faceIndices;
+            while(ptr < chunkEnd && validFile)
+            {
+                skipSpaces(ptr, chunkEnd);
+                if(isVertexLine(ptr, chunkEnd))
+                {
+                    ptr += 2;
+                    glm::vec3& vertex = vertices[vertexIndex++];
+                    if(!parseFloat(ptr, chunkEnd, vertex.x) ||
+                       !parseFloat(ptr, chunkEnd, vertex.y) ||
+                       !parseFloat(ptr, chunkEnd, vertex.z))
+                    {
+                        validFile = false;
+                    }
+                }
+                else if(ptr + 1 < chunkEnd && ptr[0] == 'f' && isLineSpace(ptr[1]))
+                {
+                    ptr += 2;
+                    faceIndices.clear();
+                    int64_t index;
+                    while(parseInt(ptr, chunkEnd, index))
+                    {
+                        // Negative indices are relative to the last vertex defined
+                        const int64_t absIndex = (index < 0) ? static_cast<int64_t>(vertexIndex) + index : index - 1;
+                        if(absIndex < 0 || absIndex >= static_cast<int64_t>(numVertices))
+                        {
+                            validFile = false;
+                            break;
+                        }
+                        faceIndices.push_back(static_cast<uint32_t>(absIndex));
+                        // Skip texture and normal indices
+                        while(ptr < chunkEnd && !isLineSpace(*ptr) && *ptr != '\n') ptr++;
+                    }
+
+                    // Triangulate the polygon as a fan
+                    for(size_t i=2; i < faceIndices.size(); i++)
+                    {
+                        outIndices.push_back(faceIndices[0]);
+                        outIndices.push_back(faceIndices[i-1]);
+                        outIndices.push_back(faceIndices[i]);
+                    }
+                }
+                skipLine(ptr, chunkEnd);
+            }
+        }
+
+        if(!validFile)
+        {
+            SPDLOG_ERROR("The OBJ file contains invalid vertices or faces");
+            return false;
+        }
+
+        // Join the triangles of all the chunks
+        std::vector<size_t> chunkIndicesStart(numChunks + 1, 0);
+        for(uint32_t c=0; c < numChunks; c++)
+        {
+            chunkIndicesStart[c+1] = chunkIndicesStart[c] + chunkIndices[c].size();
+        }
+        indices.resize(chunkIndicesStart[numChunks]);
+        #ifdef OPENMP_AVAILABLE
+        #pragma omp parallel for num_threads(numThreads) schedule(dynamic, 1)
+        #endif
+        for(int32_t c=0; c < static_cast<int32_t>(numChunks); c++)
+        {
+            std::copy(chunkIndices[c].begin(), chunkIndices[c].end(), indices.begin() + chunkIndicesStart[c]);
+        }
+
+        if(indices.empty())
+        {
+            SPDLOG_ERROR("The OBJ file does not contain any triangle");
+            return false;
+        }
+
+        return true;
+    }
+}
+
+bool isFormatSupported(const std::string& filePath)
+{
+    const std::string ext = getExtension(filePath);
+    return ext == "stl" || ext == "ply" || ext == "obj";
+}
+
+bool load(const std::string& filePath, Mesh& outMesh, uint32_t numThreads)
+{
+    const std::string ext = getExtension(filePath);
+    numThreads = getNumThreads(numThreads);
+
+    MappedFile file;
+    if(!file.open(filePath))
+    {
+        SPDLOG_ERROR("Cannot open file {}", filePath);
+        return false;
+    }
+
+    if(file.size() == 0)
+    {
+        SPDLOG_ERROR("The file {} is empty", filePath);
+        return false;
+    }
+
+    std::vector<glm::vec3> vertices;
+    std::vector<uint32_t> indices;
+    bool loaded = false;
+    if(ext == "stl") loaded = loadBinaryStl(file, vertices, indices, numThreads);
+    else if(ext == "ply") loaded = loadBinaryPly(file, vertices, indices, numThreads);
+    else if(ext == "obj") loaded = loadObj(file, vertices, indices, numThreads);
+    else SPDLOG_ERROR("The format of {} is not supported by the native loader", filePath);
+
+    if(!loaded) return false;
+
+    const uint32_t numVertices = static_cast<uint32_t>(vertices.size());
+    const bool validIndices = std::all_of(indices.begin(), indices.end(), [numVertices](uint32_t i) { return i < numVertices; });
+    if(!validIndices)
+    {
+        SPDLOG_ERROR("The model {} has indices out of range", filePath);
+        return false;
+    }
+
+    weldVertices(vertices, indices, numThreads);
+
+    outMesh.getVertices() = std::move(vertices);
+    outMesh.getIndices() = std::move(indices);
+    return true;
+}
+
+void weldVertices(std::vector<glm::vec3>& vertices, std::vector<uint32_t>& indices, uint32_t numThreads)
+{
+    numThreads = getNumThreads(numThreads);
+    const size_t numVertices = vertices.size();
+    if(numVertices == 0) return;
+
+    // The vertices are distributed in buckets by the hash of their position,
+    // then each bucket is welded independently
+    constexpr uint32_t NUM_BUCKETS_BITS = 10;
+    constexpr uint32_t NUM_BUCKETS = 1 << NUM_BUCKETS_BITS;
+
+    auto getKey = [&](size_t v) -> std::array<uint32_t, 3>
+    {
+        // Adding zero converts -0.0 to 0.0
+        const glm::vec3 pos = vertices[v] + glm::vec3(0.0f);
+        std::array<uint32_t, 3> key;
+        std::memcpy(key.data(), &pos, sizeof(key));
+        return key;
+    };
+
+    auto getBucket = [&](size_t v) -> uint32_t
+    {
+        const std::array<uint32_t, 3> key = getKey(v);
+        uint64_t h = key[0] * 0x9E3779B97F4A7C15ull;
+        h ^= key[1] * 0xC2B2AE3D27D4EB4Full + (h << 6) + (h >> 2);
+        h ^= key[2] * 0x165667B19E3779F9ull + (h << 6) + (h >> 2);
+        h ^= h >> 31;
+        h *= 0xBF58476D1CE4E5B9ull;
+        return static_cast<uint32_t>(h >> (64 - NUM_BUCKETS_BITS));
+    };
+
+    // Count the vertices of each bucket per thread
+    std::vector<uint32_t> vertexBucket(numVertices);
+    std::vector<std::vector<size_t>> threadBucketOffset(numThreads, std::vector<size_t>(NUM_BUCKETS, 0));
+    #ifdef OPENMP_AVAILABLE
+    #pragma omp parallel for num_threads(numThreads) schedule(static, 1)
+    #endif
+    for(int32_t t=0; t < static_cast<int32_t>(numThreads); t++)
+    {
+        const std::pair<size_t, size_t> range = getThreadRange(numVertices, t, numThreads);
+        for(size_t v=range.first; v < range.second; v++)
+        {
+            vertexBucket[v] = getBucket(v);
+            threadBucketOffset[t][vertexBucket[v]]++;
+        }
+    }
+
+    std::vector<size_t> bucketStart(NUM_BUCKETS + 1, 0);
+    {
+        size_t offset = 0;
+        for(uint32_t b=0; b < NUM_BUCKETS; b++)
+        {
+            bucketStart[b] = offset;
+            for(uint32_t t=0; t < numThreads; t++)
+            {
+                const size_t count = threadBucketOffset[t][b];
+                threadBucketOffset[t][b] = offset;
+                offset += count;
+            }
+        }
+        bucketStart[NUM_BUCKETS] = offset;
+    }
+
+    // Sort the vertices by bucket keeping the original order inside each bucket
+    std::vector<uint32_t> sortedVertices(numVertices);
+    #ifdef OPENMP_AVAILABLE
+    #pragma omp parallel for num_threads(numThreads) schedule(static, 1)
+    #endif
+    for(int32_t t=0; t < static_cast<int32_t>(numThreads); t++)
+    {
+        const std::pair<size_t, size_t> range = getThreadRange(numVertices, t, numThreads);
+        for(size_t v=range.first; v < range.second; v++)
+        {
+            sortedVertices[threadBucketOffset[t][vertexBucket[v]]++] = static_cast<uint32_t>(v);
+        }
+    }
+
+    // Find the first appearance of each position
+    std::vector<uint32_t> representative(numVertices);
+    #ifdef OPENMP_AVAILABLE
+    #pragma omp parallel for num_threads(numThreads) schedule(dynamic, 8)
+    #endif
+    for(int32_t b=0; b < static_cast<int32_t>(NUM_BUCKETS); b++)
+    {
+        auto first = sortedVertices.begin() + bucketStart[b];
+        auto last = sortedVertices.begin() + bucketStart[b+1];
+        std::sort(first, last, [&](uint32_t lhs, uint32_t rhs)
+        {
+            const std::array<uint32_t, 3> lhsKey = getKey(lhs);
+            const std::array<uint32_t, 3> rhsKey = getKey(rhs);
+            return (lhsKey != rhsKey) ? lhsKey < rhsKey : lhs < rhs;
+        });
+
+        for(auto it = first; it != last;)
+        {
+            const uint32_t rep = *it;
+            const std::array<uint32_t, 3> repKey = getKey(rep);
+            for(; it != last && getKey(*it) == repKey; ++it)
+            {
+                representative[*it] = rep;
+            }
+        }
+    }
+
+    // Compute the new index of the unique vertices with a parallel prefix sum
+    std::vector<uint32_t> newIndex(numVertices);
+    std::vector<uint32_t> threadUniqueStart(numThreads + 1, 0);
+    #ifdef OPENMP_AVAILABLE
+    #pragma omp parallel for num_threads(numThreads) schedule(static, 1)
+    #endif
+    for(int32_t t=0; t < static_cast<int32_t>(numThreads); t++)
+    {
+        const std::pair<size_t, size_t> range = getThreadRange(numVertices, t, numThreads);
+        uint32_t count = 0;
+        for(size_t v=range.first; v < range.second; v++)
+        {
+            if(representative[v] == v) count++;
+        }
+        threadUniqueStart[t+1] = count;
+    }
+
+    for(uint32_t t=0; t < numThreads; t++)
+    {
+        threadUniqueStart[t+1] += threadUniqueStart[t];
+    }
+
+    std::vector<glm::vec3> uniqueVertices(threadUniqueStart[numThreads]);
+    #ifdef OPENMP_AVAILABLE
+    #pragma omp parallel for num_threads(numThreads) schedule(static, 1)
+    #endif
+    for(int32_t t=0; t < static_cast<int32_t>(numThreads); t++)
+    {
+        const std::pair<size_t, size_t> range = getThreadRange(numVertices, t, numThreads);
+        uint32_t index = threadUniqueStart[t];
+        for(size_t v=range.first; v < range.second; v++)
+        {
+            if(representative[v] == v)
+            {
+                uniqueVertices[index] = vertices[v];
+                newIndex[v] = index++;
+            }
+        }
+    }
+
+    #ifdef OPENMP_AVAILABLE
+    #pragma omp parallel for num_threads(numThreads) schedule(static)
+    #endif
+    for(int64_t i=0; i < static_cast<int64_t>(indices.size()); i++)
+    {
+        indices[i] = newIndex[representative[indices[i]]];
+    }
+
+    SPDLOG_INFO("Welded {} vertices into {}", numVertices, uniqueVertices.size());
+    vertices = std::move(uniqueVertices);
+}
+}
+}
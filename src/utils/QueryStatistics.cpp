@@ -0,0 +1,151 @@
+#include "SdfLib/utils/QueryStatistics.h"
+
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <cmath>
+
+namespace sdflib
+{
+void QueryStatistics::merge(const QueryStatistics& other)
+{
+    numQueries += other.numQueries;
+    numNodesVisited += other.numNodesVisited;
+    numTrianglesTested += other.numTrianglesTested;
+    numOutOfBoxQueries += other.numOutOfBoxQueries;
+    maxDepthReached = std::max(maxDepthReached, other.maxDepthReached);
+    for(uint32_t i=0; i < MAX_DEPTH; i++) depthHistogram[i] += other.depthHistogram[i];
+
+    numLatencySamples += other.numLatencySamples;
+    for(uint32_t i=0; i < LATENCY_BINS; i++) latencyHistogram[i] += other.latencyHistogram[i];
+}
+
+void QueryStatistics::reset()
+{
+    *this = QueryStatistics();
+}
+
+float QueryStatistics::getMeanNodesVisited() const
+{
+    return (numQueries > 0) ? static_cast<float>(numNodesVisited) / static_cast<float>(numQueries) : 0.0f;
+}
+
+float QueryStatistics::getMeanTrianglesTested() const
+{
+    return (numQueries > 0) ? static_cast<float>(numTrianglesTested) / static_cast<float>(numQueries) : 0.0f;
+}
+
+float QueryStatistics::getMeanDepth() const
+{
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    for(uint32_t d=0; d < MAX_DEPTH; d++)
+    {
+        count += depthHistogram[d];
+        sum += d * depthHistogram[d];
+    }
+    return (count > 0) ? static_cast<float>(sum) / static_cast<float>(count) : 0.0f;
+}
+
+float QueryStatistics::getLatencyPercentile(float p) const
+{
+    if(numLatencySamples == 0) return 0.0f;
+    const uint64_t target = std::max(static_cast<uint64_t>(std::ceil(p * static_cast<double>(numLatencySamples))), uint64_t(1));
+    uint64_t accum = 0;
+    for(uint32_t i=0; i < LATENCY_BINS; i++)
+    {
+        accum += latencyHistogram[i];
+        if(accum >= target)
+        {
+            // Upper limit of the bin
+            return std::exp2(static_cast<float>(i + 1) / static_cast<float>(LATENCY_BINS_PER_OCTAVE));
+        }
+    }
+    return std::exp2(static_cast<float>(LATENCY_BINS) / static_cast<float>(LATENCY_BINS_PER_OCTAVE));
+}
+
+namespace QueryStats
+{
+namespace
+{
+    struct ThreadStatistics;
+
+    std::mutex registryMutex;
+    std::vector<ThreadStatistics*> registry;
+    std::array<QueryStatistics, NUM_STRUCTURES> finishedThreadsStatistics;
+    std::atomic<uint32_t> latencySampleRate(64);
+
+    // Each thread writes its own counters, they are merged when the statistics are collected
+    struct ThreadStatistics
+    {
+        ThreadStatistics()
+        {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            registry.push_back(this);
+        }
+
+        ~ThreadStatistics()
+        {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            for(uint32_t s=0; s < NUM_STRUCTURES; s++) finishedThreadsStatistics[s].merge(stats[s]);
+            registry.erase(std::find(registry.begin(), registry.end(), this));
+        }
+
+        std::array<QueryStatistics, NUM_STRUCTURES> stats;
+        uint32_t queryCounter = 0;
+    };
+
+    thread_local ThreadStatistics threadStatistics;
+}
+
+QueryStatistics collect(Structure structure)
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    QueryStatistics res = finishedThreadsStatistics[structure];
+    for(const ThreadStatistics* t : registry)
+    {
+        res.merge(t->stats[structure]);
+    }
+    return res;
+}
+
+void reset()
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for(QueryStatistics& s : finishedThreadsStatistics) s.reset();
+    for(ThreadStatistics* t : registry)
+    {
+        for(QueryStatistics& s : t->stats) s.reset();
+    }
+}
+
+void setLatencySampleRate(uint32_t oneEvery)
+{
+    latencySampleRate.store(oneEvery, std::memory_order_relaxed);
+}
+
+namespace internal
+{
+    QueryStatistics& getThreadStatistics(Structure structure)
+    {
+        return threadStatistics.stats[structure];
+    }
+
+    bool sampleLatency()
+    {
+        const uint32_t rate = latencySampleRate.load(std::memory_order_relaxed);
+        return rate > 0 && (++threadStatistics.queryCounter % rate) == 0;
+    }
+
+    void QueryScope::addLatencySample()
+    {
+        const float nanoseconds = static_cast<float>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                        std::chrono::steady_clock::now() - startTime).count());
+        const float bin = std::log2(std::max(nanoseconds, 1.0f)) * static_cast<float>(QueryStatistics::LATENCY_BINS_PER_OCTAVE);
+        stats.latencyHistogram[std::min(static_cast<uint32_t>(bin), QueryStatistics::LATENCY_BINS - 1)]++;
+        stats.numLatencySamples++;
+    }
+}
+}
+}
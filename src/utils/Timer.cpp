@@ -1,5 +1,10 @@
 #include "SdfLib/utils/Timer.h"
 
+#include <mutex>
+#include <fstream>
+#include <algorithm>
+#include <spdlog/spdlog.h>
+
 namespace sdflib
 {
 using namespace std;
@@ -19,4 +24,194 @@ float Timer::getElapsedMicroseconds() {
 int Timer::getElapsedMilliseconds() {
 	return chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - lastTime).count();
 }
-}
\ No newline at end of file
+
+void writeJsonString(std::ostream& out, const std::string& str)
+{
+	out << "\"";
+	for(char c : str)
+	{
+		switch(c)
+		{
+			case '"': out << "\\\""; break;
+			case '\\': out << "\\\\"; break;
+			case '\n': out << "\\n"; break;
+			case '\r': out << "\\r"; break;
+			case '\t': out << "\\t"; break;
+			default:
+				if(static_cast<unsigned char>(c) < 0x20)
+				{
+					const char* hex = "0123456789abcdef";
+					out << "\\u00" << hex[(c >> 4) & 0xF] << hex[c & 0xF];
+				}
+				else out << c;
+		}
+	}
+	out << "\"";
+}
+
+// Profiler
+std::atomic<bool> Profiler::sEnabled(false);
+
+namespace
+{
+	struct ProfilerEvent
+	{
+		std::string name;
+		chrono::time_point<chrono::steady_clock> start;
+		chrono::time_point<chrono::steady_clock> end;
+		Profiler::EventArgs args;
+	};
+
+	struct ThreadEvents;
+
+	std::mutex profilerMutex;
+	std::vector<ThreadEvents*> threadsEvents;
+	// Events of the threads that have already finished
+	std::vector<std::pair<uint32_t, ProfilerEvent>> finishedThreadsEvents;
+	std::vector<std::pair<uint32_t, std::string>> threadsNames;
+	uint32_t nextThreadId = 0;
+
+	// Each thread stores its events in its own buffer to avoid synchronizations
+	struct ThreadEvents
+	{
+		ThreadEvents()
+		{
+			std::lock_guard<std::mutex> lock(profilerMutex);
+			threadId = nextThreadId++;
+			threadsEvents.push_back(this);
+		}
+
+		~ThreadEvents()
+		{
+			std::lock_guard<std::mutex> lock(profilerMutex);
+			for(ProfilerEvent& e : events) finishedThreadsEvents.push_back(std::make_pair(threadId, std::move(e)));
+			threadsEvents.erase(std::find(threadsEvents.begin(), threadsEvents.end(), this));
+		}
+
+		uint32_t threadId;
+		std::mutex eventsMutex; // Only contended while the trace is written
+		std::vector<ProfilerEvent> events;
+	};
+
+	thread_local ThreadEvents tEvents;
+}
+
+void Profiler::setEnabled(bool enabled)
+{
+	sEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+void Profiler::addEvent(const std::string& name,
+						chrono::time_point<chrono::steady_clock> start,
+						chrono::time_point<chrono::steady_clock> end,
+						EventArgs args)
+{
+	std::lock_guard<std::mutex> lock(tEvents.eventsMutex);
+	tEvents.events.push_back(ProfilerEvent{ name, start, end, std::move(args) });
+}
+
+void Profiler::setThreadName(const std::string& name)
+{
+	const uint32_t threadId = tEvents.threadId;
+	std::lock_guard<std::mutex> lock(profilerMutex);
+	threadsNames.push_back(std::make_pair(threadId, name));
+}
+
+bool Profiler::writeChromeTrace(const std::string& outputPath)
+{
+	std::ofstream file(outputPath);
+	if(!file.is_open())
+	{
+		SPDLOG_ERROR("Cannot open file {}", outputPath);
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(profilerMutex);
+
+	// Gather the events of all the threads
+	std::vector<std::pair<uint32_t, ProfilerEvent>> events = finishedThreadsEvents;
+	for(ThreadEvents* t : threadsEvents)
+	{
+		std::lock_guard<std::mutex> eventsLock(t->eventsMutex);
+		for(const ProfilerEvent& e : t->events) events.push_back(std::make_pair(t->threadId, e));
+	}
+
+	chrono::time_point<chrono::steady_clock> origin = chrono::steady_clock::now();
+	for(const auto& e : events) origin = std::min(origin, e.second.start);
+
+	file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+	bool first = true;
+	for(const auto& name : threadsNames)
+	{
+		if(!first) file << ",\n";
+		first = false;
+		file << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << name.first << ", \"args\": {\"name\": ";
+		writeJsonString(file, name.second);
+		file << "}}";
+	}
+
+	for(const auto& e : events)
+	{
+		if(!first) file << ",\n";
+		first = false;
+		const double ts = chrono::duration<double, std::micro>(e.second.start - origin).count();
+		const double dur = chrono::duration<double, std::micro>(e.second.end - e.second.start).count();
+		file << "{\"name\": ";
+		writeJsonString(file, e.second.name);
+		file << ", \"ph\": \"X\", \"pid\": 1, \"tid\": " << e.first << ", \"ts\": " << ts << ", \"dur\": " << dur;
+		if(!e.second.args.empty())
+		{
+			file << ", \"args\": {";
+			for(uint32_t a=0; a < e.second.args.size(); a++)
+			{
+				if(a > 0) file << ", ";
+				writeJsonString(file, e.second.args[a].first);
+				file << ": " << e.second.args[a].second;
+			}
+			file << "}";
+		}
+		file << "}";
+	}
+	file << "\n]}\n";
+
+	return true;
+}
+
+void Profiler::clear()
+{
+	std::lock_guard<std::mutex> lock(profilerMutex);
+	finishedThreadsEvents.clear();
+	for(ThreadEvents* t : threadsEvents)
+	{
+		std::lock_guard<std::mutex> eventsLock(t->eventsMutex);
+		t->events.clear();
+	}
+}
+
+// Scoped timer
+ScopedTimer::ScopedTimer(const char* name)
+	: mEnabled(Profiler::isEnabled()),
+	  mName(name)
+{
+	if(mEnabled) mStartTime = chrono::steady_clock::now();
+}
+
+ScopedTimer::~ScopedTimer()
+{
+	stop();
+}
+
+void ScopedTimer::stop()
+{
+	if(mEnabled)
+	{
+		Profiler::addEvent(mName, mStartTime, chrono::steady_clock::now(), std::move(mArgs));
+		mEnabled = false;
+	}
+}
+
+void ScopedTimer::addArg(const char* name, double value)
+{
+	if(mEnabled) mArgs.push_back(std::make_pair(std::string(name), value));
+}
+}
@@ -1,14 +1,20 @@
 #include "SdfLib/utils/TriangleUtils.h"
 
+#include <limits>
+
 namespace sdflib
 {
 namespace TriangleUtils
 {
     std::vector<TriangleData> calculateMeshTriangleData(const Mesh& mesh)
     {
-        const std::vector<glm::vec3>& vertices = mesh.getVertices();
-        const std::vector<uint32_t> indices = mesh.getIndices();
+        return calculateMeshTriangleData(mesh.getVertices(), mesh.getIndices(), mesh.getBoundingBox());
+    }
 
+    std::vector<TriangleData> calculateMeshTriangleData(const std::vector<glm::vec3>& vertices, 
+                                                        const std::vector<uint32_t>& indices,
+                                                        const BoundingBox& meshBox, uint32_t numThreads)
+    {
         std::vector<TriangleData> triangles(indices.size()/3);
         std::vector<bool> isTriangleDegenerated(indices.size()/3, false);
         std::vector<std::pair<uint32_t, uint32_t>> degeneratedTriangles; // Stores triangle index and vertex index with bigger angle
@@ -18,8 +24,15 @@ namespace TriangleUtils
         std::vector<glm::vec3> verticesNormal(vertices.size(), glm::vec3(0.0f));
 
         // Init triangles
-		for (int i = 0, tIndex = 0; i < indices.size(); i += 3, tIndex++)
+        // Each triangle is independent, and the degenerated triangles are gathered after
+        const int numTriangles = static_cast<int>(indices.size() / 3);
+        std::vector<uint32_t> triangleDegeneratedVertex(numTriangles, std::numeric_limits<uint32_t>::max());
+        #ifdef OPENMP_AVAILABLE
+        #pragma omp parallel for num_threads(numThreads) schedule(static)
+        #endif
+		for (int tIndex = 0; tIndex < numTriangles; tIndex++)
 		{
+            const int i = 3 * tIndex;
             // Mark area zero triangles
             const double zeroAngleThreshold = 1e-6;
             const double degeneratedTriangleValue = 0.006;
@@ -44,8 +57,7 @@ namespace TriangleUtils
 
             if(false && triangleArea < zeroAngleThreshold && triangleDegerancyValue < degeneratedTriangleValue)
             {
-                degeneratedTriangles.push_back(std::make_pair(tIndex, degeneratedVertex));
-                isTriangleDegenerated[tIndex] = true;
+                triangleDegeneratedVertex[tIndex] = degeneratedVertex;
                 triangles[tIndex] = TriangleUtils::TriangleData(vertices[indices[i]], vertices[indices[i + 1]], vertices[indices[i + 2]]);
                 triangles[tIndex].transform[0][2] = 0.0f; triangles[tIndex].transform[1][2] = 0.0f; triangles[tIndex].transform[2][2] = 0.0f;
             }
@@ -55,6 +67,13 @@ namespace TriangleUtils
             }
 		}
 
+        for(int tIndex = 0; tIndex < numTriangles; tIndex++)
+        {
+            if(triangleDegeneratedVertex[tIndex] == std::numeric_limits<uint32_t>::max()) continue;
+            degeneratedTriangles.push_back(std::make_pair(tIndex, triangleDegeneratedVertex[tIndex]));
+            isTriangleDegenerated[tIndex] = true;
+        }
+
         if(degeneratedTriangles.size() > 0)
         {
             SPDLOG_INFO("The mesh has {} degenerated triangles", degeneratedTriangles.size());
@@ -316,8 +335,8 @@ namespace TriangleUtils
             auto newEnd = std::unique(nonManifoldVertices.begin(), nonManifoldVertices.end());
             nonManifoldVertices.erase(newEnd, nonManifoldVertices.end());
 
-            const glm::vec3 bbSize = mesh.getBoundingBox().getSize();
-            const glm::vec3 gridStartPos = mesh.getBoundingBox().min;
+            const glm::vec3 bbSize = meshBox.getSize();
+            const glm::vec3 gridStartPos = meshBox.min;
             const uint32_t axisRes = 2048; 
             const float gridScale = static_cast<float>(axisRes) / glm::max(bbSize.x, glm::max(bbSize.y, bbSize.z));
             const float threshold = 1e-5 / glm::max(bbSize.x, glm::max(bbSize.y, bbSize.z));
@@ -419,7 +438,10 @@ namespace TriangleUtils
             }
         }
 
-        for(int i = 0; i < indices.size(); i++)
+        #ifdef OPENMP_AVAILABLE
+        #pragma omp parallel for num_threads(numThreads) schedule(static)
+        #endif
+        for(int i = 0; i < static_cast<int>(indices.size()); i++)
         {
             triangles[i/3].verticesNormal[i % 3] = triangles[i/3].transform * verticesNormal[indices[i]];
         }